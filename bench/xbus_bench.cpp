@@ -0,0 +1,487 @@
+// Throughput and latency benchmarks for framing, parsing and formatting.
+//
+// A deterministic MTData2 stream is generated (mixed XDIs, some
+// extended-length frames, optional corruption) and every stage is measured
+// twice: once as a tight loop for frames/s and ns/frame, and once with every
+// call timed individually for the p50/p99/max latency. Results are written
+// as JSON so they can be compared between releases.
+#include "xbus.h"
+#include "xbus_parser.h"
+#include "xbus_message_id.h"
+#include "xbus_framer.h"
+#include "xbus_message_builder.h"
+#include "xbus_simd.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef XBUS_BENCH_BUILD_TYPE
+#define XBUS_BENCH_BUILD_TYPE ""
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Payload of the frames that carry padding items, above the 254 byte
+// standard length limit
+constexpr size_t EXTENDED_PAYLOAD_SIZE = 400;
+
+// Unknown XDI used to pad extended frames; the parser skips it
+constexpr uint16_t PADDING_XDI = 0x0810;
+
+// Results are accumulated here so the measured calls are not optimized away
+volatile uint64_t g_sink = 0;
+
+struct Options {
+    size_t frames = 200000;
+    uint32_t seed = 1;
+    double extendedRatio = 0.02;
+    double corruptRatio = 0.01;
+    std::string output;
+};
+
+struct Result {
+    std::string name;
+    size_t frames = 0;
+    double framesPerSecond = 0.0;
+    double nsPerFrame = 0.0;
+    double p50Ns = 0.0;
+    double p99Ns = 0.0;
+    double maxNs = 0.0;
+};
+
+uint64_t elapsedNs(Clock::time_point start, Clock::time_point end) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+double percentile(std::vector<uint64_t>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return static_cast<double>(samples[index]);
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+class XbusBenchmark {
+private:
+    Options m_options;
+    std::mt19937 m_random;
+    
+    // Clean frames, one contiguous buffer with offsets
+    std::vector<uint8_t> m_frameBytes;
+    std::vector<size_t> m_frameOffsets;
+    std::vector<const uint8_t*> m_frames;
+    std::vector<const uint8_t*> m_extended;
+    size_t m_extendedFrames;
+    
+    // Same frames as one serial byte stream, with corruption injected
+    std::vector<uint8_t> m_stream;
+    size_t m_corruptedFrames;
+    
+    // parseMTData2 output, input of the formatting benchmark
+    std::vector<SensorData> m_decoded;
+    char m_text[XbusParser::TEXT_BUFFER_SIZE];
+    
+    uint64_t m_timerOverheadNs;
+    std::vector<Result> m_results;
+
+public:
+    explicit XbusBenchmark(const Options& options)
+        : m_options(options)
+        , m_random(options.seed)
+        , m_extendedFrames(0)
+        , m_corruptedFrames(0)
+        , m_timerOverheadNs(0) {
+    }
+    
+    void run() {
+        generate();
+        m_timerOverheadNs = measureTimerOverhead();
+        
+        runVerifyChecksum();
+        runParseMTData2();
+        runFormatSensorData();
+        runMessageToString();
+        runFormatToBuffer();
+        runFramer();
+    }
+    
+    std::string toJson() const {
+        std::ostringstream json;
+        json << std::fixed;
+        json.precision(1);
+        
+        std::string buildType = XBUS_BENCH_BUILD_TYPE;
+        json << "{\n";
+        json << "  \"benchmark\": \"xbus_bench\",\n";
+        json << "  \"version\": 1,\n";
+        json << "  \"config\": {\n";
+        json << "    \"frames\": " << m_frames.size() << ",\n";
+        json << "    \"seed\": " << m_options.seed << ",\n";
+        json << "    \"extended_frames\": " << m_extendedFrames << ",\n";
+        json << "    \"corrupted_frames\": " << m_corruptedFrames << ",\n";
+        json << "    \"stream_bytes\": " << m_stream.size() << ",\n";
+        json << "    \"simd_level\": \"" << XbusSimd::levelName(XbusSimd::activeLevel()) << "\",\n";
+        json << "    \"build_type\": \"" << jsonEscape(buildType.empty() ? "none" : buildType) << "\"\n";
+        json << "  },\n";
+        json << "  \"timer_overhead_ns\": " << m_timerOverheadNs << ",\n";
+        json << "  \"results\": [\n";
+        for (size_t i = 0; i < m_results.size(); i++) {
+            const Result& result = m_results[i];
+            json << "    {\"name\": \"" << jsonEscape(result.name) << "\", "
+                 << "\"frames\": " << result.frames << ", "
+                 << "\"frames_per_sec\": " << result.framesPerSecond << ", "
+                 << "\"ns_per_frame\": " << result.nsPerFrame << ", "
+                 << "\"p50_ns\": " << result.p50Ns << ", "
+                 << "\"p99_ns\": " << result.p99Ns << ", "
+                 << "\"max_ns\": " << result.maxNs << "}"
+                 << (i + 1 < m_results.size() ? ",\n" : "\n");
+        }
+        json << "  ]\n";
+        json << "}\n";
+        return json.str();
+    }
+    
+    void printSummary(std::ostream& out) const {
+        out << std::left << std::setw(18) << "benchmark" << std::right
+            << std::setw(14) << "frames/s" << std::setw(12) << "ns/frame"
+            << std::setw(10) << "p50" << std::setw(10) << "p99" << std::endl;
+        for (const Result& result : m_results) {
+            out << std::left << std::setw(18) << result.name << std::right << std::fixed << std::setprecision(0)
+                << std::setw(14) << result.framesPerSecond << std::setprecision(1)
+                << std::setw(12) << result.nsPerFrame
+                << std::setw(10) << result.p50Ns << std::setw(10) << result.p99Ns << std::endl;
+        }
+    }
+
+private:
+    // Stream generation
+    
+    void appendItem(std::vector<uint8_t>& payload, uint16_t xdi, size_t size) {
+        payload.push_back(static_cast<uint8_t>(xdi >> 8));
+        payload.push_back(static_cast<uint8_t>(xdi & 0xFF));
+        payload.push_back(static_cast<uint8_t>(size));
+        for (size_t i = 0; i < size; i++) {
+            payload.push_back(static_cast<uint8_t>(m_random()));
+        }
+    }
+    
+    void appendFloats(std::vector<uint8_t>& payload, uint16_t xdi, size_t count, float range) {
+        std::uniform_real_distribution<float> distribution(-range, range);
+        payload.push_back(static_cast<uint8_t>(xdi >> 8));
+        payload.push_back(static_cast<uint8_t>(xdi & 0xFF));
+        payload.push_back(static_cast<uint8_t>(count * 4));
+        for (size_t i = 0; i < count; i++) {
+            float value = distribution(m_random);
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                payload.push_back(static_cast<uint8_t>(bits >> shift));
+            }
+        }
+    }
+    
+    // A typical MTData2 payload: counters and orientation on every frame,
+    // GNSS, time and pressure outputs on a subset
+    std::vector<uint8_t> makePayload(uint16_t packetCounter, bool extended) {
+        std::vector<uint8_t> payload;
+        payload.push_back(static_cast<uint8_t>(XDI::PACKET_COUNTER >> 8));
+        payload.push_back(static_cast<uint8_t>(XDI::PACKET_COUNTER & 0xFF));
+        payload.push_back(2);
+        payload.push_back(static_cast<uint8_t>(packetCounter >> 8));
+        payload.push_back(static_cast<uint8_t>(packetCounter & 0xFF));
+        appendItem(payload, XDI::SAMPLE_TIME_FINE, 4);
+        
+        if (m_random() % 2 == 0) {
+            appendFloats(payload, XDI::EULER_ANGLES, 3, 180.0f);
+        } else {
+            appendFloats(payload, XDI::QUATERNION, 4, 1.0f);
+        }
+        appendItem(payload, XDI::STATUS_WORD, 4);
+        
+        if (m_random() % 4 == 0) {
+            appendItem(payload, XDI::UTC_TIME, 12);
+        }
+        if (m_random() % 4 == 0) {
+            appendItem(payload, XDI::LAT_LON, 12);
+            appendItem(payload, XDI::ALTITUDE_ELLIPSOID, 6);
+            appendItem(payload, XDI::VELOCITY_XYZ, 18);
+        }
+        if (m_random() % 8 == 0) {
+            appendItem(payload, XDI::BAROMETRIC_PRESSURE, 4);
+        }
+        
+        while (extended && payload.size() + 3 < EXTENDED_PAYLOAD_SIZE) {
+            size_t size = std::min<size_t>(EXTENDED_PAYLOAD_SIZE - payload.size() - 3, 200);
+            appendItem(payload, PADDING_XDI, size);
+        }
+        return payload;
+    }
+    
+    void generate() {
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        std::vector<uint8_t> frame(XbusMessageBuilder::messageSize(EXTENDED_PAYLOAD_SIZE + 256));
+        
+        for (size_t n = 0; n < m_options.frames; n++) {
+            bool extended = chance(m_random) < m_options.extendedRatio;
+            std::vector<uint8_t> payload = makePayload(static_cast<uint16_t>(n), extended);
+            size_t size = XbusMessageBuilder::build(frame.data(), frame.size(), XMID_MtData2,
+                                                    payload.data(), static_cast<uint16_t>(payload.size()));
+            if (extended) {
+                m_extendedFrames++;
+            }
+            
+            m_frameOffsets.push_back(m_frameBytes.size());
+            m_frameBytes.insert(m_frameBytes.end(), frame.begin(), frame.begin() + size);
+            
+            // Corrupt a payload or checksum byte of the streamed copy only
+            size_t streamOffset = m_stream.size();
+            m_stream.insert(m_stream.end(), frame.begin(), frame.begin() + size);
+            if (chance(m_random) < m_options.corruptRatio) {
+                size_t position = Xbus::OFFSET_TO_PAYLOAD + m_random() % (size - Xbus::OFFSET_TO_PAYLOAD);
+                m_stream[streamOffset + position] ^= static_cast<uint8_t>(1 + m_random() % 255);
+                m_corruptedFrames++;
+            }
+        }
+        
+        for (size_t offset : m_frameOffsets) {
+            m_frames.push_back(m_frameBytes.data() + offset);
+            if (m_frames.back()[Xbus::OFFSET_TO_LEN] == Xbus::LENGTH_EXTENDER_BYTE) {
+                m_extended.push_back(m_frames.back());
+            }
+        }
+    }
+    
+    // Measurement
+    
+    uint64_t measureTimerOverhead() {
+        std::vector<uint64_t> samples(10000);
+        for (uint64_t& sample : samples) {
+            Clock::time_point start = Clock::now();
+            sample = elapsedNs(start, Clock::now());
+        }
+        return static_cast<uint64_t>(percentile(samples, 0.5));
+    }
+    
+    // Run op(i) for every frame: once untimed for throughput, once with each
+    // call timed for the latency distribution
+    template <typename Op>
+    void measure(const std::string& name, Op op) {
+        measure(name, m_frames.size(), op);
+    }
+    
+    template <typename Op>
+    void measure(const std::string& name, size_t count, Op op) {
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < count; i++) {
+            op(i);
+        }
+        uint64_t totalNs = elapsedNs(start, Clock::now());
+        
+        std::vector<uint64_t> samples(count);
+        for (size_t i = 0; i < count; i++) {
+            Clock::time_point callStart = Clock::now();
+            op(i);
+            uint64_t ns = elapsedNs(callStart, Clock::now());
+            samples[i] = ns > m_timerOverheadNs ? ns - m_timerOverheadNs : 0;
+        }
+        
+        addResult(name, count, totalNs, samples);
+    }
+    
+    void addResult(const std::string& name, size_t frames, uint64_t totalNs, std::vector<uint64_t>& samples) {
+        Result result;
+        result.name = name;
+        result.frames = frames;
+        if (frames > 0 && totalNs > 0) {
+            result.nsPerFrame = static_cast<double>(totalNs) / static_cast<double>(frames);
+            result.framesPerSecond = 1e9 / result.nsPerFrame;
+        }
+        result.p50Ns = percentile(samples, 0.50);
+        result.p99Ns = percentile(samples, 0.99);
+        result.maxNs = samples.empty() ? 0.0 : static_cast<double>(*std::max_element(samples.begin(), samples.end()));
+        m_results.push_back(result);
+    }
+    
+    // Once with the detected SIMD level and once with the scalar byte sum,
+    // over all frames and over the extended frames alone, where the vector
+    // sum pays off
+    void runVerifyChecksum() {
+        auto all = [this](size_t i) {
+            g_sink = g_sink + (Xbus::verifyChecksum(m_frames[i]) ? 1 : 0);
+        };
+        auto extended = [this](size_t i) {
+            g_sink = g_sink + (Xbus::verifyChecksum(m_extended[i]) ? 1 : 0);
+        };
+        measure("verifyChecksum", all);
+        measure("verifyChecksum_extended", m_extended.size(), extended);
+        
+        XbusSimd::Level level = XbusSimd::activeLevel();
+        XbusSimd::setLevel(XbusSimd::Level::Scalar);
+        measure("verifyChecksum_scalar", all);
+        measure("verifyChecksum_extended_scalar", m_extended.size(), extended);
+        XbusSimd::setLevel(level);
+    }
+    
+    void runParseMTData2() {
+        m_decoded.resize(m_frames.size());
+        measure("parseMTData2", [this](size_t i) {
+            XbusParser::parseMTData2(m_frames[i], m_decoded[i]);
+            g_sink = g_sink + m_decoded[i].packetCounter;
+        });
+    }
+    
+    void runFormatSensorData() {
+        measure("formatSensorData", [this](size_t i) {
+            g_sink = g_sink + XbusParser::formatSensorData(m_decoded[i]).size();
+        });
+    }
+    
+    void runMessageToString() {
+        measure("messageToString", [this](size_t i) {
+            g_sink = g_sink + XbusParser::messageToString(m_frames[i]).size();
+        });
+    }
+    
+    // The same text appended to a reused buffer
+    void runFormatToBuffer() {
+        measure("formatSensorData_buffer", [this](size_t i) {
+            XbusTextWriter out(m_text);
+            XbusParser::formatSensorData(m_decoded[i], out);
+            g_sink = g_sink + out.size();
+        });
+        measure("messageToString_buffer", [this](size_t i) {
+            XbusTextWriter out(m_text);
+            XbusParser::messageToString(m_frames[i], out);
+            g_sink = g_sink + out.size();
+        });
+    }
+    
+    // The stream is fed in reads of 32 to 512 bytes, as a serial port would
+    // deliver it. Latency is the time between consecutive frames, including
+    // the writes that completed them.
+    void runFramer() {
+        std::vector<size_t> readSizes;
+        for (size_t offset = 0; offset < m_stream.size();) {
+            size_t size = std::min<size_t>(32 + m_random() % 481, m_stream.size() - offset);
+            readSizes.push_back(size);
+            offset += size;
+        }
+        
+        size_t frames = 0;
+        uint64_t totalNs = 0;
+        {
+            XbusFramer framer;
+            const uint8_t* data = m_stream.data();
+            Clock::time_point start = Clock::now();
+            for (size_t size : readSizes) {
+                frames += framer.feed(data, size, [](const XbusFrame& frame) {
+                    g_sink = g_sink + frame.size;
+                });
+                data += size;
+            }
+            totalNs = elapsedNs(start, Clock::now());
+        }
+        
+        std::vector<uint64_t> samples;
+        samples.reserve(frames);
+        {
+            XbusFramer framer;
+            const uint8_t* data = m_stream.data();
+            XbusFrame frame;
+            Clock::time_point last = Clock::now();
+            for (size_t size : readSizes) {
+                size_t consumed = 0;
+                while (consumed < size) {
+                    consumed += framer.write(data + consumed, size - consumed);
+                    while (framer.nextFrame(frame)) {
+                        Clock::time_point now = Clock::now();
+                        uint64_t ns = elapsedNs(last, now);
+                        samples.push_back(ns > m_timerOverheadNs ? ns - m_timerOverheadNs : 0);
+                        last = now;
+                        g_sink = g_sink + frame.size;
+                    }
+                }
+                data += size;
+            }
+        }
+        
+        addResult("framer", frames, totalNs, samples);
+    }
+};
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --frames N        Frames in the generated stream (default 200000)" << std::endl;
+    std::cout << "  --seed N          Random seed (default 1)" << std::endl;
+    std::cout << "  --extended R      Fraction of extended-length frames (default 0.02)" << std::endl;
+    std::cout << "  --corrupt R       Fraction of corrupted frames in the stream (default 0.01)" << std::endl;
+    std::cout << "  --output FILE     Write the JSON results to FILE and a summary to stdout" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue) {
+            options.frames = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--extended" && hasValue) {
+            options.extendedRatio = std::atof(argv[++i]);
+        } else if (arg == "--corrupt" && hasValue) {
+            options.corruptRatio = std::atof(argv[++i]);
+        } else if (arg == "--output" && hasValue) {
+            options.output = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    
+    if (options.frames == 0) {
+        std::cerr << "--frames must be at least 1" << std::endl;
+        return 1;
+    }
+    
+    XbusBenchmark benchmark(options);
+    benchmark.run();
+    
+    if (options.output.empty()) {
+        std::cout << benchmark.toJson();
+        return 0;
+    }
+    
+    std::ofstream file(options.output);
+    file << benchmark.toJson();
+    if (!file) {
+        std::cerr << "Failed to write " << options.output << std::endl;
+        return 1;
+    }
+    benchmark.printSummary(std::cout);
+    return 0;
+}
@@ -0,0 +1,372 @@
+// Corrupted-stream stress test for the framer and the parsers.
+//
+// A synthetic serial stream is generated block by block, so gigabytes can be
+// replayed without holding them in memory. Most of it is intact MTData2
+// frames, each tagged with a sequence number; in between are frames with
+// flipped bits, dropped or inserted bytes and cut-off ends, runs of noise,
+// false preambles announcing extended lengths of up to 65535 bytes, and
+// extended-length frames. The stream is fed to a framer in reads of random
+// size. Every frame it delivers must be complete with a valid checksum, and
+// goes through the bounds-checked parse functions and the layout decoder.
+//
+// At the end the throughput and counts are printed. The run fails when a
+// delivered frame is malformed, fewer than 99% of the intact frames came
+// out of the framer, or an intact frame was held back by more than the
+// framer capacity plus one read: the longest a false preamble may stall
+// delivery.
+#include "xbus.h"
+#include "xbus_parser.h"
+#include "xbus_message_id.h"
+#include "xbus_framer.h"
+#include "xbus_layout_decoder.h"
+#include "xbus_message_builder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Bytes generated at a time
+constexpr size_t BLOCK_SIZE = 1 << 20;
+
+// Status word of intact frames; their SampleTimeFine is the sequence number
+constexpr uint32_t INTACT_MARKER = 0x5EED0000;
+
+// Unknown XDI used to pad extended frames; the parser skips it
+constexpr uint16_t PADDING_XDI = 0x0810;
+
+// Share of intact frames that must come out of the framer
+constexpr double MIN_RECOVERED = 0.99;
+
+// Results are accumulated here so the parse calls are not optimized away
+volatile uint64_t g_sink = 0;
+
+struct Options {
+    uint64_t bytes = 1ull << 30;
+    uint32_t seed = 1;
+    size_t capacity = XbusFramer::DEFAULT_CAPACITY;
+    size_t maxRead = 4096;
+};
+
+class NoisyStream {
+private:
+    std::mt19937 m_random;
+    std::vector<uint8_t> m_frame;
+    uint32_t m_intactFrames;
+    uint64_t m_corruptedFrames;
+    uint64_t m_falsePreambles;
+    
+    // Stream position of the bytes before the current block, and the end
+    // position of the intact frames not yet looked up by frameEnd()
+    uint64_t m_position;
+    std::deque<std::pair<uint32_t, uint64_t>> m_intactEnds;
+
+public:
+    explicit NoisyStream(uint32_t seed)
+        : m_random(seed)
+        , m_frame(Xbus::MAX_MESSAGE_SIZE)
+        , m_intactFrames(0)
+        , m_corruptedFrames(0)
+        , m_falsePreambles(0)
+        , m_position(0) {
+    }
+    
+    // Replace block with the next BLOCK_SIZE or so bytes of the stream
+    void next(std::vector<uint8_t>& block) {
+        m_position += block.size();
+        block.clear();
+        while (block.size() < BLOCK_SIZE) {
+            uint32_t event = m_random() % 1000;
+            if (event < 900) {
+                appendIntact(block);
+            } else if (event < 980) {
+                appendCorrupted(block);
+            } else if (event < 998) {
+                appendNoise(block);
+            } else {
+                appendFalsePreamble(block);
+            }
+        }
+    }
+    
+    uint32_t intactFrames() const { return m_intactFrames; }
+    uint64_t corruptedFrames() const { return m_corruptedFrames; }
+    uint64_t falsePreambles() const { return m_falsePreambles; }
+    
+    // Stream position just past intact frame sequence. Frames come out of
+    // the framer in order, so the ends of earlier frames are dropped.
+    uint64_t frameEnd(uint32_t sequence) {
+        while (!m_intactEnds.empty() && m_intactEnds.front().first < sequence) {
+            m_intactEnds.pop_front();
+        }
+        return m_intactEnds.front().second;
+    }
+
+private:
+    void appendItem(std::vector<uint8_t>& payload, uint16_t xdi, size_t size, uint32_t value) {
+        payload.push_back(static_cast<uint8_t>(xdi >> 8));
+        payload.push_back(static_cast<uint8_t>(xdi & 0xFF));
+        payload.push_back(static_cast<uint8_t>(size));
+        for (size_t i = 0; i < size; i++) {
+            size_t shift = 8 * (size - 1 - i);
+            payload.push_back(shift < 32 ? static_cast<uint8_t>(value >> shift) : 0);
+        }
+    }
+    
+    // An MTData2 frame in m_frame; one in fifty has an extended length, of a
+    // size that fits the default framer
+    size_t buildFrame(uint32_t sequence, uint32_t statusWord) {
+        std::vector<uint8_t> payload;
+        appendItem(payload, XDI::PACKET_COUNTER, 2, sequence);
+        appendItem(payload, XDI::SAMPLE_TIME_FINE, 4, sequence);
+        appendItem(payload, XDI::EULER_ANGLES, 12, static_cast<uint32_t>(m_random()));
+        appendItem(payload, XDI::STATUS_WORD, 4, statusWord);
+        if (m_random() % 4 == 0) {
+            appendItem(payload, XDI::UTC_TIME, 12, static_cast<uint32_t>(m_random()));
+        }
+        if (m_random() % 50 == 0) {
+            size_t target = 255 + m_random() % 3500;
+            while (payload.size() + 3 < target) {
+                size_t size = std::min<size_t>(target - payload.size() - 3, 255);
+                appendItem(payload, PADDING_XDI, size, static_cast<uint32_t>(m_random()));
+            }
+        }
+        return XbusMessageBuilder::build(m_frame.data(), m_frame.size(), XMID_MtData2, payload.data(),
+                                         static_cast<uint16_t>(payload.size()));
+    }
+    
+    void appendIntact(std::vector<uint8_t>& block) {
+        size_t size = buildFrame(m_intactFrames, INTACT_MARKER);
+        block.insert(block.end(), m_frame.begin(), m_frame.begin() + size);
+        m_intactEnds.emplace_back(m_intactFrames++, m_position + block.size());
+    }
+    
+    void appendCorrupted(std::vector<uint8_t>& block) {
+        std::vector<uint8_t> frame(m_frame.begin(), m_frame.begin() + buildFrame(0, 0));
+        size_t position = 1 + m_random() % (frame.size() - 1);
+        switch (m_random() % 4) {
+            case 0:
+                frame[position] ^= static_cast<uint8_t>(1u << (m_random() % 8));
+                break;
+            case 1:
+                frame.erase(frame.begin() + static_cast<std::ptrdiff_t>(position));
+                break;
+            case 2:
+                frame.insert(frame.begin() + static_cast<std::ptrdiff_t>(position),
+                             static_cast<uint8_t>(m_random()));
+                break;
+            case 3:
+                frame.resize(position);
+                break;
+        }
+        block.insert(block.end(), frame.begin(), frame.end());
+        m_corruptedFrames++;
+    }
+    
+    // Random bytes, preambles included
+    void appendNoise(std::vector<uint8_t>& block) {
+        size_t length = 1 + m_random() % 256;
+        for (size_t i = 0; i < length; i++) {
+            block.push_back(static_cast<uint8_t>(m_random()));
+        }
+    }
+    
+    // A header whose extended length makes the framer wait for up to its
+    // capacity before the checksum fails and it rescans
+    void appendFalsePreamble(std::vector<uint8_t>& block) {
+        block.push_back(Xbus::XBUS_PREAMBLE);
+        block.push_back(Xbus::XBUS_MASTERDEVICE);
+        block.push_back(XMID_MtData2);
+        block.push_back(Xbus::LENGTH_EXTENDER_BYTE);
+        block.push_back(static_cast<uint8_t>(m_random()));
+        block.push_back(static_cast<uint8_t>(m_random()));
+        m_falsePreambles++;
+    }
+};
+
+class StressTest {
+private:
+    Options m_options;
+    std::mt19937 m_random;
+    NoisyStream m_stream;
+    XbusFramer m_framer;
+    XbusLayoutDecoder m_decoder;
+    std::vector<uint8_t> m_frameCopy;
+    char m_text[XbusParser::TEXT_BUFFER_SIZE];
+    
+    std::vector<bool> m_recovered;
+    uint64_t m_recoveredFrames;
+    uint64_t m_otherFrames;
+    uint64_t m_malformedFrames;
+    uint64_t m_bytes;
+    uint64_t m_fed;             // stream bytes written to the framer
+    uint64_t m_worstDelay;      // most bytes fed between an intact frame's end and its delivery
+    double m_seconds;
+
+public:
+    explicit StressTest(const Options& options)
+        : m_options(options)
+        , m_random(options.seed + 1)
+        , m_stream(options.seed)
+        , m_framer(options.capacity)
+        , m_recoveredFrames(0)
+        , m_otherFrames(0)
+        , m_malformedFrames(0)
+        , m_bytes(0)
+        , m_fed(0)
+        , m_worstDelay(0)
+        , m_seconds(0.0) {
+    }
+    
+    void run() {
+        std::vector<uint8_t> block;
+        Clock::time_point start = Clock::now();
+        while (m_bytes < m_options.bytes) {
+            m_stream.next(block);
+            feed(block);
+            m_bytes += block.size();
+        }
+        m_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    
+    bool passed() const {
+        uint32_t intact = m_stream.intactFrames();
+        return m_malformedFrames == 0 &&
+               static_cast<double>(m_recoveredFrames) >= MIN_RECOVERED * static_cast<double>(intact) &&
+               m_worstDelay <= m_framer.capacity() + m_options.maxRead;
+    }
+    
+    void printSummary(std::ostream& out) const {
+        const XbusFramer::Stats& stats = m_framer.stats();
+        double megabytes = static_cast<double>(m_bytes) / 1e6;
+        uint32_t intact = m_stream.intactFrames();
+        double recovered = intact > 0 ? 100.0 * static_cast<double>(m_recoveredFrames) / intact : 100.0;
+        
+        out << std::fixed << std::setprecision(2);
+        out << "Stream:           " << megabytes / 1000.0 << " GB in " << m_seconds << " s ("
+            << std::setprecision(1) << (m_seconds > 0.0 ? megabytes / m_seconds : 0.0) << " MB/s)" << std::endl;
+        out << "Intact frames:    " << intact << ", recovered " << m_recoveredFrames
+            << " (" << std::setprecision(3) << recovered << "%)" << std::endl;
+        out << "Injected:         " << m_stream.corruptedFrames() << " corrupted frames, "
+            << m_stream.falsePreambles() << " false preambles" << std::endl;
+        out << "Framer:           " << stats.framesOk.load() << " frames, "
+            << stats.checksumErrors.load() << " checksum errors, "
+            << stats.lengthErrors.load() << " length errors, "
+            << stats.headerErrors.load() << " header errors, "
+            << stats.resyncs.load() << " resyncs, "
+            << stats.bytesSkipped.load() << " bytes skipped" << std::endl;
+        out << "Worst delay:      " << m_worstDelay << " bytes (" << std::setprecision(1)
+            << static_cast<double>(m_worstDelay) * 10.0 / 921.6 << " ms at 921600 baud, limit "
+            << m_framer.capacity() + m_options.maxRead << " bytes)" << std::endl;
+        out << "Other frames:     " << m_otherFrames << " (damaged frames that passed the checksum)" << std::endl;
+        out << "Malformed frames: " << m_malformedFrames << std::endl;
+    }
+
+private:
+    void feed(const std::vector<uint8_t>& block) {
+        size_t offset = 0;
+        while (offset < block.size()) {
+            size_t length = std::min<size_t>(1 + m_random() % m_options.maxRead, block.size() - offset);
+            m_fed = m_bytes + offset + length;
+            m_framer.feed(block.data() + offset, length, [this](const XbusFrame& frame) {
+                check(frame);
+            });
+            offset += length;
+        }
+    }
+    
+    void check(const XbusFrame& frame) {
+        if (!Xbus::isComplete(frame.data, frame.size) ||
+            static_cast<size_t>(Xbus::getRawLength(frame.data)) != frame.size ||
+            !Xbus::verifyChecksum(frame.data)) {
+            m_malformedFrames++;
+            return;
+        }
+        
+        // A copy of exact size, so sanitizer builds catch reads past the frame
+        m_frameCopy.assign(frame.begin(), frame.end());
+        const uint8_t* data = m_frameCopy.data();
+        size_t size = m_frameCopy.size();
+        
+        XbusTextWriter out(m_text);
+        XbusParser::messageToString(data, size, out);
+        g_sink = g_sink + out.size();
+        
+        SensorData decoded;
+        m_decoder.decode(data, size, decoded);
+        g_sink = g_sink + decoded.packetCounter;
+        
+        SensorData sensorData;
+        if (XbusParser::parseMTData2(data, size, sensorData) && sensorData.hasStatusWord &&
+            sensorData.statusWord == INTACT_MARKER && sensorData.hasSampleTimeFine &&
+            sensorData.sampleTimeFine < m_stream.intactFrames()) {
+            recover(sensorData.sampleTimeFine);
+        } else {
+            m_otherFrames++;
+        }
+    }
+    
+    void recover(uint32_t sequence) {
+        if (m_recovered.size() <= sequence) {
+            m_recovered.resize(std::max<size_t>(sequence + 1, m_recovered.size() * 2));
+        }
+        if (!m_recovered[sequence]) {
+            m_recovered[sequence] = true;
+            m_recoveredFrames++;
+            m_worstDelay = std::max(m_worstDelay, m_fed - m_stream.frameEnd(sequence));
+        }
+    }
+};
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --bytes N         Stream bytes to replay (default 1073741824)" << std::endl;
+    std::cout << "  --seed N          Random seed (default 1)" << std::endl;
+    std::cout << "  --capacity N      Framer capacity (default " << XbusFramer::DEFAULT_CAPACITY << ")" << std::endl;
+    std::cout << "  --max-read N      Largest read fed to the framer (default 4096)" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--bytes" && hasValue) {
+            options.bytes = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--capacity" && hasValue) {
+            options.capacity = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--max-read" && hasValue) {
+            options.maxRead = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    
+    if (options.maxRead == 0) {
+        std::cerr << "--max-read must be at least 1" << std::endl;
+        return 1;
+    }
+    
+    StressTest test(options);
+    test.run();
+    test.printSummary(std::cout);
+    if (!test.passed()) {
+        std::cerr << "Stress test failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
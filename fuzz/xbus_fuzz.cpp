@@ -0,0 +1,263 @@
+// Fuzz target for the framer and the message parsers.
+//
+// The input is used twice: as one message in memory of exactly that size,
+// for the bounds-checked parse functions, and as a serial byte stream fed
+// to a framer whose frames go through every parser. Frames are copied to
+// buffers of their exact size first, so any read past a message is caught
+// by AddressSanitizer.
+//
+// With clang this is a libFuzzer target (-DXBUS_BUILD_FUZZ=ON):
+//
+//     xbus_fuzz -max_len=70000 corpus/
+//
+// Other compilers, and AFL (afl-clang-fast++ with -DXBUS_FUZZ_STANDALONE=ON),
+// get a main() that runs every file given on the command line, or stdin,
+// through the target. --iterations N instead runs N mutations of built-in
+// seed messages; the test suite does that as a smoke test.
+#include "xbus.h"
+#include "xbus_parser.h"
+#include "xbus_message_id.h"
+#include "xbus_framer.h"
+#include "xbus_layout_decoder.h"
+#include "xbus_message_builder.h"
+#include "xbus_output_config.h"
+#include "xbus_imu.h"
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef XBUS_FUZZ_STANDALONE
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#endif
+
+namespace {
+
+// Accumulated so no parse result is optimized away
+volatile uint64_t g_sink = 0;
+
+void require(bool condition) {
+    if (!condition) {
+        std::abort();
+    }
+}
+
+void parseMessage(const uint8_t* data, size_t size, XbusLayoutDecoder& decoder) {
+    char text[XbusParser::TEXT_BUFFER_SIZE];
+    XbusTextWriter out(text);
+    XbusParser::messageToString(data, size, out);
+    g_sink = g_sink + out.size();
+    
+    SensorData sensorData;
+    if (XbusParser::parseMTData2(data, size, sensorData)) {
+        g_sink = g_sink + sensorData.packetCounter;
+    }
+    g_sink = g_sink + XbusParser::parseMTData2Fields(data, size, SensorField::EULER_ANGLES |
+                                                     SensorField::UTC_TIME, sensorData);
+    if (decoder.decode(data, size, sensorData)) {
+        g_sink = g_sink + sensorData.sampleTimeFine;
+    }
+    
+    SensorDataColumns columns;
+    const uint8_t* frames[] = {data};
+    const size_t sizes[] = {size};
+    g_sink = g_sink + XbusParser::parseMTData2Batch(frames, sizes, 1, columns);
+    
+    ImuSample sample;
+    g_sink = g_sink + XbusImu::decode(data, size, sample);
+    
+    XbusOutputConfig config;
+    if (config.parse(data, size)) {
+        g_sink = g_sink + config.packetPayloadLength();
+        decoder.configure(config);
+    }
+}
+
+// A verified frame from the framer goes through the functions that expect
+// a complete message
+void parseFrame(const uint8_t* frame, XbusLayoutDecoder& decoder) {
+    char text[XbusParser::TEXT_BUFFER_SIZE];
+    XbusTextWriter out(text);
+    XbusParser::messageToString(frame, out);
+    g_sink = g_sink + out.size();
+    
+    SensorData sensorData;
+    if (decoder.decode(frame, sensorData)) {
+        g_sink = g_sink + sensorData.packetCounter;
+    }
+    EulerAngles angles;
+    if (XbusParser::parseEulerAngles(frame, angles)) {
+        g_sink = g_sink + static_cast<uint64_t>(angles.roll != 0.0f);
+    }
+    g_sink = g_sink + XbusParser::parseDeviceId(frame) + XbusParser::parseFirmwareRevision(frame).size();
+    decoder.learnFromOutputConfig(frame);
+}
+
+// Framer capacity and read size come from the first two bytes, so that
+// small buffers and frames split across reads are both covered
+void frameStream(const uint8_t* data, size_t size) {
+    if (size < 2) {
+        return;
+    }
+    size_t capacity = static_cast<size_t>(64) << (data[0] % 11);
+    size_t readSize = 1 + data[1] % 128;
+    data += 2;
+    size -= 2;
+    
+    XbusFramer framer(capacity);
+    XbusLayoutDecoder decoder;
+    std::vector<uint8_t> frameCopy;
+    size_t offset = 0;
+    while (offset < size) {
+        size_t length = size - offset < readSize ? size - offset : readSize;
+        framer.feed(data + offset, length, [&](const XbusFrame& frame) {
+            require(Xbus::isComplete(frame.data, frame.size));
+            require(static_cast<size_t>(Xbus::getRawLength(frame.data)) == frame.size);
+            require(Xbus::verifyChecksum(frame.data));
+            
+            frameCopy.assign(frame.begin(), frame.end());
+            parseFrame(frameCopy.data(), decoder);
+        });
+        offset += length;
+    }
+    require(framer.buffered() <= framer.capacity());
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::vector<uint8_t> message(data, data + size);
+    XbusLayoutDecoder decoder;
+    parseMessage(message.data(), message.size(), decoder);
+    if (Xbus::isComplete(message.data(), message.size())) {
+        g_sink = g_sink + (Xbus::verifyChecksum(message.data()) ? 1 : 0);
+    }
+    
+    frameStream(data, size);
+    return 0;
+}
+
+#ifdef XBUS_FUZZ_STANDALONE
+
+namespace {
+
+std::vector<uint8_t> buildMessage(uint8_t messageId, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> message(XbusMessageBuilder::messageSize(payload.size()));
+    message.resize(XbusMessageBuilder::build(message.data(), message.size(), messageId, payload.data(),
+                                             static_cast<uint16_t>(payload.size())));
+    return message;
+}
+
+// Valid messages of every kind the parsers know, and a stream of them
+std::vector<std::vector<uint8_t>> seedInputs() {
+    std::vector<std::vector<uint8_t>> seeds;
+    seeds.push_back(buildMessage(XMID_MtData2, {0x10, 0x20, 0x02, 0x00, 0x01,
+                                                0x10, 0x60, 0x04, 0x00, 0x00, 0x30, 0x39,
+                                                0x20, 0x30, 0x0C, 0x42, 0x34, 0x00, 0x00,
+                                                0x41, 0xF0, 0x00, 0x00, 0x42, 0xB4, 0x00, 0x00,
+                                                0x10, 0x10, 0x0C, 0x00, 0x00, 0x00, 0x01, 0x07, 0xE9,
+                                                0x01, 0x02, 0x03, 0x04, 0x05, 0x07,
+                                                0x50, 0x42, 0x0C, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 2}));
+    std::vector<uint8_t> extended = {0x20, 0x10, 0x10, 0x3F, 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    while (extended.size() < 300) {
+        extended.insert(extended.end(), {0x08, 0x10, 0x04, 0x01, 0x02, 0x03, 0x04});
+    }
+    seeds.push_back(buildMessage(XMID_MtData2, extended));
+    seeds.push_back(buildMessage(XMID_DeviceId, {0x03, 0x80, 0x00, 0x01}));
+    seeds.push_back(buildMessage(XMID_FirmwareRevision, {0x01, 0x02, 0x03}));
+    seeds.push_back(buildMessage(XMID_OutputConfig, {0x10, 0x20, 0xFF, 0xFF, 0x20, 0x30, 0x00, 0x64}));
+    seeds.push_back(buildMessage(XMID_GotoConfigAck, {}));
+    
+    // Framer header, then all of the above back to back
+    std::vector<uint8_t> stream = {0x03, 0x10};
+    for (const std::vector<uint8_t>& seed : seeds) {
+        stream.insert(stream.end(), seed.begin(), seed.end());
+    }
+    seeds.push_back(stream);
+    return seeds;
+}
+
+void mutate(std::vector<uint8_t>& input, std::mt19937& random) {
+    int mutations = 1 + static_cast<int>(random() % 8);
+    for (int i = 0; i < mutations; i++) {
+        size_t position = input.empty() ? 0 : random() % input.size();
+        switch (random() % 6) {
+            case 0:
+                if (!input.empty()) {
+                    input[position] ^= static_cast<uint8_t>(1u << (random() % 8));
+                }
+                break;
+            case 1:
+                if (!input.empty()) {
+                    input[position] = static_cast<uint8_t>(random());
+                }
+                break;
+            case 2:
+                input.insert(input.begin() + static_cast<std::ptrdiff_t>(position), static_cast<uint8_t>(random()));
+                break;
+            case 3:
+                if (!input.empty()) {
+                    input.erase(input.begin() + static_cast<std::ptrdiff_t>(position));
+                }
+                break;
+            case 4:
+                input.resize(position);
+                break;
+            case 5:
+                // Length field of a message, standard or extended
+                if (input.size() > Xbus::OFFSET_TO_LEN_EXT_LO) {
+                    input[Xbus::OFFSET_TO_LEN] = (random() % 2) ? Xbus::LENGTH_EXTENDER_BYTE
+                                                                : static_cast<uint8_t>(random());
+                    input[Xbus::OFFSET_TO_LEN_EXT_HI] = static_cast<uint8_t>(random());
+                }
+                break;
+        }
+    }
+    
+    // Half of the time make the checksum right again, so mutated lengths and
+    // items get past the framer's checksum check
+    if (random() % 2 == 0 && Xbus::isComplete(input.data(), input.size())) {
+        Xbus::insertChecksum(input.data());
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc == 3 && std::string(argv[1]) == "--iterations") {
+        unsigned long iterations = std::strtoul(argv[2], nullptr, 10);
+        std::mt19937 random(1);
+        std::vector<std::vector<uint8_t>> seeds = seedInputs();
+        for (unsigned long i = 0; i < iterations; i++) {
+            std::vector<uint8_t> input = seeds[i % seeds.size()];
+            mutate(input, random);
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+        }
+        std::cout << "Ran " << iterations << " mutated inputs" << std::endl;
+        return 0;
+    }
+    
+    if (argc == 1) {
+        std::vector<uint8_t> input((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+        return 0;
+    }
+    
+    for (int i = 1; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file) {
+            std::cerr << "Failed to open " << argv[i] << std::endl;
+            return 1;
+        }
+        std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    return 0;
+}
+
+#endif // XBUS_FUZZ_STANDALONE
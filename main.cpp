@@ -1,37 +1,248 @@
 #include "serial_reader.h"
+#include "xbus_device_manager.h"
+#include "xbus_bridge.h"
 #include "xbus/xbus.h"
 #include "xbus/xbus_parser.h"
+#include "xbus/xbus_framer.h"
+#include "xbus/xbus_layout_decoder.h"
+#include "xbus/xbus_message_builder.h"
+#include "xbus/xbus_recorder.h"
+#include "xbus/xbus_clock_tracker.h"
+#include "xbus/xbus_export.h"
+#include "xbus/xbus_command_engine.h"
+#include "xbus/xbus_dispatcher.h"
+#include "xbus/xbus_output_config.h"
 #include "xbus/xbus_message_id.h"
 #include <iostream>
 #include <vector>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <atomic>
 #include <cstring>
 #include <iomanip> 
+#include <cstdlib>
+#include <memory>
+#include <future>
+
+// CSV for *.csv paths, binary columns otherwise
+static std::unique_ptr<XbusFileSink> createExportSink(const std::string& path) {
+    const std::string csv = ".csv";
+    if (path.size() >= csv.size() && path.compare(path.size() - csv.size(), csv.size(), csv) == 0) {
+        return std::unique_ptr<XbusFileSink>(new XbusCsvSink());
+    }
+    return std::unique_ptr<XbusFileSink>(new XbusColumnSink());
+}
+
+// Bridge endpoints are shm:<name> or udp:<address>:<port>
+static bool parseEndpoint(const std::string& endpoint, std::string& kind, std::string& address, uint16_t& port) {
+    size_t colon = endpoint.find(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    kind = endpoint.substr(0, colon);
+    address = endpoint.substr(colon + 1);
+    port = 0;
+    if (kind == "shm") {
+        return !address.empty();
+    }
+    size_t portColon = address.rfind(':');
+    if (kind != "udp" || portColon == std::string::npos) {
+        return false;
+    }
+    unsigned long value = std::strtoul(address.c_str() + portColon + 1, nullptr, 10);
+    address.resize(portColon);
+    port = static_cast<uint16_t>(value);
+    return value > 0 && value <= 0xFFFF;
+}
+
+static std::unique_ptr<XbusBridgePublisher> createBridgePublisher(const std::string& target, std::string& error) {
+    std::string kind;
+    std::string address;
+    uint16_t port;
+    if (!parseEndpoint(target, kind, address, port)) {
+        error = "expected shm:<name> or udp:<address>:<port>";
+        return nullptr;
+    }
+    
+    if (kind == "shm") {
+        std::unique_ptr<XbusShmPublisher> publisher(new XbusShmPublisher());
+        if (!publisher->open(address)) {
+            error = publisher->getLastError();
+            return nullptr;
+        }
+        return std::unique_ptr<XbusBridgePublisher>(publisher.release());
+    }
+    std::unique_ptr<XbusUdpPublisher> publisher(new XbusUdpPublisher());
+    if (!publisher->open(address, port)) {
+        error = publisher->getLastError();
+        return nullptr;
+    }
+    return std::unique_ptr<XbusBridgePublisher>(publisher.release());
+}
+
+static std::unique_ptr<XbusBridgeSubscriber> createBridgeSubscriber(const std::string& source, std::string& error) {
+    std::string kind;
+    std::string address;
+    uint16_t port;
+    if (!parseEndpoint(source, kind, address, port)) {
+        error = "expected shm:<name> or udp:<address>:<port>";
+        return nullptr;
+    }
+    
+    if (kind == "shm") {
+        std::unique_ptr<XbusShmSubscriber> subscriber(new XbusShmSubscriber());
+        if (!subscriber->open(address)) {
+            error = subscriber->getLastError();
+            return nullptr;
+        }
+        return std::unique_ptr<XbusBridgeSubscriber>(subscriber.release());
+    }
+    std::unique_ptr<XbusUdpSubscriber> subscriber(new XbusUdpSubscriber());
+    if (!subscriber->open(address, port)) {
+        error = subscriber->getLastError();
+        return nullptr;
+    }
+    return std::unique_ptr<XbusBridgeSubscriber>(subscriber.release());
+}
+
+// normal, above-normal, highest or time-critical
+static bool parseThreadPriority(const std::string& name, SerialReader::ThreadPriority& priority) {
+    if (name == "normal") {
+        priority = SerialReader::ThreadPriority::Normal;
+    } else if (name == "above-normal") {
+        priority = SerialReader::ThreadPriority::AboveNormal;
+    } else if (name == "highest") {
+        priority = SerialReader::ThreadPriority::Highest;
+    } else if (name == "time-critical") {
+        priority = SerialReader::ThreadPriority::TimeCritical;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Comma separated CPU numbers, e.g. "2" or "2,3"
+static bool parseCpuList(const std::string& list, uint64_t& mask) {
+    mask = 0;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string cpu = list.substr(start, end - start);
+        if (cpu.empty() || cpu.size() > 2 || cpu.find_first_not_of("0123456789") != std::string::npos || std::stoul(cpu) >= 64) {
+            return false;
+        }
+        mask |= uint64_t(1) << std::stoul(cpu);
+        start = end + 1;
+    }
+    return mask != 0;
+}
+
+// Decimal byte count below 1 GB, e.g. "4096"
+static bool parseByteCount(const std::string& text, uint32_t& bytes) {
+    if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    bytes = static_cast<uint32_t>(std::stoul(text));
+    return true;
+}
+
+// Outcome of a command sent through XbusCommandEngine
+static void reportReply(const std::string& name, const XbusCommandEngine::Reply& reply) {
+    switch (reply.status) {
+        case XbusCommandEngine::Status::Ok:
+            std::cout << name << " acknowledged after " << reply.latencyNs / 1000 << " us" << std::endl;
+            break;
+        case XbusCommandEngine::Status::DeviceError:
+            std::cerr << name << " failed: device error 0x" << std::hex << static_cast<int>(reply.errorCode)
+                      << std::dec << std::endl;
+            break;
+        case XbusCommandEngine::Status::Timeout:
+            std::cerr << name << " timed out" << std::endl;
+            break;
+        case XbusCommandEngine::Status::SendFailed:
+            std::cerr << name << " could not be sent" << std::endl;
+            break;
+        case XbusCommandEngine::Status::Cancelled:
+            break;
+    }
+}
 
 class XbusMessageProcessor {
 private:
     SerialReader m_serial;
-    std::vector<uint8_t> m_buffer;
     bool m_running;
     
-    // Message synchronization
-    enum class SyncState {
-        WaitingForPreamble,
-        ReadingMessage
-    };
+    // Outbound messages are built here; large enough for any payload
+    std::vector<uint8_t> m_txBuffer;
+    
+    // Message synchronization, then every frame goes to the subscribers
+    // below; MTData2 packets are decoded once in the dispatcher
+    XbusFramer m_framer;
+    XbusDispatcher m_dispatcher;
+    
+    // Received data is parsed and printed on m_parseThread, so console
+    // output never blocks the serial read thread
+    SerialReader::ChunkQueue m_rxQueue;
+    std::thread m_parseThread;
+    
+    // Optional binary session log; frames are stamped with the receive
+    // time of the chunk that completed them
+    XbusRecorder m_recorder;
+    uint64_t m_receiveTimeNs;
+    
+    // Samples lost on the way from the device and the device clock against
+    // the host, and the time from a read completing until its frames were
+    // handled on the parse thread
+    XbusClockTracker m_clock;
+    LatencyHistogram m_processLatency;
+    
+    // Optional export of decoded samples, written on its own thread
+    std::unique_ptr<XbusFileSink> m_exportFile;
+    std::unique_ptr<XbusAsyncSink> m_export;
     
-    SyncState m_syncState;
-    std::vector<uint8_t> m_messageBuffer;
-    size_t m_expectedLength;
+    // Commands from the console wait for their acknowledgement here
+    XbusCommandEngine m_commands;
     
+    // Other processes get the verified frames (and, over shared memory, the
+    // decoded samples) through these
+    std::vector<std::string> m_publisherNames;
+    std::vector<std::unique_ptr<XbusBridgePublisher>> m_publishers;
+
 public:
-    XbusMessageProcessor() : m_running(false), m_syncState(SyncState::WaitingForPreamble), m_expectedLength(0) {
-        m_buffer.reserve(1024);
-        m_messageBuffer.reserve(256);
+    // frameCapacity is the largest frame received (see XbusFramer)
+    explicit XbusMessageProcessor(size_t frameCapacity = XbusFramer::DEFAULT_CAPACITY)
+        : m_running(false)
+        , m_txBuffer(XbusMessageBuilder::messageSize(Xbus::MAX_PAYLOAD_LENGTH))
+        , m_framer(frameCapacity)
+        , m_rxQueue(RX_QUEUE_CHUNKS)
+        , m_receiveTimeNs(0)
+        , m_commands(1, [this](size_t, const uint8_t* frame, size_t size) {
+            return m_serial.write(frame, size);
+        }) {
+        m_dispatcher.subscribeAll([this](const XbusDispatcher::Message& message) {
+            handleFrame(message.frame);
+        });
+        m_dispatcher.subscribe(XMID_OutputConfig, [this](const XbusDispatcher::Message& message) {
+            reportOutputConfig(message.frame);
+        });
+        m_dispatcher.subscribe(XMID_MtData2, [this](const XbusDispatcher::Message& message) {
+            if (message.sample != nullptr) {
+                handleSample(*message.sample);
+            }
+        });
+        m_dispatcher.start();
     }
     
-    bool initialize(const std::string& portName, DWORD baudRate = 115200) {
+    bool initialize(const std::string& portName, DWORD baudRate = 115200,
+                    const SerialReader::ReadConfig& readConfig = SerialReader::ReadConfig()) {
+        if (!m_serial.setReadConfig(readConfig)) {
+            std::cerr << "Invalid read settings: " << m_serial.getLastError() << std::endl;
+            return false;
+        }
         if (!m_serial.open(portName, baudRate)) {
             std::cerr << "Failed to open serial port: " << m_serial.getLastError() << std::endl;
             return false;
@@ -39,11 +250,102 @@ public:
         
         std::cout << "Serial port " << portName << " opened successfully at " << baudRate << " baud." << std::endl;
         
-        // Set up async data callback
-        m_serial.setDataCallback([this](const uint8_t* data, size_t length) {
-            processIncomingData(data, length);
+        // Hand received data to the parse thread
+        m_serial.setDataQueue(&m_rxQueue);
+        
+        return true;
+    }
+    
+    bool startRecording(const std::string& path) {
+        if (!m_recorder.open(path)) {
+            std::cerr << "Failed to start recording: " << m_recorder.getLastError() << std::endl;
+            return false;
+        }
+        
+        std::cout << "Recording frames to " << path << std::endl;
+        return true;
+    }
+    
+    bool startExport(const std::string& path) {
+        m_exportFile = createExportSink(path);
+        if (!m_exportFile->open(path)) {
+            std::cerr << "Failed to start export: " << m_exportFile->getLastError() << std::endl;
+            m_exportFile.reset();
+            return false;
+        }
+        
+        m_export.reset(new XbusAsyncSink(*m_exportFile));
+        m_export->start();
+        std::cout << "Exporting samples to " << path << std::endl;
+        return true;
+    }
+    
+    // Share received frames with other processes, see xbus_bridge.h
+    bool startPublishing(const std::string& target) {
+        std::string error;
+        std::unique_ptr<XbusBridgePublisher> publisher = createBridgePublisher(target, error);
+        if (!publisher) {
+            std::cerr << "Failed to publish to " << target << ": " << error << std::endl;
+            return false;
+        }
+        
+        m_publisherNames.push_back(target);
+        m_publishers.push_back(std::move(publisher));
+        std::cout << "Publishing frames to " << target << std::endl;
+        return true;
+    }
+    
+    // Process the frames another xbus_reader publishes (--publish) instead
+    // of a serial port, until 'q' and Enter
+    bool listen(const std::string& source) {
+        std::string error;
+        std::unique_ptr<XbusBridgeSubscriber> subscriber = createBridgeSubscriber(source, error);
+        if (!subscriber) {
+            std::cerr << "Failed to subscribe to " << source << ": " << error << std::endl;
+            return false;
+        }
+        std::cout << "Listening to " << source << ". Press 'q' and Enter to quit." << std::endl;
+        
+        std::atomic<bool> running(true);
+        std::thread receiver([&] {
+            while (running) {
+                subscriber->receive([this](const XbusBridgeRecord& record) {
+                    if (record.kind == XbusBridgeRecord::Kind::Frame) {
+                        m_receiveTimeNs = record.receiveTimeNs;
+                        processCompleteMessage(record.frame);
+                    }
+                }, 100);
+            }
         });
         
+        std::string input;
+        while (std::cin >> input && input != "q" && input != "Q") {
+        }
+        running = false;
+        receiver.join();
+        
+        const XbusBridgeSubscriber::Stats& stats = subscriber->stats();
+        std::cout << "Received " << stats.records << " records from " << source << ", " << stats.lost
+                  << " lost, " << stats.invalid << " invalid" << std::endl;
+        return true;
+    }
+    
+    // Process a recorded session instead of a live port. speed 0 replays as
+    // fast as possible, 1.0 at the recorded pace.
+    bool replay(const std::string& path, double speed) {
+        XbusReplay replay;
+        if (!replay.open(path)) {
+            std::cerr << "Failed to open recording: " << replay.getLastError() << std::endl;
+            return false;
+        }
+        
+        size_t played = replay.play([this](const XbusReplay::Record& record) {
+            m_receiveTimeNs = record.receiveTimeNs;
+            processIncomingData(record.frame.data, record.frame.size);
+        }, speed);
+        
+        std::cout << "Replayed " << played << " frames from " << path
+                  << (replay.truncated() ? " (log is truncated)" : "") << std::endl;
         return true;
     }
     
@@ -54,6 +356,8 @@ public:
         }
         
         m_running = true;
+        m_commands.start();
+        m_parseThread = std::thread(&XbusMessageProcessor::parseLoop, this);
         
         if (!m_serial.startAsyncReading()) {
             std::cerr << "Failed to start async reading: " << m_serial.getLastError() << std::endl;
@@ -61,7 +365,7 @@ public:
         }
         
         std::cout << "Started listening for Xbus messages..." << std::endl;
-        std::cout << "Press 'q' and Enter to quit, 'i' for device info, 'c' to go to config mode, 'm' to go to measurement mode." << std::endl;
+        std::cout << "Press 'q' and Enter to quit, 'i' for device info, 'c' to go to config mode, 'm' to go to measurement mode, 'o' for the output configuration, 's' for statistics." << std::endl;
         
         // Main loop
         std::string input;
@@ -77,6 +381,10 @@ public:
                     gotoMeasurementMode();
                 } else if (input == "f" || input == "F") {
                     requestFirmwareRevision();
+                } else if (input == "o" || input == "O") {
+                    requestOutputConfig();
+                } else if (input == "s" || input == "S") {
+                    printStats();
                 }
             }
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
@@ -85,151 +393,230 @@ public:
     
     void stop() {
         m_running = false;
+        m_commands.stop();
         m_serial.stopAsyncReading();
         m_serial.close();
+        
+        // Let the parse thread drain what was already received
+        m_rxQueue.close();
+        if (m_parseThread.joinable()) {
+            m_parseThread.join();
+        }
+        m_dispatcher.stop();
+        
+        if (m_recorder.isOpen()) {
+            std::cout << "Recorded " << m_recorder.framesRecorded() << " frames." << std::endl;
+            m_recorder.close();
+        }
+        
+        if (m_export) {
+            if (!m_export->close()) {
+                std::cerr << "Export failed: " << m_export->getLastError() << std::endl;
+            }
+            std::cout << "Exported " << m_exportFile->rowsWritten() << " samples." << std::endl;
+            m_export.reset();
+            m_exportFile.reset();
+        }
+        
+        for (std::unique_ptr<XbusBridgePublisher>& publisher : m_publishers) {
+            publisher->close();
+        }
+        
+        uint64_t dropped = m_rxQueue.stats().dropped;
+        if (dropped > 0) {
+            std::cerr << "Receive queue overflowed, " << dropped << " chunks dropped." << std::endl;
+        }
+        printStats();
         std::cout << "Stopped and closed serial port." << std::endl;
     }
     
+    // Where samples went missing: driver, queue, framing or the device
+    void printStats() {
+        SerialReader::Stats serial = m_serial.stats();
+        const XbusFramer::Stats& framer = m_framer.stats();
+        LatencyHistogram::Snapshot delivery = serial.deliveryLatency.snapshot();
+        LatencyHistogram::Snapshot process = m_processLatency.snapshot();
+        
+        std::cout << "Serial: " << serial.bytesRead << " bytes in " << serial.reads << " reads, "
+                  << serial.readErrors << " read errors, " << serial.driverOverruns << " driver overruns, "
+                  << serial.framingErrors << " framing / " << serial.parityErrors << " parity errors" << std::endl;
+        std::cout << "Queue: " << serial.chunksQueued << " chunks, " << serial.chunksDropped << " dropped, high-water "
+                  << serial.queueHighWater << "/" << m_rxQueue.capacity() << std::endl;
+        std::cout << "Framer: " << framer.framesOk << " frames, " << framer.checksumErrors << " checksum errors, "
+                  << framer.lengthErrors << " invalid lengths, " << framer.headerErrors << " invalid headers, "
+                  << framer.resyncs << " resyncs, "
+                  << framer.bytesSkipped << " bytes skipped, buffer high-water " << framer.bufferHighWater
+                  << "/" << m_framer.capacity() << std::endl;
+        const PacketCounterGaps& gaps = m_clock.packetGaps();
+        std::cout << "Packets: " << gaps.packets << " decoded, " << gaps.gaps << " gaps, "
+                  << gaps.lostPackets << " lost" << std::endl;
+        std::cout << "Clock: " << (m_clock.isLocked() ? "locked" : "not locked") << ", drift "
+                  << std::fixed << std::setprecision(2) << m_clock.driftPpm() << " ppm, "
+                  << m_clock.resyncs() << " resyncs" << std::endl;
+        std::cout << "Latency: delivery p50 " << delivery.percentileNs(0.5) / 1000 << " us, p99 "
+                  << delivery.percentileNs(0.99) / 1000 << " us; processed p50 "
+                  << process.percentileNs(0.5) / 1000 << " us, p99 " << process.percentileNs(0.99) / 1000
+                  << " us, max " << process.maxNs / 1000 << " us" << std::endl;
+        for (size_t i = 0; i < m_publishers.size(); i++) {
+            const XbusBridgePublisher::Stats& bridge = m_publishers[i]->stats();
+            std::cout << "Bridge " << m_publisherNames[i] << ": " << bridge.records << " records in "
+                      << bridge.batches << " writes, " << bridge.dropped << " dropped" << std::endl;
+        }
+    }
+
 private:
-    void processIncomingData(const uint8_t* data, size_t length) {
-        for (size_t i = 0; i < length; i++) {
-            uint8_t byte = data[i];
-            
-            switch (m_syncState) {
-                case SyncState::WaitingForPreamble:
-                    if (byte == Xbus::XBUS_PREAMBLE) {
-                        m_messageBuffer.clear();
-                        m_messageBuffer.push_back(byte);
-                        m_syncState = SyncState::ReadingMessage;
-                        m_expectedLength = 0;
-                    }
-                    break;
-                    
-                case SyncState::ReadingMessage:
-                    m_messageBuffer.push_back(byte);
-                    
-                    // Check if we have enough bytes to determine message length
-                    if (m_messageBuffer.size() >= 4 && m_expectedLength == 0) {
-                        m_expectedLength = Xbus::getRawLength(m_messageBuffer.data());
-                        
-                        // Validate the calculated length is reasonable
-                        if (m_expectedLength < 5 || m_expectedLength > 1000) {
-                            std::cerr << "Invalid message length: " << m_expectedLength 
-                                     << ", restarting sync..." << std::endl;
-                            m_syncState = SyncState::WaitingForPreamble;
-                            m_expectedLength = 0;
-                            continue;
-                        }
-                    }
-                    
-                    // Check if we have a complete message
-                    if (m_expectedLength > 0 && m_messageBuffer.size() >= m_expectedLength) {
-                        processCompleteMessage();
-                        m_syncState = SyncState::WaitingForPreamble;
-                        m_expectedLength = 0;
-                    }
-                    
-                    // Safety check - if message buffer gets too large, reset
-                    if (m_messageBuffer.size() > 1000) {
-                        std::cerr << "Message buffer overflow, restarting sync..." << std::endl;
-                        m_syncState = SyncState::WaitingForPreamble;
-                        m_expectedLength = 0;
-                    }
-                    break;
-            }
+    static constexpr size_t RX_QUEUE_CHUNKS = 256;
+    
+    void parseLoop() {
+        SerialChunk chunk;
+        while (m_rxQueue.pop(chunk)) {
+            m_receiveTimeNs = chunk.receiveTimeNs;
+            processIncomingData(chunk.data, chunk.length);
+            m_processLatency.record(XbusLog::steadyTimeNs() - chunk.receiveTimeNs);
         }
     }
     
-    void processCompleteMessage() {
-        if (m_messageBuffer.empty()) return;
+    void processIncomingData(const uint8_t* data, size_t length) {
+        uint64_t checksumErrors = m_framer.stats().checksumErrors;
+        uint64_t lengthErrors = m_framer.stats().lengthErrors;
+        
+        m_framer.feed(data, length, [this](const XbusFrame& frame) {
+            processCompleteMessage(frame);
+        });
         
-        // Verify checksum
-        if (!Xbus::verifyChecksum(m_messageBuffer.data())) {
+        if (m_framer.stats().checksumErrors != checksumErrors) {
             std::cerr << "Checksum verification failed!" << std::endl;
-            return;
+        }
+        if (m_framer.stats().lengthErrors != lengthErrors) {
+            std::cerr << "Invalid message length, restarting sync..." << std::endl;
+        }
+        
+        // One datagram per read rather than one per frame
+        for (std::unique_ptr<XbusBridgePublisher>& publisher : m_publishers) {
+            publisher->flush();
+        }
+    }
+    
+    void processCompleteMessage(const XbusFrame& frame) {
+        m_dispatcher.dispatch(0, frame, m_receiveTimeNs);
+    }
+    
+    void handleFrame(const XbusFrame& frame) {
+        // Frames from the framer already passed checksum verification
+        if (m_recorder.isOpen() && !m_recorder.record(frame, m_receiveTimeNs)) {
+            std::cerr << "Recording failed: " << m_recorder.getLastError() << std::endl;
+            m_recorder.close();
+        }
+        m_commands.handleFrame(0, frame);
+        for (std::unique_ptr<XbusBridgePublisher>& publisher : m_publishers) {
+            publisher->publishFrame(0, frame, m_receiveTimeNs);
         }
         
         // Parse and display the message
-        std::string messageStr = XbusParser::messageToString(m_messageBuffer.data());
-        std::cout << "Received: " << messageStr << std::endl;
-        
-        // Special handling for XMID_MtData2 with detailed data
-        uint8_t messageId = Xbus::getMessageId(m_messageBuffer.data());
-        if (messageId == XMID_MtData2) {
-            SensorData sensorData;
-            if (XbusParser::parseMTData2(m_messageBuffer.data(), sensorData)) {
-                // Display detailed breakdown
-                std::cout << "  -> Detailed Data:" << std::endl;
-                
-                if (sensorData.hasPacketCounter) {
-                    std::cout << "     Packet Counter: " << sensorData.packetCounter << std::endl;
-                }
-                
-                if (sensorData.hasSampleTimeFine) {
-                    std::cout << "     Sample Time Fine: " << sensorData.sampleTimeFine 
-                             << " (approx " << (sensorData.sampleTimeFine / 10000.0) << " ms)" << std::endl;
-                }
-                
-                if (sensorData.hasEulerAngles) {
-                    std::cout << "     Euler Angles: Roll=" << std::fixed << std::setprecision(3) 
-                             << sensorData.eulerAngles.roll << " deg, Pitch=" 
-                             << sensorData.eulerAngles.pitch << " deg, Yaw=" 
-                             << sensorData.eulerAngles.yaw << " deg" << std::endl;
-                }
-                
-                if (sensorData.hasLatLon) {
-                    std::cout << "     Position: Lat=" << std::fixed << std::setprecision(8) 
-                             << sensorData.latLon.latitude << " deg, Lon=" 
-                             << sensorData.latLon.longitude << " deg" << std::endl;
-                }
-                
-                if (sensorData.hasAltitudeEllipsoid) {
-                    std::cout << "     Altitude: " << std::fixed << std::setprecision(3) 
-                             << sensorData.altitudeEllipsoid << " m" << std::endl;
-                }
-                
-                if (sensorData.hasVelocityXYZ) {
-                    std::cout << "     Velocity: X=" << std::fixed << std::setprecision(4) 
-                             << sensorData.velocityXYZ.velX << " m/s, Y=" 
-                             << sensorData.velocityXYZ.velY << " m/s, Z=" 
-                             << sensorData.velocityXYZ.velZ << " m/s" << std::endl;
-                }
-                
-                if (sensorData.hasStatusWord) {
-                    std::cout << "     Status Word: 0x" << std::hex << std::uppercase 
-                             << std::setfill('0') << std::setw(8) << sensorData.statusWord 
-                             << std::dec << std::endl;
-                }
-            }
+        char text[XbusParser::TEXT_BUFFER_SIZE];
+        XbusTextWriter out(text);
+        XbusParser::messageToString(frame.data, out);
+        std::cout << "Received: ";
+        std::cout.write(out.data(), static_cast<std::streamsize>(out.size())) << std::endl;
+    }
+    
+    // The dispatcher decodes the packets of a new output configuration on
+    // the fast path from the first one on
+    void reportOutputConfig(const XbusFrame& frame) {
+        XbusOutputConfig config;
+        if (config.parse(frame.data, frame.size) && m_dispatcher.decoder(0).isLocked()) {
+            std::cout << "Decoder set up for " << config.size() << " outputs at "
+                      << config.packetRate() << " Hz" << std::endl;
         }
     }
     
-    void sendMessage(uint8_t messageId, const uint8_t* payload = nullptr, uint16_t payloadLength = 0) {
-        std::vector<uint8_t> message(32); // Allocate enough space
+    // Special handling for XMID_MtData2 with detailed data
+    void handleSample(const SensorData& sensorData) {
+        XbusClockTracker::Sample timing = m_clock.update(sensorData, m_receiveTimeNs);
+        if (timing.lostPackets != 0) {
+            std::cerr << "Packet counter gap before " << sensorData.packetCounter << std::endl;
+        }
+        if (timing.resynced) {
+            std::cerr << "Device clock restarted, resynchronizing" << std::endl;
+        }
+        if (m_export && !m_export->add(sensorData)) {
+            std::cerr << "Export failed: " << m_export->getLastError() << std::endl;
+            m_export.reset();
+            m_exportFile.reset();
+        }
+        for (std::unique_ptr<XbusBridgePublisher>& publisher : m_publishers) {
+            publisher->publishSample(0, sensorData, m_receiveTimeNs);
+        }
+        
+        // Display detailed breakdown
+        std::cout << "  -> Detailed Data:" << std::endl;
         
-        // Create the message
-        Xbus::createMessage(message.data(), Xbus::XBUS_MASTERDEVICE, messageId, payloadLength);
+        if (sensorData.hasPacketCounter) {
+            std::cout << "     Packet Counter: " << sensorData.packetCounter << std::endl;
+        }
         
-        // Copy payload if provided
-        if (payload && payloadLength > 0) {
-            uint8_t* payloadPtr = Xbus::getPointerToPayload(message.data());
-            memcpy(payloadPtr, payload, payloadLength);
+        if (sensorData.hasSampleTimeFine) {
+            std::cout << "     Sample Time Fine: " << sensorData.sampleTimeFine 
+                     << " (approx " << (sensorData.sampleTimeFine / 10000.0) << " ms)" << std::endl;
         }
         
-        // Insert checksum
-        Xbus::insertChecksum(message.data());
+        if (timing.source != XbusClockTracker::TimeSource::None) {
+            std::cout << "     Host Time: " << timing.hostTimeNs / 1000 << " us" << std::endl;
+        }
         
-        // Get actual message length and resize vector
-        int actualLength = Xbus::getRawLength(message.data());
-        message.resize(actualLength);
+        if (sensorData.hasEulerAngles) {
+            std::cout << "     Euler Angles: Roll=" << std::fixed << std::setprecision(3) 
+                     << sensorData.eulerAngles.roll << " deg, Pitch=" 
+                     << sensorData.eulerAngles.pitch << " deg, Yaw=" 
+                     << sensorData.eulerAngles.yaw << " deg" << std::endl;
+        }
         
-        // Create raw message for transmission
-        std::vector<uint8_t> rawMessage(actualLength + 10);
-        size_t rawLength = Xbus::createRawMessage(rawMessage.data(), message.data());
-        rawMessage.resize(rawLength);
+        if (sensorData.hasLatLon) {
+            std::cout << "     Position: Lat=" << std::fixed << std::setprecision(8) 
+                     << sensorData.latLon.latitude << " deg, Lon=" 
+                     << sensorData.latLon.longitude << " deg" << std::endl;
+        }
         
-        // Send the message
-        if (m_serial.write(rawMessage)) {
+        if (sensorData.hasAltitudeEllipsoid) {
+            std::cout << "     Altitude: " << std::fixed << std::setprecision(3) 
+                     << sensorData.altitudeEllipsoid << " m" << std::endl;
+        }
+        
+        if (sensorData.hasVelocityXYZ) {
+            std::cout << "     Velocity: X=" << std::fixed << std::setprecision(4) 
+                     << sensorData.velocityXYZ.velX << " m/s, Y=" 
+                     << sensorData.velocityXYZ.velY << " m/s, Z=" 
+                     << sensorData.velocityXYZ.velZ << " m/s" << std::endl;
+        }
+        
+        if (sensorData.hasStatusWord) {
+            std::cout << "     Status Word: 0x" << std::hex << std::uppercase 
+                     << std::setfill('0') << std::setw(8) << sensorData.statusWord 
+                     << std::dec << std::endl;
+        }
+    }
+    
+    void sendMessage(uint8_t messageId, const uint8_t* payload = nullptr, uint16_t payloadLength = 0) {
+        // Built in one pass, extended length included
+        size_t messageLength = XbusMessageBuilder::build(m_txBuffer.data(), m_txBuffer.size(),
+                                                         messageId, payload, payloadLength);
+        reportSent(messageId, m_serial.write(m_txBuffer.data(), messageLength));
+    }
+    
+    // Send a pre-encoded command frame (see XbusCommand) and report its
+    // acknowledgement when it arrives
+    template <size_t N>
+    void sendCommand(const char* name, const std::array<uint8_t, N>& frame) {
+        bool queued = m_commands.submit(0, frame, [name](const XbusCommandEngine::Reply& reply) {
+            reportReply(name, reply);
+        });
+        if (!queued) {
+            std::cerr << "Failed to send " << name << ": " << m_commands.getLastError() << std::endl;
+        }
+    }
+    
+    void reportSent(uint8_t messageId, bool sent) {
+        if (sent) {
             std::cout << "Sent message ID: 0x" << std::hex << static_cast<int>(messageId) << std::dec << std::endl;
         } else {
             std::cerr << "Failed to send message: " << m_serial.getLastError() << std::endl;
@@ -238,39 +625,322 @@ private:
     
     void requestDeviceInfo() {
         std::cout << "Requesting device ID..." << std::endl;
-        sendMessage(XMID_ReqDid);
+        sendCommand("ReqDid", XbusCommand::REQ_DID);
     }
     
     void gotoConfigMode() {
         std::cout << "Going to config mode..." << std::endl;
-        sendMessage(XMID_GotoConfig);
+        sendCommand("GotoConfig", XbusCommand::GOTO_CONFIG);
     }
     
     void gotoMeasurementMode() {
         std::cout << "Going to measurement mode..." << std::endl;
-        sendMessage(XMID_GotoMeasurement);
+        sendCommand("GotoMeasurement", XbusCommand::GOTO_MEASUREMENT);
+    }
+    
+    // Only answered in config mode
+    void requestOutputConfig() {
+        std::cout << "Requesting output configuration..." << std::endl;
+        sendCommand("ReqOutputConfig", XbusCommand::REQ_OUTPUT_CONFIG);
     }
     
     void requestFirmwareRevision() {
         std::cout << "Requesting firmware revision..." << std::endl;
-        sendMessage(XMID_ReqFirmwareRevision);
+        sendCommand("ReqFirmwareRevision", XbusCommand::REQ_FIRMWARE_REVISION);
     }
 };
 
-int main() {
+// Several devices: share a few I/O threads and print one status line per
+// device every second
+static int runDeviceManager(const std::vector<std::string>& portNames, DWORD baudRate, size_t maxFrame) {
+    XbusDeviceManager manager(XbusDeviceManager::DEFAULT_IO_THREADS, maxFrame);
+    for (const std::string& portName : portNames) {
+        if (manager.addDevice(portName, baudRate) < 0) {
+            std::cerr << "Failed to open " << portName << ": " << manager.getLastError() << std::endl;
+            return 1;
+        }
+    }
+    
+    // Latest sample of every device, written on the I/O threads
+    std::mutex latestMutex;
+    std::vector<SensorData> latest(portNames.size());
+    manager.setSampleCallback([&](const XbusDeviceManager::TaggedSample& sample) {
+        std::lock_guard<std::mutex> lock(latestMutex);
+        latest[sample.device] = sample.data;
+    });
+    manager.setErrorCallback([](size_t device, const std::string& error) {
+        std::cerr << "Device " << device << ": " << error << std::endl;
+    });
+    
+    // Replies to commands are matched on the I/O threads
+    XbusCommandEngine commands(portNames.size(), [&manager](size_t device, const uint8_t* frame, size_t size) {
+        return manager.send(device, frame, size);
+    });
+    manager.setFrameCallback([&commands](size_t device, const XbusFrame& frame) {
+        commands.handleFrame(device, frame);
+    });
+    commands.start();
+    
+    if (!manager.start()) {
+        std::cerr << "Failed to start device manager: " << manager.getLastError() << std::endl;
+        return 1;
+    }
+    
+    // Identify all devices at once: one command in flight per device, the
+    // firmware request goes out as soon as the device ID arrived
+    std::chrono::steady_clock::time_point queryStart = std::chrono::steady_clock::now();
+    std::vector<std::future<XbusCommandEngine::Reply>> deviceIds;
+    std::vector<std::future<XbusCommandEngine::Reply>> firmware;
+    for (size_t i = 0; i < manager.deviceCount(); i++) {
+        deviceIds.push_back(commands.request(i, XbusCommand::REQ_DID));
+        firmware.push_back(commands.request(i, XbusCommand::REQ_FIRMWARE_REVISION));
+    }
+    for (size_t i = 0; i < manager.deviceCount(); i++) {
+        XbusCommandEngine::Reply id = deviceIds[i].get();
+        XbusCommandEngine::Reply revision = firmware[i].get();
+        std::cout << "[" << i << " " << manager.portName(i) << "] ";
+        if (id.status == XbusCommandEngine::Status::Ok) {
+            std::cout << "device ID 0x" << std::hex << std::uppercase << XbusParser::parseDeviceId(id.frame.data())
+                      << std::dec << std::nouppercase;
+        } else {
+            std::cout << "no device ID";
+        }
+        if (revision.status == XbusCommandEngine::Status::Ok) {
+            std::cout << ", firmware " << XbusParser::parseFirmwareRevision(revision.frame.data());
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "Queried " << manager.deviceCount() << " devices in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - queryStart).count() << " ms" << std::endl;
+    
+    std::cout << "Listening on " << manager.deviceCount() << " devices with "
+              << manager.ioThreadCount() << " I/O threads. Press 'q' and Enter to quit." << std::endl;
+    
+    std::atomic<bool> running(true);
+    std::thread printer([&] {
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            std::lock_guard<std::mutex> lock(latestMutex);
+            for (size_t i = 0; i < manager.deviceCount(); i++) {
+                XbusDeviceManager::DeviceStats stats = manager.stats(i);
+                std::cout << "[" << i << " " << manager.portName(i) << "] samples=" << stats.samplesDecoded
+                          << " lost=" << stats.lostPackets << " crc=" << stats.framer.checksumErrors;
+                if (latest[i].hasEulerAngles) {
+                    std::cout << std::fixed << std::setprecision(3)
+                              << " Roll=" << latest[i].eulerAngles.roll
+                              << " Pitch=" << latest[i].eulerAngles.pitch
+                              << " Yaw=" << latest[i].eulerAngles.yaw;
+                }
+                std::cout << (stats.connected ? "" : " (disconnected)") << std::endl;
+            }
+        }
+    });
+    
+    std::string input;
+    while (std::cin >> input && input != "q" && input != "Q") {
+    }
+    
+    running = false;
+    printer.join();
+    commands.stop();
+    manager.stop();
+    return 0;
+}
+
+// Decode every MTData2 frame of a recording straight into an export file
+static int exportRecording(const std::string& replayPath, const std::string& exportPath) {
+    XbusReplay replay;
+    if (!replay.open(replayPath)) {
+        std::cerr << "Failed to open recording: " << replay.getLastError() << std::endl;
+        return 1;
+    }
+    
+    std::unique_ptr<XbusFileSink> file = createExportSink(exportPath);
+    if (!file->open(exportPath)) {
+        std::cerr << "Failed to create export: " << file->getLastError() << std::endl;
+        return 1;
+    }
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    XbusAsyncSink sink(*file);
+    sink.start();
+    XbusLayoutDecoder decoder;
+    bool ok = true;
+    replay.play([&](const XbusReplay::Record& record) {
+        // Records come straight from the file, so check length and checksum
+        // before the header is trusted
+        const XbusFrame& frame = record.frame;
+        SensorData data;
+        if (ok && Xbus::isComplete(frame.data, frame.size) && Xbus::verifyChecksum(frame.data) &&
+            decoder.decode(frame.data, frame.size, data)) {
+            ok = sink.add(data);
+        }
+    });
+    ok = sink.close() && ok;
+    
+    if (!ok) {
+        std::cerr << "Export failed: " << sink.getLastError() << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Exported " << file->rowsWritten() << " samples from " << replay.recordCount()
+              << " frames to " << exportPath << " in " << std::fixed << std::setprecision(2) << seconds
+              << " s" << std::endl;
+    return 0;
+}
+
+// Usage: xbus_reader [--baud <rate>] [--record <file>] [--export <file>] [--publish <target> ...]
+//                    [--read-priority <level>] [--read-cpus <list>] [--read-buffer <bytes>]
+//                    [--driver-queue <bytes>] [--max-frame <bytes>] [port ...]
+//        xbus_reader --replay <file> [--fast | --export <file>] [--publish <target> ...]
+//                    [--max-frame <bytes>]
+//        xbus_reader --subscribe <source> [--record <file>] [--export <file>]
+//
+// Exports are CSV for *.csv files and binary columns (XbusColumnSink) otherwise.
+// Bridge targets and sources are shm:<name> (same host) or udp:<address>:<port>
+// (a multicast group or unicast address); --publish may be repeated.
+//
+// The --read-* options set up the thread reading a single port (see
+// SerialReader::ReadConfig): its priority (normal, above-normal, highest or
+// time-critical, which is SCHED_FIFO on POSIX), the CPUs it may run on
+// ("2" or "2,3") and the bytes per read. --driver-queue sizes the Windows
+// driver's receive queue and is ignored, with a notice, elsewhere.
+//
+// --max-frame is the framer capacity of a port or replay and so the largest
+// frame accepted, 4096 bytes by default; larger frames are dropped as
+// invalid lengths. 65542 bytes takes every extended-length frame, but a
+// false preamble with a plausible header then stalls delivery until that
+// many bytes arrived (0.7 s at 921600 baud, see XbusFramer).
+int main(int argc, char* argv[]) {
     std::cout << "Xbus Serial Reader" << std::endl;
     std::cout << "==================" << std::endl;
     
-    XbusMessageProcessor processor;
+    // Default to COM9 (/dev/ttyUSB0 on Linux/macOS) at 115200 baud (8N1 is default)
+    DWORD baudRate = 115200;
+    std::vector<std::string> portNames;
+    std::string recordPath;
+    std::string replayPath;
+    std::string exportPath;
+    bool replayFast = false;
+    std::vector<std::string> publishTargets;
+    std::string subscribeSource;
+    SerialReader::ReadConfig readConfig;
+    size_t maxFrame = XbusFramer::DEFAULT_CAPACITY;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--baud" && i + 1 < argc) {
+            baudRate = static_cast<DWORD>(std::stoul(argv[++i]));
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--export" && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (arg == "--fast") {
+            replayFast = true;
+        } else if (arg == "--publish" && i + 1 < argc) {
+            publishTargets.push_back(argv[++i]);
+        } else if (arg == "--subscribe" && i + 1 < argc) {
+            subscribeSource = argv[++i];
+        } else if (arg == "--read-priority" && i + 1 < argc) {
+            if (!parseThreadPriority(argv[++i], readConfig.priority)) {
+                std::cerr << "Unknown read thread priority: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--read-cpus" && i + 1 < argc) {
+            if (!parseCpuList(argv[++i], readConfig.affinityMask)) {
+                std::cerr << "Invalid CPU list: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--read-buffer" && i + 1 < argc) {
+            uint32_t bytes = 0;
+            if (!parseByteCount(argv[++i], bytes) || bytes == 0) {
+                std::cerr << "Invalid read buffer size: " << argv[i] << std::endl;
+                return 1;
+            }
+            readConfig.readBufferSize = bytes;
+        } else if (arg == "--driver-queue" && i + 1 < argc) {
+            uint32_t bytes = 0;
+            if (!parseByteCount(argv[++i], bytes)) {
+                std::cerr << "Invalid driver queue size: " << argv[i] << std::endl;
+                return 1;
+            }
+#ifdef _WIN32
+            readConfig.driverInputQueue = static_cast<DWORD>(bytes);
+#else
+            std::cout << "--driver-queue only applies on Windows, ignoring it" << std::endl;
+#endif
+        } else if (arg == "--max-frame" && i + 1 < argc) {
+            uint32_t bytes = 0;
+            if (!parseByteCount(argv[++i], bytes) || bytes == 0 || bytes > XbusFramer::MAX_CAPACITY) {
+                std::cerr << "Invalid maximum frame size (at most " << XbusFramer::MAX_CAPACITY << " bytes): "
+                          << argv[i] << std::endl;
+                return 1;
+            }
+            maxFrame = bytes;
+        } else {
+            portNames.push_back(arg);
+        }
+    }
+    if (!replayPath.empty() && !exportPath.empty()) {
+        return exportRecording(replayPath, exportPath);
+    }
+    if (!replayPath.empty()) {
+        XbusMessageProcessor processor(maxFrame);
+        for (const std::string& target : publishTargets) {
+            if (!processor.startPublishing(target)) {
+                return 1;
+            }
+        }
+        return processor.replay(replayPath, replayFast ? 0.0 : 1.0) ? 0 : 1;
+    }
+    
+    if (!subscribeSource.empty()) {
+        XbusMessageProcessor processor;
+        if ((!recordPath.empty() && !processor.startRecording(recordPath)) ||
+            (!exportPath.empty() && !processor.startExport(exportPath))) {
+            return 1;
+        }
+        bool ok = processor.listen(subscribeSource);
+        processor.stop();
+        return ok ? 0 : 1;
+    }
+    
+    if (portNames.empty()) {
+#ifdef _WIN32
+        portNames.push_back("COM9");
+#else
+        portNames.push_back("/dev/ttyUSB0");
+#endif
+    }
     
-    // Initialize with COM9 at 115200 baud (8N1 is default)
-    if (!processor.initialize("COM9")) {
-        std::cerr << "Failed to initialize. Make sure COM9 is available and not in use." << std::endl;
+    if (portNames.size() > 1) {
+        return runDeviceManager(portNames, baudRate, maxFrame);
+    }
+    
+    XbusMessageProcessor processor(maxFrame);
+    
+    const std::string& portName = portNames[0];
+    if (!processor.initialize(portName, baudRate, readConfig)) {
+        std::cerr << "Failed to initialize. Make sure " << portName << " is available and not in use." << std::endl;
         std::cout << "Press Enter to exit...";
         std::cin.get();
         return 1;
     }
     
+    if (!recordPath.empty() && !processor.startRecording(recordPath)) {
+        return 1;
+    }
+    if (!exportPath.empty() && !processor.startExport(exportPath)) {
+        return 1;
+    }
+    for (const std::string& target : publishTargets) {
+        if (!processor.startPublishing(target)) {
+            return 1;
+        }
+    }
+    
     // Start processing
     processor.start();
     
@@ -278,4 +948,4 @@ int main() {
     processor.stop();
     
     return 0;
-}
\ No newline at end of file
+}
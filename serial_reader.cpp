@@ -1,16 +1,70 @@
 #include "serial_reader.h"
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+// Host steady clock in ns, the time base of SerialChunk::receiveTimeNs
+uint64_t steadyTimeNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
 
 SerialReader::SerialReader() 
     : m_hSerial(INVALID_HANDLE_VALUE)
     , m_isOpen(false)
+    , m_readMode(ReadMode::EventDriven)
     , m_hReadThread(nullptr)
-    , m_stopReading(false) {
+    , m_hStopEvent(CreateEvent(nullptr, TRUE, FALSE, nullptr))
+    , m_stopReading(false)
+    , m_dataQueue(nullptr)
+    , m_hReadEvent(nullptr)
+    , m_hWriteEvent(nullptr) {
 }
 
 SerialReader::~SerialReader() {
     close();
+    
+    if (m_hStopEvent != nullptr) {
+        CloseHandle(m_hStopEvent);
+    }
+}
+
+bool SerialReader::setReadMode(ReadMode mode) {
+    if (m_isOpen) {
+        setLastError("Read mode must be set before the port is opened");
+        return false;
+    }
+    
+    m_readMode = mode;
+    return true;
+}
+
+SerialReader::ReadMode SerialReader::getReadMode() const {
+    return m_readMode;
+}
+
+bool SerialReader::setReadConfig(const ReadConfig& config) {
+    if (m_isOpen) {
+        setLastError("Read config must be set before the port is opened");
+        return false;
+    }
+    
+    if (config.readBufferSize == 0 || config.readBufferSize > MAXDWORD) {
+        setLastError("Read buffer size must be between 1 and " + std::to_string(MAXDWORD));
+        return false;
+    }
+    
+    m_readConfig = config;
+    return true;
+}
+
+const SerialReader::ReadConfig& SerialReader::getReadConfig() const {
+    return m_readConfig;
 }
 
 bool SerialReader::open(const std::string& portName, DWORD baudRate, 
@@ -22,12 +76,17 @@ bool SerialReader::open(const std::string& portName, DWORD baudRate,
     
     // Open the serial port
     std::string fullPortName = "\\\\.\\" + portName;
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (m_readMode == ReadMode::EventDriven) {
+        flags |= FILE_FLAG_OVERLAPPED;
+    }
+    
     m_hSerial = CreateFileA(fullPortName.c_str(),
                            GENERIC_READ | GENERIC_WRITE,
                            0,
                            nullptr,
                            OPEN_EXISTING,
-                           FILE_ATTRIBUTE_NORMAL,
+                           flags,
                            nullptr);
     
     if (m_hSerial == INVALID_HANDLE_VALUE) {
@@ -43,6 +102,16 @@ bool SerialReader::open(const std::string& portName, DWORD baudRate,
         return false;
     }
     
+    // Size the driver queues; drivers may round or ignore the request
+    if ((m_readConfig.driverInputQueue != 0 || m_readConfig.driverOutputQueue != 0) &&
+        !SetupComm(m_hSerial, m_readConfig.driverInputQueue, m_readConfig.driverOutputQueue)) {
+        DWORD error = GetLastError();
+        setLastError("Failed to set driver queue sizes. Error code: " + std::to_string(error));
+        CloseHandle(m_hSerial);
+        m_hSerial = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    
     // Set timeouts
     COMMTIMEOUTS timeouts = {0};
     timeouts.ReadIntervalTimeout = 50;
@@ -58,9 +127,23 @@ bool SerialReader::open(const std::string& portName, DWORD baudRate,
         return false;
     }
     
+    // Overlapped transfers need an event to wait on
+    if (m_readMode == ReadMode::EventDriven) {
+        m_hReadEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        m_hWriteEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        if (m_hReadEvent == nullptr || m_hWriteEvent == nullptr) {
+            setLastError("Failed to create I/O events");
+            close();
+            CloseHandle(m_hSerial);
+            m_hSerial = INVALID_HANDLE_VALUE;
+            return false;
+        }
+    }
+    
     // Flush any existing data
     flushBuffers();
     
+    m_stats = Stats();
     m_isOpen = true;
     return true;
 }
@@ -76,12 +159,29 @@ void SerialReader::close() {
         
         m_isOpen = false;
     }
+    
+    if (m_hReadEvent != nullptr) {
+        CloseHandle(m_hReadEvent);
+        m_hReadEvent = nullptr;
+    }
+    if (m_hWriteEvent != nullptr) {
+        CloseHandle(m_hWriteEvent);
+        m_hWriteEvent = nullptr;
+    }
 }
 
 bool SerialReader::isOpen() const {
     return m_isOpen;
 }
 
+SerialReader::NativeHandle SerialReader::nativeHandle() const {
+    return m_hSerial;
+}
+
+SerialReader::Stats SerialReader::stats() const {
+    return m_stats;
+}
+
 bool SerialReader::write(const uint8_t* data, size_t length) {
     if (!m_isOpen) {
         setLastError("Port is not open");
@@ -89,7 +189,7 @@ bool SerialReader::write(const uint8_t* data, size_t length) {
     }
     
     DWORD bytesWritten = 0;
-    if (!WriteFile(m_hSerial, data, static_cast<DWORD>(length), &bytesWritten, nullptr)) {
+    if (!transfer(true, const_cast<uint8_t*>(data), static_cast<DWORD>(length), bytesWritten)) {
         setLastError("Failed to write data");
         return false;
     }
@@ -116,8 +216,9 @@ int SerialReader::read(uint8_t* buffer, size_t bufferSize, DWORD timeoutMs) {
     SetCommTimeouts(m_hSerial, &timeouts);
     
     DWORD bytesRead = 0;
-    if (!ReadFile(m_hSerial, buffer, static_cast<DWORD>(bufferSize), &bytesRead, nullptr)) {
+    if (!transfer(false, buffer, static_cast<DWORD>(bufferSize), bytesRead)) {
         setLastError("Failed to read data");
+        ++m_stats.readErrors;
         return -1;
     }
     
@@ -137,8 +238,10 @@ int SerialReader::readAvailable(uint8_t* buffer, size_t bufferSize) {
     // Check how many bytes are available
     if (!ClearCommError(m_hSerial, &errors, &comStat)) {
         setLastError("Failed to get comm status");
+        ++m_stats.readErrors;
         return -1;
     }
+    countCommErrors(errors);
     
     if (comStat.cbInQue == 0) {
         return 0; // No data available
@@ -146,8 +249,9 @@ int SerialReader::readAvailable(uint8_t* buffer, size_t bufferSize) {
     
     DWORD toRead = std::min(static_cast<DWORD>(bufferSize), comStat.cbInQue);
     
-    if (!ReadFile(m_hSerial, buffer, toRead, &bytesRead, nullptr)) {
+    if (!transfer(false, buffer, toRead, bytesRead)) {
         setLastError("Failed to read data");
+        ++m_stats.readErrors;
         return -1;
     }
     
@@ -158,6 +262,16 @@ void SerialReader::setDataCallback(std::function<void(const uint8_t*, size_t)> c
     m_dataCallback = callback;
 }
 
+bool SerialReader::setDataQueue(ChunkQueue* queue) {
+    if (m_hReadThread != nullptr) {
+        setLastError("Cannot change the data queue while async reading is running");
+        return false;
+    }
+    
+    m_dataQueue = queue;
+    return true;
+}
+
 bool SerialReader::startAsyncReading() {
     if (!m_isOpen) {
         setLastError("Port is not open");
@@ -169,20 +283,37 @@ bool SerialReader::startAsyncReading() {
         return false;
     }
     
+    m_readBuffer.resize(m_readConfig.readBufferSize);
     m_stopReading = false;
-    m_hReadThread = CreateThread(nullptr, 0, readThreadProc, this, 0, nullptr);
+    ResetEvent(m_hStopEvent);
+    
+    // Apply the scheduling settings before the thread first runs
+    m_hReadThread = CreateThread(nullptr, 0, readThreadProc, this, CREATE_SUSPENDED, nullptr);
     
     if (m_hReadThread == nullptr) {
         setLastError("Failed to create read thread");
         return false;
     }
     
+    if (!applyThreadConfig()) {
+        // Let the thread run straight out of the read loop
+        m_stopReading = true;
+        SetEvent(m_hStopEvent);
+        ResumeThread(m_hReadThread);
+        WaitForSingleObject(m_hReadThread, INFINITE);
+        CloseHandle(m_hReadThread);
+        m_hReadThread = nullptr;
+        return false;
+    }
+    
+    ResumeThread(m_hReadThread);
     return true;
 }
 
 void SerialReader::stopAsyncReading() {
     if (m_hReadThread != nullptr) {
         m_stopReading = true;
+        SetEvent(m_hStopEvent);
         WaitForSingleObject(m_hReadThread, 2000); // Wait up to 2 seconds
         CloseHandle(m_hReadThread);
         m_hReadThread = nullptr;
@@ -207,17 +338,162 @@ DWORD WINAPI SerialReader::readThreadProc(LPVOID lpParam) {
     return 0;
 }
 
+bool SerialReader::applyThreadConfig() {
+    if (m_readConfig.affinityMask != 0 &&
+        SetThreadAffinityMask(m_hReadThread, static_cast<DWORD_PTR>(m_readConfig.affinityMask)) == 0) {
+        DWORD error = GetLastError();
+        setLastError("Failed to set read thread affinity. Error code: " + std::to_string(error));
+        return false;
+    }
+    
+    int priority = THREAD_PRIORITY_NORMAL;
+    switch (m_readConfig.priority) {
+        case ThreadPriority::Normal: return true;
+        case ThreadPriority::AboveNormal: priority = THREAD_PRIORITY_ABOVE_NORMAL; break;
+        case ThreadPriority::Highest: priority = THREAD_PRIORITY_HIGHEST; break;
+        case ThreadPriority::TimeCritical: priority = THREAD_PRIORITY_TIME_CRITICAL; break;
+    }
+    
+    if (!SetThreadPriority(m_hReadThread, priority)) {
+        DWORD error = GetLastError();
+        setLastError("Failed to set read thread priority. Error code: " + std::to_string(error));
+        return false;
+    }
+    
+    return true;
+}
+
 void SerialReader::readLoop() {
-    uint8_t buffer[1024];
+    if (m_readMode == ReadMode::EventDriven) {
+        eventReadLoop();
+    } else {
+        pollingReadLoop();
+    }
+}
+
+void SerialReader::deliver(const uint8_t* data, size_t length) {
+    uint64_t receiveTimeNs = steadyTimeNs();
+    m_stats.bytesRead += length;
+    ++m_stats.reads;
+    
+    if (m_dataQueue) {
+        // Reads larger than a chunk (ReadConfig::readBufferSize) are split
+        size_t offset = 0;
+        while (offset < length) {
+            size_t chunkSize = std::min(length - offset, SerialChunk::MAX_SIZE);
+            SerialChunk* chunk = m_dataQueue->beginPush();
+            if (chunk) {
+                memcpy(chunk->data, data + offset, chunkSize);
+                chunk->length = static_cast<uint16_t>(chunkSize);
+                chunk->receiveTimeNs = receiveTimeNs;
+                m_dataQueue->commitPush();
+                ++m_stats.chunksQueued;
+            } else {
+                ++m_stats.chunksDropped;
+            }
+            offset += chunkSize;
+        }
+        m_stats.queueHighWater.updateMax(m_dataQueue->size());
+    }
+    
+    if (m_dataCallback) {
+        m_dataCallback(data, length);
+    }
+    
+    m_stats.deliveryLatency.record(steadyTimeNs() - receiveTimeNs);
+}
+
+void SerialReader::pollingReadLoop() {
+    uint8_t* buffer = m_readBuffer.data();
     
     while (!m_stopReading && m_isOpen) {
-        int bytesRead = readAvailable(buffer, sizeof(buffer));
+        int bytesRead = readAvailable(buffer, m_readBuffer.size());
         
-        if (bytesRead > 0 && m_dataCallback) {
-            m_dataCallback(buffer, bytesRead);
+        if (bytesRead > 0) {
+            deliver(buffer, bytesRead);
         }
         
-        Sleep(10); // Small delay to prevent excessive CPU usage
+        // Small delay to prevent excessive CPU usage; returns early on stop
+        WaitForSingleObject(m_hStopEvent, POLL_INTERVAL_MS);
+    }
+}
+
+void SerialReader::eventReadLoop() {
+    // With ReadIntervalTimeout and ReadTotalTimeoutMultiplier at MAXDWORD,
+    // ReadFile returns at once with whatever the driver has buffered, or
+    // completes as soon as the first byte arrives. The constant only bounds
+    // an idle wait, after which the read completes with zero bytes.
+    COMMTIMEOUTS timeouts = {0};
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = 1000;
+    timeouts.WriteTotalTimeoutConstant = 50;
+    timeouts.WriteTotalTimeoutMultiplier = 10;
+    
+    if (!SetCommTimeouts(m_hSerial, &timeouts)) {
+        setLastError("Failed to set timeouts");
+        return;
+    }
+    
+    OVERLAPPED overlapped = {0};
+    overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (overlapped.hEvent == nullptr) {
+        setLastError("Failed to create read event");
+        return;
+    }
+    
+    HANDLE waitHandles[2] = { overlapped.hEvent, m_hStopEvent };
+    uint8_t* buffer = m_readBuffer.data();
+    DWORD bufferSize = static_cast<DWORD>(m_readBuffer.size());
+    
+    while (!m_stopReading && m_isOpen) {
+        DWORD bytesRead = 0;
+        
+        if (!ReadFile(m_hSerial, buffer, bufferSize, nullptr, &overlapped) &&
+            GetLastError() != ERROR_IO_PENDING) {
+            setLastError("Failed to read data");
+            break;
+        }
+        
+        DWORD waitResult = WaitForMultipleObjects(2, waitHandles, FALSE, INFINITE);
+        if (waitResult != WAIT_OBJECT_0) {
+            // Stop requested: cancel the pending read before the buffer goes away
+            CancelIoEx(m_hSerial, &overlapped);
+            GetOverlappedResult(m_hSerial, &overlapped, &bytesRead, TRUE);
+            break;
+        }
+        
+        if (!GetOverlappedResult(m_hSerial, &overlapped, &bytesRead, FALSE)) {
+            setLastError("Failed to read data");
+            ++m_stats.readErrors;
+            break;
+        }
+        
+        // Overruns and line errors are only reported through ClearCommError
+        DWORD errors = 0;
+        if (ClearCommError(m_hSerial, &errors, nullptr)) {
+            countCommErrors(errors);
+        }
+        
+        if (bytesRead > 0) {
+            deliver(buffer, bytesRead);
+        }
+    }
+    
+    CloseHandle(overlapped.hEvent);
+}
+
+void SerialReader::countCommErrors(DWORD errors) {
+    // ClearCommError reports which errors occurred since the last call, not
+    // how often, so each call adds at most one per kind
+    if (errors & (CE_OVERRUN | CE_RXOVER)) {
+        ++m_stats.driverOverruns;
+    }
+    if (errors & CE_FRAME) {
+        ++m_stats.framingErrors;
+    }
+    if (errors & CE_RXPARITY) {
+        ++m_stats.parityErrors;
     }
 }
 
@@ -225,6 +501,32 @@ void SerialReader::setLastError(const std::string& error) {
     m_lastError = error;
 }
 
+bool SerialReader::transfer(bool isWrite, void* buffer, DWORD length, DWORD& transferred) {
+    transferred = 0;
+    
+    if (m_readMode != ReadMode::EventDriven) {
+        BOOL result = isWrite ? WriteFile(m_hSerial, buffer, length, &transferred, nullptr)
+                              : ReadFile(m_hSerial, buffer, length, &transferred, nullptr);
+        return result != 0;
+    }
+    
+    // The port is overlapped: start the transfer and wait for it to finish.
+    // The comm timeouts still bound how long that takes.
+    // Setting the low bit of hEvent keeps the completion off any I/O
+    // completion port the handle has been associated with (XbusDeviceManager)
+    OVERLAPPED overlapped = {0};
+    overlapped.hEvent = reinterpret_cast<HANDLE>(
+        reinterpret_cast<DWORD_PTR>(isWrite ? m_hWriteEvent : m_hReadEvent) | 1);
+    
+    BOOL started = isWrite ? WriteFile(m_hSerial, buffer, length, nullptr, &overlapped)
+                           : ReadFile(m_hSerial, buffer, length, nullptr, &overlapped);
+    if (!started && GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+    
+    return GetOverlappedResult(m_hSerial, &overlapped, &transferred, TRUE) != 0;
+}
+
 bool SerialReader::setupSerialPort(DWORD baudRate, BYTE dataBits, BYTE parity, BYTE stopBits) {
     DCB dcb = {0};
     dcb.DCBlength = sizeof(DCB);
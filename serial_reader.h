@@ -1,20 +1,110 @@
 #ifndef SERIAL_READER_H
 #define SERIAL_READER_H
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <cstdint>
+#include <thread>
+
+// The SerialReader API uses the Win32 type and constant names; the POSIX
+// backend (serial_reader_posix.cpp) maps them onto termios settings.
+typedef uint32_t DWORD;
+typedef uint8_t BYTE;
+
+constexpr BYTE NOPARITY = 0;
+constexpr BYTE ODDPARITY = 1;
+constexpr BYTE EVENPARITY = 2;
+constexpr BYTE MARKPARITY = 3;
+constexpr BYTE SPACEPARITY = 4;
+
+constexpr BYTE ONESTOPBIT = 0;
+constexpr BYTE ONE5STOPBITS = 1;
+constexpr BYTE TWOSTOPBITS = 2;
+#endif
+
 #include <string>
 #include <vector>
 #include <functional>
+#include <atomic>
+#include "xbus_spsc_queue.h"
+#include "xbus_stats.h"
+
+// Block of received bytes as handed over through SerialReader's data queue
+struct SerialChunk {
+    static constexpr size_t MAX_SIZE = 1024;  // one read of the async read loop at the default buffer size
+    
+    uint16_t length;
+    uint64_t receiveTimeNs;  // host steady clock when the read completed
+    uint8_t data[MAX_SIZE];
+};
 
 class SerialReader {
 public:
+    typedef SpscQueue<SerialChunk> ChunkQueue;
+    
+    // Receive statistics, updated by the read thread and readable from any
+    // thread (see xbus_stats.h). Reset by open().
+    struct Stats {
+        RelaxedCounter bytesRead;
+        RelaxedCounter reads;             // reads that returned data
+        RelaxedCounter readErrors;
+        RelaxedCounter chunksQueued;
+        RelaxedCounter chunksDropped;     // data queue full: the consumer is too slow
+        RelaxedCounter queueHighWater;    // deepest data queue seen, in chunks
+        RelaxedCounter driverOverruns;    // receive overruns reported by the driver
+        RelaxedCounter framingErrors;
+        RelaxedCounter parityErrors;
+        LatencyHistogram deliveryLatency; // read completion until the data callback returned, ns
+    };
+    
+    // How the async read thread waits for incoming data
+    enum class ReadMode {
+        Polling,      // Check the driver queue every POLL_INTERVAL_MS (original behavior)
+        EventDriven   // Overlapped I/O on Windows, epoll/poll on POSIX; data is delivered as soon as the driver has it
+    };
+    
+    static constexpr DWORD POLL_INTERVAL_MS = 10;
+    
+    // Scheduling priority of the async read thread
+    enum class ThreadPriority {
+        Normal,         // Inherited from the creating thread
+        AboveNormal,    // THREAD_PRIORITY_ABOVE_NORMAL on Windows, nice -5 on Linux
+        Highest,        // THREAD_PRIORITY_HIGHEST on Windows, nice -10 on Linux
+        TimeCritical    // THREAD_PRIORITY_TIME_CRITICAL on Windows, SCHED_FIFO at realtimePriority on POSIX
+    };
+    
+    // Async read thread and driver settings. Raising the priority or using
+    // SCHED_FIFO usually needs privileges (CAP_SYS_NICE or an rtprio limit
+    // on Linux); startAsyncReading() fails if a setting cannot be applied.
+    struct ReadConfig {
+        ThreadPriority priority = ThreadPriority::Normal;
+        int realtimePriority = 50;              // SCHED_FIFO priority for TimeCritical, 1-99 on Linux; ignored on Windows
+        uint64_t affinityMask = 0;              // CPUs the read thread may run on, bit n for CPU n; 0 leaves it unrestricted
+        size_t readBufferSize = SerialChunk::MAX_SIZE;  // bytes per read; larger reads are queued as several chunks
+        DWORD driverInputQueue = 0;             // SetupComm queue sizes on Windows, 0 keeps the driver's; ignored on POSIX
+        DWORD driverOutputQueue = 0;
+    };
+    
     // Constructor
     SerialReader();
     
     // Destructor
     ~SerialReader();
     
-    // Open serial port with specified parameters
+    // Select the read mode. Must be called before open(), because
+    // event-driven mode opens the port with FILE_FLAG_OVERLAPPED.
+    bool setReadMode(ReadMode mode);
+    ReadMode getReadMode() const;
+    
+    // Select the read thread and driver settings. Must be called before
+    // open(), which sizes the driver queues.
+    bool setReadConfig(const ReadConfig& config);
+    const ReadConfig& getReadConfig() const;
+    
+    // Open serial port with specified parameters. On POSIX systems portName
+    // is a device path ("/dev/ttyUSB0"); a bare name is looked up in /dev.
+    // Any baud rate the driver accepts can be used, not only the standard ones.
     bool open(const std::string& portName, DWORD baudRate = 115200, 
               BYTE dataBits = 8, BYTE parity = NOPARITY, BYTE stopBits = ONESTOPBIT);
     
@@ -37,6 +127,14 @@ public:
     // Set callback for received data (for async reading)
     void setDataCallback(std::function<void(const uint8_t*, size_t)> callback);
     
+    // Queue received data for a consumer thread instead of handling it on
+    // the read thread. The read loop only copies each read into the queue,
+    // so slow consumers cannot stall it; when the queue is full the chunk is
+    // dropped and counted in the queue stats. The queue must outlive the
+    // async reading and can be combined with a data callback. Pass nullptr to
+    // detach. Must be called while async reading is stopped.
+    bool setDataQueue(ChunkQueue* queue);
+    
     // Start/stop async reading thread
     bool startAsyncReading();
     void stopAsyncReading();
@@ -44,26 +142,78 @@ public:
     // Get last error message
     std::string getLastError() const;
     
+    // OS handle of the open port, for multiplexing several ports on one
+    // thread (see XbusDeviceManager). Do not close it or change its settings.
+#ifdef _WIN32
+    typedef HANDLE NativeHandle;
+#else
+    typedef int NativeHandle;
+#endif
+    NativeHandle nativeHandle() const;
+    
     // Flush input/output buffers
     bool flushBuffers();
     
+    // Snapshot of the receive statistics. The driver error counts come from
+    // TIOCGICOUNT on Linux and ClearCommError on Windows; they stay 0 where
+    // the driver does not report them (e.g. ptys, macOS).
+    Stats stats() const;
+
 private:
+#ifdef _WIN32
     HANDLE m_hSerial;
+#else
+    int m_fd;
+#endif
     bool m_isOpen;
     std::string m_lastError;
     
+    ReadMode m_readMode;
+    ReadConfig m_readConfig;
+    
     // Async reading
+#ifdef _WIN32
     HANDLE m_hReadThread;
-    bool m_stopReading;
+    HANDLE m_hStopEvent;
+#else
+    std::thread m_readThread;
+    int m_stopPipe[2];  // written on stop to wake the read loop
+#endif
+    std::atomic<bool> m_stopReading;
     std::function<void(const uint8_t*, size_t)> m_dataCallback;
+    ChunkQueue* m_dataQueue;
+    std::vector<uint8_t> m_readBuffer;  // sized by startAsyncReading()
+    Stats m_stats;
+#if defined(__linux__)
+    // Driver error counts at open(); stats() reports the difference
+    uint64_t m_baseOverruns;
+    uint64_t m_baseFramingErrors;
+    uint64_t m_baseParityErrors;
+#endif
+
+#ifdef _WIN32
+    // Completion events for overlapped transfers made outside the read thread
+    HANDLE m_hReadEvent;
+    HANDLE m_hWriteEvent;
     
     // Thread function for async reading
     static DWORD WINAPI readThreadProc(LPVOID lpParam);
+#endif
+    bool applyThreadConfig();
     void readLoop();
+    void pollingReadLoop();
+    void eventReadLoop();
+    void deliver(const uint8_t* data, size_t length);
     
     // Helper methods
     void setLastError(const std::string& error);
     bool setupSerialPort(DWORD baudRate, BYTE dataBits, BYTE parity, BYTE stopBits);
+#ifdef _WIN32
+    bool transfer(bool isWrite, void* buffer, DWORD length, DWORD& transferred);
+    void countCommErrors(DWORD errors);
+#else
+    bool waitReadable(int timeoutMs);
+#endif
 };
 
-#endif // SERIAL_READER_H
\ No newline at end of file
+#endif // SERIAL_READER_H
@@ -0,0 +1,47 @@
+#include "serial_reader_linux.h"
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+namespace SerialLinux {
+
+bool setCustomBaudRate(int fd, uint32_t baudRate) {
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        return false;
+    }
+    
+    // Same rate for output and input
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_cflag &= ~(CBAUD << IBSHIFT);
+    tio.c_cflag |= BOTHER << IBSHIFT;
+    tio.c_ospeed = baudRate;
+    tio.c_ispeed = baudRate;
+    
+    return ioctl(fd, TCSETS2, &tio) == 0;
+}
+
+bool setLowLatency(int fd) {
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) != 0) {
+        return false;
+    }
+    
+    serial.flags |= ASYNC_LOW_LATENCY;
+    return ioctl(fd, TIOCSSERIAL, &serial) == 0;
+}
+
+bool getErrorCounters(int fd, ErrorCounters& counters) {
+    struct serial_icounter_struct icount;
+    if (ioctl(fd, TIOCGICOUNT, &icount) != 0) {
+        return false;
+    }
+    
+    counters.overruns = static_cast<uint64_t>(icount.overrun) + static_cast<uint64_t>(icount.buf_overrun);
+    counters.framingErrors = static_cast<uint64_t>(icount.frame);
+    counters.parityErrors = static_cast<uint64_t>(icount.parity);
+    return true;
+}
+
+} // namespace SerialLinux
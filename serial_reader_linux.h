@@ -0,0 +1,30 @@
+#ifndef SERIAL_READER_LINUX_H
+#define SERIAL_READER_LINUX_H
+
+#include <cstdint>
+
+// Linux specific serial port settings. These need the kernel termios2
+// definitions, which cannot be included next to <termios.h>, so they live in
+// their own translation unit.
+namespace SerialLinux {
+
+// Set an arbitrary baud rate with BOTHER/termios2
+bool setCustomBaudRate(int fd, uint32_t baudRate);
+
+// Request ASYNC_LOW_LATENCY; FTDI adapters then drop their latency timer to 1 ms
+bool setLowLatency(int fd);
+
+// Receive error counts kept by the driver since the port was opened
+struct ErrorCounters {
+    uint64_t overruns = 0;       // UART and driver buffer overruns
+    uint64_t framingErrors = 0;
+    uint64_t parityErrors = 0;
+};
+
+// Read the driver error counters (TIOCGICOUNT). Returns false if the driver
+// does not keep them, e.g. for ptys.
+bool getErrorCounters(int fd, ErrorCounters& counters);
+
+} // namespace SerialLinux
+
+#endif // SERIAL_READER_LINUX_H
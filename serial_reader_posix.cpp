@@ -0,0 +1,663 @@
+// POSIX (Linux/macOS) implementation of SerialReader
+#include "serial_reader.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <system_error>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "serial_reader_linux.h"
+#elif defined(__APPLE__)
+#include <IOKit/serial/ioss.h>
+#endif
+
+namespace {
+
+std::string errorString(int error) {
+    return std::string(strerror(error)) + " (errno " + std::to_string(error) + ")";
+}
+
+std::string errnoString() {
+    return errorString(errno);
+}
+
+// Host steady clock in ns, the time base of SerialChunk::receiveTimeNs
+uint64_t steadyTimeNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Standard termios speed constant for a baud rate, or B0 if there is none
+speed_t standardSpeed(DWORD baudRate) {
+    switch (baudRate) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+#ifdef B460800
+        case 460800: return B460800;
+#endif
+#ifdef B921600
+        case 921600: return B921600;
+#endif
+#ifdef B1000000
+        case 1000000: return B1000000;
+#endif
+#ifdef B2000000
+        case 2000000: return B2000000;
+#endif
+#ifdef B4000000
+        case 4000000: return B4000000;
+#endif
+        default: return B0;
+    }
+}
+
+} // namespace
+
+SerialReader::SerialReader()
+    : m_fd(-1)
+    , m_isOpen(false)
+    , m_readMode(ReadMode::EventDriven)
+    , m_stopReading(false)
+    , m_dataQueue(nullptr)
+#if defined(__linux__)
+    , m_baseOverruns(0)
+    , m_baseFramingErrors(0)
+    , m_baseParityErrors(0)
+#endif
+{
+    m_stopPipe[0] = -1;
+    m_stopPipe[1] = -1;
+}
+
+SerialReader::~SerialReader() {
+    close();
+}
+
+bool SerialReader::setReadMode(ReadMode mode) {
+    if (m_isOpen) {
+        setLastError("Read mode must be set before the port is opened");
+        return false;
+    }
+    
+    m_readMode = mode;
+    return true;
+}
+
+SerialReader::ReadMode SerialReader::getReadMode() const {
+    return m_readMode;
+}
+
+bool SerialReader::setReadConfig(const ReadConfig& config) {
+    if (m_isOpen) {
+        setLastError("Read config must be set before the port is opened");
+        return false;
+    }
+    
+    if (config.readBufferSize == 0) {
+        setLastError("Read buffer size must not be 0");
+        return false;
+    }
+    
+    m_readConfig = config;
+    return true;
+}
+
+const SerialReader::ReadConfig& SerialReader::getReadConfig() const {
+    return m_readConfig;
+}
+
+bool SerialReader::open(const std::string& portName, DWORD baudRate,
+                       BYTE dataBits, BYTE parity, BYTE stopBits) {
+    if (m_isOpen) {
+        setLastError("Port is already open");
+        return false;
+    }
+    
+    // Open the serial port without becoming its controlling process
+    std::string fullPortName = (portName.find('/') == std::string::npos) ? "/dev/" + portName : portName;
+    m_fd = ::open(fullPortName.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    
+    if (m_fd < 0) {
+        setLastError("Failed to open port " + portName + ". Error: " + errnoString());
+        return false;
+    }
+    
+    // Exclusive access, like share mode 0 on Windows
+    if (ioctl(m_fd, TIOCEXCL) != 0) {
+        setLastError("Failed to get exclusive access to " + portName + ". Error: " + errnoString());
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    
+    // Setup the serial port parameters
+    if (!setupSerialPort(baudRate, dataBits, parity, stopBits)) {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    
+    m_isOpen = true;
+    m_stats = Stats();
+
+#if defined(__linux__)
+    SerialLinux::ErrorCounters counters;
+    if (SerialLinux::getErrorCounters(m_fd, counters)) {
+        m_baseOverruns = counters.overruns;
+        m_baseFramingErrors = counters.framingErrors;
+        m_baseParityErrors = counters.parityErrors;
+    }
+#endif
+
+    // Flush any existing data
+    flushBuffers();
+    
+    return true;
+}
+
+void SerialReader::close() {
+    if (m_isOpen) {
+        stopAsyncReading();
+        
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        
+        m_isOpen = false;
+    }
+}
+
+bool SerialReader::isOpen() const {
+    return m_isOpen;
+}
+
+SerialReader::NativeHandle SerialReader::nativeHandle() const {
+    return m_fd;
+}
+
+SerialReader::Stats SerialReader::stats() const {
+    Stats snapshot = m_stats;
+#if defined(__linux__)
+    SerialLinux::ErrorCounters counters;
+    if (m_isOpen && SerialLinux::getErrorCounters(m_fd, counters)) {
+        snapshot.driverOverruns = counters.overruns - m_baseOverruns;
+        snapshot.framingErrors = counters.framingErrors - m_baseFramingErrors;
+        snapshot.parityErrors = counters.parityErrors - m_baseParityErrors;
+    }
+#endif
+    return snapshot;
+}
+
+bool SerialReader::write(const uint8_t* data, size_t length) {
+    if (!m_isOpen) {
+        setLastError("Port is not open");
+        return false;
+    }
+    
+    // The descriptor is non-blocking; wait for room in the driver queue
+    size_t written = 0;
+    while (written < length) {
+        ssize_t result = ::write(m_fd, data + written, length - written);
+        if (result > 0) {
+            written += static_cast<size_t>(result);
+            continue;
+        }
+        
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd pfd = { m_fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, 1000) > 0) {
+                continue;
+            }
+        }
+        
+        setLastError("Failed to write data: " + errnoString());
+        return false;
+    }
+    
+    return true;
+}
+
+bool SerialReader::write(const std::vector<uint8_t>& data) {
+    return write(data.data(), data.size());
+}
+
+int SerialReader::read(uint8_t* buffer, size_t bufferSize, DWORD timeoutMs) {
+    if (!m_isOpen) {
+        setLastError("Port is not open");
+        return -1;
+    }
+    
+    if (!waitReadable(static_cast<int>(timeoutMs))) {
+        return 0; // Timed out
+    }
+    
+    return readAvailable(buffer, bufferSize);
+}
+
+int SerialReader::readAvailable(uint8_t* buffer, size_t bufferSize) {
+    if (!m_isOpen) {
+        setLastError("Port is not open");
+        return -1;
+    }
+    
+    ssize_t bytesRead;
+    do {
+        bytesRead = ::read(m_fd, buffer, bufferSize);
+    } while (bytesRead < 0 && errno == EINTR);
+    
+    if (bytesRead < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0; // No data available
+        }
+        setLastError("Failed to read data: " + errnoString());
+        ++m_stats.readErrors;
+        return -1;
+    }
+    
+    return static_cast<int>(bytesRead);
+}
+
+void SerialReader::setDataCallback(std::function<void(const uint8_t*, size_t)> callback) {
+    m_dataCallback = callback;
+}
+
+bool SerialReader::setDataQueue(ChunkQueue* queue) {
+    if (m_readThread.joinable()) {
+        setLastError("Cannot change the data queue while async reading is running");
+        return false;
+    }
+    
+    m_dataQueue = queue;
+    return true;
+}
+
+bool SerialReader::startAsyncReading() {
+    if (!m_isOpen) {
+        setLastError("Port is not open");
+        return false;
+    }
+    
+    if (m_readThread.joinable()) {
+        setLastError("Async reading is already started");
+        return false;
+    }
+    
+    if (pipe(m_stopPipe) != 0) {
+        setLastError("Failed to create stop pipe: " + errnoString());
+        return false;
+    }
+    fcntl(m_stopPipe[0], F_SETFL, O_NONBLOCK);
+    
+    m_readBuffer.resize(m_readConfig.readBufferSize);
+    m_stopReading = false;
+    
+    // The thread applies its scheduling settings itself before reading;
+    // wait for the result so that a failure is reported here
+    std::promise<bool> configured;
+    std::future<bool> configApplied = configured.get_future();
+    try {
+        m_readThread = std::thread([this](std::promise<bool> result) {
+            bool applied = applyThreadConfig();
+            result.set_value(applied);
+            if (applied) {
+                readLoop();
+            }
+        }, std::move(configured));
+    } catch (const std::system_error&) {
+        setLastError("Failed to create read thread");
+        ::close(m_stopPipe[0]);
+        ::close(m_stopPipe[1]);
+        m_stopPipe[0] = m_stopPipe[1] = -1;
+        return false;
+    }
+    
+    if (!configApplied.get()) {
+        m_readThread.join();
+        ::close(m_stopPipe[0]);
+        ::close(m_stopPipe[1]);
+        m_stopPipe[0] = m_stopPipe[1] = -1;
+        return false;
+    }
+    
+    return true;
+}
+
+void SerialReader::stopAsyncReading() {
+    if (m_readThread.joinable()) {
+        m_stopReading = true;
+        
+        // Wake the read loop if it is waiting for data
+        uint8_t wake = 1;
+        ssize_t ignored = ::write(m_stopPipe[1], &wake, 1);
+        (void)ignored;
+        
+        m_readThread.join();
+        
+        ::close(m_stopPipe[0]);
+        ::close(m_stopPipe[1]);
+        m_stopPipe[0] = m_stopPipe[1] = -1;
+    }
+}
+
+std::string SerialReader::getLastError() const {
+    return m_lastError;
+}
+
+bool SerialReader::flushBuffers() {
+    if (!m_isOpen) {
+        return false;
+    }
+    
+    return tcflush(m_fd, TCIOFLUSH) == 0;
+}
+
+bool SerialReader::applyThreadConfig() {
+    if (m_readConfig.affinityMask != 0) {
+#if defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if ((m_readConfig.affinityMask >> cpu) & 1) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result != 0) {
+            setLastError("Failed to set read thread affinity: " + errorString(result));
+            return false;
+        }
+#else
+        setLastError("Read thread affinity is not supported on this platform");
+        return false;
+#endif
+    }
+    
+    switch (m_readConfig.priority) {
+        case ThreadPriority::Normal:
+            break;
+        case ThreadPriority::AboveNormal:
+        case ThreadPriority::Highest: {
+#if defined(__linux__)
+            // Linux threads have a nice value of their own
+            int nice = m_readConfig.priority == ThreadPriority::Highest ? -10 : -5;
+            if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) != 0) {
+                setLastError("Failed to raise read thread priority: " + errnoString());
+                return false;
+            }
+#else
+            setLastError("Raised read thread priority is only supported as TimeCritical on this platform");
+            return false;
+#endif
+            break;
+        }
+        case ThreadPriority::TimeCritical: {
+            sched_param param = {};
+            param.sched_priority = m_readConfig.realtimePriority;
+            int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (result != 0) {
+                setLastError("Failed to set SCHED_FIFO priority " + std::to_string(m_readConfig.realtimePriority) +
+                             " for the read thread: " + errorString(result));
+                return false;
+            }
+            break;
+        }
+    }
+    
+    return true;
+}
+
+void SerialReader::readLoop() {
+    if (m_readMode == ReadMode::EventDriven) {
+        eventReadLoop();
+    } else {
+        pollingReadLoop();
+    }
+}
+
+void SerialReader::deliver(const uint8_t* data, size_t length) {
+    uint64_t receiveTimeNs = steadyTimeNs();
+    m_stats.bytesRead += length;
+    ++m_stats.reads;
+    
+    if (m_dataQueue) {
+        // Reads larger than a chunk (ReadConfig::readBufferSize) are split
+        size_t offset = 0;
+        while (offset < length) {
+            size_t chunkSize = std::min(length - offset, SerialChunk::MAX_SIZE);
+            SerialChunk* chunk = m_dataQueue->beginPush();
+            if (chunk) {
+                memcpy(chunk->data, data + offset, chunkSize);
+                chunk->length = static_cast<uint16_t>(chunkSize);
+                chunk->receiveTimeNs = receiveTimeNs;
+                m_dataQueue->commitPush();
+                ++m_stats.chunksQueued;
+            } else {
+                ++m_stats.chunksDropped;
+            }
+            offset += chunkSize;
+        }
+        m_stats.queueHighWater.updateMax(m_dataQueue->size());
+    }
+    
+    if (m_dataCallback) {
+        m_dataCallback(data, length);
+    }
+    
+    m_stats.deliveryLatency.record(steadyTimeNs() - receiveTimeNs);
+}
+
+void SerialReader::pollingReadLoop() {
+    uint8_t* buffer = m_readBuffer.data();
+    
+    while (!m_stopReading && m_isOpen) {
+        int bytesRead = readAvailable(buffer, m_readBuffer.size());
+        
+        if (bytesRead > 0) {
+            deliver(buffer, bytesRead);
+        }
+        
+        // Small delay to prevent excessive CPU usage; returns early on stop
+        pollfd pfd = { m_stopPipe[0], POLLIN, 0 };
+        poll(&pfd, 1, static_cast<int>(POLL_INTERVAL_MS));
+    }
+}
+
+void SerialReader::eventReadLoop() {
+    uint8_t* buffer = m_readBuffer.data();
+
+#if defined(__linux__)
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        setLastError("Failed to create epoll instance: " + errnoString());
+        return;
+    }
+    
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = m_fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, m_fd, &event);
+    event.data.fd = m_stopPipe[0];
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, m_stopPipe[0], &event);
+#endif
+
+    while (!m_stopReading && m_isOpen) {
+#if defined(__linux__)
+        epoll_event events[2];
+        int ready = epoll_wait(epollFd, events, 2, -1);
+        bool dataReady = false;
+        bool hangup = false;
+        bool stopRequested = false;
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.fd == m_fd) {
+                dataReady = true;
+                hangup = (events[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+            } else {
+                stopRequested = true;
+            }
+        }
+#else
+        pollfd pfds[2] = { { m_fd, POLLIN, 0 }, { m_stopPipe[0], POLLIN, 0 } };
+        int ready = poll(pfds, 2, -1);
+        bool dataReady = ready > 0 && (pfds[0].revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+        bool hangup = ready > 0 && (pfds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+        bool stopRequested = ready > 0 && (pfds[1].revents & POLLIN) != 0;
+#endif
+        if (ready < 0 && errno != EINTR) {
+            setLastError("Failed to wait for data: " + errnoString());
+            break;
+        }
+        
+        if (stopRequested) {
+            break;
+        }
+        
+        if (!dataReady) {
+            continue;
+        }
+        
+        // Drain everything the driver has buffered
+        int bytesRead;
+        while ((bytesRead = readAvailable(buffer, m_readBuffer.size())) > 0) {
+            deliver(buffer, bytesRead);
+        }
+        
+        if (bytesRead < 0) {
+            break; // Read error, already reported
+        }
+        
+        if (hangup) {
+            setLastError("Serial device disconnected");
+            break;
+        }
+    }
+
+#if defined(__linux__)
+    ::close(epollFd);
+#endif
+}
+
+void SerialReader::setLastError(const std::string& error) {
+    m_lastError = error;
+}
+
+bool SerialReader::setupSerialPort(DWORD baudRate, BYTE dataBits, BYTE parity, BYTE stopBits) {
+    termios tio;
+    if (tcgetattr(m_fd, &tio) != 0) {
+        setLastError("Failed to get port attributes: " + errnoString());
+        return false;
+    }
+    
+    // Raw binary mode, no flow control, reads never block in the driver
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    
+    tio.c_cflag &= ~CSIZE;
+    switch (dataBits) {
+        case 5: tio.c_cflag |= CS5; break;
+        case 6: tio.c_cflag |= CS6; break;
+        case 7: tio.c_cflag |= CS7; break;
+        case 8: tio.c_cflag |= CS8; break;
+        default:
+            setLastError("Unsupported data bits: " + std::to_string(dataBits));
+            return false;
+    }
+    
+    tio.c_cflag &= ~(PARENB | PARODD);
+#ifdef CMSPAR
+    tio.c_cflag &= ~CMSPAR;
+#endif
+    switch (parity) {
+        case NOPARITY: break;
+        case ODDPARITY: tio.c_cflag |= PARENB | PARODD; break;
+        case EVENPARITY: tio.c_cflag |= PARENB; break;
+#ifdef CMSPAR
+        case MARKPARITY: tio.c_cflag |= PARENB | PARODD | CMSPAR; break;
+        case SPACEPARITY: tio.c_cflag |= PARENB | CMSPAR; break;
+#endif
+        default:
+            setLastError("Unsupported parity: " + std::to_string(parity));
+            return false;
+    }
+    
+    // 1.5 stop bits is only valid with 5 data bits; termios selects it with CSTOPB
+    if (stopBits == ONESTOPBIT) {
+        tio.c_cflag &= ~CSTOPB;
+    } else {
+        tio.c_cflag |= CSTOPB;
+    }
+    
+    speed_t speed = standardSpeed(baudRate);
+    if (speed != B0) {
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    } else {
+        // Placeholder rate; the real one is set below
+        cfsetispeed(&tio, B38400);
+        cfsetospeed(&tio, B38400);
+    }
+    
+    if (tcsetattr(m_fd, TCSANOW, &tio) != 0) {
+        setLastError("Failed to set port attributes: " + errnoString());
+        return false;
+    }
+    
+    if (speed == B0) {
+#if defined(__linux__)
+        bool customRateSet = SerialLinux::setCustomBaudRate(m_fd, baudRate);
+#elif defined(__APPLE__)
+        speed_t customSpeed = baudRate;
+        bool customRateSet = ioctl(m_fd, IOSSIOSPEED, &customSpeed) == 0;
+#else
+        bool customRateSet = false;
+#endif
+        if (!customRateSet) {
+            setLastError("Unsupported baud rate: " + std::to_string(baudRate));
+            return false;
+        }
+    }
+
+#if defined(__linux__)
+    // Not every driver supports this; it only affects latency, so failure is ignored
+    SerialLinux::setLowLatency(m_fd);
+#endif
+
+    return true;
+}
+
+bool SerialReader::waitReadable(int timeoutMs) {
+    pollfd pfd = { m_fd, POLLIN, 0 };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeoutMs);
+    } while (ready < 0 && errno == EINTR);
+    
+    return ready > 0;
+}
@@ -1,20 +1,93 @@
 #include "xbus.h"
 #include "xbus_parser.h"
 #include "xbus_message_id.h"
+#include "xbus_framer.h"
+#include "xbus_layout_decoder.h"
+#include "xbus_simd.h"
+#include "xbus_spsc_queue.h"
+#include "xbus_message_builder.h"
+#include "xbus_recorder.h"
+#include "xbus_clock_tracker.h"
+#include "xbus_export.h"
+#include "xbus_command_engine.h"
+#include "xbus_output_config.h"
+#include "xbus_imu.h"
+#include "xbus_pool.h"
+#include "xbus_dispatcher.h"
+#include "xbus_bridge.h"
+#include "xbus_orientation.h"
 #include <iostream>
 #include <iomanip>
 #include <vector>
+#include <cstdio>
 #include <cstring>
 #include <cassert>
 #include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include "xbus_device_manager.h"
+#include <pty.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+// Every heap allocation of the test binary is counted, so a test can check
+// that a code path allocates nothing. Only the plain forms touch malloc and
+// free, and they are never inlined: the array and sized forms forward to
+// them, so the compiler always sees each new paired with its own delete
+// rather than malloc paired with operator delete (-Wmismatched-new-delete).
+#if defined(__GNUC__)
+#define TEST_NOINLINE __attribute__((noinline))
+#else
+#define TEST_NOINLINE
+#endif
+
+static std::atomic<size_t> g_heapAllocations(0);
+
+TEST_NOINLINE void* operator new(size_t size) {
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+TEST_NOINLINE void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    operator delete(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    operator delete(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    operator delete(memory);
+}
 
 class XbusParserTest {
 private:
     int testsPassed = 0;
     int testsTotal = 0;
-    
+
 public:
-    void runAllTests() {
+    bool runAllTests() {
         std::cout << "=== XBus Parser Test Suite ===" << std::endl;
         std::cout << std::endl;
         
@@ -27,6 +100,39 @@ public:
         testQuaternionOnly();
         testBarometricPressureOnly();
         testInvalidMessage();
+        testFramerSplitStream();
+        testFramerCorruptedStream();
+        testFramerResync();
+        testLayoutDecoder();
+        testMTData2Batch();
+        testSimdKernels();
+        testSpscQueue();
+#ifdef __linux__
+        testDeviceManager();
+#endif
+        testMessageBuilder();
+        testRecorderReplay();
+        testSelectiveDecoding();
+        testXdiRegistry();
+        testPrecisionFormats();
+        testPipelineStats();
+#ifdef __linux__
+        testSerialReaderStats();
+        testSerialReaderReadConfig();
+#endif
+        testClockTracker();
+        testTextFormatting();
+        testExportSinks();
+        testExtendedLengthFrames();
+        testCommandEngine();
+        testOutputConfig();
+        testBoundsCheckedParsing();
+        testInertialData();
+        testObjectPool();
+        testDispatcher();
+        testBridge();
+        testFramerChecksum();
+        testOrientation();
         
         std::cout << std::endl;
         std::cout << "=== Test Results ===" << std::endl;
@@ -37,8 +143,10 @@ public:
         } else {
             std::cout << "Some tests FAILED!" << std::endl;
         }
+        
+        return testsPassed == testsTotal;
     }
-    
+
 private:
     void assertTrue(bool condition, const std::string& testName) {
         testsTotal++;
@@ -71,7 +179,7 @@ private:
             std::cout << "[FAIL] " << testName << " (expected: " << expected << ", actual: " << actual << ", diff: " << std::abs(expected - actual) << ")" << std::endl;
         }
     }
-
+    
     void assertUint32Equals(uint32_t expected, uint32_t actual, const std::string& testName) {
         testsTotal++;
         if (expected == actual) {
@@ -81,7 +189,7 @@ private:
             std::cout << "[FAIL] " << testName << " (expected: " << expected << ", actual: " << actual << ")" << std::endl;
         }
     }
-
+    
     void assertUint16Equals(uint16_t expected, uint16_t actual, const std::string& testName) {
         testsTotal++;
         if (expected == actual) {
@@ -91,7 +199,7 @@ private:
             std::cout << "[FAIL] " << testName << " (expected: " << expected << ", actual: " << actual << ")" << std::endl;
         }
     }
-
+    
     void assertUint8Equals(uint8_t expected, uint8_t actual, const std::string& testName) {
         testsTotal++;
         if (expected == actual) {
@@ -101,7 +209,7 @@ private:
             std::cout << "[FAIL] " << testName << " (expected: " << static_cast<int>(expected) << ", actual: " << static_cast<int>(actual) << ")" << std::endl;
         }
     }
-
+    
     std::vector<uint8_t> doubleToFP1632(double value) {
         // Calculate: i = round(value * 2^32)
         int64_t fixedPoint = static_cast<int64_t>(std::round(value * 4294967296.0));
@@ -125,6 +233,17 @@ private:
         return result;
     }
     
+    void appendBigEndian(std::vector<uint8_t>& dest, uint64_t value, int bytes) {
+        for (int i = bytes - 1; i >= 0; i--) {
+            dest.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+    
+    void appendItemHeader(std::vector<uint8_t>& dest, uint16_t xdi, uint8_t size) {
+        appendBigEndian(dest, xdi, 2);
+        dest.push_back(size);
+    }
+    
     std::vector<uint8_t> createMTData2Message(const std::vector<uint8_t>& payload) {
         std::vector<uint8_t> message;
         
@@ -147,6 +266,17 @@ private:
         return message;
     }
     
+    std::vector<uint8_t> createXbusMessage(uint8_t messageId, const std::vector<uint8_t>& payload) {
+        std::vector<uint8_t> message(payload.size() + Xbus::OFFSET_TO_PAYLOAD_EXT + Xbus::XBUS_CHECKSUM_SIZE);
+        Xbus::createMessage(message.data(), Xbus::XBUS_MASTERDEVICE, messageId, static_cast<uint16_t>(payload.size()));
+        if (!payload.empty()) {
+            memcpy(Xbus::getPointerToPayload(message.data()), payload.data(), payload.size());
+        }
+        Xbus::insertChecksum(message.data());
+        message.resize(Xbus::getRawLength(message.data()));
+        return message;
+    }
+    
     void testFP1632Conversion() {
         std::cout << std::endl << "--- Testing FP1632 Conversion ---" << std::endl;
         
@@ -232,8 +362,8 @@ private:
         assertDoubleEquals(31.393166223541, sensorData.latLon.latitude, 0.000000000001, "Latitude");
         assertDoubleEquals(121.229738174938, sensorData.latLon.longitude, 0.000000000001, "Longitude");
         assertDoubleEquals(56.714969451306, sensorData.altitudeEllipsoid, 0.0001, "Altitude");
-
         
+
         assertDoubleEquals(-0.021542994305, sensorData.velocityXYZ.velX, 0.000000000001, "Velocity X");
         assertDoubleEquals(0.013762803748, sensorData.velocityXYZ.velY, 0.000000000001, "Velocity Y");
         assertDoubleEquals(-0.043488796800, sensorData.velocityXYZ.velZ, 0.000000000001, "Velocity Z");
@@ -289,7 +419,7 @@ private:
         assertDoubleEquals(1.0, sensorData.latLon.latitude, 0.000000001, "Latitude (1.0)");
         assertDoubleEquals(-1.0, sensorData.latLon.longitude, 0.000000001, "Longitude (-1.0)");
     }
-
+    
     void testVelocityOnly() {
         std::cout << std::endl << "--- Testing Velocity Only ---" << std::endl;
         
@@ -318,7 +448,7 @@ private:
         assertDoubleEquals(0.2, sensorData.velocityXYZ.velY, 0.000000001, "Velocity Y (0.2)");
         assertDoubleEquals(0.3, sensorData.velocityXYZ.velZ, 0.000000001, "Velocity Z (0.3)");
     }
-
+    
     void testUtcTimeOnly() {
         std::cout << std::endl << "--- Testing UTC Time Only ---" << std::endl;
         
@@ -351,7 +481,7 @@ private:
         assertUint8Equals(34, sensorData.utcTime.second, "UTC second");
         assertUint8Equals(0, sensorData.utcTime.flags, "UTC flags");
     }
-
+    
     void testQuaternionOnly() {
         std::cout << std::endl << "--- Testing Quaternion Only ---" << std::endl;
         
@@ -376,7 +506,7 @@ private:
         assertFloatEquals(0.0019313f, sensorData.quaternion.q2, 0.0000001f, "Quaternion q2");
         assertFloatEquals(0.0052016f, sensorData.quaternion.q3, 0.0000001f, "Quaternion q3");
     }
-
+    
     void testBarometricPressureOnly() {
         std::cout << std::endl << "--- Testing Barometric Pressure Only ---" << std::endl;
         
@@ -395,7 +525,7 @@ private:
         
         assertUint32Equals(100260, sensorData.barometricPressure.pressure, "Barometric pressure value");
     }
-
+    
     void testInvalidMessage() {
         std::cout << std::endl << "--- Testing Invalid Message ---" << std::endl;
         
@@ -410,10 +540,2254 @@ private:
         success = XbusParser::parseMTData2(wrongMsgId.data(), sensorData);
         assertTrue(!success, "Wrong message ID rejection");
     }
+    
+    void testFramerSplitStream() {
+        std::cout << std::endl << "--- Testing Framer Split Stream ---" << std::endl;
+        
+        std::vector<uint8_t> euler = createMTData2Message({0x20, 0x30, 0x0C,
+                                                           0x42, 0x34, 0x00, 0x00,
+                                                           0x41, 0xF0, 0x00, 0x00,
+                                                           0x42, 0xB4, 0x00, 0x00});
+        std::vector<uint8_t> ack = createXbusMessage(XMID_GotoConfigAck, {});
+        
+        // Leading garbage, then two frames back to back
+        std::vector<uint8_t> stream = {0x00, 0x13, 0x37};
+        stream.insert(stream.end(), euler.begin(), euler.end());
+        stream.insert(stream.end(), ack.begin(), ack.end());
+        
+        // Feed one byte at a time so every frame straddles write() calls
+        XbusFramer framer(64);
+        std::vector<std::vector<uint8_t>> frames;
+        for (size_t i = 0; i < stream.size(); i++) {
+            framer.feed(&stream[i], 1, [&frames](const XbusFrame& frame) {
+                frames.emplace_back(frame.begin(), frame.end());
+            });
+        }
+        
+        assertTrue(frames.size() == 2, "Two frames extracted from byte-wise stream");
+        assertTrue(frames.size() > 0 && frames[0] == euler, "First frame is MTData2");
+        assertTrue(frames.size() > 1 && frames[1] == ack, "Second frame is GotoConfigAck");
+        assertTrue(framer.buffered() == 0, "Framer buffer drained");
+        
+        // Feed the whole stream in one call; views must point into the framer buffer
+        XbusFramer bulkFramer(64);
+        size_t bulkFrames = bulkFramer.feed(stream.data(), stream.size(), [&](const XbusFrame& frame) {
+            EulerAngles angles;
+            if (Xbus::getMessageId(frame.data) == XMID_MtData2) {
+                assertTrue(XbusParser::parseEulerAngles(frame.data, angles), "Parse MTData2 from frame view");
+                assertFloatEquals(45.0f, angles.roll, 0.001f, "Framed Euler Roll");
+            }
+        });
+        assertTrue(bulkFrames == 2, "Two frames extracted from single chunk");
+        assertUint32Equals(2, static_cast<uint32_t>(bulkFramer.stats().framesOk), "Frames OK counter");
+    }
+    
+    void testFramerCorruptedStream() {
+        std::cout << std::endl << "--- Testing Framer Corrupted Stream ---" << std::endl;
+        
+        std::vector<uint8_t> good = createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x12, 0x34});
+        std::vector<uint8_t> bad = good;
+        bad[5] ^= 0x01; // Corrupt the payload so the checksum fails
+        
+        std::vector<uint8_t> stream;
+        stream.insert(stream.end(), bad.begin(), bad.end());
+        stream.insert(stream.end(), good.begin(), good.end());
+        
+        XbusFramer framer(64);
+        std::vector<uint32_t> deviceIds;
+        framer.feed(stream.data(), stream.size(), [&deviceIds](const XbusFrame& frame) {
+            deviceIds.push_back(XbusParser::parseDeviceId(frame.data));
+        });
+        
+        assertTrue(deviceIds.size() == 1, "Corrupted frame dropped");
+        assertTrue(!deviceIds.empty() && deviceIds[0] == 0x03801234, "Valid frame after corruption");
+        assertUint32Equals(1, static_cast<uint32_t>(framer.stats().checksumErrors), "Checksum error counted");
+        
+        // A length larger than the framer capacity is rejected
+        std::vector<uint8_t> oversized = {Xbus::XBUS_PREAMBLE, Xbus::XBUS_MASTERDEVICE, XMID_MtData2, 0xFF, 0x10, 0x00};
+        oversized.insert(oversized.end(), good.begin(), good.end());
+        deviceIds.clear();
+        framer.feed(oversized.data(), oversized.size(), [&deviceIds](const XbusFrame& frame) {
+            deviceIds.push_back(XbusParser::parseDeviceId(frame.data));
+        });
+        
+        assertTrue(deviceIds.size() == 1, "Valid frame after oversized header");
+        assertUint32Equals(1, static_cast<uint32_t>(framer.stats().lengthErrors), "Length error counted");
+    }
+    
+    void testFramerResync() {
+        std::cout << std::endl << "--- Testing Framer Resync ---" << std::endl;
+        
+        std::vector<uint8_t> first = createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x00, 0x01});
+        std::vector<uint8_t> second = createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x00, 0x02});
+        
+        // A truncated header claiming 10 payload bytes swallows the start of
+        // the first real frame; the framer must find that frame again
+        std::vector<uint8_t> stream = {Xbus::XBUS_PREAMBLE, Xbus::XBUS_MASTERDEVICE, XMID_MtData2, 0x0A};
+        stream.insert(stream.end(), first.begin(), first.end());
+        stream.insert(stream.end(), second.begin(), second.end());
+        
+        XbusFramer framer(64);
+        std::vector<uint32_t> deviceIds;
+        framer.feed(stream.data(), stream.size(), [&deviceIds](const XbusFrame& frame) {
+            deviceIds.push_back(XbusParser::parseDeviceId(frame.data));
+        });
+        
+        assertTrue(deviceIds.size() == 2, "Both frames recovered after false preamble");
+        assertTrue(!deviceIds.empty() && deviceIds[0] == 0x03800001, "Frame inside bad frame recovered");
+        assertUint32Equals(1, static_cast<uint32_t>(framer.stats().resyncs), "Resync counted");
+        assertUint32Equals(4, static_cast<uint32_t>(framer.stats().bytesSkipped), "Skipped bytes counted");
+        
+        // Headers no device sends are rejected before their length is
+        // waited for, even by a framer that takes 64 KiB frames: a foreign
+        // bus ID and an extended length of 16 bytes
+        std::vector<uint8_t> falseHeaders = {Xbus::XBUS_PREAMBLE, 0x01, XMID_MtData2, 0xFF, 0xFF, 0xFF,
+                                             Xbus::XBUS_PREAMBLE, Xbus::XBUS_MASTERDEVICE, XMID_MtData2, 0xFF, 0x00, 0x10};
+        falseHeaders.insert(falseHeaders.end(), first.begin(), first.end());
+        XbusFramer large(XbusFramer::MAX_CAPACITY);
+        size_t delivered = large.feed(falseHeaders.data(), falseHeaders.size(), [](const XbusFrame&) {});
+        assertTrue(delivered == 1 && large.buffered() == 0, "Frame after false headers delivered at once");
+        assertUint32Equals(2, static_cast<uint32_t>(large.stats().headerErrors), "Header errors counted");
+    }
+    
+    void testLayoutDecoder() {
+        std::cout << std::endl << "--- Testing Layout Decoder ---" << std::endl;
+        
+        std::vector<uint8_t> eulerPayload = {0x10, 0x20, 0x02, 0x0B, 0x0A,
+                                             0x20, 0x30, 0x0C,
+                                             0x42, 0x34, 0x00, 0x00,
+                                             0x41, 0xF0, 0x00, 0x00,
+                                             0x42, 0xB4, 0x00, 0x00};
+        std::vector<uint8_t> first = createMTData2Message(eulerPayload);
+        eulerPayload[4] = 0x0B; // Next packet counter
+        std::vector<uint8_t> second = createMTData2Message(eulerPayload);
+        
+        XbusLayoutDecoder decoder;
+        SensorData sensorData;
+        assertTrue(decoder.decode(first.data(), sensorData), "First packet decoded");
+        assertTrue(decoder.isLocked(), "Layout locked after first packet");
+        assertUint32Equals(2, static_cast<uint32_t>(decoder.fieldCount()), "Locked layout field count");
+        
+        assertTrue(decoder.decode(second.data(), sensorData), "Second packet decoded");
+        assertUint32Equals(1, static_cast<uint32_t>(decoder.stats().lockedDecodes), "Second packet used locked layout");
+        assertUint16Equals(2827, sensorData.packetCounter, "Locked PacketCounter");
+        assertFloatEquals(90.0f, sensorData.eulerAngles.yaw, 0.001f, "Locked Euler Yaw");
+        assertTrue(!sensorData.hasQuaternion, "Locked decode resets absent fields");
+        
+        // Layout change falls back to the generic parser and relocks
+        std::vector<uint8_t> quaternion = createMTData2Message({0x20, 0x10, 0x10,
+                                                                0x3F, 0x80, 0x00, 0x00,
+                                                                0x00, 0x00, 0x00, 0x00,
+                                                                0x00, 0x00, 0x00, 0x00,
+                                                                0x00, 0x00, 0x00, 0x00});
+        assertTrue(decoder.decode(quaternion.data(), sensorData), "Changed layout decoded");
+        assertTrue(sensorData.hasQuaternion && !sensorData.hasEulerAngles, "Changed layout fields");
+        assertUint32Equals(1, static_cast<uint32_t>(decoder.stats().relocks), "Relock counted");
+        
+        // Layout predicted from an OutputConfig message: PacketCounter + Euler at 100 Hz
+        std::vector<uint8_t> outputConfig = createXbusMessage(XMID_OutputConfig, {0x10, 0x20, 0xFF, 0xFF,
+                                                                                  0x20, 0x30, 0x00, 0x64});
+        XbusLayoutDecoder configured;
+        assertTrue(configured.learnFromOutputConfig(outputConfig.data()), "Layout learned from OutputConfig");
+        assertTrue(configured.decode(first.data(), sensorData), "Configured layout decode");
+        assertUint32Equals(1, static_cast<uint32_t>(configured.stats().lockedDecodes), "First packet used configured layout");
+        assertUint16Equals(2826, sensorData.packetCounter, "Configured PacketCounter");
+        assertFloatEquals(45.0f, sensorData.eulerAngles.roll, 0.001f, "Configured Euler Roll");
+    }
+    
+    void testMTData2Batch() {
+        std::cout << std::endl << "--- Testing MTData2 Batch ---" << std::endl;
+        
+        std::vector<uint8_t> euler = createMTData2Message({0x10, 0x20, 0x02, 0x00, 0x01,
+                                                           0x20, 0x30, 0x0C,
+                                                           0x42, 0x34, 0x00, 0x00,
+                                                           0x41, 0xF0, 0x00, 0x00,
+                                                           0x42, 0xB4, 0x00, 0x00});
+        std::vector<uint8_t> pressure = createMTData2Message({0x10, 0x20, 0x02, 0x00, 0x02,
+                                                              0x30, 0x10, 0x04, 0x00, 0x01, 0x87, 0xA4});
+        std::vector<uint8_t> ack = createXbusMessage(XMID_GotoConfigAck, {});
+        
+        const uint8_t* frames[] = {euler.data(), ack.data(), pressure.data()};
+        SensorDataColumns columns;
+        size_t rows = XbusParser::parseMTData2Batch(frames, 3, columns);
+        
+        assertUint32Equals(2, static_cast<uint32_t>(rows), "Batch rows appended");
+        assertUint32Equals(2, static_cast<uint32_t>(columns.size()), "Batch column size");
+        assertTrue(columns.roll.size() == 2 && columns.barometricPressure.size() == 2, "Columns aligned");
+        assertTrue(columns.has(0, SensorField::EULER_ANGLES), "Row 0 has EulerAngles");
+        assertTrue(!columns.has(0, SensorField::BAROMETRIC_PRESSURE), "Row 0 has no BarometricPressure");
+        assertTrue(columns.has(1, SensorField::BAROMETRIC_PRESSURE), "Row 1 has BarometricPressure");
+        assertTrue(!columns.has(1, SensorField::EULER_ANGLES), "Row 1 has no EulerAngles");
+        assertUint16Equals(1, columns.packetCounter[0], "Row 0 PacketCounter");
+        assertUint16Equals(2, columns.packetCounter[1], "Row 1 PacketCounter");
+        assertFloatEquals(30.0f, columns.pitch[0], 0.001f, "Row 0 Euler Pitch");
+        assertUint32Equals(100260, columns.barometricPressure[1], "Row 1 BarometricPressure");
+        
+        // Batch and single-packet decoding agree
+        SensorData sensorData;
+        XbusParser::parseMTData2(euler.data(), sensorData);
+        assertTrue(sensorData.eulerAngles.yaw == columns.yaw[0], "Batch matches parseMTData2");
+        
+        // With sizes, a frame cut short by its buffer is skipped
+        const size_t sizes[] = {euler.size(), ack.size(), pressure.size() - 1};
+        SensorDataColumns sized;
+        assertUint32Equals(1, static_cast<uint32_t>(XbusParser::parseMTData2Batch(frames, sizes, 3, sized)),
+                           "Sized batch skips the truncated frame");
+        assertTrue(sized.size() == 1 && sized.packetCounter[0] == 1, "Sized batch keeps the complete frame");
+    }
+    
+    void testSimdKernels() {
+        std::cout << std::endl << "--- Testing SIMD Kernels ---" << std::endl;
+        std::cout << "Detected level: " << XbusSimd::levelName(XbusSimd::detectedLevel()) << std::endl;
+        
+        // Deterministic pseudo-random payload bytes
+        std::vector<uint8_t> bytes(4096);
+        uint32_t seed = 12345;
+        for (size_t i = 0; i < bytes.size(); i++) {
+            seed = seed * 1103515245u + 12345u;
+            bytes[i] = static_cast<uint8_t>(seed >> 16);
+        }
+        // Edge cases: FP16.32 minimum, maximum and -1 ulp
+        const uint8_t edges[] = {0x00, 0x00, 0x00, 0x00, 0x80, 0x00,
+                                 0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0xFF,
+                                 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+        memcpy(bytes.data(), edges, sizeof(edges));
+        
+        // Reference values from the byte-at-a-time readers
+        const size_t floatCount = bytes.size() / 4;
+        std::vector<float> expectedFloats(floatCount);
+        int index = 0;
+        for (size_t i = 0; i < floatCount; i++) {
+            expectedFloats[i] = XbusParser::readFloat(bytes.data(), index);
+        }
+        const size_t fixedCount = bytes.size() / 6;
+        std::vector<double> expectedFixed(fixedCount);
+        index = 0;
+        for (size_t i = 0; i < fixedCount; i++) {
+            expectedFixed[i] = XbusParser::readFP1632(bytes.data(), index);
+        }
+        
+        // The short runs of one data item use the inline readers
+        bool float3Ok = true;
+        bool float4Ok = true;
+        for (size_t i = 0; i + 4 <= floatCount; i += 4) {
+            float values[4];
+            readValues<float, 3>(bytes.data() + 4 * i, values);
+            float3Ok = float3Ok && memcmp(values, &expectedFloats[i], 3 * sizeof(float)) == 0;
+            readValues<float, 4>(bytes.data() + 4 * i, values);
+            float4Ok = float4Ok && memcmp(values, &expectedFloats[i], 4 * sizeof(float)) == 0;
+        }
+        assertTrue(float3Ok && float4Ok, "Float32 item values bit-identical");
+        
+        bool fixed2Ok = true;
+        bool fixed3Ok = true;
+        for (size_t i = 0; i + 3 <= fixedCount; i += 3) {
+            double values[3];
+            readValues<Fp1632, 2>(bytes.data() + 6 * i, values);
+            fixed2Ok = fixed2Ok && memcmp(values, &expectedFixed[i], 2 * sizeof(double)) == 0;
+            readValues<Fp1632, 3>(bytes.data() + 6 * i, values);
+            fixed3Ok = fixed3Ok && memcmp(values, &expectedFixed[i], 3 * sizeof(double)) == 0;
+        }
+        assertTrue(fixed2Ok && fixed3Ok, "FP16.32 item values bit-identical");
+        
+        const XbusSimd::Level levels[] = {XbusSimd::Level::Scalar, XbusSimd::Level::Ssse3,
+                                          XbusSimd::Level::Avx2, XbusSimd::Level::Neon};
+        XbusSimd::Level original = XbusSimd::activeLevel();
+        for (XbusSimd::Level level : levels) {
+            if (!XbusSimd::setLevel(level)) {
+                continue;
+            }
+            std::string name = XbusSimd::levelName(level);
+            
+            // Every length up to a few vector widths, at every alignment
+            bool sumOk = true;
+            for (size_t offset = 0; offset < 8; offset++) {
+                uint8_t expected = 0;
+                for (size_t length = 0; length <= 300; length++) {
+                    sumOk = sumOk && XbusSimd::byteSum(bytes.data() + offset, length) == expected;
+                    expected = static_cast<uint8_t>(expected + bytes[offset + length]);
+                }
+            }
+            uint8_t expectedTotal = 0;
+            for (uint8_t byte : bytes) {
+                expectedTotal = static_cast<uint8_t>(expectedTotal + byte);
+            }
+            assertTrue(sumOk && XbusSimd::byteSum(bytes.data(), bytes.size()) == expectedTotal,
+                       name + " byteSum matches byte-at-a-time sum");
+            
+            std::vector<uint8_t> extended = createXbusMessage(XMID_MtData2, std::vector<uint8_t>(bytes.begin(),
+                                                                                               bytes.begin() + 1000));
+            bool checksumOk = Xbus::verifyChecksum(extended.data());
+            extended[500] ^= 0x01;
+            checksumOk = checksumOk && !Xbus::verifyChecksum(extended.data());
+            Xbus::insertChecksum(extended.data());
+            assertTrue(checksumOk && Xbus::verifyChecksum(extended.data()),
+                       name + " checksum of an extended frame");
+        }
+        XbusSimd::setLevel(original);
+    }
+    
+    void testSpscQueue() {
+        std::cout << std::endl << "--- Testing SPSC Queue ---" << std::endl;
+        
+        SpscQueue<uint32_t> queue(3);
+        assertUint32Equals(4, static_cast<uint32_t>(queue.capacity()), "Capacity rounded up to power of two");
+        
+        for (uint32_t i = 0; i < 4; i++) {
+            queue.tryPush(i);
+        }
+        assertTrue(!queue.tryPush(99), "Push to full queue rejected");
+        assertUint32Equals(1, static_cast<uint32_t>(queue.stats().dropped), "Drop counted");
+        assertUint32Equals(4, static_cast<uint32_t>(queue.stats().highWater), "High water mark");
+        
+        uint32_t value = 0;
+        bool inOrder = true;
+        for (uint32_t i = 0; i < 4; i++) {
+            inOrder = queue.tryPop(value) && value == i && inOrder;
+        }
+        assertTrue(inOrder, "Elements popped in FIFO order");
+        assertTrue(!queue.tryPop(value), "Pop from empty queue fails");
+        assertTrue(!queue.pop(value, std::chrono::milliseconds(1)), "Blocking pop times out when empty");
+        
+        queue.tryPush(7);
+        queue.close();
+        assertTrue(!queue.tryPush(8), "Push to closed queue rejected");
+        assertTrue(queue.pop(value) && value == 7, "Closed queue still drains");
+        assertTrue(!queue.pop(value), "Blocking pop returns once closed and drained");
+        
+        // Producer thread against a blocking consumer; the producer retries
+        // instead of dropping so every value must arrive exactly once in order
+        const uint32_t count = 200000;
+        SpscQueue<uint32_t> shared(64);
+        std::thread producer([&shared, count] {
+            for (uint32_t i = 0; i < count; i++) {
+                while (!shared.tryPush(i)) {
+                    std::this_thread::yield();
+                }
+            }
+            shared.close();
+        });
+        
+        uint32_t expected = 0;
+        bool ordered = true;
+        while (shared.pop(value)) {
+            ordered = ordered && value == expected;
+            expected++;
+        }
+        producer.join();
+        
+        assertTrue(ordered, "Cross-thread values arrive in order");
+        assertUint32Equals(count, expected, "Cross-thread values all received");
+        assertTrue(shared.stats().pushed == count && shared.stats().popped == count, "Push/pop counters");
+    }
+
+#ifdef __linux__
+    void testDeviceManager() {
+        std::cout << std::endl << "--- Testing Device Manager ---" << std::endl;
+        
+        // Three pty pairs stand in for serial devices, served by two I/O threads
+        const size_t deviceCount = 3;
+        int masters[deviceCount];
+        XbusDeviceManager manager(2);
+        bool opened = true;
+        for (size_t i = 0; i < deviceCount; i++) {
+            int slave = -1;
+            char name[128];
+            opened = openpty(&masters[i], &slave, name, nullptr, nullptr) == 0 && opened;
+            opened = manager.addDevice(name, 921600) == static_cast<int>(i) && opened;
+            ::close(slave);
+        }
+        assertTrue(opened, "Ptys added as devices");
+        if (!opened) {
+            return;
+        }
+        
+        std::mutex mutex;
+        std::vector<std::vector<uint8_t>> counters(deviceCount);
+        std::vector<std::string> errors(deviceCount);
+        manager.setSampleCallback([&](const XbusDeviceManager::TaggedSample& sample) {
+            std::lock_guard<std::mutex> lock(mutex);
+            counters[sample.device].push_back(static_cast<uint8_t>(sample.data.packetCounter));
+        });
+        manager.setErrorCallback([&](size_t device, const std::string& error) {
+            std::lock_guard<std::mutex> lock(mutex);
+            errors[device] = error;
+        });
+        assertTrue(manager.start(), "Device manager started");
+        
+        // Every device sends 10 packets whose counter encodes the device,
+        // written byte by byte on device 0 to exercise per-device framing
+        bool written = true;
+        for (uint8_t packet = 0; packet < 10; packet++) {
+            for (size_t i = 0; i < deviceCount; i++) {
+                std::vector<uint8_t> message = createMTData2Message(
+                    {0x10, 0x20, 0x02, static_cast<uint8_t>(i), static_cast<uint8_t>(i * 16 + packet)});
+                if (i == 0) {
+                    for (uint8_t byte : message) {
+                        written = ::write(masters[i], &byte, 1) == 1 && written;
+                    }
+                } else {
+                    written = ::write(masters[i], message.data(), message.size()) ==
+                              static_cast<ssize_t>(message.size()) && written;
+                }
+            }
+        }
+        assertTrue(written, "Messages written to ptys");
+        
+        bool complete = false;
+        for (int wait = 0; wait < 200 && !complete; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            std::lock_guard<std::mutex> lock(mutex);
+            complete = true;
+            for (auto& deviceCounters : counters) {
+                complete = complete && deviceCounters.size() == 10;
+            }
+        }
+        assertTrue(complete, "All samples delivered");
+        
+        bool tagged = true;
+        for (size_t i = 0; i < deviceCount; i++) {
+            for (size_t packet = 0; packet < counters[i].size(); packet++) {
+                tagged = tagged && counters[i][packet] == i * 16 + packet;
+            }
+            tagged = tagged && manager.stats(i).samplesDecoded == counters[i].size();
+        }
+        assertTrue(tagged, "Samples tagged with their device, in order");
+        XbusDeviceManager::DeviceStats deviceStats = manager.stats(0);
+        assertTrue(deviceStats.lostPackets == 0 && deviceStats.clockResyncs == 0 && deviceStats.framer.framesOk == 10 &&
+                   deviceStats.processingLatency.count > 0, "Device stats readable while running");
+        
+        // Sending reaches only the addressed device
+        std::vector<uint8_t> request = createXbusMessage(XMID_ReqDid, {});
+        assertTrue(manager.send(1, request.data(), request.size()), "Send to device 1");
+        uint8_t echoed[16] = {0};
+        pollfd pfd = { masters[1], POLLIN, 0 };
+        bool received = poll(&pfd, 1, 1000) == 1 &&
+                        ::read(masters[1], echoed, sizeof(echoed)) == static_cast<ssize_t>(request.size()) &&
+                        memcmp(echoed, request.data(), request.size()) == 0;
+        assertTrue(received, "Sent message arrives on device 1");
+        
+        // Closing one device reports it and leaves the others running
+        ::close(masters[2]);
+        bool reported = false;
+        for (int wait = 0; wait < 200 && !reported; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            std::lock_guard<std::mutex> lock(mutex);
+            reported = !errors[2].empty();
+        }
+        assertTrue(reported && !manager.stats(2).connected, "Disconnected device reported");
+        assertTrue(manager.stats(0).connected && manager.stats(1).connected, "Other devices still connected");
+        
+        manager.stop();
+        assertTrue(!manager.isRunning(), "Device manager stopped");
+        ::close(masters[0]);
+        ::close(masters[1]);
+    }
+#endif
+
+    void testMessageBuilder() {
+        std::cout << std::endl << "--- Testing Message Builder ---" << std::endl;
+        
+        // One-pass build matches createMessage + insertChecksum, for both
+        // the standard and the extended length field
+        for (size_t payloadLength : {size_t(0), size_t(4), size_t(254), size_t(255), size_t(300)}) {
+            std::vector<uint8_t> payload(payloadLength);
+            for (size_t i = 0; i < payloadLength; i++) {
+                payload[i] = static_cast<uint8_t>(i * 7);
+            }
+            std::vector<uint8_t> expected = createXbusMessage(XMID_SetOutputConfig, payload);
+            
+            std::vector<uint8_t> built(XbusMessageBuilder::messageSize(payloadLength));
+            size_t size = XbusMessageBuilder::build(built.data(), built.size(), XMID_SetOutputConfig,
+                                                    payload.data(), static_cast<uint16_t>(payloadLength));
+            assertTrue(size == expected.size() && built == expected,
+                       "Built message matches reference, payload " + std::to_string(payloadLength));
+        }
+        
+        uint8_t buffer[XbusMessageBuilder::messageSize(11)];
+        XbusMessageBuilder builder(buffer, sizeof(buffer));
+        builder.begin(XMID_SetOutputConfig, 11).putU16(0x2030).putU32(0x01020304).putFloat(1.0f).putU8(0xAB);
+        size_t size = builder.finish();
+        std::vector<uint8_t> expected = createXbusMessage(XMID_SetOutputConfig,
+            {0x20, 0x30, 0x01, 0x02, 0x03, 0x04, 0x3F, 0x80, 0x00, 0x00, 0xAB});
+        assertTrue(size == expected.size() && memcmp(buffer, expected.data(), size) == 0, "Typed puts are big-endian");
+        
+        builder.begin(XMID_SetOutputConfig, 11).putU16(0x2030);
+        assertUint32Equals(0, static_cast<uint32_t>(builder.finish()), "Short payload rejected");
+        builder.begin(XMID_SetOutputConfig, 12);
+        assertUint32Equals(0, static_cast<uint32_t>(builder.finish()), "Message larger than buffer rejected");
+        assertUint32Equals(0, static_cast<uint32_t>(XbusMessageBuilder::build(buffer, 4, XMID_ReqDid)),
+                           "Build into too small buffer rejected");
+        
+        // Pre-encoded commands are compile-time constants
+        static_assert(XbusCommand::GOTO_CONFIG[2] == XMID_GotoConfig && XbusCommand::GOTO_CONFIG[4] == 0xD1,
+                      "GotoConfig frame encoded at compile time");
+        constexpr auto setBaud = XbusCommand::encode(XMID_SetOutputConfig, std::array<uint8_t, 2>{{0x12, 0x34}});
+        std::vector<uint8_t> setBaudExpected = createXbusMessage(XMID_SetOutputConfig, {0x12, 0x34});
+        assertTrue(std::vector<uint8_t>(setBaud.begin(), setBaud.end()) == setBaudExpected, "Payload command encoded");
+        
+        const std::array<uint8_t, 5>* commands[] = {&XbusCommand::GOTO_CONFIG, &XbusCommand::GOTO_MEASUREMENT,
+            &XbusCommand::REQ_DID, &XbusCommand::REQ_FIRMWARE_REVISION, &XbusCommand::REQ_OUTPUT_CONFIG,
+            &XbusCommand::RESET, &XbusCommand::WAKEUP_ACK};
+        bool valid = true;
+        for (const std::array<uint8_t, 5>* command : commands) {
+            valid = valid && Xbus::verifyChecksum(command->data()) &&
+                    *command == XbusCommand::encode(static_cast<uint8_t>(Xbus::getMessageId(command->data())));
+        }
+        assertTrue(valid, "Pre-encoded command checksums");
+        assertTrue(createXbusMessage(XMID_ReqDid, {}) ==
+                   std::vector<uint8_t>(XbusCommand::REQ_DID.begin(), XbusCommand::REQ_DID.end()),
+                   "ReqDid frame matches reference");
+    }
+    
+    void testRecorderReplay() {
+        std::cout << std::endl << "--- Testing Recorder and Replay ---" << std::endl;
+        
+        const std::string path = "xbus_test_recording.bin";
+        std::vector<std::vector<uint8_t>> frames = {
+            createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x00, 0x01}),
+            createXbusMessage(XMID_MtData2, std::vector<uint8_t>(300, 0x00)),  // larger than the buffer
+            createXbusMessage(XMID_GotoConfigAck, {})
+        };
+        const uint64_t times[] = {1000000000ULL, 1010000000ULL, 1030000000ULL};
+        
+        // A 64-byte buffer forces buffer flushes and the direct write path
+        XbusRecorder recorder(64);
+        assertTrue(recorder.open(path), "Recorder opened");
+        bool recorded = true;
+        for (size_t i = 0; i < frames.size(); i++) {
+            recorded = recorder.record(frames[i].data(), frames[i].size(), times[i]) && recorded;
+        }
+        assertTrue(recorded, "Frames recorded");
+        assertUint32Equals(3, static_cast<uint32_t>(recorder.framesRecorded()), "Recorded frame count");
+        uint64_t fileSize = recorder.bytesRecorded();
+        recorder.close();
+        
+        XbusReplay replay;
+        assertTrue(replay.open(path), "Replay opened");
+        assertUint32Equals(3, static_cast<uint32_t>(replay.recordCount()), "Indexed record count");
+        assertTrue(!replay.truncated(), "Complete log not truncated");
+        assertTrue(replay.startSystemTimeNs() > 0, "Recording start time stored");
+        
+        bool identical = true;
+        for (size_t i = 0; i < frames.size(); i++) {
+            XbusReplay::Record record = replay.record(i);
+            identical = identical && record.receiveTimeNs == times[i] && record.frame.size == frames[i].size() &&
+                        memcmp(record.frame.data, frames[i].data(), frames[i].size()) == 0;
+        }
+        assertTrue(identical, "Replayed frames and times match the recording");
+        
+        // Replaying through a framer reproduces the frames; at the recorded
+        // pace the 30 ms session takes at least 30 ms
+        XbusFramer framer;
+        std::vector<int> messageIds;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t delivered = replay.feed(framer, [&messageIds](const XbusFrame& frame) {
+            messageIds.push_back(Xbus::getMessageId(frame.data));
+        }, 1.0);
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+        assertTrue(delivered == 3 && messageIds.size() == 3 && messageIds[1] == XMID_MtData2, "Replay through framer");
+        assertTrue(elapsed >= std::chrono::milliseconds(30), "Replay keeps recorded timing");
+        
+        size_t played = replay.play([](const XbusReplay::Record&) {}, 0.0, 1);
+        assertUint32Equals(2, static_cast<uint32_t>(played), "Replay from an index");
+        replay.close();
+        
+        // Cut the last record short, as a crash during recording would
+        std::vector<uint8_t> contents(static_cast<size_t>(fileSize));
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        size_t readBytes = file ? std::fread(contents.data(), 1, contents.size(), file) : 0;
+        if (file) {
+            std::fclose(file);
+        }
+        assertTrue(readBytes == contents.size(), "Log size matches bytes recorded");
+        file = std::fopen(path.c_str(), "wb");
+        if (file) {
+            std::fwrite(contents.data(), 1, contents.size() - 3, file);
+            std::fclose(file);
+        }
+        assertTrue(replay.open(path) && replay.recordCount() == 2 && replay.truncated(), "Truncated log keeps complete records");
+        replay.close();
+        
+        file = std::fopen(path.c_str(), "wb");
+        if (file) {
+            std::fwrite(frames[0].data(), 1, frames[0].size(), file);
+            std::fclose(file);
+        }
+        assertTrue(!replay.open(path), "File without log header rejected");
+        
+        // Records are untrusted: a header claiming more bytes than the
+        // record holds, a cut off frame and a bad checksum are not decoded
+        std::vector<uint8_t> valid = createMTData2Message({0x10, 0x20, 0x02, 0x12, 0x34});
+        std::vector<uint8_t> badChecksum = valid;
+        badChecksum.back() ^= 0x01;
+        std::vector<std::vector<uint8_t>> records = {
+            {0xFA, 0xFF, XMID_MtData2, 0xFF, 0xFF, 0xF0},
+            std::vector<uint8_t>(valid.begin(), valid.end() - 2),
+            badChecksum,
+            valid
+        };
+        XbusRecorder untrusted;
+        recorded = untrusted.open(path);
+        for (const std::vector<uint8_t>& record : records) {
+            recorded = untrusted.record(record.data(), record.size(), 0) && recorded;
+        }
+        untrusted.close();
+        XbusLayoutDecoder decoder;
+        std::vector<uint16_t> counters;
+        assertTrue(recorded && replay.open(path) && replay.recordCount() == records.size(), "Untrusted records replayed");
+        replay.play([&decoder, &counters](const XbusReplay::Record& record) {
+            const XbusFrame& frame = record.frame;
+            SensorData data;
+            if (Xbus::isComplete(frame.data, frame.size) && Xbus::verifyChecksum(frame.data) &&
+                decoder.decode(frame.data, frame.size, data)) {
+                counters.push_back(data.packetCounter);
+            }
+        });
+        assertTrue(counters.size() == 1 && counters[0] == 0x1234, "Only the intact record decoded");
+        replay.close();
+        std::remove(path.c_str());
+    }
+    
+    void testSelectiveDecoding() {
+        std::cout << std::endl << "--- Testing Selective Decoding ---" << std::endl;
+        
+        // Packet counter, Euler angles, status word, quaternion
+        std::vector<uint8_t> payload = {0x10, 0x20, 0x02, 0x12, 0x34,
+                                        0x20, 0x30, 0x0C,
+                                        0x42, 0x34, 0x00, 0x00,
+                                        0x41, 0xF0, 0x00, 0x00,
+                                        0x42, 0xB4, 0x00, 0x00,
+                                        0xE0, 0x20, 0x04, 0x00, 0x00, 0x00, 0x03,
+                                        0x20, 0x10, 0x10,
+                                        0x3F, 0x80, 0x00, 0x00,
+                                        0x00, 0x00, 0x00, 0x00,
+                                        0x00, 0x00, 0x00, 0x00,
+                                        0x00, 0x00, 0x00, 0x00};
+        std::vector<uint8_t> message = createMTData2Message(payload);
+        
+        SensorData sensorData;
+        sensorData.hasStatusWord = true;
+        sensorData.statusWord = 0xDEADBEEF;
+        uint32_t found = XbusParser::parseMTData2Fields(message.data(), SensorField::EULER_ANGLES, sensorData);
+        assertUint32Equals(SensorField::EULER_ANGLES, found, "Only Euler angles decoded");
+        assertFloatEquals(45.0f, sensorData.eulerAngles.roll, 0.001f, "Selected roll");
+        assertTrue(!sensorData.hasPacketCounter && !sensorData.hasQuaternion, "Unrequested fields not decoded");
+        assertTrue(sensorData.hasStatusWord && sensorData.statusWord == 0xDEADBEEF, "Unrequested fields left untouched");
+        
+        // The walk stops once everything requested is found, so a corrupt
+        // item after the Euler angles does not matter
+        std::vector<uint8_t> corrupt = payload;
+        corrupt[22] = 0xFF; // Status word size far past the payload end
+        std::vector<uint8_t> corruptMessage = createMTData2Message(corrupt);
+        found = XbusParser::parseMTData2Fields(corruptMessage.data(),
+                                               SensorField::PACKET_COUNTER | SensorField::EULER_ANGLES, sensorData);
+        assertUint32Equals(SensorField::PACKET_COUNTER | SensorField::EULER_ANGLES, found, "Walk stops at last wanted item");
+        found = XbusParser::parseMTData2Fields(corruptMessage.data(), SensorField::QUATERNION, sensorData);
+        assertUint32Equals(0, found, "Item behind corrupt size not reached");
+        assertTrue(!sensorData.hasQuaternion, "Requested but missing field reset");
+        
+        // Compile-time selection of two fields in one pass
+        SensorData selected;
+        found = XbusParser::parseMTData2Select<XDI::EULER_ANGLES, XDI::QUATERNION>(message.data(), selected);
+        assertUint32Equals(SensorField::EULER_ANGLES | SensorField::QUATERNION, found, "Compile-time selection");
+        assertTrue(selected.hasQuaternion && selected.quaternion.q0 == 1.0f && !selected.hasStatusWord,
+                   "Compile-time selection decodes only the listed XDIs");
+        
+        // Same values as the full decoder
+        SensorData full;
+        XbusParser::parseMTData2(message.data(), full);
+        SensorData all;
+        found = XbusParser::parseMTData2Fields(message.data(), 0xFFFFFFFF, all);
+        assertUint32Equals(SensorField::PACKET_COUNTER | SensorField::EULER_ANGLES | SensorField::STATUS_WORD |
+                           SensorField::QUATERNION, found, "All present fields found");
+        assertTrue(all.packetCounter == full.packetCounter && all.statusWord == full.statusWord &&
+                   all.eulerAngles.yaw == full.eulerAngles.yaw, "Selective values match parseMTData2");
+        
+        std::vector<uint8_t> deviceId = createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x00, 0x01});
+        assertUint32Equals(0, XbusParser::parseMTData2Fields(deviceId.data(), SensorField::EULER_ANGLES, all),
+                           "Non-MTData2 message rejected");
+    }
+    
+    void testXdiRegistry() {
+        std::cout << std::endl << "--- Testing XDI Registry ---" << std::endl;
+        
+        // Sizes and masks come from the wire layouts in the list
+        static_assert(SensorDataXdi::All::count == 13, "Every decoded output is registered");
+        static_assert(SensorDataXdi::UtcTime::size == 12 && SensorDataXdi::VelocityXYZ::size == 18,
+                      "Item sizes follow the wire layout");
+        static_assert(SensorField::fromXdi(XDI::BAROMETRIC_PRESSURE) == SensorField::BAROMETRIC_PRESSURE,
+                      "Field lookup is constexpr");
+        bool sizesOk = XbusParser::getDataItemSize(XDI::PACKET_COUNTER) == 2 &&
+                       XbusParser::getDataItemSize(XDI::SAMPLE_TIME_FINE) == 4 &&
+                       XbusParser::getDataItemSize(XDI::EULER_ANGLES) == 12 &&
+                       XbusParser::getDataItemSize(XDI::STATUS_WORD) == 4 &&
+                       XbusParser::getDataItemSize(XDI::LAT_LON) == 12 &&
+                       XbusParser::getDataItemSize(XDI::ALTITUDE_ELLIPSOID) == 6 &&
+                       XbusParser::getDataItemSize(XDI::VELOCITY_XYZ) == 18 &&
+                       XbusParser::getDataItemSize(XDI::UTC_TIME) == 12 &&
+                       XbusParser::getDataItemSize(XDI::QUATERNION) == 16 &&
+                       XbusParser::getDataItemSize(XDI::BAROMETRIC_PRESSURE) == 4 &&
+                       XbusParser::getDataItemSize(XDI::ACCELERATION) == 12 &&
+                       XbusParser::getDataItemSize(XDI::RATE_OF_TURN) == 12 &&
+                       XbusParser::getDataItemSize(XDI::MAGNETIC_FIELD) == 12 &&
+                       XbusParser::getDataItemSize(0x0810) == 0;
+        assertTrue(sizesOk, "Registry item sizes");
+        assertUint32Equals(0x1FFF, SensorDataXdi::All::allFields(), "Registry covers every SensorField bit");
+        assertTrue(std::string(SensorDataXdi::All::name(XDI::VELOCITY_XYZ)) == "VelocityXYZ" &&
+                   SensorDataXdi::All::name(0x0810) == nullptr, "Registry names");
+        assertTrue(XbusParser::getDataItemDecoder(XDI::UTC_TIME, 11) == nullptr &&
+                   XbusParser::getDataItemDecoder(0x1234, 4) == nullptr, "No decoder for bad size or unknown XDI");
+        
+        // Mixed-width layout decoded in declaration order
+        const uint8_t utc[12] = {0x1D, 0xCD, 0x65, 0x00, 0x07, 0xE8, 0x03, 0x0F, 0x0C, 0x1E, 0x2D, 0x07};
+        SensorData data;
+        XbusParser::getDataItemDecoder(XDI::UTC_TIME, sizeof(utc))(utc, data);
+        assertTrue(data.hasUtcTime && data.utcTime.nanoseconds == 500000000 && data.utcTime.year == 2024 &&
+                   data.utcTime.month == 3 && data.utcTime.day == 15 && data.utcTime.hour == 12 &&
+                   data.utcTime.minute == 30 && data.utcTime.second == 45 && data.utcTime.flags == 7,
+                   "UtcTime decoded from registry layout");
+        
+        // Single FP16.32 value, negative integer part
+        std::vector<uint8_t> altitude = doubleToFP1632(-12.25);
+        assertTrue(SensorDataXdi::All::decode(XDI::ALTITUDE_ELLIPSOID, 6, altitude.data(), data),
+                   "Registry decode of known XDI");
+        assertDoubleEquals(-12.25, data.altitudeEllipsoid, 1e-9, "Negative FP16.32 altitude");
+        assertTrue(!SensorDataXdi::All::decode(0x0810, 12, utc, data), "Registry rejects unknown XDI");
+        
+        SensorDataXdi::All::clear(data, SensorField::UTC_TIME);
+        assertTrue(!data.hasUtcTime && data.hasAltitudeEllipsoid, "Registry clears only selected fields");
+    }
+    
+    void testPrecisionFormats() {
+        std::cout << std::endl << "--- Testing Precision Formats ---" << std::endl;
+        
+        static_assert(XdiFormat::precision(XDI::LAT_LON) == XdiFormat::FP1632, "LatLon defaults to FP16.32");
+        static_assert(XdiFormat::withPrecision(XDI::EULER_ANGLES, XdiFormat::FLOAT64) == 0x2033, "Precision bits");
+        static_assert(XdiFormat::withCoordinateSystem(XDI::EULER_ANGLES, XdiFormat::NED) == 0x2034, "Coordinate bits");
+        
+        const uint16_t eulerFp1632 = XdiFormat::withPrecision(XDI::EULER_ANGLES, XdiFormat::FP1632);
+        const uint16_t latLonFloat64 = XdiFormat::withPrecision(XDI::LAT_LON, XdiFormat::FLOAT64);
+        const uint16_t quaternionFixed = XdiFormat::withPrecision(XDI::QUATERNION, XdiFormat::FIXED1220);
+        const uint16_t velocityFloat32 = XdiFormat::withCoordinateSystem(
+            XdiFormat::withPrecision(XDI::VELOCITY_XYZ, XdiFormat::FLOAT32), XdiFormat::NED);
+        const uint16_t altitudeFixed = XdiFormat::withPrecision(XDI::ALTITUDE_ELLIPSOID, XdiFormat::FIXED1220);
+        bool sizesOk = XbusParser::getDataItemSize(eulerFp1632) == 18 &&
+                       XbusParser::getDataItemSize(latLonFloat64) == 16 &&
+                       XbusParser::getDataItemSize(quaternionFixed) == 16 &&
+                       XbusParser::getDataItemSize(velocityFloat32) == 12 &&
+                       XbusParser::getDataItemSize(altitudeFixed) == 4 &&
+                       XbusParser::getDataItemSize(XDI::PACKET_COUNTER | XdiFormat::FP1632) == 0;
+        assertTrue(sizesOk, "Item sizes follow the precision bits");
+        
+        std::vector<uint8_t> payload;
+        appendItemHeader(payload, eulerFp1632, 18);
+        for (double angle : {10.5, -20.25, 179.75}) {
+            std::vector<uint8_t> value = doubleToFP1632(angle);
+            payload.insert(payload.end(), value.begin(), value.end());
+        }
+        appendItemHeader(payload, latLonFloat64, 16);
+        for (double coordinate : {52.2215372, -6.8937031}) {
+            uint64_t bits;
+            memcpy(&bits, &coordinate, sizeof(bits));
+            appendBigEndian(payload, bits, 8);
+        }
+        appendItemHeader(payload, quaternionFixed, 16);
+        for (int32_t fixedPoint : {1 << 20, -(1 << 19), 1 << 18, 0}) {
+            appendBigEndian(payload, static_cast<uint32_t>(fixedPoint), 4);
+        }
+        appendItemHeader(payload, velocityFloat32, 12);
+        for (float velocity : {1.5f, -2.0f, 0.25f}) {
+            uint32_t bits;
+            memcpy(&bits, &velocity, sizeof(bits));
+            appendBigEndian(payload, bits, 4);
+        }
+        appendItemHeader(payload, altitudeFixed, 4);
+        appendBigEndian(payload, static_cast<uint32_t>(-(3 << 20) - (1 << 19)), 4); // -3.5
+        std::vector<uint8_t> message = createMTData2Message(payload);
+        
+        SensorData data;
+        assertTrue(XbusParser::parseMTData2(message.data(), data), "Parse mixed precision MTData2");
+        assertTrue(data.hasEulerAngles && data.hasLatLon && data.hasQuaternion && data.hasVelocityXYZ &&
+                   data.hasAltitudeEllipsoid, "Every non-default format decoded");
+        assertFloatEquals(-20.25f, data.eulerAngles.pitch, 0.0001f, "FP16.32 Euler pitch");
+        assertDoubleEquals(52.2215372, data.latLon.latitude, 1e-12, "Float64 latitude");
+        assertDoubleEquals(-6.8937031, data.latLon.longitude, 1e-12, "Float64 longitude");
+        assertFloatEquals(-0.5f, data.quaternion.q1, 1e-6f, "Fixed12.20 quaternion q1");
+        assertFloatEquals(0.25f, data.quaternion.q2, 1e-6f, "Fixed12.20 quaternion q2");
+        assertDoubleEquals(-2.0, data.velocityXYZ.velY, 1e-9, "Float32 velocity in NED");
+        assertDoubleEquals(-3.5, data.altitudeEllipsoid, 1e-9, "Fixed12.20 altitude");
+        assertTrue(XdiFormat::coordinateSystem(data.velocityXYZFormat) == XdiFormat::NED &&
+                   XdiFormat::precision(data.velocityXYZFormat) == XdiFormat::FLOAT32 &&
+                   data.latLonFormat == XdiFormat::FLOAT64 && data.eulerAnglesFormat == XdiFormat::FP1632 &&
+                   data.quaternionFormat == XdiFormat::FIXED1220, "Format bits recorded per item");
+        
+        // Selective and batch decoding follow the same format bits
+        SensorData selected;
+        uint32_t found = XbusParser::parseMTData2Select<XDI::LAT_LON, XDI::QUATERNION>(message.data(), selected);
+        assertUint32Equals(SensorField::LAT_LON | SensorField::QUATERNION, found, "Selective decode of other formats");
+        assertTrue(selected.latLon.latitude == data.latLon.latitude && selected.quaternion.q0 == 1.0f,
+                   "Selective values match parseMTData2");
+        
+        SensorDataColumns columns;
+        const uint8_t* frames[] = {message.data()};
+        XbusParser::parseMTData2Batch(frames, 1, columns);
+        assertTrue(columns.yaw[0] == data.eulerAngles.yaw && columns.longitude[0] == data.latLon.longitude &&
+                   columns.q1[0] == data.quaternion.q1 && columns.velZ[0] == data.velocityXYZ.velZ &&
+                   columns.altitudeEllipsoid[0] == data.altitudeEllipsoid &&
+                   columns.velocityXYZFormat[0] == data.velocityXYZFormat, "Batch columns match parseMTData2");
+        
+        XbusLayoutDecoder layout;
+        SensorData learned;
+        assertTrue(layout.learn(message.data()) && layout.decode(message.data(), learned) &&
+                   learned.latLon.longitude == data.latLon.longitude && learned.eulerAngles.roll == data.eulerAngles.roll &&
+                   learned.velocityXYZFormat == data.velocityXYZFormat, "Layout decoder handles other formats");
+        
+        // A size that does not match the precision bits is still skipped
+        std::vector<uint8_t> wrongSize;
+        appendItemHeader(wrongSize, latLonFloat64, 12);
+        wrongSize.insert(wrongSize.end(), 12, 0x00);
+        SensorData skipped;
+        XbusParser::parseMTData2(createMTData2Message(wrongSize).data(), skipped);
+        assertTrue(!skipped.hasLatLon, "Item with inconsistent size skipped");
+    }
+    
+    void testPipelineStats() {
+        std::cout << std::endl << "--- Testing Pipeline Stats ---" << std::endl;
+        
+        RelaxedCounter counter;
+        ++counter;
+        counter += 41;
+        counter.updateMax(10);
+        RelaxedCounter copy = counter;
+        assertTrue(counter == 42 && copy.load() == 42, "Relaxed counter add and copy");
+        
+        // Power-of-two buckets, percentiles report the bucket upper bound
+        LatencyHistogram histogram;
+        assertTrue(LatencyHistogram::bucketFor(0) == 0 && LatencyHistogram::bucketFor(1) == 0 &&
+                   LatencyHistogram::bucketFor(1000) == 9 && LatencyHistogram::bucketFor(~0ull) == 39,
+                   "Latency bucket index");
+        for (int i = 0; i < 98; i++) {
+            histogram.record(1000);
+        }
+        histogram.record(100000);
+        histogram.record(5000000);
+        LatencyHistogram::Snapshot latency = histogram.snapshot();
+        assertTrue(latency.count == 100 && latency.maxNs == 5000000 && latency.buckets[9] == 98, "Histogram counts");
+        assertTrue(latency.percentileNs(0.5) == 1023, "Histogram p50 within the 512-1023 ns bucket");
+        assertTrue(latency.percentileNs(0.99) == 131071, "Histogram p99 within the 64-128 us bucket");
+        assertTrue(latency.percentileNs(1.0) == 5000000, "Histogram p100 capped at the maximum");
+        assertDoubleEquals(51980.0, latency.meanNs(), 0.001, "Histogram mean");
+        
+        // Gaps across the 16-bit wrap, duplicates are not gaps
+        PacketCounterGaps gaps;
+        bool continuous = gaps.update(65534) == 0 && gaps.update(65535) == 0 && gaps.update(0) == 0;
+        assertTrue(continuous && gaps.gaps == 0, "Packet counter wrap is not a gap");
+        assertUint16Equals(2, gaps.update(3), "Two packets missing");
+        gaps.update(3);
+        assertTrue(gaps.gaps == 1 && gaps.lostPackets == 2 && gaps.duplicates == 1 && gaps.packets == 5,
+                   "Gap, loss and duplicate counts");
+        
+        // Framer counts bytes and the deepest buffer fill
+        XbusFramer framer(64);
+        std::vector<uint8_t> message = createMTData2Message({0x10, 0x20, 0x02, 0x00, 0x01});
+        std::vector<uint8_t> stream = {0x00, 0xFA, 0xFF};
+        stream.insert(stream.end(), message.begin(), message.end());
+        framer.feed(stream.data(), stream.size(), [](const XbusFrame&) {});
+        const XbusFramer::Stats& stats = framer.stats();
+        assertTrue(stats.bytesReceived == stream.size() && stats.bufferHighWater == stream.size() &&
+                   stats.framesOk == 1, "Framer byte and high-water counters");
+        XbusFramer::Stats snapshot = stats;
+        assertTrue(snapshot.bytesSkipped == stats.bytesSkipped, "Framer stats snapshot");
+    }
+
+#ifdef __linux__
+    void testSerialReaderStats() {
+        std::cout << std::endl << "--- Testing Serial Reader Stats ---" << std::endl;
+        
+        int master = -1;
+        int slave = -1;
+        char name[128];
+        SerialReader reader;
+        bool opened = openpty(&master, &slave, name, nullptr, nullptr) == 0 && reader.open(name, 115200);
+        ::close(slave);
+        assertTrue(opened, "Pty opened as serial port");
+        if (!opened) {
+            return;
+        }
+        
+        // A one-chunk queue that is never drained overflows
+        SerialReader::ChunkQueue queue(1);
+        reader.setDataQueue(&queue);
+        std::atomic<uint64_t> callbackBytes(0);
+        reader.setDataCallback([&callbackBytes](const uint8_t*, size_t length) {
+            callbackBytes += length;
+        });
+        assertTrue(reader.startAsyncReading(), "Async reading started");
+        
+        std::vector<uint8_t> message = createMTData2Message({0x10, 0x20, 0x02, 0x00, 0x01});
+        bool written = true;
+        for (int i = 0; i < 3; i++) {
+            written = ::write(master, message.data(), message.size()) == static_cast<ssize_t>(message.size()) && written;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        assertTrue(written, "Messages written to pty");
+        for (int wait = 0; wait < 200 && callbackBytes < 3 * message.size(); wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        
+        SerialReader::Stats stats = reader.stats();
+        LatencyHistogram::Snapshot delivery = stats.deliveryLatency.snapshot();
+        assertTrue(stats.bytesRead == 3 * message.size() && stats.reads >= 1, "Bytes and reads counted");
+        assertTrue(stats.chunksQueued + stats.chunksDropped == stats.reads && stats.queueHighWater == queue.capacity(),
+                   "Queue handoff, drops and high-water counted");
+        assertTrue(stats.chunksDropped >= 1, "Full queue counted as dropped");
+        assertTrue(delivery.count == stats.reads && stats.readErrors == 0, "Delivery latency recorded per read");
+        
+        reader.stopAsyncReading();
+        reader.close();
+        ::close(master);
+    }
+    
+    void testSerialReaderReadConfig() {
+        std::cout << std::endl << "--- Testing Serial Reader Read Config ---" << std::endl;
+        
+        SerialReader reader;
+        SerialReader::ReadConfig config;
+        config.readBufferSize = 0;
+        assertTrue(!reader.setReadConfig(config), "Empty read buffer rejected");
+        
+        // Pin the read thread to the last CPU this process may use and read
+        // in small pieces
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        int pinnedCpu = -1;
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                pinnedCpu = cpu;
+            }
+        }
+        config.readBufferSize = 16;
+        config.affinityMask = uint64_t(1) << pinnedCpu;
+        assertTrue(pinnedCpu >= 0 && reader.setReadConfig(config), "Read config accepted");
+        
+        int master = -1;
+        int slave = -1;
+        char name[128];
+        bool opened = openpty(&master, &slave, name, nullptr, nullptr) == 0 && reader.open(name, 115200);
+        ::close(slave);
+        assertTrue(opened, "Pty opened as serial port");
+        if (!opened) {
+            return;
+        }
+        assertTrue(!reader.setReadConfig(SerialReader::ReadConfig()), "Read config fixed while open");
+        
+        std::atomic<uint64_t> callbackBytes(0);
+        std::atomic<size_t> largestRead(0);
+        std::atomic<bool> onPinnedCpu(true);
+        reader.setDataCallback([&](const uint8_t*, size_t length) {
+            callbackBytes += length;
+            if (length > largestRead) {
+                largestRead = length;
+            }
+            if (sched_getcpu() != pinnedCpu) {
+                onPinnedCpu = false;
+            }
+        });
+        assertTrue(reader.startAsyncReading(), "Async reading started with affinity");
+        
+        std::vector<uint8_t> payload(100);
+        for (size_t i = 0; i < payload.size(); i++) {
+            payload[i] = static_cast<uint8_t>(i);
+        }
+        std::vector<uint8_t> message = createXbusMessage(XMID_MtData2, payload);
+        bool written = ::write(master, message.data(), message.size()) == static_cast<ssize_t>(message.size());
+        for (int wait = 0; wait < 200 && callbackBytes < message.size(); wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        assertTrue(written && callbackBytes == message.size(), "Message read through small buffer");
+        assertTrue(largestRead <= config.readBufferSize && reader.stats().reads >= message.size() / config.readBufferSize,
+                   "Reads limited to the buffer size");
+        assertTrue(onPinnedCpu, "Read thread runs on the pinned CPU");
+        reader.stopAsyncReading();
+        
+        // Real-time scheduling may need privileges; either it starts or the
+        // failure is reported and nothing is left running
+        SerialReader realtime;
+        SerialReader::ReadConfig realtimeConfig;
+        realtimeConfig.priority = SerialReader::ThreadPriority::TimeCritical;
+        realtimeConfig.realtimePriority = 1;
+        realtime.setReadConfig(realtimeConfig);
+        reader.close();
+        bool reopened = realtime.open(name, 115200);
+        bool started = reopened && realtime.startAsyncReading();
+        assertTrue(reopened && (started || !realtime.getLastError().empty()), "SCHED_FIFO applied or reported");
+        assertTrue(!started || !realtime.setDataQueue(nullptr), "Real-time read thread running");
+        realtime.close();
+        
+        // An out of range priority always fails
+        SerialReader invalid;
+        realtimeConfig.realtimePriority = 1000;
+        invalid.setReadConfig(realtimeConfig);
+        bool invalidOpened = invalid.open(name, 115200);
+        assertTrue(invalidOpened && !invalid.startAsyncReading() && invalid.getLastError().find("SCHED_FIFO") != std::string::npos,
+                   "Invalid SCHED_FIFO priority reported");
+        assertTrue(invalid.setDataQueue(nullptr), "Failed start leaves no thread");
+        invalid.close();
+        ::close(master);
+    }
+#endif
+
+    void testClockTracker() {
+        std::cout << std::endl << "--- Testing Clock Tracker ---" << std::endl;
+        
+        // 100 Hz device whose clock runs 50 ppm slow against the host,
+        // received 1 ms + 0..4 ms late in bursts of four samples, starting
+        // just before SampleTimeFine wraps
+        XbusClockTracker tracker;
+        const uint64_t hostStartNs = 5000000000ull;
+        const uint32_t startTicks = 0xFFFFFFFFu - 1000;
+        const double hostPerDevice = 1.0 + 50e-6;
+        uint32_t random = 12345;
+        double maxError = 0.0;
+        bool monotonic = true;
+        uint64_t lastHostNs = 0;
+        
+        for (int k = 0; k < 6000; k += 4) {
+            // The burst is read when its last sample arrived
+            random = random * 1664525u + 1013904223u;
+            uint64_t jitterNs = (random >> 8) % 4000000;
+            uint64_t readNs = hostStartNs + static_cast<uint64_t>((k + 3) * 10000000.0 * hostPerDevice) +
+                              1000000 + jitterNs;
+            for (int i = k; i < k + 4; i++) {
+                SensorData data;
+                data.hasPacketCounter = true;
+                data.packetCounter = static_cast<uint16_t>(i);
+                data.hasSampleTimeFine = true;
+                data.sampleTimeFine = startTicks + static_cast<uint32_t>(i) * 100;
+                
+                XbusClockTracker::Sample sample = tracker.update(data, readNs);
+                // Only the first burst shares one timestamp; there is no floor yet
+                monotonic = monotonic && (i < 4 || sample.hostTimeNs > lastHostNs) && !sample.resynced;
+                lastHostNs = sample.hostTimeNs;
+                
+                // Against the true time the sample would arrive with the minimum latency
+                double expectedNs = hostStartNs + i * 10000000.0 * hostPerDevice + 1000000.0;
+                if (i >= 3000) {
+                    maxError = std::max(maxError, std::fabs(static_cast<double>(sample.hostTimeNs) - expectedNs));
+                }
+            }
+        }
+        assertTrue(monotonic && tracker.resyncs() == 0, "Corrected timestamps increase across the tick wrap");
+        assertTrue(tracker.isLocked() && tracker.source() == XbusClockTracker::TimeSource::SampleTimeFine,
+                   "Tracker locked on SampleTimeFine");
+        assertDoubleEquals(50.0, tracker.driftPpm(), 5.0, "Drift estimate");
+        assertTrue(maxError < 300000.0, "Corrected timestamps within 300 us of the latency floor");
+        
+        // Jitter-free timestamps for every sample of a burst
+        SensorData next;
+        next.hasPacketCounter = true;
+        next.packetCounter = 6005;
+        next.hasSampleTimeFine = true;
+        next.sampleTimeFine = startTicks + 6005 * 100;
+        uint64_t readNs = hostStartNs + static_cast<uint64_t>(6005 * 10000000.0 * hostPerDevice) + 3000000;
+        XbusClockTracker::Sample sample = tracker.update(next, readNs);
+        assertUint16Equals(5, sample.lostPackets, "Lost packets before a gap");
+        assertTrue(!sample.resynced && tracker.packetGaps().lostPackets == 5, "Gap does not restart the estimate");
+        assertTrue(sample.deviceTimeNs == (static_cast<uint64_t>(startTicks) + 600500) * 100000,
+                   "Device time unwrapped past 32 bits");
+        
+        // A device reset steps SampleTimeFine back
+        next.packetCounter = 0;
+        next.sampleTimeFine = 10;
+        sample = tracker.update(next, readNs + 10000000);
+        assertTrue(sample.resynced && tracker.resyncs() == 1 && sample.hostTimeNs == readNs + 10000000,
+                   "Device clock reset restarts the estimate");
+        
+        // UtcTime as the device clock when no SampleTimeFine is sent
+        uint64_t utcNs = 0;
+        assertTrue(XbusClockTracker::utcToNs(UtcTime(500, 2024, 1, 1, 0, 0, 0, 0), utcNs) &&
+                   utcNs == 1704067200000000500ull, "UTC to ns since epoch");
+        assertTrue(!XbusClockTracker::utcToNs(UtcTime(0, 2024, 13, 1, 0, 0, 0, 0), utcNs), "Invalid UTC month");
+        
+        XbusClockTracker::Config utcConfig;
+        utcConfig.floorRiseNsPerSec = 0;
+        XbusClockTracker utcTracker(utcConfig);
+        SensorData utc;
+        utc.hasUtcTime = true;
+        utc.utcTime = UtcTime(0, 2024, 1, 1, 12, 0, 0, 0);
+        sample = utcTracker.update(utc, 1000);
+        assertTrue(sample.source == XbusClockTracker::TimeSource::None && sample.hostTimeNs == 1000,
+                   "UTC without the valid flag is passed through");
+        utc.utcTime.flags = UtcFlags::VALID_UTC;
+        utcTracker.update(utc, 1000);
+        utc.utcTime.nanoseconds = 10000000;
+        sample = utcTracker.update(utc, 12000000);
+        assertTrue(sample.source == XbusClockTracker::TimeSource::UtcTime && sample.hostTimeNs == 10001000,
+                   "UTC device clock with the earliest arrival as latency floor");
+    }
+    
+    void testTextFormatting() {
+        std::cout << std::endl << "--- Testing Text Formatting ---" << std::endl;
+        
+        char small[8];
+        XbusTextWriter writer(small);
+        writer.append("ab");
+        writer.appendHex(0xBEEF, 6);
+        assertTrue(std::string(small) == "ab00BEE" &&
+                   writer.truncated(), "Writer truncates and stays terminated");
+        writer.clear();
+        writer.appendFixed(-0.0049, 2);
+        writer.appendSigned(-7);
+        assertTrue(std::string(small) == "-0.00-7" && !writer.truncated(), "Fixed and signed numbers");
+        
+        SensorData data;
+        data.hasPacketCounter = data.hasSampleTimeFine = data.hasUtcTime = data.hasEulerAngles = true;
+        data.hasQuaternion = data.hasLatLon = data.hasAltitudeEllipsoid = data.hasVelocityXYZ = true;
+        data.hasBarometricPressure = data.hasStatusWord = true;
+        data.packetCounter = 65535;
+        data.sampleTimeFine = 4000000123u;
+        data.utcTime = UtcTime(5000, 2024, 3, 7, 9, 5, 59, 0x07);
+        data.eulerAngles = EulerAngles(-1.005f, 45.125f, -179.999f);
+        data.quaternion = Quaternion(0.7071068f, -0.0f, 0.25f, -0.7071068f);
+        data.latLon = LatLon(52.123456789, -4.98765432149);
+        data.altitudeEllipsoid = -12.3456;
+        data.velocityXYZ = VelocityXYZ(0.00005f, -1.23456f, 100.0f);
+        data.barometricPressure = BarometricPressure(101325);
+        data.statusWord = 0x00000007;
+        std::string expected = "PC=65535, STF=4000000123, UTC=2024-03-07 09:05:59.000005000 [F:07], "
+                               "Euler(R=-1.00°, P=45.12°, Y=-180.00°), Quat=(0.707107, -0.000000, 0.250000, -0.707107), "
+                               "LatLon(52.12345679, -4.98765432), Alt=-12.346m, Vel(0.0000, -1.2346, 100.0000)m/s, "
+                               "Baro=1013.25 hPa, Status=0x00000007 [SelfTest] [FilterValid] [GNSSFix]";
+        assertTrue(XbusParser::formatSensorData(data) == expected, "All fields formatted");
+        
+        // Appends after existing text, separators start fresh
+        char text[XbusParser::TEXT_BUFFER_SIZE];
+        XbusTextWriter out(text);
+        out.append("> ");
+        SensorData status;
+        status.hasStatusWord = true;
+        status.statusWord = 0xDEADBEE2;
+        XbusParser::formatSensorData(status, out);
+        assertTrue(std::string(text) == "> Status=0xDEADBEE2 [FilterValid]", "Formatting appends to a buffer");
+        
+        // Extreme values still fit the documented buffer size
+        SensorData extreme = data;
+        extreme.latLon = LatLon(-1.7e308, -1.7e308);
+        extreme.altitudeEllipsoid = -1.7e308;
+        extreme.velocityXYZ = VelocityXYZ(-1.7e308, -1.7e308, -1.7e308);
+        extreme.eulerAngles = EulerAngles(-3.4e38f, -3.4e38f, -3.4e38f);
+        extreme.quaternion = Quaternion(-3.4e38f, -3.4e38f, -3.4e38f, -3.4e38f);
+        out.clear();
+        XbusParser::formatSensorData(extreme, out);
+        assertTrue(!out.truncated() && out.size() > 2000, "Extreme values fit TEXT_BUFFER_SIZE");
+        
+        std::vector<uint8_t> firmware = createXbusMessage(XMID_FirmwareRevision, {1, 2, 30});
+        std::vector<uint8_t> deviceId = createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x12, 0xAB});
+        std::vector<uint8_t> unknown = createXbusMessage(0x7E, {});
+        assertTrue(XbusParser::messageToString(firmware.data()) == "Firmware revision: 1.2.30" &&
+                   XbusParser::parseFirmwareRevision(firmware.data()) == "1.2.30" &&
+                   XbusParser::messageToString(deviceId.data()) == "XMID_DeviceId: 0x038012AB" &&
+                   XbusParser::messageToString(unknown.data()) == "Unhandled xbus message: MessageId = 0x7E",
+                   "Message text");
+    }
+    
+    std::string readFile(const std::string& path) {
+        std::string contents;
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (file) {
+            char chunk[4096];
+            size_t got;
+            while ((got = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+                contents.append(chunk, got);
+            }
+            std::fclose(file);
+        }
+        return contents;
+    }
+    
+    void testExportSinks() {
+        std::cout << std::endl << "--- Testing Export Sinks ---" << std::endl;
+        
+        SensorDataColumns batch;
+        SensorData first;
+        first.hasPacketCounter = true;
+        first.packetCounter = 7;
+        first.hasEulerAngles = true;
+        first.eulerAngles = EulerAngles(1.5f, -0.1f, 180.0f);
+        first.hasUtcTime = true;
+        first.utcTime = UtcTime(1500, 2024, 3, 7, 9, 5, 59, UtcFlags::VALID_UTC);
+        batch.append(first);
+        
+        SensorData second;
+        second.hasPacketCounter = true;
+        second.packetCounter = 8;
+        second.hasLatLon = true;
+        second.latLon = LatLon(52.1234567891, -4.5);
+        second.latLonFormat = XdiFormat::bits(XDI::LAT_LON);
+        batch.append(second);
+        assertTrue(batch.size() == 2 && batch.has(0, SensorField::EULER_ANGLES) && !batch.has(1, SensorField::UTC_TIME) &&
+                   batch.latitude[1] == 52.1234567891, "Samples appended as rows");
+        
+        // Columns from the fields present in the first batch, absent cells empty
+        const std::string csvPath = "xbus_test_export.csv";
+        {
+            XbusCsvSink csv(0, 64);
+            assertTrue(csv.open(csvPath) && csv.write(batch), "CSV batch written");
+            assertTrue(csv.write(SensorDataColumns()) && csv.close() && csv.rowsWritten() == 2, "CSV closed");
+        }
+        std::string expected = "PacketCounter,Roll,Pitch,Yaw,EulerAnglesFormat,Latitude,Longitude,LatLonFormat,UtcTime\n"
+                   "7,1.5,-0.1,180,0,,,,2024-03-07T09:05:59.000001500\n"
+                   "8,,,,,52.1234567891,-4.5,2,\n";
+        assertTrue(readFile(csvPath) == expected, "CSV header and rows");
+        std::remove(csvPath.c_str());
+        
+        // Binary columns read back into the same rows, over several blocks
+        const std::string columnPath = "xbus_test_export.xcol";
+        XbusColumnSink column(SensorField::PACKET_COUNTER | SensorField::LAT_LON | SensorField::UTC_TIME, 64);
+        assertTrue(column.open(columnPath) && column.write(batch) && column.write(batch) && column.close(),
+                   "Column file written");
+        const size_t rowSize = 4 + 2 + 16 + 1 + 12;
+        assertTrue(XbusColumnFormat::rowSize(column.fields()) == rowSize &&
+                   column.bytesWritten() == XbusColumnFormat::FILE_HEADER_SIZE + 2 * (4 + 2 * rowSize),
+                   "Column file is fixed width");
+        
+        SensorDataColumns read;
+        XbusColumnReader reader;
+        assertTrue(reader.read(columnPath, read) && !reader.truncated() && read.size() == 4, "Column file read");
+        bool same = read.packetCounter[2] == 7 && read.packetCounter[3] == 8 && read.has(3, SensorField::LAT_LON) &&
+                    read.latitude[3] == 52.1234567891 && read.longitude[3] == -4.5 && read.latLonFormat[3] == XdiFormat::FP1632 &&
+                    read.utcTime[0].nanoseconds == 1500 &&
+                    read.utcTime[0].year == 2024 && read.utcTime[0].flags == UtcFlags::VALID_UTC &&
+                    read.has(0, SensorField::EULER_ANGLES) && read.roll[0] == 0.0f;
+        assertTrue(same, "Column values round trip, unexported columns stay default");
+        
+        // A corrupt row count in the second block reads as truncation
+        std::FILE* corrupt = std::fopen(columnPath.c_str(), "r+b");
+        const uint8_t hugeCount[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+        bool corrupted = corrupt && std::fseek(corrupt, XbusColumnFormat::FILE_HEADER_SIZE + 4 + 2 * rowSize, SEEK_SET) == 0 &&
+                         std::fwrite(hugeCount, 1, sizeof(hugeCount), corrupt) == sizeof(hugeCount);
+        if (corrupt) {
+            std::fclose(corrupt);
+        }
+        read.clear();
+        assertTrue(corrupted && reader.read(columnPath, read) && reader.truncated() && read.size() == 2 &&
+                   read.packetCounter[1] == 8, "Column file with a corrupt row count keeps the blocks before it");
+        std::remove(columnPath.c_str());
+        
+        // Background writing: rows written in order across many hand-offs
+        const std::string asyncPath = "xbus_test_export_async.xcol";
+        XbusColumnSink target(SensorField::PACKET_COUNTER);
+        assertTrue(target.open(asyncPath), "Async target opened");
+        XbusAsyncSink async(target, 64);
+        assertTrue(async.start(), "Async sink started");
+        bool added = true;
+        for (int i = 0; i < 10000; i++) {
+            SensorData sample;
+            sample.hasPacketCounter = true;
+            sample.packetCounter = static_cast<uint16_t>(i);
+            added = async.add(sample) && added;
+        }
+        assertTrue(added && async.close(), "Async sink closed");
+        XbusAsyncSink::Stats stats = async.stats();
+        assertTrue(stats.rows == 10000 && stats.batches == 157 && target.rowsWritten() == 10000, "Async sink counts");
+        
+        read.clear();
+        bool ordered = reader.read(asyncPath, read) && read.size() == 10000;
+        for (size_t i = 0; ordered && i < read.size(); i++) {
+            ordered = read.packetCounter[i] == static_cast<uint16_t>(i);
+        }
+        assertTrue(ordered, "Async rows written in order");
+        std::remove(asyncPath.c_str());
+        
+        // Failures of the target reach the producer
+        XbusCsvSink closed;
+        XbusAsyncSink failing(closed, 1);
+        failing.start();
+        failing.add(first);
+        bool failed = false;
+        for (int i = 0; i < 3 && !failed; i++) {
+            failed = !failing.add(first);
+        }
+        assertTrue(failed && !failing.close() && failing.getLastError() == "Sink is not open", "Async sink reports errors");
+    }
+    
+    void testExtendedLengthFrames() {
+        std::cout << std::endl << "--- Testing Extended Length Frames ---" << std::endl;
+        
+        assertTrue(XbusMessageBuilder::messageSize(Xbus::MAX_PAYLOAD_LENGTH) == Xbus::MAX_MESSAGE_SIZE,
+                   "Largest message size");
+        assertTrue(XbusFramer(XbusFramer::MAX_CAPACITY).capacity() >= Xbus::MAX_MESSAGE_SIZE,
+                   "Framer at MAX_CAPACITY holds the largest frame");
+        
+        // One Euler item followed by packet counters up to the requested length
+        // (counter i is i), as one big packet with many data items
+        auto buildPacket = [](uint16_t payloadLength) {
+            std::vector<uint8_t> frame(XbusMessageBuilder::messageSize(payloadLength));
+            XbusMessageBuilder builder(frame.data(), frame.size());
+            builder.begin(XMID_MtData2, payloadLength);
+            builder.putU16(XDI::EULER_ANGLES).putU8(12).putFloat(45.0f).putFloat(30.0f).putFloat(90.0f);
+            for (uint16_t i = 0; i < (payloadLength - 15) / 5; i++) {
+                builder.putU16(XDI::PACKET_COUNTER).putU8(2).putU16(i);
+            }
+            frame.resize(builder.finish());
+            return frame;
+        };
+        std::vector<uint8_t> medium = buildPacket(2000);
+        std::vector<uint8_t> largest = buildPacket(Xbus::MAX_PAYLOAD_LENGTH);
+        assertTrue(medium.size() == 2007 && medium[Xbus::OFFSET_TO_LEN] == Xbus::LENGTH_EXTENDER_BYTE,
+                   "2000 byte payload uses the extended length");
+        assertTrue(largest.size() == Xbus::MAX_MESSAGE_SIZE && Xbus::verifyChecksum(largest.data()),
+                   "65535 byte payload built with a valid checksum");
+        
+        // Both frames after some garbage, fed in serial-sized chunks
+        std::vector<uint8_t> stream = {0x00, Xbus::XBUS_PREAMBLE, 0x42};
+        stream.insert(stream.end(), medium.begin(), medium.end());
+        stream.insert(stream.end(), largest.begin(), largest.end());
+        XbusFramer framer(XbusFramer::MAX_CAPACITY);
+        std::vector<std::vector<uint8_t>> frames;
+        for (size_t offset = 0; offset < stream.size(); offset += 1024) {
+            framer.feed(stream.data() + offset, std::min<size_t>(1024, stream.size() - offset),
+                        [&frames](const XbusFrame& frame) {
+                frames.emplace_back(frame.begin(), frame.end());
+            });
+        }
+        assertTrue(frames.size() == 2 && frames[0] == medium && frames[1] == largest, "Extended frames framed");
+        assertUint32Equals(0, static_cast<uint32_t>(framer.stats().lengthErrors), "No length errors");
+        
+        SensorData data;
+        assertTrue(frames.size() == 2 && XbusParser::parseMTData2(frames[1].data(), data), "Largest frame parsed");
+        assertFloatEquals(90.0f, data.eulerAngles.yaw, 0.001f, "Euler yaw from the largest frame");
+        assertUint16Equals((Xbus::MAX_PAYLOAD_LENGTH - 15) / 5 - 1, data.packetCounter,
+                           "Last item at the end of the largest frame");
+        
+        // A smaller framer rejects what does not fit and keeps the rest
+        XbusFramer small(1024);
+        std::vector<uint8_t> ack = createXbusMessage(XMID_GotoConfigAck, {});
+        std::vector<uint8_t> mixed(medium);
+        mixed.insert(mixed.end(), ack.begin(), ack.end());
+        size_t smallFrames = small.feed(mixed.data(), mixed.size(), [](const XbusFrame&) {});
+        assertTrue(smallFrames == 1 && small.stats().lengthErrors == 1, "Frame larger than the capacity rejected");
+        
+        // Records of both sizes, through the buffer and past it, replay unchanged
+        const std::string path = "xbus_test_extended.bin";
+        XbusRecorder recorder(4096);
+        assertTrue(recorder.open(path) && recorder.record(medium.data(), medium.size(), 1) &&
+                   recorder.record(largest.data(), largest.size(), 2), "Extended frames recorded");
+        recorder.close();
+        
+        XbusReplay replay;
+        assertTrue(replay.open(path) && replay.recordCount() == 2, "Extended frames indexed");
+        XbusReplay::Record record = replay.record(1);
+        assertTrue(record.frame.size == largest.size() &&
+                   memcmp(record.frame.data, largest.data(), largest.size()) == 0, "Largest frame replayed");
+        XbusFramer replayFramer(XbusFramer::MAX_CAPACITY);
+        size_t replayed = replay.feed(replayFramer, [](const XbusFrame&) {});
+        assertTrue(replayed == 2, "Replay of extended frames through a framer");
+        replay.close();
+        std::remove(path.c_str());
+    }
+    
+    void testCommandEngine() {
+        std::cout << std::endl << "--- Testing Command Engine ---" << std::endl;
+        
+        std::mutex sentMutex;
+        std::vector<std::pair<size_t, uint8_t>> sent;
+        bool failSends = false;
+        XbusCommandEngine engine(2, [&](size_t device, const uint8_t* frame, size_t) {
+            std::lock_guard<std::mutex> lock(sentMutex);
+            sent.emplace_back(device, frame[Xbus::OFFSET_TO_MID]);
+            return !failSends;
+        });
+        assertTrue(!engine.submit(0, XbusCommand::GOTO_CONFIG, nullptr), "Commands rejected before start");
+        assertTrue(engine.start(), "Command engine started");
+        
+        // Commands to one device go out one at a time
+        std::future<XbusCommandEngine::Reply> config = engine.request(0, XbusCommand::GOTO_CONFIG);
+        std::future<XbusCommandEngine::Reply> deviceId = engine.request(0, XbusCommand::REQ_DID);
+        assertTrue(sent.size() == 1 && sent[0].second == XMID_GotoConfig, "Only the first command in flight");
+        assertUint32Equals(2, static_cast<uint32_t>(engine.pending(0)), "Second command queued");
+        
+        std::vector<uint8_t> data = createMTData2Message({0x10, 0x20, 0x02, 0x00, 0x01});
+        assertTrue(!engine.handleFrame(0, XbusFrame(data.data(), data.size())), "Data frame is no reply");
+        std::vector<uint8_t> ack = createXbusMessage(XMID_GotoConfigAck, {});
+        assertTrue(!engine.handleFrame(1, XbusFrame(ack.data(), ack.size())), "Reply from another device ignored");
+        assertTrue(engine.handleFrame(0, XbusFrame(ack.data(), ack.size())), "Acknowledgement matched");
+        XbusCommandEngine::Reply reply = config.get();
+        assertTrue(reply.status == XbusCommandEngine::Status::Ok && reply.commandId == XMID_GotoConfig &&
+                   reply.frame == ack, "GotoConfig completed with its acknowledgement");
+        assertTrue(sent.size() == 2 && sent[1].second == XMID_ReqDid, "Next command sent after the reply");
+        
+        std::vector<uint8_t> id = createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x00, 0x01});
+        engine.handleFrame(0, XbusFrame(id.data(), id.size()));
+        reply = deviceId.get();
+        assertTrue(reply.status == XbusCommandEngine::Status::Ok &&
+                   XbusParser::parseDeviceId(reply.frame.data()) == 0x03800001, "Device ID reply");
+        
+        // Error replies, timeouts and failed sends
+        std::future<XbusCommandEngine::Reply> failing = engine.request(1, XbusCommand::GOTO_MEASUREMENT);
+        std::vector<uint8_t> error = createXbusMessage(XMID_Error, {0x04});
+        engine.handleFrame(1, XbusFrame(error.data(), error.size()));
+        reply = failing.get();
+        assertTrue(reply.status == XbusCommandEngine::Status::DeviceError && reply.errorCode == 0x04,
+                   "Device error reported");
+        
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::future<XbusCommandEngine::Reply> unanswered = engine.request(1, XbusCommand::REQ_DID, 20);
+        std::future<XbusCommandEngine::Reply> afterTimeout = engine.request(1, XbusCommand::RESET, 20);
+        reply = unanswered.get();
+        assertTrue(reply.status == XbusCommandEngine::Status::Timeout &&
+                   std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20), "Request timed out");
+        assertTrue(afterTimeout.get().status == XbusCommandEngine::Status::Timeout, "Queue continues after a timeout");
+        
+        {
+            std::lock_guard<std::mutex> lock(sentMutex);
+            failSends = true;
+        }
+        assertTrue(engine.request(1, XbusCommand::REQ_DID).get().status == XbusCommandEngine::Status::SendFailed,
+                   "Failed send reported");
+        {
+            std::lock_guard<std::mutex> lock(sentMutex);
+            failSends = false;
+        }
+        
+        std::future<XbusCommandEngine::Reply> cancelled = engine.request(0, XbusCommand::REQ_DID);
+        engine.stop();
+        assertTrue(cancelled.get().status == XbusCommandEngine::Status::Cancelled, "Stop cancels pending commands");
+        assertUint32Equals(1, static_cast<uint32_t>(engine.stats().deviceErrors), "Device error counted");
+        assertUint32Equals(2, static_cast<uint32_t>(engine.stats().timeouts), "Timeouts counted");
+        
+        // Many devices answering from another thread, one command in flight each
+        const size_t devices = 16;
+        std::mutex wireMutex;
+        std::condition_variable wireCondition;
+        std::vector<std::pair<size_t, uint8_t>> wire;
+        size_t maxInFlight = 0;
+        XbusCommandEngine many(devices, [&](size_t device, const uint8_t* frame, size_t) {
+            std::lock_guard<std::mutex> lock(wireMutex);
+            wire.emplace_back(device, frame[Xbus::OFFSET_TO_MID]);
+            maxInFlight = std::max(maxInFlight, wire.size());
+            wireCondition.notify_one();
+            return true;
+        });
+        many.start();
+        
+        std::vector<std::future<XbusCommandEngine::Reply>> replies;
+        for (size_t device = 0; device < devices; device++) {
+            replies.push_back(many.request(device, XbusCommand::GOTO_CONFIG));
+            replies.push_back(many.request(device, XbusCommand::REQ_DID));
+            replies.push_back(many.request(device, XbusCommand::GOTO_MEASUREMENT));
+        }
+        
+        std::thread responder([&] {
+            for (size_t answered = 0; answered < 3 * devices; answered++) {
+                std::unique_lock<std::mutex> lock(wireMutex);
+                wireCondition.wait(lock, [&wire] { return !wire.empty(); });
+                std::pair<size_t, uint8_t> command = wire.front();
+                wire.erase(wire.begin());
+                lock.unlock();
+                
+                std::vector<uint8_t> answer = createXbusMessage(XbusCommandEngine::replyId(command.second), {});
+                many.handleFrame(command.first, XbusFrame(answer.data(), answer.size()));
+            }
+        });
+        
+        bool allOk = true;
+        for (size_t i = 0; i < replies.size(); i++) {
+            allOk = replies[i].get().status == XbusCommandEngine::Status::Ok && allOk;
+        }
+        responder.join();
+        assertTrue(allOk, "All commands of 16 devices acknowledged");
+        assertTrue(maxInFlight == devices, "One command in flight per device, all devices at once");
+        assertUint32Equals(48, static_cast<uint32_t>(many.stats().replies), "Replies counted");
+        many.stop();
+    }
+    
+    void testOutputConfig() {
+        std::cout << std::endl << "--- Testing Output Configuration ---" << std::endl;
+        
+        XbusOutputConfig config;
+        config.add(XDI::PACKET_COUNTER).add(XDI::SAMPLE_TIME_FINE).add(XDI::EULER_ANGLES, 100).add(XDI::QUATERNION, 100);
+        uint8_t message[XbusOutputConfig::MAX_MESSAGE_SIZE];
+        size_t size = config.build(message, sizeof(message));
+        std::vector<uint8_t> expected = createXbusMessage(XMID_SetOutputConfig, {0x10, 0x20, 0xFF, 0xFF,
+                                                                                0x10, 0x60, 0xFF, 0xFF,
+                                                                                0x20, 0x30, 0x00, 0x64,
+                                                                                0x20, 0x10, 0x00, 0x64});
+        assertTrue(size == expected.size() && size == config.messageSize() &&
+                   memcmp(message, expected.data(), size) == 0, "SetOutputConfig built");
+        assertTrue(config.build(message, size - 1) == 0, "SetOutputConfig into a short buffer fails");
+        assertUint32Equals(SensorField::PACKET_COUNTER | SensorField::SAMPLE_TIME_FINE | SensorField::EULER_ANGLES |
+                           SensorField::QUATERNION, config.fields(), "Configured fields");
+        assertTrue(config.hasFixedLayout() && config.packetRate() == 100, "Common output rate");
+        assertUint32Equals(5 + 7 + 15 + 19, static_cast<uint32_t>(config.packetPayloadLength()), "Packet payload length");
+        
+        // The device echoes the applied configuration
+        std::vector<uint8_t> reply(expected);
+        reply[Xbus::OFFSET_TO_MID] = XMID_OutputConfig;
+        Xbus::insertChecksum(reply.data());
+        XbusOutputConfig applied;
+        assertTrue(applied.parse(reply.data()) && applied.size() == 4 && applied.outputs()[2].xdi == XDI::EULER_ANGLES &&
+                   applied.outputs()[2].frequency == 100, "OutputConfig parsed");
+        assertTrue(!applied.parse(expected.data()) && applied.empty(), "Other messages are no OutputConfig");
+        assertTrue(XbusParser::messageToString(reply.data()) ==
+                   "XMID_OutputConfig: PacketCounter (0x1020) SampleTimeFine (0x1060) EulerAngles (0x2030) @ 100 Hz"
+                   " Quaternion (0x2010) @ 100 Hz", "OutputConfig text");
+        
+        // An extended-length configuration needs more than TEXT_BUFFER_SIZE:
+        // a caller buffer is cut off, the string overload grows
+        std::vector<uint8_t> pairs;
+        for (int i = 0; i < 300; i++) {
+            pairs.insert(pairs.end(), {0x20, 0x30, 0x00, 0x64});
+        }
+        std::vector<uint8_t> longConfig = createXbusMessage(XMID_OutputConfig, pairs);
+        char text[XbusParser::TEXT_BUFFER_SIZE];
+        XbusTextWriter out(text);
+        XbusParser::messageToString(longConfig.data(), out);
+        std::string longText = XbusParser::messageToString(longConfig.data(), longConfig.size());
+        assertTrue(out.truncated() && longText.size() > sizeof(text) &&
+                   longText.compare(longText.size() - 30, 30, " EulerAngles (0x2030) @ 100 Hz") == 0 &&
+                   longText.compare(0, out.size(), out.data()) == 0, "Long OutputConfig text not truncated");
+        
+        XbusOutputConfig mixedRates;
+        mixedRates.add(XDI::EULER_ANGLES, 100).add(XDI::LAT_LON, 4);
+        assertTrue(!mixedRates.hasFixedLayout(), "Different rates have no fixed layout");
+        
+        // A decoder configured from the reply takes the locked path from the
+        // first packet on, decoding only the selected fields
+        std::vector<uint8_t> packet = createMTData2Message({0x10, 0x20, 0x02, 0x00, 0x07,
+                                                            0x10, 0x60, 0x04, 0x00, 0x00, 0x30, 0x39,
+                                                            0x20, 0x30, 0x0C,
+                                                            0x42, 0x34, 0x00, 0x00,
+                                                            0x41, 0xF0, 0x00, 0x00,
+                                                            0x42, 0xB4, 0x00, 0x00,
+                                                            0x20, 0x10, 0x10,
+                                                            0x3F, 0x80, 0x00, 0x00,
+                                                            0x00, 0x00, 0x00, 0x00,
+                                                            0x00, 0x00, 0x00, 0x00,
+                                                            0x00, 0x00, 0x00, 0x00});
+        XbusLayoutDecoder decoder;
+        decoder.setFields(SensorField::PACKET_COUNTER | SensorField::EULER_ANGLES);
+        assertTrue(decoder.learnFromOutputConfig(reply.data()) && decoder.isLocked(), "Decoder configured");
+        SensorData data;
+        assertTrue(decoder.decode(packet.data(), data), "First packet decoded");
+        assertUint32Equals(1, static_cast<uint32_t>(decoder.stats().lockedDecodes), "First packet on the locked path");
+        assertTrue(data.hasPacketCounter && data.packetCounter == 7 && data.hasEulerAngles &&
+                   !data.hasSampleTimeFine && !data.hasQuaternion, "Only selected fields decoded");
+        
+        decoder.setFields(SensorDataXdi::All::allFields());
+        assertTrue(decoder.decode(packet.data(), data) && data.hasQuaternion && data.sampleTimeFine == 12345,
+                   "All fields after widening the selection");
+        
+        // The generic path honours the selection as well
+        XbusLayoutDecoder generic;
+        generic.setFields(SensorField::QUATERNION);
+        assertTrue(generic.decode(packet.data(), data) && data.hasQuaternion && !data.hasEulerAngles,
+                   "Selection on the generic path");
+        assertTrue(!decoder.configure(mixedRates), "Mixed rates are not configured");
+    }
+    
+    void testBoundsCheckedParsing() {
+        std::cout << std::endl << "--- Testing Bounds-Checked Parsing ---" << std::endl;
+        
+        std::vector<uint8_t> message = createMTData2Message({0x10, 0x20, 0x02, 0x00, 0x2A,
+                                                             0x10, 0x60, 0x04, 0x00, 0x00, 0x30, 0x39});
+        assertTrue(Xbus::isComplete(message.data(), message.size()), "Complete message");
+        assertTrue(!Xbus::isComplete(message.data(), message.size() - 1), "Message without checksum is incomplete");
+        assertTrue(!Xbus::isComplete(message.data(), 3), "Header cut off");
+        assertTrue(!Xbus::isComplete(nullptr, 100), "No message");
+        
+        SensorData sensorData;
+        assertTrue(XbusParser::parseMTData2(message.data(), message.size(), sensorData) &&
+                   sensorData.packetCounter == 42 && sensorData.sampleTimeFine == 12345, "Complete MTData2 parsed");
+        SensorData truncated;
+        assertTrue(!XbusParser::parseMTData2(message.data(), message.size() - 4, truncated) &&
+                   !truncated.hasPacketCounter, "Truncated MTData2 rejected");
+        assertUint32Equals(0, XbusParser::parseMTData2Fields(message.data(), 8, SensorField::PACKET_COUNTER, truncated),
+                           "Truncated MTData2 decodes no fields");
+        assertTrue(XbusParser::messageToString(message.data(), 10) == "Invalid xbus message", "Truncated message text");
+        
+        // Extended length whose two length bytes are missing
+        uint8_t extendedHeader[] = {0xFA, 0xFF, XMID_MtData2, 0xFF, 0x01};
+        assertTrue(!Xbus::isComplete(extendedHeader, sizeof(extendedHeader)), "Extended header cut off");
+        
+        // Replies too short for their fixed layout
+        std::vector<uint8_t> shortDeviceId = createXbusMessage(XMID_DeviceId, {0x03, 0x80});
+        assertUint32Equals(0, XbusParser::parseDeviceId(shortDeviceId.data()), "Short DeviceId rejected");
+        assertTrue(XbusParser::messageToString(shortDeviceId.data(), shortDeviceId.size()) ==
+                   "XMID_DeviceId: Invalid length", "Short DeviceId text");
+        std::vector<uint8_t> shortRevision = createXbusMessage(XMID_FirmwareRevision, {0x01});
+        assertTrue(XbusParser::parseFirmwareRevision(shortRevision.data()).empty(), "Short firmware revision rejected");
+        assertTrue(XbusParser::messageToString(shortRevision.data(), shortRevision.size()) ==
+                   "Firmware revision: Invalid length", "Short firmware revision text");
+        
+        XbusLayoutDecoder decoder;
+        SensorData decoded;
+        assertTrue(decoder.decode(message.data(), message.size(), decoded) && decoded.packetCounter == 42,
+                   "Layout decoder with size");
+        assertTrue(!decoder.decode(message.data(), message.size() - 1, decoded), "Layout decoder rejects truncated");
+        
+        std::vector<uint8_t> config = createXbusMessage(XMID_OutputConfig, {0x10, 0x20, 0xFF, 0xFF});
+        XbusOutputConfig outputConfig;
+        assertTrue(outputConfig.parse(config.data(), config.size()) && outputConfig.size() == 1, "OutputConfig with size");
+        assertTrue(!outputConfig.parse(config.data(), config.size() - 2) && outputConfig.empty(),
+                   "Truncated OutputConfig rejected");
+    }
+    
+    void testInertialData() {
+        std::cout << std::endl << "--- Testing Inertial Data ---" << std::endl;
+        
+        // PacketCounter, SampleTimeFine, Acceleration, RateOfTurn, MagneticField
+        std::vector<uint8_t> payload = {0x10, 0x20, 0x02, 0x00, 0x05,
+                                        0x10, 0x60, 0x04, 0x00, 0x00, 0x30, 0x39,
+                                        0x40, 0x20, 0x0C, 0x3F, 0x80, 0x00, 0x00, 0xBF, 0x00, 0x00, 0x00,
+                                        0x41, 0x1C, 0xF5, 0xC3,
+                                        0x80, 0x20, 0x0C, 0x3E, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                        0x40, 0x00, 0x00, 0x00,
+                                        0xC0, 0x20, 0x0C, 0x3F, 0x00, 0x00, 0x00, 0x40, 0x40, 0x00, 0x00,
+                                        0xBF, 0x80, 0x00, 0x00};
+        std::vector<uint8_t> message = createMTData2Message(payload);
+        
+        SensorData sensorData;
+        assertTrue(XbusParser::parseMTData2(message.data(), sensorData) && sensorData.hasAcceleration &&
+                   sensorData.hasRateOfTurn && sensorData.hasMagneticField, "Inertial outputs decoded");
+        assertFloatEquals(1.0f, sensorData.acceleration.x, 1e-6f, "Acceleration X");
+        assertFloatEquals(-0.5f, sensorData.acceleration.y, 1e-6f, "Acceleration Y");
+        assertFloatEquals(9.81f, sensorData.acceleration.z, 1e-5f, "Acceleration Z");
+        assertFloatEquals(2.0f, sensorData.rateOfTurn.z, 1e-6f, "Rate of turn Z");
+        assertFloatEquals(-1.0f, sensorData.magneticField.z, 1e-6f, "Magnetic field Z");
+        assertTrue(alignof(Vector3) == 16, "Vector3 is 16 byte aligned");
+        assertTrue(XbusParser::formatSensorData(sensorData).find("Acc(1.0000, -0.5000, 9.8100)m/s²") != std::string::npos,
+                   "Acceleration text");
+        
+        // Fixed12.20 acceleration
+        std::vector<uint8_t> fixed = createMTData2Message({0x40, 0x21, 0x0C, 0x00, 0x18, 0x00, 0x00,
+                                                           0xFF, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00});
+        SensorData fixedData;
+        assertTrue(XbusParser::parseMTData2(fixed.data(), fixedData) && fixedData.hasAcceleration, "Fixed12.20 acceleration");
+        assertFloatEquals(1.5f, fixedData.acceleration.x, 1e-6f, "Fixed12.20 acceleration X");
+        assertFloatEquals(-1.0f, fixedData.acceleration.y, 1e-6f, "Fixed12.20 acceleration Y");
+        
+        // Columns
+        const uint8_t* frames[] = {message.data()};
+        SensorDataColumns columns;
+        assertTrue(XbusParser::parseMTData2Batch(frames, 1, columns) == 1 &&
+                   columns.has(0, SensorField::ACCELERATION | SensorField::RATE_OF_TURN | SensorField::MAGNETIC_FIELD) &&
+                   columns.accZ[0] == sensorData.acceleration.z && columns.gyrX[0] == 0.25f && columns.magY[0] == 3.0f,
+                   "Inertial columns");
+        columns.append(sensorData);
+        assertTrue(columns.size() == 2 && columns.presence[1] == columns.presence[0] && columns.magZ[1] == -1.0f,
+                   "Inertial sample appended as row");
+        
+        // High-rate path straight into a ring
+        ImuSample sample;
+        assertUint32Equals(XbusImu::FIELDS, XbusImu::decode(message.data(), message.size(), sample), "IMU sample decoded");
+        assertTrue(sample.packetCounter == 5 && sample.sampleTimeFine == 12345 && sample.rateOfTurn.x == 0.25f,
+                   "IMU sample values");
+        assertUint32Equals(0, XbusImu::decode(message.data(), message.size() - 1, sample), "Truncated IMU sample rejected");
+        
+        ImuSampleRing ring(2);
+        std::vector<uint8_t> orientation = createMTData2Message({0x20, 0x30, 0x0C, 0x3F, 0x80, 0x00, 0x00,
+                                                                 0x3F, 0x80, 0x00, 0x00, 0x3F, 0x80, 0x00, 0x00});
+        assertTrue(!XbusImu::push(orientation.data(), orientation.size(), ring) && ring.empty(),
+                   "Packets without inertial data are not queued");
+        assertTrue(XbusImu::push(message.data(), message.size(), ring) && XbusImu::push(fixed.data(), fixed.size(), ring),
+                   "IMU samples pushed");
+        assertTrue(!XbusImu::push(message.data(), message.size(), ring) && ring.stats().dropped == 1, "Full ring drops");
+        ImuSample popped;
+        assertTrue(ring.tryPop(popped) && popped.hasMagneticField && popped.acceleration.z == sensorData.acceleration.z,
+                   "First IMU sample popped");
+        assertTrue(ring.tryPop(popped) && popped.hasAcceleration && !popped.hasPacketCounter && !popped.hasMagneticField,
+                   "Slot fields reset for the next sample");
+    }
+    
+    void testObjectPool() {
+        std::cout << std::endl << "--- Testing Object Pool ---" << std::endl;
+        
+        SensorDataPool pool(2);
+        SensorDataPool::Handle first = pool.acquire();
+        assertTrue(first && first.useCount() == 1 && pool.stats().inUse == 1, "Object acquired");
+        first->packetCounter = 7;
+        {
+            SensorDataPool::Handle shared = first;
+            SensorDataPool::Handle moved = std::move(shared);
+            assertTrue(!shared && moved.get() == first.get() && first.useCount() == 2, "Handles share one object");
+        }
+        assertUint32Equals(1, first.useCount(), "Copy released");
+        
+        SensorData value;
+        value.packetCounter = 9;
+        SensorDataPool::Handle second = pool.acquire(value);
+        SensorDataPool::Handle third = pool.acquire();
+        assertTrue(second && second->packetCounter == 9 && !third && pool.stats().exhausted == 1, "Pool exhausted");
+        first.reset();
+        third = pool.acquire();
+        assertTrue(third && third->packetCounter == 7 && pool.stats().highWater == 2, "Released object reused");
+        
+        XbusFramePool frames(1);
+        std::vector<uint8_t> big(XbusFrameSlot::CAPACITY + 1);
+        XbusFramePool::Handle frame = frames.acquire();
+        assertTrue(!frame->assign(XbusFrame(big.data(), big.size())) && frame->size == 0, "Oversized frame rejected");
+        
+        // Steady state: frames and samples from the pools fanned out to
+        // three consumers allocate nothing once the queues and pools exist
+        std::vector<uint8_t> stream;
+        for (int i = 0; i < 8; i++) {
+            std::vector<uint8_t> message = createMTData2Message({0x10, 0x20, 0x02, 0x00, static_cast<uint8_t>(i),
+                                                                 0x20, 0x30, 0x0C, 0x3F, 0x80, 0x00, 0x00,
+                                                                 0x3F, 0x80, 0x00, 0x00, 0x3F, 0x80, 0x00, 0x00});
+            stream.insert(stream.end(), message.begin(), message.end());
+        }
+        XbusFramer framer(1024);
+        XbusFramePool framePool(16);
+        SensorDataPool samplePool(16);
+        SpscQueue<SensorDataPool::Handle> consumers[3] = {SpscQueue<SensorDataPool::Handle>(8),
+                                                           SpscQueue<SensorDataPool::Handle>(8),
+                                                           SpscQueue<SensorDataPool::Handle>(8)};
+        char text[XbusParser::TEXT_BUFFER_SIZE];
+        size_t delivered = 0;
+        size_t allocations = 0;
+        for (int round = 0; round < 100; round++) {
+            size_t before = g_heapAllocations.load();
+            framer.feed(stream.data(), stream.size(), [&](const XbusFrame& received) {
+                XbusFramePool::Handle raw = framePool.acquire();
+                SensorDataPool::Handle sample = samplePool.acquire();
+                if (!raw || !raw->assign(received) || !sample || !XbusParser::parseMTData2(raw->data, *sample)) {
+                    return;
+                }
+                for (SpscQueue<SensorDataPool::Handle>& consumer : consumers) {
+                    consumer.tryPush(sample);
+                }
+                XbusTextWriter out(text);
+                XbusParser::messageToString(raw->data, raw->size, out);
+            });
+            for (SpscQueue<SensorDataPool::Handle>& consumer : consumers) {
+                SensorDataPool::Handle sample;
+                while (consumer.tryPop(sample)) {
+                    XbusTextWriter out(text);
+                    XbusParser::formatSensorData(*sample, out);
+                    delivered++;
+                }
+            }
+            if (round > 0) {
+                allocations += g_heapAllocations.load() - before;
+            }
+        }
+        assertTrue(delivered == 100 * 8 * 3, "Every sample reached every consumer");
+        assertTrue(allocations == 0, "No heap allocation in the steady state");
+        assertTrue(samplePool.stats().inUse == 0 && framePool.stats().inUse == 0, "Every object returned");
+        
+        // Acquired on one thread, released on another
+        SensorDataPool crossPool(4);
+        SpscQueue<SensorDataPool::Handle> handOff(4);
+        std::thread producer([&crossPool, &handOff] {
+            for (int i = 0; i < 20000; i++) {
+                SensorDataPool::Handle sample;
+                while (!(sample = crossPool.acquire())) {
+                    std::this_thread::yield();
+                }
+                sample->packetCounter = static_cast<uint16_t>(i);
+                while (!handOff.tryPush(sample)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        bool ordered = true;
+        for (int i = 0; i < 20000; i++) {
+            SensorDataPool::Handle sample;
+            while (!handOff.tryPop(sample)) {
+                std::this_thread::yield();
+            }
+            ordered = ordered && sample->packetCounter == static_cast<uint16_t>(i);
+        }
+        producer.join();
+        assertTrue(ordered && crossPool.stats().inUse == 0 && crossPool.stats().acquired == 20000,
+                   "Handles released across threads");
+    }
+    
+    void testDispatcher() {
+        std::cout << std::endl << "--- Testing Dispatcher ---" << std::endl;
+        
+        XbusDispatcher::Config config;
+        config.poolSize = 64;
+        config.queueCapacity = 512;
+        XbusDispatcher dispatcher(config);
+        XbusDispatcher::Callback ignore = [](const XbusDispatcher::Message&) {};
+        assertTrue(!dispatcher.subscribeXdi(0x0810, ignore), "Undecoded XDI rejected");
+        assertTrue(!dispatcher.subscribeFields(0, ignore), "Empty field mask rejected");
+        
+        // Inline subscribers see the dispatching thread's sample
+        size_t deviceIds = 0;
+        size_t eulerPackets = 0;
+        size_t quaternionPackets = 0;
+        float lastRoll = 0.0f;
+        const SensorData* inlineSample = nullptr;
+        dispatcher.subscribe(XMID_DeviceId, [&](const XbusDispatcher::Message& message) {
+            deviceIds += message.sample == nullptr && message.frame.size == 9;
+        });
+        dispatcher.subscribeXdi(XDI::EULER_ANGLES, [&](const XbusDispatcher::Message& message) {
+            eulerPackets++;
+            lastRoll = message.sample->eulerAngles.roll;
+            inlineSample = message.sample;
+        });
+        dispatcher.subscribeXdi(XDI::QUATERNION, [&](const XbusDispatcher::Message&) {
+            quaternionPackets++;
+        });
+        
+        // Worker subscribers get references to one pooled frame and sample
+        std::atomic<size_t> allFrames(0);
+        std::atomic<size_t> largeFrames(0);
+        std::atomic<uint64_t> counterSum(0);
+        std::atomic<size_t> counterPackets(0);
+        std::atomic<size_t> wrongFields(0);
+        size_t sameSample = 0;
+        std::vector<const SensorData*> seen(2000, nullptr);
+        std::vector<const SensorData*> seenByCounter(2000, nullptr);
+        dispatcher.subscribeAll([&](const XbusDispatcher::Message& message) {
+            allFrames++;
+            largeFrames += message.frame.size > XbusFrameSlot::CAPACITY;
+            if (message.sample != nullptr && message.sample->hasPacketCounter) {
+                seen[message.sample->packetCounter] = message.sample;
+            }
+        }, XbusDispatcher::Delivery::Worker);
+        dispatcher.subscribeFields(SensorField::PACKET_COUNTER, [&](const XbusDispatcher::Message& message) {
+            wrongFields += message.messageId != XMID_MtData2 || (message.fields & SensorField::PACKET_COUNTER) == 0;
+            counterPackets++;
+            counterSum += message.sample->packetCounter;
+            seenByCounter[message.sample->packetCounter] = message.sample;
+        }, XbusDispatcher::Delivery::Worker);
+        
+        std::vector<uint8_t> deviceId = createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x00, 0x01});
+        std::vector<uint8_t> eulerPayload = {0x20, 0x30, 0x0C, 0x3F, 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        for (int i = 0; i < 41; i++) {
+            eulerPayload.insert(eulerPayload.end(), {0x08, 0x10, 0x04, 0x01, 0x02, 0x03, 0x04});
+        }
+        std::vector<uint8_t> extended = createXbusMessage(XMID_MtData2, eulerPayload);
+        assertTrue(extended.size() > XbusFrameSlot::CAPACITY, "Extended test frame");
+        
+        dispatcher.dispatch(0, XbusFrame(deviceId.data(), deviceId.size()));
+        assertUint32Equals(0, static_cast<uint32_t>(dispatcher.stats().frames), "Ignored while stopped");
+        assertTrue(dispatcher.start() && !dispatcher.subscribeAll(ignore), "Subscriptions fixed once started");
+        
+        std::vector<std::vector<uint8_t>> packets;
+        uint64_t expectedSum = 0;
+        for (uint16_t counter = 1; counter <= 1000; counter++) {
+            packets.push_back(createMTData2Message({0x10, 0x20, 0x02, static_cast<uint8_t>(counter >> 8),
+                                                    static_cast<uint8_t>(counter),
+                                                    0x20, 0x30, 0x0C, 0x3F, 0x80, 0x00, 0x00,
+                                                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}));
+            expectedSum += counter;
+        }
+        
+        // The first packet sizes the decoder's layout
+        dispatcher.dispatch(0, XbusFrame(deviceId.data(), deviceId.size()));
+        dispatcher.dispatch(0, XbusFrame(extended.data(), extended.size()));
+        size_t before = g_heapAllocations.load();
+        for (const std::vector<uint8_t>& packet : packets) {
+            dispatcher.dispatch(0, XbusFrame(packet.data(), packet.size()), 42);
+            // Stay within the pool so nothing is dropped
+            while (dispatcher.stats().frames > 32 + std::min(allFrames.load(), counterPackets.load())) {
+                std::this_thread::yield();
+            }
+        }
+        size_t allocations = g_heapAllocations.load() - before;
+        dispatcher.stop();
+        
+        const XbusDispatcher::Stats& stats = dispatcher.stats();
+        assertUint32Equals(1002, static_cast<uint32_t>(stats.frames), "Frames dispatched");
+        assertUint32Equals(1001, static_cast<uint32_t>(stats.decoded), "Packets decoded once");
+        assertUint32Equals(0, static_cast<uint32_t>(stats.dropped), "No deliveries dropped");
+        assertUint32Equals(0, static_cast<uint32_t>(allocations), "No allocation per frame");
+        assertUint32Equals(1, static_cast<uint32_t>(deviceIds), "Message ID subscriber");
+        assertUint32Equals(1001, static_cast<uint32_t>(eulerPackets), "XDI subscriber");
+        assertUint32Equals(0, static_cast<uint32_t>(quaternionPackets), "Absent XDI not delivered");
+        assertFloatEquals(1.0f, lastRoll, 0.0f, "Inline subscriber sees the decoded sample");
+        assertUint32Equals(1002, static_cast<uint32_t>(allFrames), "Worker sees every frame");
+        assertUint32Equals(1, static_cast<uint32_t>(largeFrames), "Extended frame reaches worker");
+        assertTrue(counterSum == expectedSum && wrongFields == 0, "Field worker sees every packet");
+        for (size_t counter = 1; counter <= 1000; counter++) {
+            sameSample += seen[counter] != nullptr && seen[counter] == seenByCounter[counter];
+        }
+        assertUint32Equals(1000, static_cast<uint32_t>(sameSample), "Workers share one decoded sample");
+        assertTrue(inlineSample != nullptr, "Inline sample delivered");
+    }
+    
+    void testBridge() {
+        std::cout << std::endl << "--- Testing Bridge ---" << std::endl;
+        
+        std::vector<std::vector<uint8_t>> packets;
+        for (uint16_t counter = 0; counter < 6000; counter++) {
+            packets.push_back(createMTData2Message({0x10, 0x20, 0x02, static_cast<uint8_t>(counter >> 8),
+                                                    static_cast<uint8_t>(counter),
+                                                    0x20, 0x30, 0x0C, 0x3F, 0x80, 0x00, 0x00,
+                                                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}));
+        }
+        auto frameOf = [&](size_t i) { return XbusFrame(packets[i].data(), packets[i].size()); };
+        auto counterOf = [](const XbusFrame& frame) {
+            return static_cast<uint16_t>(frame.data[Xbus::OFFSET_TO_PAYLOAD + 3] << 8 |
+                                         frame.data[Xbus::OFFSET_TO_PAYLOAD + 4]);
+        };
+        
+        // Datagram format
+        XbusBridgeBatch batch(256);
+        std::vector<uint8_t> deviceId = createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x00, 0x01});
+        assertTrue(batch.add(1, frameOf(0), 1000) && batch.add(2, frameOf(1), 2000) &&
+                   batch.add(3, XbusFrame(deviceId.data(), deviceId.size()), 3000), "Frames batched");
+        assertTrue(!batch.add(0, XbusFrame(deviceId.data(), deviceId.size() - 1), 0), "Partial message rejected");
+        batch.finish(7);
+        std::vector<uint8_t> datagram(batch.data(), batch.data() + batch.size());
+        
+        std::vector<XbusBridgeRecord> records;
+        XbusBridgeBatch::Info info;
+        auto collect = [&](const XbusBridgeRecord& record) { records.push_back(record); };
+        assertTrue(XbusBridgeBatch::parse(datagram.data(), datagram.size(), collect, info) && info.sequence == 7 &&
+                   info.records == 3 && info.invalid == 0, "Batch parsed");
+        assertTrue(records.size() == 3 && records[1].device == 2 && records[1].receiveTimeNs == 2000 &&
+                   records[2].frame.size == deviceId.size() && counterOf(records[1].frame) == 1, "Records decoded");
+        
+        datagram[XbusBridgeBatch::HEADER_SIZE + XbusBridgeBatch::RECORD_HEADER_SIZE + 6] ^= 0x01;
+        records.clear();
+        XbusBridgeBatch::parse(datagram.data(), datagram.size(), collect, info);
+        assertTrue(info.records == 2 && info.invalid == 1 && records[0].device == 2, "Corrupted record skipped");
+        XbusBridgeBatch::parse(datagram.data(), datagram.size() - 3, collect, info);
+        assertTrue(info.records == 1 && info.invalid == 2, "Truncated batch stops at the cut");
+        datagram[0] = 0;
+        assertTrue(!XbusBridgeBatch::parse(datagram.data(), datagram.size(), collect, info), "Foreign datagram rejected");
+        
+        // Shared memory: frames and decoded samples
+        std::string name = "test_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() % 1000000);
+        XbusShmPublisher shmPublisher;
+        XbusShmSubscriber shmSubscriber;
+        assertTrue(!shmSubscriber.open(name), "No ring before the publisher");
+        assertTrue(shmPublisher.open(name, 64 * 1024), "Ring created");
+        assertTrue(shmSubscriber.open(name), "Ring opened");
+        
+        SensorData sample;
+        sample.hasPacketCounter = true;
+        sample.packetCounter = 4242;
+        sample.hasEulerAngles = true;
+        sample.eulerAngles.roll = 1.5f;
+        for (size_t i = 0; i < 100; i++) {
+            shmPublisher.publishFrame(0, frameOf(i), i);
+            shmPublisher.publishSample(0, sample, i);
+        }
+        size_t frames = 0;
+        size_t samples = 0;
+        size_t ordered = 0;
+        shmSubscriber.poll([&](const XbusBridgeRecord& record) {
+            if (record.kind == XbusBridgeRecord::Kind::Frame) {
+                ordered += counterOf(record.frame) == frames && record.receiveTimeNs == frames;
+                frames++;
+            } else if (record.sample->packetCounter == 4242 && record.sample->eulerAngles.roll == 1.5f) {
+                samples++;
+            }
+        });
+        assertTrue(frames == 100 && ordered == 100 && samples == 100, "Ring delivers frames and samples in order");
+        
+        // A subscriber lapped by the publisher resumes with the oldest
+        // records left: 6000 frames of 6 words each through an 8192 word ring
+        for (size_t i = 0; i < 6000; i++) {
+            shmPublisher.publishFrame(0, frameOf(i), i);
+        }
+        frames = 0;
+        ordered = 0;
+        uint64_t first = 0;
+        shmSubscriber.poll([&](const XbusBridgeRecord& record) {
+            first = frames == 0 ? record.receiveTimeNs : first;
+            ordered += record.receiveTimeNs == first + frames && counterOf(record.frame) == record.receiveTimeNs;
+            frames++;
+        });
+        assertTrue(shmSubscriber.stats().lost == 1 && shmSubscriber.stats().invalid == 0, "Overrun counted");
+        assertTrue(frames > 1200 && ordered == frames && first + frames == 6000,
+                   "Oldest intact frames delivered after an overrun");
+        shmPublisher.publishFrame(0, frameOf(1), 1);
+        frames = 0;
+        shmSubscriber.poll([&](const XbusBridgeRecord& record) { frames += counterOf(record.frame) == 1; });
+        assertTrue(frames == 1 && shmSubscriber.stats().lost == 1, "Newest frames follow");
+        
+        // Concurrent publisher, with a ring that holds the whole burst so
+        // nothing is lost however the threads are scheduled
+        const size_t total = 20 * packets.size();
+        shmSubscriber.close();
+        XbusShmSubscriber burstSubscriber;
+        assertTrue(shmPublisher.open(name, total * 6 * sizeof(uint64_t)) && burstSubscriber.open(name),
+                   "Large ring opened");
+        std::thread publisher([&] {
+            for (size_t round = 0; round < 20; round++) {
+                for (size_t i = 0; i < packets.size(); i++) {
+                    shmPublisher.publishFrame(0, frameOf(i), round * packets.size() + i);
+                }
+            }
+        });
+        size_t received = 0;
+        size_t outOfOrder = 0;
+        for (int idle = 0; received < total && idle < 100; ) {
+            size_t delivered = burstSubscriber.receive([&](const XbusBridgeRecord& record) {
+                outOfOrder += record.receiveTimeNs != received ||
+                              counterOf(record.frame) != record.receiveTimeNs % packets.size();
+                received++;
+            }, 10);
+            idle = delivered == 0 ? idle + 1 : 0;
+        }
+        publisher.join();
+        assertTrue(received == total && outOfOrder == 0 && burstSubscriber.stats().lost == 0 &&
+                   burstSubscriber.stats().invalid == 0, "Concurrent ring reads are intact");
+        burstSubscriber.close();
+        shmPublisher.close();
+        
+        // UDP over loopback, received straight into a dispatcher
+        XbusUdpSubscriber udpSubscriber;
+        XbusUdpPublisher udpPublisher;
+        assertTrue(udpSubscriber.open("127.0.0.1", 0) && udpSubscriber.port() != 0, "UDP subscriber bound");
+        assertTrue(udpPublisher.open("127.0.0.1", udpSubscriber.port()), "UDP publisher open");
+        assertTrue(!udpPublisher.open("not an address", 1), "Bad address rejected");
+        udpPublisher.open("127.0.0.1", udpSubscriber.port());
+        
+        XbusDispatcher dispatcher;
+        size_t eulerPackets = 0;
+        size_t udpOrdered = 0;
+        dispatcher.subscribeXdi(XDI::EULER_ANGLES, [&](const XbusDispatcher::Message& message) {
+            udpOrdered += message.sample->packetCounter == eulerPackets && message.receiveTimeNs == eulerPackets;
+            eulerPackets++;
+        });
+        dispatcher.start();
+        for (size_t i = 0; i < 300; i++) {
+            udpPublisher.publishFrame(0, frameOf(i), i);
+        }
+        udpPublisher.flush();
+        for (int attempt = 0; attempt < 100 && eulerPackets < 300; attempt++) {
+            udpSubscriber.receive([&](const XbusBridgeRecord& record) {
+                dispatcher.dispatch(record.device, record.frame, record.receiveTimeNs);
+            }, 20);
+        }
+        assertTrue(eulerPackets == 300 && udpOrdered == 300, "UDP frames reach subscribers");
+        assertTrue(udpPublisher.stats().batches < 300 / 10 && udpSubscriber.stats().lost == 0,
+                   "Frames batched into datagrams");
+    }
+    
+    void testFramerChecksum() {
+        std::cout << std::endl << "--- Testing Framer Running Checksum ---" << std::endl;
+        
+        // No 0xFA in the payload, so a rejected frame holds no false preambles
+        std::vector<uint8_t> payload(2000);
+        for (size_t i = 0; i < payload.size(); i++) {
+            payload[i] = static_cast<uint8_t>(i % 200);
+        }
+        std::vector<uint8_t> large = createXbusMessage(XMID_MtData2, payload);
+        std::vector<uint8_t> small = createXbusMessage(XMID_DeviceId, {0x03, 0x80, 0x12, 0x34});
+        
+        // One byte per write: the sum is built up over 2000+ calls
+        XbusFramer framer;
+        size_t delivered = 0;
+        bool intact = true;
+        for (uint8_t byte : large) {
+            framer.feed(&byte, 1, [&](const XbusFrame& frame) {
+                delivered++;
+                intact = intact && frame.size == large.size() &&
+                         memcmp(frame.data, large.data(), large.size()) == 0;
+            });
+        }
+        assertTrue(delivered == 1 && intact, "Frame fed byte by byte is delivered intact");
+        
+        // A flipped byte early in a frame is caught when the frame completes,
+        // and the frame after it is still found
+        std::vector<uint8_t> stream = large;
+        stream[100] ^= 0x40;
+        stream.insert(stream.end(), small.begin(), small.end());
+        XbusFramer chunked;
+        std::vector<size_t> sizes;
+        for (size_t offset = 0; offset < stream.size(); offset += 37) {
+            size_t length = std::min<size_t>(37, stream.size() - offset);
+            chunked.feed(stream.data() + offset, length, [&](const XbusFrame& frame) {
+                sizes.push_back(frame.size);
+            });
+        }
+        assertTrue(sizes.size() == 1 && sizes[0] == small.size(), "Corrupted frame rejected, next one found");
+        assertUint32Equals(1, static_cast<uint32_t>(chunked.stats().checksumErrors),
+                           "Checksum error counted once");
+        
+        // A pending frame moved by compaction keeps its partial sum
+        XbusFramer compacting(large.size() + 4);
+        std::vector<uint8_t> lead(small);
+        lead.insert(lead.end(), large.begin(), large.begin() + 1500);
+        delivered = 0;
+        compacting.feed(lead.data(), lead.size(), [&](const XbusFrame&) { delivered++; });
+        compacting.feed(large.data() + 1500, large.size() - 1500, [&](const XbusFrame& frame) {
+            delivered++;
+            intact = frame.size == large.size() && memcmp(frame.data, large.data(), large.size()) == 0;
+        });
+        assertTrue(delivered == 2 && intact && compacting.stats().checksumErrors.load() == 0,
+                   "Partial frame survives compaction");
+        
+        // reset() drops the partial sum with the bytes
+        XbusFramer restarted;
+        restarted.write(large.data(), 600);
+        XbusFrame frame;
+        restarted.nextFrame(frame);
+        restarted.reset();
+        delivered = restarted.feed(large.data(), large.size(), [](const XbusFrame&) {});
+        assertTrue(delivered == 1 && restarted.stats().checksumErrors.load() == 0, "reset() clears running checksum");
+    }
+    
+    void testOrientation() {
+        std::cout << std::endl << "--- Testing Orientation Conversions ---" << std::endl;
+        
+        // Deterministic orientations away from gimbal lock (odd count for the
+        // vector tails) with double precision reference quaternions
+        const size_t count = 1001;
+        const double toRad = 3.14159265358979323846 / 180.0;
+        std::vector<float> roll(count), pitch(count), yaw(count);
+        std::vector<float> q0(count), q1(count), q2(count), q3(count);
+        std::vector<double> ref0(count), ref1(count), ref2(count), ref3(count);
+        uint32_t seed = 2024;
+        auto uniform = [&seed](double low, double high) {
+            seed = seed * 1664525u + 1013904223u;
+            return low + (high - low) * (seed >> 8) / 16777216.0;
+        };
+        for (size_t i = 0; i < count; i++) {
+            roll[i] = static_cast<float>(uniform(-179.0, 179.0));
+            pitch[i] = static_cast<float>(uniform(-89.0, 89.0));
+            yaw[i] = static_cast<float>(uniform(-179.0, 179.0));
+            double cr = std::cos(roll[i] * toRad / 2), sr = std::sin(roll[i] * toRad / 2);
+            double cp = std::cos(pitch[i] * toRad / 2), sp = std::sin(pitch[i] * toRad / 2);
+            double cy = std::cos(yaw[i] * toRad / 2), sy = std::sin(yaw[i] * toRad / 2);
+            ref0[i] = cr * cp * cy + sr * sp * sy;
+            ref1[i] = sr * cp * cy - cr * sp * sy;
+            ref2[i] = cr * sp * cy + sr * cp * sy;
+            ref3[i] = cr * cp * sy - sr * sp * cy;
+            q0[i] = static_cast<float>(ref0[i]);
+            q1[i] = static_cast<float>(ref1[i]);
+            q2[i] = static_cast<float>(ref2[i]);
+            q3[i] = static_cast<float>(ref3[i]);
+        }
+        
+        // Xsens conventions on known orientations
+        EulerAngles rolled = XbusOrientation::toEuler(Quaternion(std::cos(15 * toRad), std::sin(15 * toRad), 0, 0));
+        assertFloatEquals(30.0f, rolled.roll, 1e-4f, "Quaternion about x is roll");
+        Vector3 east = XbusOrientation::rotateToGlobal(XbusOrientation::toQuaternion(EulerAngles(0, 0, 90)),
+                                                       Vector3(1, 0, 0));
+        assertTrue(std::abs(east.x) < 1e-6f && std::abs(east.y - 1.0f) < 1e-6f, "Yaw 90 turns sensor x to global y");
+        RotationMatrix pitched = XbusOrientation::toMatrix(XbusOrientation::toQuaternion(EulerAngles(0, 90, 0)));
+        assertTrue(std::abs(pitched.m[2][0] + 1.0f) < 1e-6f, "Pitch 90 matrix has -1 at row 2 column 0");
+        
+        const XbusSimd::Level levels[] = {XbusSimd::Level::Scalar, XbusSimd::Level::Ssse3,
+                                          XbusSimd::Level::Avx2, XbusSimd::Level::Neon};
+        XbusSimd::Level original = XbusSimd::activeLevel();
+        auto difference = [](float a, float b) { return static_cast<double>(std::abs(a - b)); };
+        std::vector<float> libmRoll(count), libmPitch(count), libmYaw(count);
+        for (XbusSimd::Level level : levels) {
+            if (!XbusSimd::setLevel(level)) {
+                continue;
+            }
+            std::string name = XbusSimd::levelName(level);
+            
+            std::vector<float> w(count), x(count), y(count), z(count);
+            XbusOrientation::eulerToQuaternion(roll.data(), pitch.data(), yaw.data(),
+                                               w.data(), x.data(), y.data(), z.data(), count);
+            double quaternionError = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                quaternionError = std::max({quaternionError, std::abs(w[i] - ref0[i]), std::abs(x[i] - ref1[i]),
+                                            std::abs(y[i] - ref2[i]), std::abs(z[i] - ref3[i])});
+            }
+            assertTrue(quaternionError < 1e-6, name + " eulerToQuaternion matches reference");
+            
+            std::vector<float> r(count), p(count), h(count);
+            XbusOrientation::quaternionToEuler(q0.data(), q1.data(), q2.data(), q3.data(),
+                                               r.data(), p.data(), h.data(), count);
+            if (level == XbusSimd::Level::Scalar) {
+                libmRoll = r;
+                libmPitch = p;
+                libmYaw = h;
+            }
+            double angleError = 0.0;
+            double libmError = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                angleError = std::max({angleError, difference(r[i], roll[i]), difference(p[i], pitch[i]),
+                                       difference(h[i], yaw[i])});
+                libmError = std::max({libmError, difference(r[i], libmRoll[i]),
+                                      difference(p[i], libmPitch[i]), difference(h[i], libmYaw[i])});
+            }
+            std::cout << name << " Euler error: " << angleError << " deg, vs libm " << libmError << " deg" << std::endl;
+            assertTrue(angleError < 2e-3 && libmError < 1e-4, name + " quaternionToEuler matches reference");
+            
+            // R v from the matrix columns equals the rotated vector
+            std::vector<std::vector<float>> elements(9, std::vector<float>(count));
+            float* const matrix[9] = {elements[0].data(), elements[1].data(), elements[2].data(),
+                                      elements[3].data(), elements[4].data(), elements[5].data(),
+                                      elements[6].data(), elements[7].data(), elements[8].data()};
+            XbusOrientation::quaternionToMatrix(q0.data(), q1.data(), q2.data(), q3.data(), matrix, count);
+            std::vector<float> vx(count), vy(count), vz(count);
+            for (size_t i = 0; i < count; i++) {
+                vx[i] = static_cast<float>(uniform(-10.0, 10.0));
+                vy[i] = static_cast<float>(uniform(-10.0, 10.0));
+                vz[i] = static_cast<float>(uniform(-10.0, 10.0));
+            }
+            std::vector<float> gx(count), gy(count), gz(count);
+            XbusOrientation::rotateToGlobal(q0.data(), q1.data(), q2.data(), q3.data(), vx.data(), vy.data(),
+                                            vz.data(), gx.data(), gy.data(), gz.data(), count);
+            double matrixError = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                double mx = elements[0][i] * vx[i] + elements[1][i] * vy[i] + elements[2][i] * vz[i];
+                double my = elements[3][i] * vx[i] + elements[4][i] * vy[i] + elements[5][i] * vz[i];
+                double mz = elements[6][i] * vx[i] + elements[7][i] * vy[i] + elements[8][i] * vz[i];
+                matrixError = std::max({matrixError, std::abs(mx - gx[i]), std::abs(my - gy[i]),
+                                        std::abs(mz - gz[i])});
+            }
+            assertTrue(matrixError < 1e-4, name + " quaternionToMatrix agrees with rotateToGlobal");
+            
+            // Back to the sensor frame in place
+            XbusOrientation::rotateToSensor(q0.data(), q1.data(), q2.data(), q3.data(), gx.data(), gy.data(),
+                                            gz.data(), gx.data(), gy.data(), gz.data(), count);
+            double roundTripError = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                roundTripError = std::max({roundTripError, difference(gx[i], vx[i]),
+                                           difference(gy[i], vy[i]), difference(gz[i], vz[i])});
+            }
+            assertTrue(roundTripError < 1e-4, name + " rotateToSensor undoes rotateToGlobal");
+            
+            // Gimbal lock: rounding pushes the sine of pitch past 1
+            float lock[4] = {0.70710677f, 0.0f, 0.70710683f, 0.0f};
+            float lockRoll[4], lockPitch[4], lockYaw[4];
+            float lw[4], lx[4], ly[4], lz[4];
+            for (int i = 0; i < 4; i++) {
+                lw[i] = lock[0];
+                lx[i] = lock[1];
+                ly[i] = lock[2];
+                lz[i] = lock[3];
+            }
+            XbusOrientation::quaternionToEuler(lw, lx, ly, lz, lockRoll, lockPitch, lockYaw, 4);
+            assertTrue(std::abs(lockPitch[0] - 90.0f) < 1e-3f && !std::isnan(lockRoll[0]) && !std::isnan(lockYaw[0]),
+                       name + " pitch of 90 degrees without NaN");
+        }
+        XbusSimd::setLevel(original);
+        
+        // Quaternion only, Euler only, both and neither
+        SensorDataColumns columns;
+        SensorData sample;
+        sample.hasQuaternion = true;
+        sample.quaternion = XbusOrientation::toQuaternion(EulerAngles(10, 20, 30));
+        columns.append(sample);
+        columns.append(sample);
+        sample.hasQuaternion = false;
+        sample.hasEulerAngles = true;
+        sample.eulerAngles = EulerAngles(-40, 50, -60);
+        columns.append(sample);
+        sample.hasQuaternion = true;
+        columns.append(sample);
+        columns.append(SensorData());
+        
+        size_t filled = XbusOrientation::completeOrientation(columns);
+        assertUint32Equals(3, static_cast<uint32_t>(filled), "completeOrientation fills three rows");
+        assertTrue(columns.has(1, SensorField::EULER_ANGLES) && columns.has(2, SensorField::QUATERNION) &&
+                   !columns.has(4, SensorField::QUATERNION), "Filled rows get their presence bit");
+        assertFloatEquals(30.0f, columns.yaw[1], 1e-3f, "Euler angles filled from the quaternion");
+        Quaternion expected = XbusOrientation::toQuaternion(EulerAngles(-40, 50, -60));
+        assertFloatEquals(expected.q3, columns.q3[2], 1e-6f, "Quaternion filled from Euler angles");
+    }
 };
 
 int main() {
     XbusParserTest test;
-    test.runAllTests();
-    return 0;
+    return test.runAllTests() ? 0 : 1;
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "xbus.h"
+#include "xbus_simd.h"
 
 bool Xbus::checkPreamble(const uint8_t* xbusMessage) {
     return xbusMessage[OFFSET_TO_PREAMBLE] == XBUS_PREAMBLE;
@@ -59,6 +60,16 @@ int Xbus::getRawLength(const uint8_t* xbusMessage) {
     return result;
 }
 
+bool Xbus::isComplete(const uint8_t* xbusMessage, size_t size) {
+    if (xbusMessage == nullptr || size < OFFSET_TO_PAYLOAD + XBUS_CHECKSUM_SIZE) {
+        return false;
+    }
+    if (xbusMessage[OFFSET_TO_LEN] == LENGTH_EXTENDER_BYTE && size < OFFSET_TO_PAYLOAD_EXT + XBUS_CHECKSUM_SIZE) {
+        return false;
+    }
+    return static_cast<size_t>(getRawLength(xbusMessage)) <= size;
+}
+
 uint8_t* Xbus::getPointerToPayload(uint8_t* xbusMessage) {
     if ((xbusMessage[OFFSET_TO_LEN] & 0xff) == LENGTH_EXTENDER_BYTE) {
         return xbusMessage + OFFSET_TO_PAYLOAD_EXT;
@@ -74,22 +85,14 @@ const uint8_t* Xbus::getConstPointerToPayload(const uint8_t* xbusMessage) {
 void Xbus::insertChecksum(uint8_t* xbusMessage) {
     int nBytes = getRawLength(xbusMessage);
     
-    uint8_t checksum = 0;
-    for (int i = 0; i < nBytes - 2; i++) {
-        checksum -= xbusMessage[1 + i];
-    }
-    
-    xbusMessage[nBytes - 1] = checksum;
+    // Everything from BID to the checksum sums to zero
+    uint8_t sum = XbusSimd::byteSum(xbusMessage + 1, static_cast<size_t>(nBytes - 2));
+    xbusMessage[nBytes - 1] = static_cast<uint8_t>(0 - sum);
 }
 
 bool Xbus::verifyChecksum(const uint8_t* xbusMessage) {
     int nBytes = getRawLength(xbusMessage);
-    uint8_t checksum = 0;
-    for (int n = 1; n < nBytes; n++) {
-        checksum += (xbusMessage[n] & 0xff);
-    }
-    checksum &= 0xff;
-    return (checksum == 0);
+    return XbusSimd::byteSum(xbusMessage + 1, static_cast<size_t>(nBytes - 1)) == 0;
 }
 
 size_t Xbus::createRawMessage(uint8_t* dest, const uint8_t* message) {
@@ -125,8 +128,9 @@ size_t Xbus::createRawMessage(uint8_t* dest, const uint8_t* message) {
         checksum -= *dptr++;
     }
 
+    const uint8_t* payload = getConstPointerToPayload(message);
     for (n = 0; n < length; n++) {
-        *dptr = getConstPointerToPayload(message)[n];
+        *dptr = payload[n];
         checksum -= *dptr++;
     }
 
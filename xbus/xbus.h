@@ -20,7 +20,12 @@ public:
     static constexpr uint8_t XBUS_PREAMBLE = 0xFA;
     static constexpr uint8_t XBUS_MASTERDEVICE = 0xFF;
     static constexpr uint8_t XBUS_EXTENDED_LENGTH = 0xFF;
-
+    
+    // Largest payload of an extended-length message and the size of that
+    // whole message (preamble to checksum)
+    static constexpr uint16_t MAX_PAYLOAD_LENGTH = 0xFFFF;
+    static constexpr size_t MAX_MESSAGE_SIZE = MAX_PAYLOAD_LENGTH + OFFSET_TO_PAYLOAD_EXT + XBUS_CHECKSUM_SIZE;
+    
     // Static methods
     static bool checkPreamble(const uint8_t* xbusMessage);
     
@@ -37,6 +42,10 @@ public:
     
     static int getRawLength(const uint8_t* xbusMessage);
     
+    // True when size bytes hold the whole header and the message length it
+    // declares; check this before reading a message from untrusted memory
+    static bool isComplete(const uint8_t* xbusMessage, size_t size);
+    
     static uint8_t* getPointerToPayload(uint8_t* xbusMessage);
     static const uint8_t* getConstPointerToPayload(const uint8_t* xbusMessage);
     
@@ -0,0 +1,180 @@
+#include "xbus_clock_tracker.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double NS_PER_SECOND = 1e9;
+
+// Days from 1970-01-01 to a proleptic Gregorian date
+int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2 ? 1 : 0;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    const unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+}
+
+} // namespace
+
+XbusClockTracker::XbusClockTracker()
+    : XbusClockTracker(Config()) {
+}
+
+XbusClockTracker::XbusClockTracker(const Config& config)
+    : m_config(config)
+    , m_source(TimeSource::None)
+    , m_lastTicks(0)
+    , m_deviceTimeNs(0) {
+    restart(TimeSource::None, 0, 0);
+}
+
+XbusClockTracker::Sample XbusClockTracker::update(const SensorData& data, uint64_t receiveTimeNs) {
+    Sample sample;
+    sample.hostTimeNs = receiveTimeNs - std::min(receiveTimeNs, m_config.transportLatencyNs);
+    sample.deviceTimeNs = 0;
+    sample.lostPackets = data.hasPacketCounter ? m_packetGaps.update(data.packetCounter) : 0;
+    sample.resynced = false;
+    sample.source = TimeSource::None;
+    
+    // Device clock of this sample and whether it continues the current timeline
+    TimeSource source = TimeSource::None;
+    uint64_t deviceTimeNs = 0;
+    bool continuous = false;
+    if (data.hasSampleTimeFine) {
+        source = TimeSource::SampleTimeFine;
+        int32_t stepTicks = static_cast<int32_t>(data.sampleTimeFine - m_lastTicks);
+        if (m_source == source && stepTicks >= 0 &&
+            static_cast<uint64_t>(stepTicks) * SAMPLE_TIME_FINE_NS <= m_config.maxDeviceStepNs) {
+            deviceTimeNs = m_deviceTimeNs + static_cast<uint64_t>(stepTicks) * SAMPLE_TIME_FINE_NS;
+            continuous = true;
+        } else {
+            deviceTimeNs = static_cast<uint64_t>(data.sampleTimeFine) * SAMPLE_TIME_FINE_NS;
+        }
+        m_lastTicks = data.sampleTimeFine;
+    } else if (data.hasUtcTime && (data.utcTime.flags & UtcFlags::VALID_UTC) != 0 &&
+               utcToNs(data.utcTime, deviceTimeNs)) {
+        source = TimeSource::UtcTime;
+        continuous = m_source == source && deviceTimeNs >= m_deviceTimeNs &&
+                     deviceTimeNs - m_deviceTimeNs <= m_config.maxDeviceStepNs;
+    } else {
+        return sample;
+    }
+    
+    sample.source = source;
+    sample.deviceTimeNs = deviceTimeNs;
+    if (!continuous) {
+        sample.resynced = m_source != TimeSource::None;
+        restart(source, deviceTimeNs, receiveTimeNs);
+    }
+    m_deviceTimeNs = deviceTimeNs;
+    
+    double x = static_cast<double>(deviceTimeNs - m_anchorDeviceNs) / NS_PER_SECOND;
+    double y = static_cast<double>(static_cast<int64_t>(receiveTimeNs - m_anchorHostNs)) / NS_PER_SECOND - x;
+    double dt = x - m_lastX;
+    double floor = m_floor + (drift() + static_cast<double>(m_config.floorRiseNsPerSec) / NS_PER_SECOND) * dt;
+    
+    // A sample far earlier than the latency floor allows means the model no
+    // longer holds (e.g. the device clock was adjusted); start over
+    if (m_weight > 0.0 && y - floor < -static_cast<double>(m_config.resyncThresholdNs) / NS_PER_SECOND) {
+        sample.resynced = true;
+        restart(source, deviceTimeNs, receiveTimeNs);
+        x = 0.0;
+        y = 0.0;
+        dt = 0.0;
+    }
+    
+    // Exponentially weighted running means and co-moments, decayed by the
+    // device time since the previous sample
+    double decay = m_weight > 0.0 ? std::exp(-dt / m_config.windowSeconds) : 0.0;
+    m_weight = decay * m_weight + 1.0;
+    double dx = x - m_meanX;
+    m_meanX += dx / m_weight;
+    m_meanY += (y - m_meanY) / m_weight;
+    m_varX = decay * m_varX + dx * (x - m_meanX);
+    m_covXY = decay * m_covXY + dx * (y - m_meanY);
+    
+    // The floor follows the fitted drift and drops to every earlier arrival
+    m_floor = m_weight > 1.0 ? std::min(floor, y) : y;
+    m_lastX = x;
+    
+    sample.hostTimeNs = toHostTimeNs(deviceTimeNs);
+    return sample;
+}
+
+void XbusClockTracker::reset() {
+    m_packetGaps.restart();
+    restart(TimeSource::None, 0, 0);
+}
+
+uint64_t XbusClockTracker::toHostTimeNs(uint64_t deviceTimeNs) const {
+    int64_t fromAnchor = static_cast<int64_t>(deviceTimeNs - m_anchorDeviceNs);
+    double x = static_cast<double>(fromAnchor) / NS_PER_SECOND;
+    int64_t offsetNs = std::llround((m_floor + drift() * (x - m_lastX)) * NS_PER_SECOND);
+    int64_t hostNs = static_cast<int64_t>(m_anchorHostNs) + fromAnchor + offsetNs -
+                     static_cast<int64_t>(m_config.transportLatencyNs);
+    return hostNs > 0 ? static_cast<uint64_t>(hostNs) : 0;
+}
+
+bool XbusClockTracker::isLocked() const {
+    return m_source != TimeSource::None && m_lastX >= m_config.minFitSeconds;
+}
+
+double XbusClockTracker::driftPpm() const {
+    return drift() * 1e6;
+}
+
+int64_t XbusClockTracker::hostMinusDeviceNs() const {
+    return static_cast<int64_t>(m_anchorHostNs - m_anchorDeviceNs) +
+           std::llround(m_floor * NS_PER_SECOND);
+}
+
+XbusClockTracker::TimeSource XbusClockTracker::source() const {
+    return m_source;
+}
+
+const PacketCounterGaps& XbusClockTracker::packetGaps() const {
+    return m_packetGaps;
+}
+
+uint64_t XbusClockTracker::resyncs() const {
+    return m_resyncs;
+}
+
+bool XbusClockTracker::utcToNs(const UtcTime& utc, uint64_t& ns) {
+    if (utc.year < 1970 || utc.month < 1 || utc.month > 12 || utc.day < 1 || utc.day > 31 ||
+        utc.hour > 23 || utc.minute > 59 || utc.second > 60 || utc.nanoseconds >= 1000000000u) {
+        return false;
+    }
+    
+    int64_t days = daysFromCivil(utc.year, utc.month, utc.day);
+    int64_t seconds = ((days * 24 + utc.hour) * 60 + utc.minute) * 60 + utc.second;
+    ns = static_cast<uint64_t>(seconds) * 1000000000ull + utc.nanoseconds;
+    return true;
+}
+
+void XbusClockTracker::restart(TimeSource source, uint64_t deviceTimeNs, uint64_t receiveTimeNs) {
+    if (m_source != TimeSource::None && source != TimeSource::None) {
+        ++m_resyncs;
+    }
+    
+    m_source = source;
+    m_deviceTimeNs = deviceTimeNs;
+    m_anchorHostNs = receiveTimeNs;
+    m_anchorDeviceNs = deviceTimeNs;
+    m_lastX = 0.0;
+    m_weight = 0.0;
+    m_meanX = 0.0;
+    m_meanY = 0.0;
+    m_varX = 0.0;
+    m_covXY = 0.0;
+    m_floor = 0.0;
+}
+
+double XbusClockTracker::drift() const {
+    if (m_lastX < m_config.minFitSeconds || m_varX <= 0.0) {
+        return 0.0;
+    }
+    return m_covXY / m_varX;
+}
@@ -0,0 +1,122 @@
+#ifndef XBUS_CLOCK_TRACKER_H
+#define XBUS_CLOCK_TRACKER_H
+
+#include "xbus_parser.h"
+#include "xbus_stats.h"
+#include <cstdint>
+
+// UtcTime flag bits as sent by the device
+namespace UtcFlags {
+    constexpr uint8_t VALID_TIME_OF_WEEK = 0x01;
+    constexpr uint8_t VALID_WEEK_NUMBER = 0x02;
+    constexpr uint8_t VALID_UTC = 0x04;
+}
+
+// Per-device packet loss and clock correlation.
+//
+// Feed every decoded sample of one device together with the host steady
+// clock time its data was received (SerialChunk::receiveTimeNs). The tracker
+// counts samples lost between packet counters and maps the device clock
+// onto the host clock, returning each sample with a host-domain timestamp
+// that is free of serial, USB and scheduling jitter. Samples of several
+// devices tracked this way can be aligned directly on those timestamps.
+//
+// The device clock is SampleTimeFine (10 kHz ticks, unwrapped to 64 bits),
+// or UtcTime when a device only sends that and it is marked valid. Host
+// receive time is modelled as
+//
+//     host = device + offset + drift * device + latency
+//
+// where latency is never negative. Drift comes from an exponentially
+// weighted least-squares fit over the last windowSeconds of device time.
+// The fit follows the mean latency, so the offset is instead taken from the
+// earliest arrivals: a floor that is carried along the drift, drops to any
+// sample arriving earlier and rises again only slowly. Samples are stamped
+// on that floor, so several samples read in one chunk still get their own,
+// evenly spaced timestamps. Every update is O(1).
+//
+// A device clock that steps backwards or jumps (device reset), a change of
+// time source, or a sample that arrives far earlier than predicted restarts
+// the estimate from that sample.
+//
+// Not thread safe: use one tracker per device, updated by the thread that
+// decodes its samples. packetGaps() and resyncs() may be read from any thread.
+class XbusClockTracker {
+public:
+    enum class TimeSource {
+        None,               // no usable device time, host receive time passed through
+        SampleTimeFine,
+        UtcTime
+    };
+    
+    struct Config {
+        double windowSeconds = 60.0;                // effective length of the drift fit, device time
+        double minFitSeconds = 2.0;                 // drift is held at 0 until the fit spans this much
+        uint64_t floorRiseNsPerSec = 20000;         // how fast the latency floor may rise again
+        uint64_t resyncThresholdNs = 50000000;      // arrivals this much early restart the estimate
+        uint64_t maxDeviceStepNs = 10000000000ull;  // larger device clock jumps restart the estimate
+        uint64_t transportLatencyNs = 0;            // known minimum latency, subtracted from timestamps
+    };
+    
+    struct Sample {
+        uint64_t hostTimeNs;        // corrected host steady clock time of the sample
+        uint64_t deviceTimeNs;      // device clock in ns (unwrapped SampleTimeFine, or UTC since 1970)
+        uint16_t lostPackets;       // samples missing right before this one
+        bool resynced;              // the clock estimate restarted at this sample
+        TimeSource source;
+    };
+    
+    static constexpr uint64_t SAMPLE_TIME_FINE_NS = 100000;  // one 10 kHz tick
+    
+    XbusClockTracker();
+    explicit XbusClockTracker(const Config& config);
+    
+    Sample update(const SensorData& data, uint64_t receiveTimeNs);
+    
+    // Forget the clock estimate and the last packet counter, e.g. after
+    // the device was reconfigured. Counters are kept.
+    void reset();
+    
+    // Host time of a device clock value under the current estimate
+    uint64_t toHostTimeNs(uint64_t deviceTimeNs) const;
+    
+    // Current estimate; hostMinusDeviceNs() is the host - device offset at
+    // the latest sample, including the latency floor
+    bool isLocked() const;
+    double driftPpm() const;
+    int64_t hostMinusDeviceNs() const;
+    TimeSource source() const;
+    
+    const PacketCounterGaps& packetGaps() const;
+    uint64_t resyncs() const;
+    
+    // UTC calendar time to ns since 1970-01-01. False for out-of-range fields.
+    static bool utcToNs(const UtcTime& utc, uint64_t& ns);
+
+private:
+    void restart(TimeSource source, uint64_t deviceTimeNs, uint64_t receiveTimeNs);
+    double drift() const;
+    
+    Config m_config;
+    PacketCounterGaps m_packetGaps;
+    RelaxedCounter m_resyncs;
+    
+    // Device clock unwrapping
+    TimeSource m_source;
+    uint32_t m_lastTicks;
+    uint64_t m_deviceTimeNs;
+    
+    // Fit of y = host - device against x = device, both in seconds since
+    // the anchor sample
+    uint64_t m_anchorHostNs;
+    uint64_t m_anchorDeviceNs;
+    double m_lastX;
+    double m_weight;
+    double m_meanX;
+    double m_meanY;
+    double m_varX;
+    double m_covXY;
+    double m_floor;         // latency floor at m_lastX: lowest y, carried along the drift
+};
+
+#endif // XBUS_CLOCK_TRACKER_H
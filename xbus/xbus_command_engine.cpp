@@ -0,0 +1,287 @@
+#include "xbus_command_engine.h"
+#include "xbus.h"
+#include "xbus_message_id.h"
+#include <chrono>
+#include <memory>
+
+namespace {
+
+uint64_t steadyNowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+XbusCommandEngine::XbusCommandEngine(size_t deviceCount, SendFunction send)
+    : m_send(std::move(send))
+    , m_channels(deviceCount)
+    , m_nextCommandId(0)
+    , m_running(false) {
+}
+
+XbusCommandEngine::~XbusCommandEngine() {
+    stop();
+}
+
+bool XbusCommandEngine::start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) {
+        return true;
+    }
+    if (!m_send) {
+        m_lastError = "No send function";
+        return false;
+    }
+    
+    m_running = true;
+    m_timer = std::thread(&XbusCommandEngine::timerLoop, this);
+    return true;
+}
+
+void XbusCommandEngine::stop() {
+    std::vector<Completion> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        for (size_t device = 0; device < m_channels.size(); device++) {
+            Channel& channel = m_channels[device];
+            while (!channel.queue.empty()) {
+                cancelled.push_back(complete(device, Status::Cancelled));
+            }
+        }
+    }
+    m_condition.notify_all();
+    if (m_timer.joinable()) {
+        m_timer.join();
+    }
+    
+    for (Completion& completion : cancelled) {
+        completion.callback(completion.reply);
+    }
+}
+
+bool XbusCommandEngine::submit(size_t device, const uint8_t* frame, size_t size, ReplyCallback callback,
+                               uint32_t timeoutMs) {
+    if (frame == nullptr || size < Xbus::OFFSET_TO_PAYLOAD + Xbus::XBUS_CHECKSUM_SIZE ||
+        !Xbus::checkPreamble(frame) || static_cast<size_t>(Xbus::getRawLength(frame)) != size) {
+        setLastError("Not a complete Xbus message");
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            m_lastError = "Command engine is not started";
+            return false;
+        }
+        if (device >= m_channels.size()) {
+            m_lastError = "Unknown device " + std::to_string(device);
+            return false;
+        }
+        
+        Command command;
+        command.id = m_nextCommandId++;
+        command.commandId = frame[Xbus::OFFSET_TO_MID];
+        command.frame.assign(frame, frame + size);
+        command.timeoutNs = static_cast<uint64_t>(timeoutMs) * 1000000ull;
+        command.callback = callback ? std::move(callback) : [](const Reply&) {};
+        m_channels[device].queue.push_back(std::move(command));
+    }
+    
+    sendNext(device);
+    return true;
+}
+
+std::future<XbusCommandEngine::Reply> XbusCommandEngine::request(size_t device, const uint8_t* frame,
+                                                                 size_t size, uint32_t timeoutMs) {
+    std::shared_ptr<std::promise<Reply>> promise = std::make_shared<std::promise<Reply>>();
+    std::future<Reply> result = promise->get_future();
+    bool queued = submit(device, frame, size, [promise](const Reply& reply) {
+        promise->set_value(reply);
+    }, timeoutMs);
+    
+    if (!queued) {
+        Reply reply;
+        reply.device = device;
+        reply.commandId = (frame != nullptr && size > Xbus::OFFSET_TO_MID) ? frame[Xbus::OFFSET_TO_MID] : 0;
+        promise->set_value(reply);
+    }
+    return result;
+}
+
+bool XbusCommandEngine::handleFrame(size_t device, const XbusFrame& frame) {
+    if (frame.size <= Xbus::OFFSET_TO_MID) {
+        return false;
+    }
+    
+    Completion completion;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (device >= m_channels.size() || !m_channels[device].inFlight) {
+            return false;
+        }
+        
+        uint8_t messageId = frame.data[Xbus::OFFSET_TO_MID];
+        uint8_t commandId = m_channels[device].queue.front().commandId;
+        Status status;
+        if (messageId == replyId(commandId)) {
+            status = Status::Ok;
+        } else if (messageId == XMID_Error) {
+            status = Status::DeviceError;
+        } else {
+            return false;
+        }
+        
+        completion = complete(device, status);
+        completion.reply.frame.assign(frame.begin(), frame.end());
+        if (status == Status::DeviceError && Xbus::getPayloadLength(frame.data) > 0) {
+            completion.reply.errorCode = *Xbus::getConstPointerToPayload(frame.data);
+        }
+    }
+    
+    completion.callback(completion.reply);
+    sendNext(device);
+    return true;
+}
+
+size_t XbusCommandEngine::pending(size_t device) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return device < m_channels.size() ? m_channels[device].queue.size() : 0;
+}
+
+size_t XbusCommandEngine::deviceCount() const {
+    return m_channels.size();
+}
+
+const XbusCommandEngine::Stats& XbusCommandEngine::stats() const {
+    return m_stats;
+}
+
+std::string XbusCommandEngine::getLastError() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
+
+uint8_t XbusCommandEngine::replyId(uint8_t commandId) {
+    return static_cast<uint8_t>(commandId + 1);
+}
+
+void XbusCommandEngine::sendNext(size_t device) {
+    for (;;) {
+        // Move the frame out so it can be written without holding the lock;
+        // the command may complete before the write returns
+        std::vector<uint8_t> frame;
+        uint64_t id;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Channel& channel = m_channels[device];
+            if (!m_running || channel.inFlight || channel.queue.empty()) {
+                return;
+            }
+            
+            Command& command = channel.queue.front();
+            frame = std::move(command.frame);
+            id = command.id;
+            channel.inFlight = true;
+            channel.sentNs = steadyNowNs();
+            channel.deadlineNs = channel.sentNs + command.timeoutNs;
+            ++m_stats.sent;
+        }
+        m_condition.notify_all();
+        
+        if (m_send(device, frame.data(), frame.size())) {
+            return;
+        }
+        
+        Completion completion;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Channel& channel = m_channels[device];
+            if (!channel.inFlight || channel.queue.front().id != id) {
+                continue;
+            }
+            completion = complete(device, Status::SendFailed);
+        }
+        completion.callback(completion.reply);
+    }
+}
+
+XbusCommandEngine::Completion XbusCommandEngine::complete(size_t device, Status status) {
+    Channel& channel = m_channels[device];
+    Command& command = channel.queue.front();
+    
+    Completion completion;
+    completion.callback = std::move(command.callback);
+    completion.reply.status = status;
+    completion.reply.device = device;
+    completion.reply.commandId = command.commandId;
+    if (status == Status::Ok || status == Status::DeviceError) {
+        completion.reply.latencyNs = steadyNowNs() - channel.sentNs;
+        m_stats.replyLatency.record(completion.reply.latencyNs);
+    }
+    
+    switch (status) {
+        case Status::Ok:
+            ++m_stats.replies;
+            break;
+        case Status::DeviceError:
+            ++m_stats.deviceErrors;
+            break;
+        case Status::Timeout:
+            ++m_stats.timeouts;
+            break;
+        case Status::SendFailed:
+            ++m_stats.sendFailures;
+            break;
+        case Status::Cancelled:
+            break;
+    }
+    
+    channel.queue.pop_front();
+    channel.inFlight = false;
+    return completion;
+}
+
+void XbusCommandEngine::timerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        uint64_t now = steadyNowNs();
+        uint64_t nextDeadline = UINT64_MAX;
+        std::vector<Completion> expired;
+        std::vector<size_t> devices;
+        for (size_t device = 0; device < m_channels.size(); device++) {
+            Channel& channel = m_channels[device];
+            if (!channel.inFlight) {
+                continue;
+            }
+            if (channel.deadlineNs <= now) {
+                expired.push_back(complete(device, Status::Timeout));
+                devices.push_back(device);
+            } else if (channel.deadlineNs < nextDeadline) {
+                nextDeadline = channel.deadlineNs;
+            }
+        }
+        
+        if (!expired.empty()) {
+            lock.unlock();
+            for (size_t i = 0; i < expired.size(); i++) {
+                expired[i].callback(expired[i].reply);
+                sendNext(devices[i]);
+            }
+            lock.lock();
+            continue;
+        }
+        
+        if (nextDeadline == UINT64_MAX) {
+            m_condition.wait(lock);
+        } else {
+            m_condition.wait_for(lock, std::chrono::nanoseconds(nextDeadline - now));
+        }
+    }
+}
+
+void XbusCommandEngine::setLastError(const std::string& error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lastError = error;
+}
@@ -0,0 +1,165 @@
+#ifndef XBUS_COMMAND_ENGINE_H
+#define XBUS_COMMAND_ENGINE_H
+
+#include "xbus_framer.h"
+#include "xbus_stats.h"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Matches device replies to the commands that asked for them.
+//
+// Commands are complete frames (see XbusMessageBuilder and XbusCommand).
+// Every device has its own queue with at most one command in flight: a
+// command is sent as soon as the one before it completed, so a sequence
+// of commands runs back to back without fixed sleeps, and commands to
+// different devices overlap. A command completes with
+//
+//     Ok            the reply arrived: message ID of the command + 1
+//                   (GotoConfig -> GotoConfigAck, ReqDid -> DeviceId, ...)
+//     DeviceError   the device answered with XMID_Error
+//     Timeout       no reply within the command's timeout
+//     SendFailed    writing the frame failed
+//     Cancelled     stop() or destruction while queued or in flight
+//
+// Feed every received frame to handleFrame(); frames that are no reply
+// (MTData2, ...) are ignored. Callbacks run on the thread that completed
+// the command: the caller of handleFrame() for replies, the engine's timer
+// thread for timeouts, or the caller of submit()/stop(). The send function
+// may be called from any of those threads as well, and must be thread safe
+// (XbusDeviceManager::send() and SerialReader::write() are).
+class XbusCommandEngine {
+public:
+    enum class Status {
+        Ok,
+        DeviceError,
+        Timeout,
+        SendFailed,
+        Cancelled
+    };
+    
+    struct Reply {
+        Status status = Status::Cancelled;
+        size_t device = 0;
+        uint8_t commandId = 0;          // message ID of the command
+        uint8_t errorCode = 0;          // first payload byte of an XMID_Error reply
+        uint64_t latencyNs = 0;         // from sending the command to its reply
+        std::vector<uint8_t> frame;     // whole reply frame, for XbusParser
+    };
+    
+    // Updated under the engine lock, readable from any thread
+    struct Stats {
+        RelaxedCounter sent;
+        RelaxedCounter replies;
+        RelaxedCounter deviceErrors;
+        RelaxedCounter timeouts;
+        RelaxedCounter sendFailures;
+        LatencyHistogram replyLatency;
+    };
+    
+    typedef std::function<void(const Reply& reply)> ReplyCallback;
+    typedef std::function<bool(size_t device, const uint8_t* frame, size_t size)> SendFunction;
+    
+    static constexpr uint32_t DEFAULT_TIMEOUT_MS = 1000;
+    
+    XbusCommandEngine(size_t deviceCount, SendFunction send);
+    ~XbusCommandEngine();
+    
+    XbusCommandEngine(const XbusCommandEngine&) = delete;
+    XbusCommandEngine& operator=(const XbusCommandEngine&) = delete;
+    
+    // Start the timer thread; commands are only accepted while started
+    bool start();
+    
+    // Cancel every queued and in-flight command and stop the timer thread
+    void stop();
+    
+    // Queue a command frame for a device. Returns false, without calling
+    // the callback, for an unknown device, a frame that is no Xbus message
+    // or when the engine is not started.
+    bool submit(size_t device, const uint8_t* frame, size_t size, ReplyCallback callback,
+                uint32_t timeoutMs = DEFAULT_TIMEOUT_MS);
+    
+    template <size_t N>
+    bool submit(size_t device, const std::array<uint8_t, N>& frame, ReplyCallback callback,
+                uint32_t timeoutMs = DEFAULT_TIMEOUT_MS) {
+        return submit(device, frame.data(), N, std::move(callback), timeoutMs);
+    }
+    
+    // The same with a future. A command that was not accepted yields a
+    // Cancelled reply at once.
+    std::future<Reply> request(size_t device, const uint8_t* frame, size_t size,
+                               uint32_t timeoutMs = DEFAULT_TIMEOUT_MS);
+    
+    template <size_t N>
+    std::future<Reply> request(size_t device, const std::array<uint8_t, N>& frame,
+                               uint32_t timeoutMs = DEFAULT_TIMEOUT_MS) {
+        return request(device, frame.data(), N, timeoutMs);
+    }
+    
+    // Complete the device's in-flight command if frame is its reply or an
+    // error. Returns true when the frame completed a command.
+    bool handleFrame(size_t device, const XbusFrame& frame);
+    
+    // Commands queued or in flight on a device
+    size_t pending(size_t device) const;
+    
+    size_t deviceCount() const;
+    const Stats& stats() const;
+    std::string getLastError() const;
+    
+    // Message ID of the reply to a command
+    static uint8_t replyId(uint8_t commandId);
+
+private:
+    struct Command {
+        uint64_t id;                    // tells commands apart across a send
+        uint8_t commandId;
+        std::vector<uint8_t> frame;     // moved out once sent
+        uint64_t timeoutNs;
+        ReplyCallback callback;
+    };
+    
+    struct Channel {
+        std::deque<Command> queue;      // front() is in flight when inFlight is set
+        bool inFlight = false;
+        uint64_t sentNs = 0;
+        uint64_t deadlineNs = 0;
+    };
+    
+    struct Completion {
+        ReplyCallback callback;
+        Reply reply;
+    };
+    
+    // Send queued commands of a device until one is in flight or the queue
+    // is empty; commands whose send fails are completed. Called unlocked.
+    void sendNext(size_t device);
+    
+    // Take the in-flight command off the device's queue; lock held
+    Completion complete(size_t device, Status status);
+    
+    void timerLoop();
+    void setLastError(const std::string& error);
+    
+    SendFunction m_send;
+    std::vector<Channel> m_channels;
+    uint64_t m_nextCommandId;
+    
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running;
+    std::thread m_timer;
+    std::string m_lastError;
+    Stats m_stats;
+};
+
+#endif // XBUS_COMMAND_ENGINE_H
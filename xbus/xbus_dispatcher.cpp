@@ -0,0 +1,262 @@
+#include "xbus_dispatcher.h"
+#include "xbus_message_id.h"
+#include <utility>
+
+void XbusDispatcher::Envelope::reset() {
+    frame.reset();
+    largeFrame.reset();
+    sample.reset();
+}
+
+XbusDispatcher::XbusDispatcher()
+    : XbusDispatcher(Config()) {
+}
+
+XbusDispatcher::XbusDispatcher(const Config& config)
+    : m_config(config)
+    , m_decoders(config.deviceCount < 1 ? 1 : config.deviceCount)
+    , m_decodeMTData2(false)
+    , m_hasWorkers(false)
+    , m_running(false) {
+}
+
+XbusDispatcher::~XbusDispatcher() {
+    stop();
+}
+
+bool XbusDispatcher::subscribe(uint8_t messageId, Callback callback, Delivery delivery) {
+    return addSubscriber(Match::MessageId, messageId, 0, std::move(callback), delivery);
+}
+
+bool XbusDispatcher::subscribeFields(uint32_t fields, Callback callback, Delivery delivery) {
+    if (fields == 0) {
+        m_lastError = "No fields to subscribe to";
+        return false;
+    }
+    return addSubscriber(Match::Fields, XMID_MtData2, fields, std::move(callback), delivery);
+}
+
+bool XbusDispatcher::subscribeXdi(uint16_t xdi, Callback callback, Delivery delivery) {
+    uint32_t field = SensorField::fromXdi(xdi);
+    if (field == 0) {
+        m_lastError = "XDI is not decoded by XbusParser";
+        return false;
+    }
+    return addSubscriber(Match::Fields, XMID_MtData2, field, std::move(callback), delivery);
+}
+
+bool XbusDispatcher::subscribeAll(Callback callback, Delivery delivery) {
+    return addSubscriber(Match::All, 0, 0, std::move(callback), delivery);
+}
+
+bool XbusDispatcher::start() {
+    if (m_running.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    
+    if (m_hasWorkers && !m_frames) {
+        m_frames.reset(new XbusFramePool(m_config.poolSize));
+        m_largeFrames.reset(new LargeFramePool(m_config.largeFrames));
+        m_samples.reset(new SensorDataPool(m_config.poolSize));
+    }
+    
+    // Queues are closed by stop(), so every start gets new ones
+    for (std::unique_ptr<Subscriber>& subscriber : m_subscribers) {
+        if (subscriber->delivery == Delivery::Worker) {
+            subscriber->queue.reset(new SpscQueue<Envelope>(m_config.queueCapacity));
+            subscriber->thread = std::thread(&XbusDispatcher::workerLoop, this, std::ref(*subscriber));
+        }
+    }
+    
+    m_running.store(true, std::memory_order_release);
+    return true;
+}
+
+void XbusDispatcher::stop() {
+    m_running.store(false, std::memory_order_release);
+    for (std::unique_ptr<Subscriber>& subscriber : m_subscribers) {
+        if (subscriber->queue) {
+            subscriber->queue->close();
+        }
+        if (subscriber->thread.joinable()) {
+            subscriber->thread.join();
+        }
+    }
+}
+
+bool XbusDispatcher::isRunning() const {
+    return m_running.load(std::memory_order_acquire);
+}
+
+void XbusDispatcher::dispatch(size_t device, const XbusFrame& frame, uint64_t receiveTimeNs) {
+    if (!m_running.load(std::memory_order_acquire) || device >= m_decoders.size() ||
+        frame.size <= Xbus::OFFSET_TO_MID) {
+        return;
+    }
+    ++m_stats.frames;
+    
+    Message message;
+    message.device = device;
+    message.messageId = frame.data[Xbus::OFFSET_TO_MID];
+    message.receiveTimeNs = receiveTimeNs;
+    message.frame = frame;
+    message.sample = nullptr;
+    message.fields = 0;
+    
+    // Decoded once for everyone; into a pooled object when a worker may
+    // receive it
+    XbusLayoutDecoder& decoder = m_decoders[device];
+    SensorDataPool::Handle sample;
+    if (message.messageId == XMID_OutputConfig) {
+        decoder.learnFromOutputConfig(frame.data);
+    } else if (message.messageId == XMID_MtData2 && m_decodeMTData2) {
+        if (m_hasWorkers) {
+            sample = m_samples->acquire();
+        }
+        SensorData& target = sample ? *sample : m_sample;
+        if (decoder.decode(frame.data, frame.size, target)) {
+            ++m_stats.decoded;
+            message.sample = &target;
+            message.fields = SensorDataXdi::All::present(target);
+        } else {
+            ++m_stats.decodeErrors;
+            sample.reset();
+        }
+    }
+    
+    // The pooled frame copy is made for the first worker that wants it
+    Envelope envelope;
+    bool prepared = false;
+    bool envelopeReady = false;
+    bool matched = false;
+    for (std::unique_ptr<Subscriber>& subscriber : m_subscribers) {
+        if (!wants(*subscriber, message.messageId, message.fields)) {
+            continue;
+        }
+        matched = true;
+        
+        if (subscriber->delivery == Delivery::Inline) {
+            subscriber->callback(message);
+            ++m_stats.delivered;
+            continue;
+        }
+        
+        if (!prepared) {
+            prepared = true;
+            envelopeReady = prepare(envelope, message, sample);
+        }
+        if (envelopeReady && subscriber->queue->tryPush(envelope)) {
+            ++m_stats.delivered;
+        } else {
+            ++m_stats.dropped;
+        }
+    }
+    
+    if (!matched) {
+        ++m_stats.unmatched;
+    }
+}
+
+const XbusLayoutDecoder& XbusDispatcher::decoder(size_t device) const {
+    return m_decoders[device];
+}
+
+size_t XbusDispatcher::deviceCount() const {
+    return m_decoders.size();
+}
+
+size_t XbusDispatcher::subscriberCount() const {
+    return m_subscribers.size();
+}
+
+const XbusDispatcher::Stats& XbusDispatcher::stats() const {
+    return m_stats;
+}
+
+std::string XbusDispatcher::getLastError() const {
+    return m_lastError;
+}
+
+bool XbusDispatcher::addSubscriber(Match match, uint8_t messageId, uint32_t fields, Callback callback,
+                                   Delivery delivery) {
+    if (m_running.load(std::memory_order_relaxed)) {
+        m_lastError = "Subscriptions are fixed while the dispatcher is running";
+        return false;
+    }
+    if (!callback) {
+        m_lastError = "No callback";
+        return false;
+    }
+    
+    std::unique_ptr<Subscriber> subscriber(new Subscriber());
+    subscriber->match = match;
+    subscriber->messageId = messageId;
+    subscriber->fields = fields;
+    subscriber->delivery = delivery;
+    subscriber->callback = std::move(callback);
+    m_subscribers.push_back(std::move(subscriber));
+    
+    if (match != Match::MessageId || messageId == XMID_MtData2) {
+        m_decodeMTData2 = true;
+    }
+    if (delivery == Delivery::Worker) {
+        m_hasWorkers = true;
+    }
+    return true;
+}
+
+bool XbusDispatcher::wants(const Subscriber& subscriber, uint8_t messageId, uint32_t fields) const {
+    switch (subscriber.match) {
+        case Match::MessageId:
+            return subscriber.messageId == messageId;
+        case Match::Fields:
+            return (subscriber.fields & fields) != 0;
+        case Match::All:
+            return true;
+    }
+    return false;
+}
+
+bool XbusDispatcher::prepare(Envelope& envelope, const Message& message, SensorDataPool::Handle& sample) {
+    // A decoded sample that is not pooled (the pool ran out) cannot be
+    // handed to another thread
+    if (message.sample != nullptr && !sample) {
+        return false;
+    }
+    
+    if (message.frame.size <= XbusFrameSlot::CAPACITY) {
+        envelope.frame = m_frames->acquire();
+        if (!envelope.frame || !envelope.frame->assign(message.frame)) {
+            return false;
+        }
+    } else {
+        envelope.largeFrame = m_largeFrames->acquire();
+        if (!envelope.largeFrame || !envelope.largeFrame->assign(message.frame)) {
+            return false;
+        }
+    }
+    
+    envelope.device = message.device;
+    envelope.messageId = message.messageId;
+    envelope.receiveTimeNs = message.receiveTimeNs;
+    envelope.fields = message.fields;
+    envelope.sample = std::move(sample);
+    return true;
+}
+
+void XbusDispatcher::workerLoop(Subscriber& subscriber) {
+    Envelope envelope;
+    while (subscriber.queue->pop(envelope)) {
+        Message message;
+        message.device = envelope.device;
+        message.messageId = envelope.messageId;
+        message.receiveTimeNs = envelope.receiveTimeNs;
+        message.frame = envelope.frame ? envelope.frame->frame() : envelope.largeFrame->frame();
+        message.sample = envelope.sample.get();
+        message.fields = envelope.fields;
+        subscriber.callback(message);
+        
+        // Return the objects to the pools before waiting for the next one
+        envelope.reset();
+    }
+}
@@ -0,0 +1,181 @@
+#ifndef XBUS_DISPATCHER_H
+#define XBUS_DISPATCHER_H
+
+#include "xbus.h"
+#include "xbus_framer.h"
+#include "xbus_layout_decoder.h"
+#include "xbus_parser.h"
+#include "xbus_pool.h"
+#include "xbus_spsc_queue.h"
+#include "xbus_stats.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Publish/subscribe fan-out of received frames.
+//
+// Consumers subscribe to a message ID, to data items of MTData2 packets or
+// to every frame. dispatch() decodes an MTData2 packet once, with a layout
+// decoder per device that XMID_OutputConfig replies set up, and hands the
+// same frame and SensorData to every subscriber that wants them:
+//
+//     XbusDispatcher dispatcher;
+//     dispatcher.subscribe(XMID_DeviceId, printDeviceId);
+//     dispatcher.subscribeXdi(XDI::EULER_ANGLES, updateAttitude);
+//     dispatcher.subscribeAll(publishFrame, XbusDispatcher::Delivery::Worker);
+//     dispatcher.start();
+//     framer.feed(data, length, [&](const XbusFrame& frame) {
+//         dispatcher.dispatch(0, frame, receiveTimeNs);
+//     });
+//
+// Inline subscribers run on the thread calling dispatch(), in subscription
+// order, and see the framer's frame directly. Worker subscribers each run
+// on a thread of their own behind an SpscQueue. For them the frame is
+// copied once into a pooled buffer and the packet decoded into a pooled
+// SensorData (see XbusPool); every worker queue then gets a reference to
+// the same two objects, so nothing is copied or allocated per subscriber.
+// A full worker queue or exhausted pools drop the delivery and count it,
+// the dispatching thread never waits for a slow subscriber.
+//
+// Subscriptions are made while stopped and stay fixed while running.
+// dispatch() is for one thread at a time (e.g. the parse thread, or one
+// dispatcher per XbusDeviceManager I/O thread) and ignores frames while
+// stopped.
+class XbusDispatcher {
+public:
+    enum class Delivery {
+        Inline,     // on the thread calling dispatch()
+        Worker      // on a thread of the subscriber's own
+    };
+    
+    // What a subscriber receives, valid until the callback returns
+    struct Message {
+        size_t device;
+        uint8_t messageId;
+        uint64_t receiveTimeNs;     // as passed to dispatch()
+        XbusFrame frame;
+        const SensorData* sample;   // decoded MTData2 packet, nullptr for other messages or a failed decode
+        uint32_t fields;            // SensorField bits present in sample
+    };
+    
+    typedef std::function<void(const Message& message)> Callback;
+    
+    struct Config {
+        size_t deviceCount = 1;         // devices passed to dispatch(), each with its own decoder
+        size_t poolSize = 256;          // frames and samples in flight to worker subscribers
+        size_t largeFrames = 4;         // of those, frames with an extended length
+        size_t queueCapacity = 256;     // per worker subscriber
+    };
+    
+    // Written by the dispatching thread only
+    struct Stats {
+        RelaxedCounter frames;          // frames dispatched
+        RelaxedCounter decoded;         // MTData2 packets decoded
+        RelaxedCounter decodeErrors;    // MTData2 packets that did not decode
+        RelaxedCounter unmatched;       // frames no subscriber wanted
+        RelaxedCounter delivered;       // inline callbacks and worker deliveries queued
+        RelaxedCounter dropped;         // worker deliveries lost to a full queue or exhausted pools
+    };
+    
+    XbusDispatcher();
+    explicit XbusDispatcher(const Config& config);
+    ~XbusDispatcher();
+    
+    XbusDispatcher(const XbusDispatcher&) = delete;
+    XbusDispatcher& operator=(const XbusDispatcher&) = delete;
+    
+    // Frames with this message ID
+    bool subscribe(uint8_t messageId, Callback callback, Delivery delivery = Delivery::Inline);
+    
+    // Decoded MTData2 packets carrying any of the SensorField bits in fields
+    bool subscribeFields(uint32_t fields, Callback callback, Delivery delivery = Delivery::Inline);
+    
+    // subscribeFields() for one data item, in any of its formats. Fails for
+    // XDIs XbusParser does not decode.
+    bool subscribeXdi(uint16_t xdi, Callback callback, Delivery delivery = Delivery::Inline);
+    
+    // Every frame
+    bool subscribeAll(Callback callback, Delivery delivery = Delivery::Inline);
+    
+    // Start the worker threads. Subscriptions are fixed from here on.
+    bool start();
+    
+    // Let the workers finish what is queued and join them. The dispatching
+    // thread must have stopped calling dispatch().
+    void stop();
+    bool isRunning() const;
+    
+    // Deliver a verified frame (e.g. from XbusFramer) of device
+    void dispatch(size_t device, const XbusFrame& frame, uint64_t receiveTimeNs = 0);
+    
+    // The layout decoder of a device, e.g. for isLocked() or stats()
+    const XbusLayoutDecoder& decoder(size_t device) const;
+    
+    size_t deviceCount() const;
+    size_t subscriberCount() const;
+    const Stats& stats() const;
+    std::string getLastError() const;
+
+private:
+    typedef XbusFrameBuffer<Xbus::MAX_MESSAGE_SIZE> LargeFrameSlot;
+    typedef XbusPool<LargeFrameSlot> LargeFramePool;
+    
+    enum class Match {
+        MessageId,
+        Fields,
+        All
+    };
+    
+    // One delivery to a worker: references to the pooled frame and sample
+    struct Envelope {
+        size_t device = 0;
+        uint8_t messageId = 0;
+        uint64_t receiveTimeNs = 0;
+        uint32_t fields = 0;
+        XbusFramePool::Handle frame;
+        LargeFramePool::Handle largeFrame;
+        SensorDataPool::Handle sample;
+        
+        void reset();
+    };
+    
+    struct Subscriber {
+        Match match;
+        uint8_t messageId;
+        uint32_t fields;
+        Delivery delivery;
+        Callback callback;
+        std::unique_ptr<SpscQueue<Envelope>> queue;
+        std::thread thread;
+    };
+    
+    bool addSubscriber(Match match, uint8_t messageId, uint32_t fields, Callback callback, Delivery delivery);
+    bool wants(const Subscriber& subscriber, uint8_t messageId, uint32_t fields) const;
+    bool prepare(Envelope& envelope, const Message& message, SensorDataPool::Handle& sample);
+    void workerLoop(Subscriber& subscriber);
+    
+    Config m_config;
+    std::vector<XbusLayoutDecoder> m_decoders;
+    std::vector<std::unique_ptr<Subscriber>> m_subscribers;
+    bool m_decodeMTData2;       // some subscriber can receive MTData2 packets
+    bool m_hasWorkers;
+    std::atomic<bool> m_running;
+    
+    // Created by start() when there are worker subscribers
+    std::unique_ptr<XbusFramePool> m_frames;
+    std::unique_ptr<LargeFramePool> m_largeFrames;
+    std::unique_ptr<SensorDataPool> m_samples;
+    
+    // Decode target when no pooled sample is needed or left
+    SensorData m_sample;
+    
+    Stats m_stats;
+    std::string m_lastError;
+};
+
+#endif // XBUS_DISPATCHER_H
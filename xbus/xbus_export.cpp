@@ -0,0 +1,625 @@
+#include "xbus_export.h"
+#include "xbus_text_writer.h"
+#include <cerrno>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+std::string errnoString() {
+    return std::string(strerror(errno)) + " (errno " + std::to_string(errno) + ")";
+}
+
+// Calls visit(field, name, column) for every value column of the given
+// SensorField bits, in bit order. Shared by all formats so they agree on
+// column order and names.
+template <typename Columns, typename Visitor>
+void visitColumns(Columns& columns, uint32_t fields, Visitor&& visit) {
+    SensorDataXdi::All::visitColumns(columns, fields, visit);
+}
+
+// Every SensorField bit visitColumns knows about
+constexpr uint32_t ALL_FIELDS = SensorDataXdi::All::allFields();
+
+// Longest CSV row: every column filled with its longest value
+constexpr size_t MAX_CSV_ROW = 1024;
+
+void writeCsvValue(XbusTextWriter& out, uint8_t value) { out.appendUnsigned(value); }
+void writeCsvValue(XbusTextWriter& out, uint16_t value) { out.appendUnsigned(value); }
+void writeCsvValue(XbusTextWriter& out, uint32_t value) { out.appendUnsigned(value); }
+void writeCsvValue(XbusTextWriter& out, float value) { out.appendNumber(value); }
+void writeCsvValue(XbusTextWriter& out, double value) { out.appendNumber(value); }
+
+void writeCsvValue(XbusTextWriter& out, const UtcTime& utc) {
+    out.appendUnsigned(utc.year, 4);
+    out.append('-');
+    out.appendUnsigned(utc.month, 2);
+    out.append('-');
+    out.appendUnsigned(utc.day, 2);
+    out.append('T');
+    out.appendUnsigned(utc.hour, 2);
+    out.append(':');
+    out.appendUnsigned(utc.minute, 2);
+    out.append(':');
+    out.appendUnsigned(utc.second, 2);
+    out.append('.');
+    out.appendUnsigned(utc.nanoseconds, 9);
+}
+
+// Little-endian fixed-width values of the column format
+template <typename T>
+void writeLe(uint8_t* dest, T value) {
+    typedef typename std::conditional<sizeof(T) == 8, uint64_t,
+            typename std::conditional<sizeof(T) == 4, uint32_t,
+            typename std::conditional<sizeof(T) == 2, uint16_t, uint8_t>::type>::type>::type Bits;
+    Bits bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (size_t i = 0; i < sizeof(bits); i++) {
+        dest[i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+template <typename T>
+T readLe(const uint8_t* src) {
+    typedef typename std::conditional<sizeof(T) == 8, uint64_t,
+            typename std::conditional<sizeof(T) == 4, uint32_t,
+            typename std::conditional<sizeof(T) == 2, uint16_t, uint8_t>::type>::type>::type Bits;
+    Bits bits = 0;
+    for (size_t i = sizeof(bits); i-- > 0;) {
+        bits = static_cast<Bits>((bits << 8) | src[i]);
+    }
+    T value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+template <typename T>
+size_t valueSize(const std::vector<T>&) {
+    return sizeof(T);
+}
+
+size_t valueSize(const std::vector<UtcTime>&) {
+    return XbusColumnFormat::UTC_TIME_SIZE;
+}
+
+template <typename T>
+void writeColumn(uint8_t* dest, const std::vector<T>& column) {
+    for (size_t row = 0; row < column.size(); row++) {
+        writeLe(dest + row * sizeof(T), column[row]);
+    }
+}
+
+void writeColumn(uint8_t* dest, const std::vector<UtcTime>& column) {
+    for (const UtcTime& utc : column) {
+        writeLe(dest, utc.nanoseconds);
+        writeLe(dest + 4, utc.year);
+        dest[6] = utc.month;
+        dest[7] = utc.day;
+        dest[8] = utc.hour;
+        dest[9] = utc.minute;
+        dest[10] = utc.second;
+        dest[11] = utc.flags;
+        dest += XbusColumnFormat::UTC_TIME_SIZE;
+    }
+}
+
+template <typename T>
+void readColumn(const uint8_t* src, std::vector<T>& column, size_t first) {
+    for (size_t row = first; row < column.size(); row++, src += sizeof(T)) {
+        column[row] = readLe<T>(src);
+    }
+}
+
+void readColumn(const uint8_t* src, std::vector<UtcTime>& column, size_t first) {
+    for (size_t row = first; row < column.size(); row++, src += XbusColumnFormat::UTC_TIME_SIZE) {
+        column[row] = UtcTime(readLe<uint32_t>(src), readLe<uint16_t>(src + 4),
+                              src[6], src[7], src[8], src[9], src[10], src[11]);
+    }
+}
+
+} // namespace
+
+// XbusFileSink
+
+XbusFileSink::XbusFileSink(uint32_t fields, size_t bufferSize)
+    : m_file(nullptr)
+    , m_buffer(bufferSize > MAX_CSV_ROW ? bufferSize : MAX_CSV_ROW)
+    , m_used(0)
+    , m_requestedFields(fields & ALL_FIELDS)
+    , m_fields(m_requestedFields)
+    , m_headerWritten(false)
+    , m_rowsWritten(0)
+    , m_bytesWritten(0) {
+}
+
+XbusFileSink::~XbusFileSink() {
+    // The derived sink already closed the file; writeHeader() is gone by now
+    if (m_file) {
+        writeBuffer();
+        std::fclose(m_file);
+    }
+}
+
+bool XbusFileSink::open(const std::string& path) {
+    close();
+    
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file) {
+        setLastError("Failed to create " + path + ": " + errnoString());
+        return false;
+    }
+    
+    m_used = 0;
+    m_fields = m_requestedFields;
+    m_headerWritten = false;
+    m_rowsWritten = 0;
+    m_bytesWritten = 0;
+    return true;
+}
+
+bool XbusFileSink::isOpen() const {
+    return m_file != nullptr;
+}
+
+bool XbusFileSink::write(const SensorDataColumns& batch) {
+    if (!m_file) {
+        setLastError("Sink is not open");
+        return false;
+    }
+    
+    if (!m_headerWritten) {
+        if (m_fields == 0) {
+            for (uint32_t presence : batch.presence) {
+                m_fields |= presence;
+            }
+            m_fields &= ALL_FIELDS;
+        }
+        
+        // Nothing to export yet; choose the columns from a later batch
+        if (m_fields == 0) {
+            return true;
+        }
+        
+        if (!writeHeader()) {
+            return false;
+        }
+        m_headerWritten = true;
+    }
+    
+    if (batch.size() == 0) {
+        return true;
+    }
+    
+    if (!writeRows(batch)) {
+        return false;
+    }
+    m_rowsWritten += batch.size();
+    return true;
+}
+
+bool XbusFileSink::close() {
+    if (!m_file) {
+        return true;
+    }
+    
+    // An export without any rows still gets its header
+    bool ok = m_headerWritten || writeHeader();
+    ok = writeBuffer() && ok;
+    if (std::fclose(m_file) != 0 && ok) {
+        setLastError("Failed to close export file: " + errnoString());
+        ok = false;
+    }
+    m_file = nullptr;
+    return ok;
+}
+
+std::string XbusFileSink::getLastError() const {
+    return m_lastError;
+}
+
+uint32_t XbusFileSink::fields() const {
+    return m_fields;
+}
+
+uint64_t XbusFileSink::rowsWritten() const {
+    return m_rowsWritten;
+}
+
+uint64_t XbusFileSink::bytesWritten() const {
+    return m_bytesWritten;
+}
+
+bool XbusFileSink::reserve(size_t size) {
+    if (size <= m_buffer.size() - m_used) {
+        return true;
+    }
+    if (!writeBuffer()) {
+        return false;
+    }
+    if (size > m_buffer.size()) {
+        m_buffer.resize(size);
+    }
+    return true;
+}
+
+uint8_t* XbusFileSink::bufferEnd() {
+    return m_buffer.data() + m_used;
+}
+
+size_t XbusFileSink::bufferFree() const {
+    return m_buffer.size() - m_used;
+}
+
+void XbusFileSink::commit(size_t size) {
+    m_used += size;
+    m_bytesWritten += size;
+}
+
+bool XbusFileSink::append(const void* data, size_t size) {
+    if (!reserve(size)) {
+        return false;
+    }
+    memcpy(bufferEnd(), data, size);
+    commit(size);
+    return true;
+}
+
+void XbusFileSink::setLastError(const std::string& error) {
+    m_lastError = error;
+}
+
+bool XbusFileSink::writeBuffer() {
+    if (m_used == 0) {
+        return true;
+    }
+    
+    size_t used = m_used;
+    m_used = 0;
+    if (std::fwrite(m_buffer.data(), 1, used, m_file) != used) {
+        setLastError("Failed to write export file: " + errnoString());
+        return false;
+    }
+    return true;
+}
+
+// XbusCsvSink
+
+XbusCsvSink::XbusCsvSink(uint32_t fields, size_t bufferSize)
+    : XbusFileSink(fields, bufferSize) {
+}
+
+XbusCsvSink::~XbusCsvSink() {
+    close();
+}
+
+bool XbusCsvSink::writeHeader() {
+    std::string header;
+    SensorDataColumns names;
+    visitColumns(names, fields(), [&header](uint32_t, const char* name, const auto&) {
+        if (!header.empty()) {
+            header += ',';
+        }
+        header += name;
+    });
+    if (header.empty()) {
+        return true;
+    }
+    header += '\n';
+    return append(header.data(), header.size());
+}
+
+bool XbusCsvSink::writeRows(const SensorDataColumns& batch) {
+    const uint32_t exported = fields();
+    for (size_t row = 0; row < batch.size(); row++) {
+        if (!reserve(MAX_CSV_ROW)) {
+            return false;
+        }
+        
+        XbusTextWriter out(reinterpret_cast<char*>(bufferEnd()), bufferFree());
+        const uint32_t presence = batch.presence[row];
+        bool first = true;
+        visitColumns(batch, exported, [&](uint32_t field, const char*, const auto& column) {
+            if (!first) {
+                out.append(',');
+            }
+            first = false;
+            if (presence & field) {
+                writeCsvValue(out, column[row]);
+            }
+        });
+        out.append('\n');
+        
+        if (out.truncated()) {
+            setLastError("CSV row too long");
+            return false;
+        }
+        commit(out.size());
+    }
+    return true;
+}
+
+// XbusColumnSink
+
+size_t XbusColumnFormat::rowSize(uint32_t fields) {
+    size_t size = sizeof(uint32_t);
+    const SensorDataColumns columns;
+    visitColumns(columns, fields, [&size](uint32_t, const char*, const auto& column) {
+        size += valueSize(column);
+    });
+    return size;
+}
+
+XbusColumnSink::XbusColumnSink(uint32_t fields, size_t bufferSize)
+    : XbusFileSink(fields, bufferSize) {
+}
+
+XbusColumnSink::~XbusColumnSink() {
+    close();
+}
+
+bool XbusColumnSink::writeHeader() {
+    uint8_t header[XbusColumnFormat::FILE_HEADER_SIZE];
+    memcpy(header, XbusColumnFormat::MAGIC, sizeof(XbusColumnFormat::MAGIC));
+    writeLe(header + 8, XbusColumnFormat::VERSION);
+    writeLe(header + 12, fields());
+    return append(header, sizeof(header));
+}
+
+bool XbusColumnSink::writeRows(const SensorDataColumns& batch) {
+    const size_t rows = batch.size();
+    const size_t blockSize = sizeof(uint32_t) + rows * XbusColumnFormat::rowSize(fields());
+    if (!reserve(blockSize)) {
+        return false;
+    }
+    
+    uint8_t* dest = bufferEnd();
+    writeLe(dest, static_cast<uint32_t>(rows));
+    dest += sizeof(uint32_t);
+    writeColumn(dest, batch.presence);
+    dest += rows * sizeof(uint32_t);
+    visitColumns(batch, fields(), [&dest, rows](uint32_t, const char*, const auto& column) {
+        writeColumn(dest, column);
+        dest += rows * valueSize(column);
+    });
+    
+    commit(blockSize);
+    return true;
+}
+
+// XbusColumnReader
+
+bool XbusColumnReader::read(const std::string& path, SensorDataColumns& columns) {
+    m_fields = 0;
+    m_truncated = false;
+    
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        setLastError("Failed to open " + path + ": " + errnoString());
+        return false;
+    }
+    
+    uint8_t header[XbusColumnFormat::FILE_HEADER_SIZE];
+    if (std::fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, XbusColumnFormat::MAGIC, sizeof(XbusColumnFormat::MAGIC)) != 0) {
+        setLastError(path + " is not a column export");
+        std::fclose(file);
+        return false;
+    }
+    if (readLe<uint32_t>(header + 8) != XbusColumnFormat::VERSION) {
+        setLastError("Unsupported column export version");
+        std::fclose(file);
+        return false;
+    }
+    m_fields = readLe<uint32_t>(header + 12);
+    if ((m_fields & ~ALL_FIELDS) != 0) {
+        setLastError("Column export contains unknown fields");
+        std::fclose(file);
+        return false;
+    }
+    
+    // A row count is only trusted as far as the rest of the file can hold it
+    long fileSize = -1;
+    if (std::fseek(file, 0, SEEK_END) == 0) {
+        fileSize = std::ftell(file);
+    }
+    if (fileSize < 0 || std::fseek(file, XbusColumnFormat::FILE_HEADER_SIZE, SEEK_SET) != 0) {
+        setLastError("Failed to size " + path + ": " + errnoString());
+        std::fclose(file);
+        return false;
+    }
+    size_t remaining = static_cast<size_t>(fileSize) - XbusColumnFormat::FILE_HEADER_SIZE;
+    
+    const size_t rowSize = XbusColumnFormat::rowSize(m_fields);
+    std::vector<uint8_t> block;
+    uint8_t count[4];
+    size_t got;
+    while ((got = std::fread(count, 1, sizeof(count), file)) == sizeof(count)) {
+        remaining -= sizeof(count);
+        const size_t rows = readLe<uint32_t>(count);
+        if (rows > remaining / rowSize) {
+            m_truncated = true;
+            break;
+        }
+        block.resize(rows * rowSize);
+        remaining -= block.size();
+        if (std::fread(block.data(), 1, block.size(), file) != block.size()) {
+            m_truncated = true;
+            break;
+        }
+        
+        const size_t first = columns.size();
+        for (size_t row = 0; row < rows; row++) {
+            columns.appendRow();
+        }
+        
+        const uint8_t* src = block.data();
+        readColumn(src, columns.presence, first);
+        src += rows * sizeof(uint32_t);
+        visitColumns(columns, m_fields, [&src, rows, first](uint32_t, const char*, auto& column) {
+            readColumn(src, column, first);
+            src += rows * valueSize(column);
+        });
+    }
+    m_truncated = m_truncated || got != 0;
+    
+    std::fclose(file);
+    return true;
+}
+
+uint32_t XbusColumnReader::fields() const {
+    return m_fields;
+}
+
+bool XbusColumnReader::truncated() const {
+    return m_truncated;
+}
+
+std::string XbusColumnReader::getLastError() const {
+    return m_lastError;
+}
+
+void XbusColumnReader::setLastError(const std::string& error) {
+    m_lastError = error;
+}
+
+// XbusAsyncSink
+
+XbusAsyncSink::XbusAsyncSink(XbusSampleSink& sink, size_t batchRows)
+    : m_sink(sink)
+    , m_batchRows(batchRows > 0 ? batchRows : 1)
+    , m_front(0)
+    , m_backFull(false)
+    , m_stopping(false)
+    , m_failed(false)
+    , m_closed(false)
+    , m_stats() {
+    m_buffers[0].reserve(m_batchRows);
+    m_buffers[1].reserve(m_batchRows);
+}
+
+XbusAsyncSink::~XbusAsyncSink() {
+    close();
+}
+
+bool XbusAsyncSink::start() {
+    if (m_thread.joinable()) {
+        return true;
+    }
+    
+    m_stopping = false;
+    m_failed = false;
+    m_closed = false;
+    m_thread = std::thread(&XbusAsyncSink::writerLoop, this);
+    return true;
+}
+
+bool XbusAsyncSink::add(const SensorData& sample) {
+    m_buffers[m_front].append(sample);
+    if (m_buffers[m_front].size() >= m_batchRows) {
+        return handOff();
+    }
+    return true;
+}
+
+bool XbusAsyncSink::write(const SensorDataColumns& batch) {
+    m_buffers[m_front].append(batch);
+    if (m_buffers[m_front].size() >= m_batchRows) {
+        return handOff();
+    }
+    return true;
+}
+
+bool XbusAsyncSink::close() {
+    if (m_closed) {
+        return !m_failed;
+    }
+    m_closed = true;
+    
+    if (!m_thread.joinable()) {
+        // Never started: write what was collected on this thread
+        bool ok = m_buffers[m_front].size() == 0 || m_sink.write(m_buffers[m_front]);
+        m_buffers[m_front].clear();
+        ok = m_sink.close() && ok;
+        if (!ok) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_failed = true;
+            m_lastError = m_sink.getLastError();
+        }
+        return ok;
+    }
+    
+    bool ok = m_buffers[m_front].size() == 0 || handOff();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_sink.close() && !m_failed) {
+        m_failed = true;
+        m_lastError = m_sink.getLastError();
+    }
+    return ok && !m_failed;
+}
+
+std::string XbusAsyncSink::getLastError() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
+
+XbusAsyncSink::Stats XbusAsyncSink::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+bool XbusAsyncSink::handOff() {
+    if (!m_thread.joinable()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_lastError = "Export thread is not running";
+        return false;
+    }
+    
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_backFull && !m_failed) {
+        m_stats.producerWaits++;
+        m_condition.wait(lock, [this] { return !m_backFull || m_failed; });
+    }
+    if (m_failed) {
+        m_buffers[m_front].clear();
+        return false;
+    }
+    
+    m_stats.rows += m_buffers[m_front].size();
+    m_stats.batches++;
+    m_front ^= 1;
+    m_backFull = true;
+    lock.unlock();
+    m_condition.notify_all();
+    return true;
+}
+
+void XbusAsyncSink::writerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_condition.wait(lock, [this] { return m_backFull || m_stopping; });
+        if (!m_backFull) {
+            break;
+        }
+        
+        // The producer only touches the front buffer
+        SensorDataColumns& back = m_buffers[m_front ^ 1];
+        lock.unlock();
+        bool ok = m_sink.write(back);
+        back.clear();
+        lock.lock();
+        
+        if (!ok && !m_failed) {
+            m_failed = true;
+            m_lastError = m_sink.getLastError();
+        }
+        m_backFull = false;
+        m_condition.notify_all();
+    }
+}
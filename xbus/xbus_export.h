@@ -0,0 +1,208 @@
+#ifndef XBUS_EXPORT_H
+#define XBUS_EXPORT_H
+
+#include "xbus_parser.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Export of decoded samples for offline analysis.
+//
+// A sink takes batches of rows as SensorDataColumns (fill them with
+// XbusParser::parseMTData2Batch or SensorDataColumns::append) and writes
+// them out. The file sinks pick their columns from the SensorField bits:
+// either given up front, or the fields present in the first batch written.
+// Fields that first appear later are not exported.
+class XbusSampleSink {
+public:
+    virtual ~XbusSampleSink() {}
+    
+    // Write all rows of a batch; the batch may be reused once this returns
+    virtual bool write(const SensorDataColumns& batch) = 0;
+    
+    // Write everything still buffered and close the output
+    virtual bool close() = 0;
+    
+    virtual std::string getLastError() const = 0;
+};
+
+// Common part of the file sinks: a large write buffer in front of the file,
+// written once per buffer instead of once per row (1 MiB by default)
+class XbusFileSink : public XbusSampleSink {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+    
+    ~XbusFileSink() override;
+    
+    XbusFileSink(const XbusFileSink&) = delete;
+    XbusFileSink& operator=(const XbusFileSink&) = delete;
+    
+    // Create (or truncate) the output file
+    bool open(const std::string& path);
+    bool isOpen() const;
+    
+    bool write(const SensorDataColumns& batch) override;
+    bool close() override;
+    std::string getLastError() const override;
+    
+    // Exported SensorField bits, 0 until the first batch chose them
+    uint32_t fields() const;
+    uint64_t rowsWritten() const;
+    uint64_t bytesWritten() const;
+
+protected:
+    XbusFileSink(uint32_t fields, size_t bufferSize);
+    
+    // Called once before the first rows, with fields() already set
+    virtual bool writeHeader() = 0;
+    virtual bool writeRows(const SensorDataColumns& batch) = 0;
+    
+    // Room for at least size more bytes at bufferEnd(), flushing if needed
+    bool reserve(size_t size);
+    uint8_t* bufferEnd();
+    size_t bufferFree() const;
+    void commit(size_t size);
+    bool append(const void* data, size_t size);
+    void setLastError(const std::string& error);
+
+private:
+    bool writeBuffer();
+    
+    std::FILE* m_file;
+    std::vector<uint8_t> m_buffer;
+    size_t m_used;
+    uint32_t m_requestedFields;
+    uint32_t m_fields;
+    bool m_headerWritten;
+    uint64_t m_rowsWritten;
+    uint64_t m_bytesWritten;
+    std::string m_lastError;
+};
+
+// Comma separated text, one row per sample and a header line with the
+// column names. Absent values are empty cells, numbers are written in the
+// shortest form that reads back to the same value, UTC as ISO 8601.
+class XbusCsvSink : public XbusFileSink {
+public:
+    explicit XbusCsvSink(uint32_t fields = 0, size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    ~XbusCsvSink() override;
+
+protected:
+    bool writeHeader() override;
+    bool writeRows(const SensorDataColumns& batch) override;
+};
+
+// Compact binary columns, little-endian throughout:
+//
+//     file header  16 bytes  "XBUSCOL1", version, exported SensorField bits
+//     block         4 bytes  row count N
+//                   N x 4    presence bits per row
+//                   N x w    one column per exported value, in SensorField
+//                            bit order (e.g. roll, pitch, yaw, then the
+//                            1 byte Euler angle format bits), each value
+//                            w bytes wide as in SensorDataColumns; UtcTime
+//                            is 12 bytes (ns, year, month ... second, flags)
+//     block ...
+//
+// Every write() produces one block. XbusColumnReader reads the file back.
+namespace XbusColumnFormat {
+
+constexpr char MAGIC[8] = {'X', 'B', 'U', 'S', 'C', 'O', 'L', '1'};
+constexpr uint32_t VERSION = 2;
+constexpr size_t FILE_HEADER_SIZE = 16;
+constexpr size_t UTC_TIME_SIZE = 12;
+
+// Bytes per row of a block exporting the given fields, presence included
+size_t rowSize(uint32_t fields);
+
+} // namespace XbusColumnFormat
+
+class XbusColumnSink : public XbusFileSink {
+public:
+    explicit XbusColumnSink(uint32_t fields = 0, size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    ~XbusColumnSink() override;
+
+protected:
+    bool writeHeader() override;
+    bool writeRows(const SensorDataColumns& batch) override;
+};
+
+class XbusColumnReader {
+public:
+    // Read a whole column file, appending its rows to columns. A file cut
+    // off inside a block, or a row count larger than the rest of the file,
+    // keeps the complete blocks before it.
+    bool read(const std::string& path, SensorDataColumns& columns);
+    
+    uint32_t fields() const;
+    bool truncated() const;
+    std::string getLastError() const;
+
+private:
+    void setLastError(const std::string& error);
+    
+    uint32_t m_fields = 0;
+    bool m_truncated = false;
+    std::string m_lastError;
+};
+
+// Moves the writing of another sink to a background thread.
+//
+// Rows are collected in one of two buffers; when it holds batchRows rows
+// it is handed to the writer thread and collection continues in the other
+// one. The producer only waits if the writer is still busy with the
+// previous buffer, so no rows are ever dropped. Call close() (or destroy
+// the sink) to write the last partial batch and close the target sink.
+class XbusAsyncSink : public XbusSampleSink {
+public:
+    static constexpr size_t DEFAULT_BATCH_ROWS = 4096;
+    
+    struct Stats {
+        uint64_t rows;
+        uint64_t batches;       // handed to the writer thread
+        uint64_t producerWaits; // times the producer waited for the writer
+    };
+    
+    explicit XbusAsyncSink(XbusSampleSink& sink, size_t batchRows = DEFAULT_BATCH_ROWS);
+    ~XbusAsyncSink() override;
+    
+    XbusAsyncSink(const XbusAsyncSink&) = delete;
+    XbusAsyncSink& operator=(const XbusAsyncSink&) = delete;
+    
+    // Start the writer thread
+    bool start();
+    
+    // Append one sample or a batch; false once the target sink failed
+    bool add(const SensorData& sample);
+    bool write(const SensorDataColumns& batch) override;
+    
+    bool close() override;
+    std::string getLastError() const override;
+    Stats stats() const;
+
+private:
+    bool handOff();
+    void writerLoop();
+    
+    XbusSampleSink& m_sink;
+    size_t m_batchRows;
+    SensorDataColumns m_buffers[2];
+    size_t m_front;             // buffer the producer fills
+    
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_backFull;            // the other buffer waits for or is being written
+    bool m_stopping;
+    bool m_failed;
+    bool m_closed;
+    std::thread m_thread;
+    std::string m_lastError;
+    Stats m_stats;
+};
+
+#endif // XBUS_EXPORT_H
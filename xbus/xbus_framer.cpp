@@ -0,0 +1,145 @@
+#include "xbus_framer.h"
+#include "xbus_simd.h"
+#include <algorithm>
+#include <cstring>
+
+XbusFramer::XbusFramer(size_t capacity)
+    : m_buffer(std::max<size_t>(capacity, Xbus::OFFSET_TO_PAYLOAD_EXT + Xbus::XBUS_CHECKSUM_SIZE))
+    , m_head(0)
+    , m_tail(0)
+    , m_summed(0)
+    , m_checksum(0) {
+}
+
+size_t XbusFramer::write(const uint8_t* data, size_t length) {
+    if (m_buffer.size() - m_tail < length && m_head > 0) {
+        compact();
+    }
+    
+    size_t toCopy = std::min(length, m_buffer.size() - m_tail);
+    if (toCopy > 0) {
+        memcpy(m_buffer.data() + m_tail, data, toCopy);
+        m_tail += toCopy;
+        m_stats.bytesReceived += toCopy;
+        m_stats.bufferHighWater.updateMax(m_tail - m_head);
+    }
+    return toCopy;
+}
+
+bool XbusFramer::nextFrame(XbusFrame& frame) {
+    while (m_head < m_tail) {
+        const uint8_t* start = m_buffer.data() + m_head;
+        size_t available = m_tail - m_head;
+        
+        // Skip to the next preamble
+        if (*start != Xbus::XBUS_PREAMBLE) {
+            const void* preamble = memchr(start, Xbus::XBUS_PREAMBLE, available);
+            size_t skipped = (preamble == nullptr)
+                ? available : static_cast<size_t>(static_cast<const uint8_t*>(preamble) - start);
+            m_stats.bytesSkipped += skipped;
+            m_head += skipped;
+            continue;
+        }
+        
+        // Reject a false preamble on its header, before waiting for a body of
+        // whatever length it announces
+        if (available > Xbus::OFFSET_TO_BID && start[Xbus::OFFSET_TO_BID] != Xbus::XBUS_MASTERDEVICE) {
+            ++m_stats.headerErrors;
+            resync();
+            continue;
+        }
+        
+        // Wait for the full header (extended length needs two more bytes)
+        if (available < Xbus::OFFSET_TO_PAYLOAD) {
+            return false;
+        }
+        bool extended = start[Xbus::OFFSET_TO_LEN] == Xbus::LENGTH_EXTENDER_BYTE;
+        size_t headerLength = extended ? Xbus::OFFSET_TO_PAYLOAD_EXT : Xbus::OFFSET_TO_PAYLOAD;
+        if (available < headerLength) {
+            return false;
+        }
+        
+        // Payloads up to 254 bytes always use the short length
+        if (extended && Xbus::getPayloadLength(start) < Xbus::LENGTH_EXTENDER_BYTE) {
+            ++m_stats.headerErrors;
+            resync();
+            continue;
+        }
+        
+        size_t rawLength = static_cast<size_t>(Xbus::getRawLength(start));
+        if (rawLength > m_buffer.size()) {
+            ++m_stats.lengthErrors;
+            resync();
+            continue;
+        }
+        
+        // The checksum covers BID through the checksum byte. Bytes of a
+        // partial frame are summed as they arrive, so a frame completed by
+        // many small reads is not walked again.
+        size_t end = std::min(available, rawLength);
+        m_checksum = static_cast<uint8_t>(m_checksum + XbusSimd::byteSum(start + 1 + m_summed, end - 1 - m_summed));
+        m_summed = end - 1;
+        if (available < rawLength) {
+            return false;
+        }
+        
+        if (m_checksum != 0) {
+            ++m_stats.checksumErrors;
+            resync();
+            continue;
+        }
+        
+        m_head += rawLength;
+        clearChecksum();
+        ++m_stats.framesOk;
+        frame = XbusFrame(start, rawLength);
+        return true;
+    }
+    
+    // Everything consumed; rewind so the next write needs no compaction.
+    // Views handed out above stay valid because no bytes are moved here.
+    m_head = 0;
+    m_tail = 0;
+    return false;
+}
+
+void XbusFramer::reset() {
+    m_head = 0;
+    m_tail = 0;
+    clearChecksum();
+}
+
+size_t XbusFramer::capacity() const {
+    return m_buffer.size();
+}
+
+size_t XbusFramer::buffered() const {
+    return m_tail - m_head;
+}
+
+const XbusFramer::Stats& XbusFramer::stats() const {
+    return m_stats;
+}
+
+void XbusFramer::resync() {
+    // The preamble was false; a real frame may start anywhere after it, so
+    // rescan the bytes already buffered instead of discarding them.
+    ++m_stats.resyncs;
+    ++m_stats.bytesSkipped;
+    m_head++;
+    clearChecksum();
+}
+
+void XbusFramer::clearChecksum() {
+    m_summed = 0;
+    m_checksum = 0;
+}
+
+void XbusFramer::compact() {
+    size_t remaining = m_tail - m_head;
+    if (remaining > 0) {
+        memmove(m_buffer.data(), m_buffer.data() + m_head, remaining);
+    }
+    m_head = 0;
+    m_tail = remaining;
+}
@@ -0,0 +1,114 @@
+#ifndef XBUS_FRAMER_H
+#define XBUS_FRAMER_H
+
+#include "xbus.h"
+#include "xbus_stats.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Non-owning view of one complete Xbus frame (preamble through checksum).
+// The view points into the framer's buffer and stays valid until the next
+// call to XbusFramer::write(), feed() or reset().
+struct XbusFrame {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    
+    XbusFrame() = default;
+    XbusFrame(const uint8_t* d, size_t s) : data(d), size(s) {}
+    
+    const uint8_t* begin() const { return data; }
+    const uint8_t* end() const { return data + size; }
+    bool empty() const { return size == 0; }
+};
+
+// Splits a raw serial byte stream into verified Xbus frames.
+//
+// Incoming bytes are copied once into a fixed buffer that is allocated at
+// construction. Frames are located with memchr on the preamble, their length
+// is taken from the header and the checksum is verified before a view of the
+// frame is handed out. The header is checked before the framer waits for
+// the rest of a frame: the bus ID must be XBUS_MASTERDEVICE and an extended
+// length must be one the short form cannot express. The checksum is summed (XbusSimd::byteSum) over the
+// bytes of the pending frame as they are buffered, so it is known as soon as
+// the last byte arrives. When the length or checksum check fails, scanning
+// resumes at the byte after the rejected preamble, so a frame that started
+// inside the bad one is still found. Unconsumed bytes are moved to the front
+// of the buffer only when the free space at the end runs out, so every frame
+// is contiguous.
+//
+// A false preamble with a plausible header stalls delivery until as many
+// bytes as its length arrived and the checksum fails, so the capacity bounds
+// that stall. The default holds every common output configuration;
+// MAX_CAPACITY takes the largest extended-length frame (65535 byte payload)
+// at the cost of stalls of up to 64 KiB (0.7 s at 921600 baud).
+class XbusFramer {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+    static constexpr size_t MAX_CAPACITY = Xbus::MAX_MESSAGE_SIZE;
+    
+    // Updated by the thread that feeds the framer, readable from any thread
+    // (see xbus_stats.h)
+    struct Stats {
+        RelaxedCounter bytesReceived;
+        RelaxedCounter framesOk;
+        RelaxedCounter checksumErrors;
+        RelaxedCounter lengthErrors;     // declared length larger than the buffer
+        RelaxedCounter headerErrors;     // bus ID other than 0xFF or an extended length below 255
+        RelaxedCounter resyncs;          // false preambles rejected
+        RelaxedCounter bytesSkipped;     // bytes discarded while searching for a frame
+        RelaxedCounter bufferHighWater;  // most bytes buffered at once
+    };
+    
+    // capacity is also the largest raw frame the framer accepts
+    explicit XbusFramer(size_t capacity = DEFAULT_CAPACITY);
+    
+    // Append raw bytes. Returns the number of bytes accepted, which is less
+    // than length only when the buffer is full; call nextFrame() to make room.
+    size_t write(const uint8_t* data, size_t length);
+    
+    // Extract the next verified frame from the buffered bytes.
+    // Returns false when no complete frame is available yet.
+    bool nextFrame(XbusFrame& frame);
+    
+    // Write all bytes and invoke onFrame(const XbusFrame&) for every complete
+    // frame. Returns the number of frames delivered.
+    template <typename Callback>
+    size_t feed(const uint8_t* data, size_t length, Callback&& onFrame) {
+        size_t frames = 0;
+        size_t consumed = 0;
+        XbusFrame frame;
+        while (consumed < length) {
+            consumed += write(data + consumed, length - consumed);
+            while (nextFrame(frame)) {
+                onFrame(frame);
+                frames++;
+            }
+        }
+        return frames;
+    }
+    
+    // Drop all buffered bytes (statistics are kept)
+    void reset();
+    
+    size_t capacity() const;
+    size_t buffered() const;
+    const Stats& stats() const;
+
+private:
+    void resync();
+    void compact();
+    void clearChecksum();
+    
+    std::vector<uint8_t> m_buffer;
+    size_t m_head;
+    size_t m_tail;
+    
+    // Running checksum of the frame starting at m_head: bytes 1..m_summed
+    // are added into m_checksum
+    size_t m_summed;
+    uint8_t m_checksum;
+    Stats m_stats;
+};
+
+#endif // XBUS_FRAMER_H
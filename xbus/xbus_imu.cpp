@@ -0,0 +1,60 @@
+#include "xbus_imu.h"
+#include "xbus.h"
+#include "xbus_message_id.h"
+
+uint32_t XbusImu::decode(const uint8_t* xbusData, ImuSample& sample) {
+    if (!Xbus::checkPreamble(xbusData) || Xbus::getMessageId(xbusData) != XMID_MtData2) {
+        return 0;
+    }
+    
+    ImuSampleXdi::All::clear(sample, FIELDS);
+    
+    int payloadLength = Xbus::getPayloadLength(xbusData);
+    const uint8_t* payload = Xbus::getConstPointerToPayload(xbusData);
+    
+    // Same item walk as XbusParser::parseMTData2Fields
+    uint32_t found = 0;
+    int index = 0;
+    while (index + 3 <= payloadLength && found != FIELDS) {
+        uint16_t xdi = XbusParser::readUint16(payload, index);
+        uint8_t size = XbusParser::readUint8(payload, index);
+        
+        if (index + size > payloadLength) {
+            break; // Not enough bytes for the data
+        }
+        
+        uint32_t field = ImuSampleXdi::All::field(xdi);
+        if (field != 0 && ImuSampleXdi::All::decode(xdi, size, payload + index, sample)) {
+            found |= field;
+        }
+        index += size;
+    }
+    
+    return found;
+}
+
+uint32_t XbusImu::decode(const uint8_t* xbusData, size_t size, ImuSample& sample) {
+    if (!Xbus::isComplete(xbusData, size)) {
+        return 0;
+    }
+    return decode(xbusData, sample);
+}
+
+bool XbusImu::push(const uint8_t* xbusData, size_t size, ImuSampleRing& ring) {
+    // Check before claiming a slot, so other messages are not counted as drops
+    if (!Xbus::isComplete(xbusData, size) || Xbus::getMessageId(xbusData) != XMID_MtData2) {
+        return false;
+    }
+    
+    ImuSample* slot = ring.beginPush();
+    if (slot == nullptr) {
+        return false;
+    }
+    
+    // An unpublished slot is simply reused by the next push
+    if ((decode(xbusData, *slot) & INERTIAL_FIELDS) == 0) {
+        return false;
+    }
+    ring.commitPush();
+    return true;
+}
@@ -0,0 +1,104 @@
+#ifndef XBUS_IMU_H
+#define XBUS_IMU_H
+
+#include "xbus_parser.h"
+#include "xbus_spsc_queue.h"
+#include <cstdint>
+#include <cstddef>
+
+// One raw inertial sample, the part of an MTData2 packet a 1-2 kHz IMU
+// stream carries. About a third of the size of SensorData and decoded
+// without touching the other outputs.
+struct ImuSample {
+    bool hasPacketCounter = false;
+    bool hasSampleTimeFine = false;
+    bool hasAcceleration = false;
+    bool hasRateOfTurn = false;
+    bool hasMagneticField = false;
+    
+    // XdiFormat::bits of the inertial items, as in SensorData
+    uint8_t accelerationFormat = 0;
+    uint8_t rateOfTurnFormat = 0;
+    uint8_t magneticFieldFormat = 0;
+    
+    uint16_t packetCounter = 0;
+    uint32_t sampleTimeFine = 0;
+    Vector3 acceleration;
+    Vector3 rateOfTurn;
+    Vector3 magneticField;
+};
+
+// The same registry entries as SensorDataXdi, decoded into ImuSample
+namespace ImuSampleXdi {
+    struct PacketCounter : XdiField<XDI::PACKET_COUNTER, SensorField::PACKET_COUNTER,
+                                    &ImuSample::packetCounter, &ImuSample::hasPacketCounter,
+                                    nullptr, uint16_t> {
+        static constexpr const char* name = SensorDataXdi::PacketCounter::name;
+    };
+    
+    struct SampleTimeFine : XdiField<XDI::SAMPLE_TIME_FINE, SensorField::SAMPLE_TIME_FINE,
+                                     &ImuSample::sampleTimeFine, &ImuSample::hasSampleTimeFine,
+                                     nullptr, uint32_t> {
+        static constexpr const char* name = SensorDataXdi::SampleTimeFine::name;
+    };
+    
+    struct Acceleration : XdiField<XDI::ACCELERATION, SensorField::ACCELERATION,
+                                   &ImuSample::acceleration, &ImuSample::hasAcceleration,
+                                   &ImuSample::accelerationFormat,
+                                   float, float, float> {
+        static constexpr const char* name = SensorDataXdi::Acceleration::name;
+    };
+    
+    struct RateOfTurn : XdiField<XDI::RATE_OF_TURN, SensorField::RATE_OF_TURN,
+                                 &ImuSample::rateOfTurn, &ImuSample::hasRateOfTurn,
+                                 &ImuSample::rateOfTurnFormat,
+                                 float, float, float> {
+        static constexpr const char* name = SensorDataXdi::RateOfTurn::name;
+    };
+    
+    struct MagneticField : XdiField<XDI::MAGNETIC_FIELD, SensorField::MAGNETIC_FIELD,
+                                    &ImuSample::magneticField, &ImuSample::hasMagneticField,
+                                    &ImuSample::magneticFieldFormat,
+                                    float, float, float> {
+        static constexpr const char* name = SensorDataXdi::MagneticField::name;
+    };
+    
+    typedef XdiList<PacketCounter, SampleTimeFine, Acceleration, RateOfTurn, MagneticField> All;
+}
+
+// Preallocated ring of samples between the read thread and a consumer
+typedef SpscQueue<ImuSample> ImuSampleRing;
+
+// High-rate path for raw inertial data.
+//
+// Only the ImuSampleXdi items of an MTData2 packet are decoded; everything
+// else is jumped over by its size byte. push() decodes straight into the
+// next free slot of a ring, so the read thread does no copy and no
+// allocation per sample:
+//
+//     ImuSampleRing ring(4096);
+//     // read thread, for every frame:
+//     XbusImu::push(frame.data, frame.size, ring);
+//     // consumer thread:
+//     ImuSample sample;
+//     while (ring.tryPop(sample)) { ... }
+class XbusImu {
+public:
+    // SensorField bits an ImuSample can hold
+    static constexpr uint32_t FIELDS = ImuSampleXdi::All::allFields();
+    static constexpr uint32_t INERTIAL_FIELDS = SensorField::ACCELERATION | SensorField::RATE_OF_TURN |
+                                                SensorField::MAGNETIC_FIELD;
+    
+    // Decode the inertial items of an MTData2 message into sample. Returns
+    // the SensorField bits decoded, 0 for other messages. The size overload
+    // also rejects a message that does not fit in size bytes.
+    static uint32_t decode(const uint8_t* xbusData, ImuSample& sample);
+    static uint32_t decode(const uint8_t* xbusData, size_t size, ImuSample& sample);
+    
+    // Decode into the ring's next free slot and publish it. False when the
+    // message has no acceleration, rate of turn or magnetic field (nothing
+    // is queued) or the ring is full (the ring counts a drop).
+    static bool push(const uint8_t* xbusData, size_t size, ImuSampleRing& ring);
+};
+
+#endif // XBUS_IMU_H
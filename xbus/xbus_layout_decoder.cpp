@@ -0,0 +1,169 @@
+#include "xbus_layout_decoder.h"
+
+XbusLayoutDecoder::XbusLayoutDecoder()
+    : m_payloadLength(0)
+    , m_locked(false)
+    , m_decodeFields(SensorDataXdi::All::allFields()) {
+}
+
+bool XbusLayoutDecoder::decode(const uint8_t* xbusData, SensorData& sensorData) {
+    if (!Xbus::checkPreamble(xbusData)) {
+        return false;
+    }
+
+    if (Xbus::getMessageId(xbusData) != XMID_MtData2) {
+        return false;
+    }
+
+    int payloadLength = Xbus::getPayloadLength(xbusData);
+    const uint8_t* payload = Xbus::getConstPointerToPayload(xbusData);
+
+    if (m_locked && matches(payload, payloadLength)) {
+        sensorData = SensorData();
+        for (const Field& field : m_fields) {
+            if (field.decoder != nullptr) {
+                field.decoder(payload + field.offset, sensorData);
+            }
+        }
+        m_stats.lockedDecodes++;
+        return true;
+    }
+
+    // Layout unknown or changed: decode generically and lock onto this one
+    if (m_locked) {
+        m_stats.relocks++;
+    }
+    learn(xbusData);
+    m_stats.genericDecodes++;
+    if (m_decodeFields == SensorDataXdi::All::allFields()) {
+        return XbusParser::parseMTData2(xbusData, sensorData);
+    }
+    sensorData = SensorData();
+    XbusParser::parseMTData2Fields(xbusData, m_decodeFields, sensorData);
+    return true;
+}
+
+bool XbusLayoutDecoder::decode(const uint8_t* xbusData, size_t size, SensorData& sensorData) {
+    return Xbus::isComplete(xbusData, size) && decode(xbusData, sensorData);
+}
+
+bool XbusLayoutDecoder::learn(const uint8_t* xbusData) {
+    if (!Xbus::checkPreamble(xbusData) || Xbus::getMessageId(xbusData) != XMID_MtData2) {
+        return false;
+    }
+
+    int payloadLength = Xbus::getPayloadLength(xbusData);
+    const uint8_t* payload = Xbus::getConstPointerToPayload(xbusData);
+
+    m_fields.clear();
+
+    // Walk the items exactly like parseMTData2 so both paths agree
+    int index = 0;
+    while (index + 3 <= payloadLength) {
+        uint32_t header = readHeader(payload + index);
+        uint8_t size = static_cast<uint8_t>(header & 0xff);
+        index += 3;
+
+        if (index + size > payloadLength) {
+            break;
+        }
+
+        Field field;
+        field.offset = static_cast<uint16_t>(index);
+        field.header = header;
+        field.decoder = decoderFor(header);
+        m_fields.push_back(field);
+
+        index += size;
+    }
+
+    m_payloadLength = payloadLength;
+    m_locked = true;
+    return true;
+}
+
+bool XbusLayoutDecoder::configure(const XbusOutputConfig& config) {
+    if (config.empty() || !config.hasFixedLayout() || config.packetPayloadLength() == 0 ||
+        config.packetPayloadLength() > Xbus::MAX_PAYLOAD_LENGTH) {
+        return false;
+    }
+
+    // Items follow each other in configuration order
+    m_fields.clear();
+    int offset = 0;
+    for (const XbusOutputConfig::Output& output : config.outputs()) {
+        uint8_t size = XbusParser::getDataItemSize(output.xdi);
+
+        Field field;
+        field.offset = static_cast<uint16_t>(offset + 3);
+        field.header = (static_cast<uint32_t>(output.xdi) << 8) | size;
+        field.decoder = decoderFor(field.header);
+        m_fields.push_back(field);
+
+        offset += 3 + size;
+    }
+
+    m_payloadLength = offset;
+    m_locked = true;
+    return true;
+}
+
+bool XbusLayoutDecoder::learnFromOutputConfig(const uint8_t* xbusData) {
+    XbusOutputConfig config;
+    return config.parse(xbusData) && configure(config);
+}
+
+void XbusLayoutDecoder::setFields(uint32_t fields) {
+    m_decodeFields = fields;
+    for (Field& field : m_fields) {
+        field.decoder = decoderFor(field.header);
+    }
+}
+
+uint32_t XbusLayoutDecoder::fields() const {
+    return m_decodeFields;
+}
+
+void XbusLayoutDecoder::unlock() {
+    m_fields.clear();
+    m_payloadLength = 0;
+    m_locked = false;
+}
+
+bool XbusLayoutDecoder::isLocked() const {
+    return m_locked;
+}
+
+size_t XbusLayoutDecoder::fieldCount() const {
+    return m_fields.size();
+}
+
+const XbusLayoutDecoder::Stats& XbusLayoutDecoder::stats() const {
+    return m_stats;
+}
+
+uint32_t XbusLayoutDecoder::readHeader(const uint8_t* itemHeader) {
+    return (static_cast<uint32_t>(itemHeader[0]) << 16) |
+           (static_cast<uint32_t>(itemHeader[1]) << 8) |
+           static_cast<uint32_t>(itemHeader[2]);
+}
+
+XbusParser::DataItemDecoder XbusLayoutDecoder::decoderFor(uint32_t header) const {
+    uint16_t xdi = static_cast<uint16_t>(header >> 8);
+    if ((SensorField::fromXdi(xdi) & m_decodeFields) == 0) {
+        return nullptr;
+    }
+    return XbusParser::getDataItemDecoder(xdi, static_cast<uint8_t>(header & 0xff));
+}
+
+bool XbusLayoutDecoder::matches(const uint8_t* payload, int payloadLength) const {
+    if (payloadLength != m_payloadLength) {
+        return false;
+    }
+    for (const Field& field : m_fields) {
+        if (readHeader(payload + field.offset - 3) != field.header) {
+            return false;
+        }
+    }
+    return true;
+}
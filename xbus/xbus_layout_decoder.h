@@ -0,0 +1,78 @@
+#ifndef XBUS_LAYOUT_DECODER_H
+#define XBUS_LAYOUT_DECODER_H
+
+#include "xbus_parser.h"
+#include "xbus_output_config.h"
+#include <cstdint>
+#include <vector>
+
+// MTData2 decoder that locks onto the data item layout of a session.
+//
+// The output configuration of a device does not change during measurement,
+// so every MTData2 packet carries the same XDI/size sequence. The decoder
+// learns that sequence once (from the first packet or from an OutputConfig
+// message) and stores the offset and decoder of every item. Later packets
+// are checked against the learned item headers and decoded with direct
+// calls, without the per-item XDI dispatch of XbusParser::parseMTData2.
+// A packet with a different layout is decoded by the generic parser and
+// becomes the new locked layout.
+//
+// setFields() restricts decoding to some SensorField bits, on the locked
+// and on the generic path; items of other fields are skipped.
+class XbusLayoutDecoder {
+public:
+    struct Stats {
+        uint64_t lockedDecodes = 0;   // packets decoded with the locked layout
+        uint64_t genericDecodes = 0;  // packets that fell back to parseMTData2
+        uint64_t relocks = 0;         // layout changes after the first lock
+    };
+
+    XbusLayoutDecoder();
+
+    // Decode an MTData2 message, locking onto its layout when needed.
+    // Same contract as XbusParser::parseMTData2.
+    bool decode(const uint8_t* xbusData, SensorData& sensorData);
+
+    // decode() of a message in size bytes of untrusted memory
+    bool decode(const uint8_t* xbusData, size_t size, SensorData& sensorData);
+
+    // Learn the layout from an MTData2 message without decoding it
+    bool learn(const uint8_t* xbusData);
+
+    // Predict the layout from an output configuration, so the first packet
+    // already takes the locked path. Fails when an output has an unknown
+    // size or a lower rate than the others, since the packet layout then
+    // varies from packet to packet.
+    bool configure(const XbusOutputConfig& config);
+
+    // configure() with the configuration of an XMID_OutputConfig message
+    bool learnFromOutputConfig(const uint8_t* xbusData);
+
+    // SensorField bits to decode, all by default
+    void setFields(uint32_t fields);
+    uint32_t fields() const;
+
+    void unlock();
+    bool isLocked() const;
+    size_t fieldCount() const;
+    const Stats& stats() const;
+
+private:
+    struct Field {
+        uint16_t offset;  // offset of the item payload within the MTData2 payload
+        uint32_t header;  // XDI and size bytes as one big-endian value
+        XbusParser::DataItemDecoder decoder;  // nullptr for items that are skipped
+    };
+
+    static uint32_t readHeader(const uint8_t* itemHeader);
+    XbusParser::DataItemDecoder decoderFor(uint32_t header) const;
+    bool matches(const uint8_t* payload, int payloadLength) const;
+
+    std::vector<Field> m_fields;
+    int m_payloadLength;
+    bool m_locked;
+    uint32_t m_decodeFields;
+    Stats m_stats;
+};
+
+#endif // XBUS_LAYOUT_DECODER_H
@@ -0,0 +1,102 @@
+#include "xbus_message_builder.h"
+#include <cstring>
+
+size_t XbusMessageBuilder::build(uint8_t* dest, size_t capacity, uint8_t messageId,
+                                 const uint8_t* payload, uint16_t payloadLength, uint8_t busId) {
+    XbusMessageBuilder builder(dest, capacity);
+    builder.begin(messageId, payloadLength, busId);
+    if (payloadLength > 0) {
+        builder.putBytes(payload, payloadLength);
+    }
+    return builder.finish();
+}
+
+XbusMessageBuilder::XbusMessageBuilder(uint8_t* buffer, size_t capacity)
+    : m_buffer(buffer)
+    , m_capacity(capacity)
+    , m_position(0)
+    , m_payloadEnd(0)
+    , m_checksum(0)
+    , m_failed(true) {
+}
+
+XbusMessageBuilder& XbusMessageBuilder::begin(uint8_t messageId, uint16_t payloadLength, uint8_t busId) {
+    m_position = 0;
+    m_checksum = 0;
+    m_failed = m_buffer == nullptr || messageSize(payloadLength) > m_capacity;
+    if (m_failed) {
+        return *this;
+    }
+    
+    m_buffer[m_position++] = Xbus::XBUS_PREAMBLE;
+    putU8(busId);
+    putU8(messageId);
+    if (payloadLength < Xbus::XBUS_EXTENDED_LENGTH) {
+        putU8(static_cast<uint8_t>(payloadLength));
+    } else {
+        putU8(Xbus::LENGTH_EXTENDER_BYTE);
+        putU16(payloadLength);
+    }
+    
+    m_payloadEnd = m_position + payloadLength;
+    return *this;
+}
+
+XbusMessageBuilder& XbusMessageBuilder::putU8(uint8_t value) {
+    if (m_failed || m_position >= m_capacity) {
+        m_failed = true;
+        return *this;
+    }
+    
+    m_buffer[m_position++] = value;
+    m_checksum -= value;
+    return *this;
+}
+
+XbusMessageBuilder& XbusMessageBuilder::putU16(uint16_t value) {
+    putU8(static_cast<uint8_t>(value >> 8));
+    return putU8(static_cast<uint8_t>(value));
+}
+
+XbusMessageBuilder& XbusMessageBuilder::putU32(uint32_t value) {
+    putU16(static_cast<uint16_t>(value >> 16));
+    return putU16(static_cast<uint16_t>(value));
+}
+
+XbusMessageBuilder& XbusMessageBuilder::putFloat(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return putU32(bits);
+}
+
+XbusMessageBuilder& XbusMessageBuilder::putBytes(const uint8_t* data, size_t length) {
+    if (m_failed || length > m_capacity - m_position) {
+        m_failed = true;
+        return *this;
+    }
+    
+    uint8_t* dest = m_buffer + m_position;
+    uint8_t checksum = m_checksum;
+    for (size_t i = 0; i < length; i++) {
+        dest[i] = data[i];
+        checksum -= data[i];
+    }
+    m_checksum = checksum;
+    m_position += length;
+    return *this;
+}
+
+size_t XbusMessageBuilder::finish() {
+    if (m_failed || m_position != m_payloadEnd || m_position >= m_capacity) {
+        m_failed = true;
+        return 0;
+    }
+    
+    m_buffer[m_position++] = m_checksum;
+    m_failed = true; // A new begin() is needed for the next message
+    return m_position;
+}
+
+const uint8_t* XbusMessageBuilder::data() const {
+    return m_buffer;
+}
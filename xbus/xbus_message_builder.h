@@ -0,0 +1,105 @@
+#ifndef XBUS_MESSAGE_BUILDER_H
+#define XBUS_MESSAGE_BUILDER_H
+
+#include "xbus.h"
+#include "xbus_message_id.h"
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Builds outbound Xbus messages directly into a caller-provided buffer.
+//
+// The header, payload and checksum are written in a single pass and the
+// checksum is accumulated while writing, so no intermediate message and no
+// heap allocation is needed. Typical use with a stack buffer:
+//
+//     uint8_t buffer[XbusMessageBuilder::messageSize(2)];
+//     XbusMessageBuilder builder(buffer, sizeof(buffer));
+//     builder.begin(XMID_SetOutputConfig, 2).putU16(0x2030);
+//     size_t size = builder.finish();  // 0 on error
+//
+// Multi-byte values are written big-endian, as the devices expect.
+class XbusMessageBuilder {
+public:
+    // Complete message size (preamble to checksum) for a payload length
+    static constexpr size_t messageSize(size_t payloadLength) {
+        return payloadLength + (payloadLength < Xbus::XBUS_EXTENDED_LENGTH
+                                    ? Xbus::OFFSET_TO_PAYLOAD + Xbus::XBUS_CHECKSUM_SIZE
+                                    : Xbus::OFFSET_TO_PAYLOAD_EXT + Xbus::XBUS_CHECKSUM_SIZE);
+    }
+    
+    // Build a whole message in one call. Returns the message size, or 0 if
+    // it does not fit in capacity.
+    static size_t build(uint8_t* dest, size_t capacity, uint8_t messageId,
+                        const uint8_t* payload = nullptr, uint16_t payloadLength = 0,
+                        uint8_t busId = Xbus::XBUS_MASTERDEVICE);
+    
+    XbusMessageBuilder(uint8_t* buffer, size_t capacity);
+    
+    // Start a message with a known payload length. Payload bytes are then
+    // appended with the put methods and the message is closed by finish().
+    XbusMessageBuilder& begin(uint8_t messageId, uint16_t payloadLength,
+                              uint8_t busId = Xbus::XBUS_MASTERDEVICE);
+    
+    XbusMessageBuilder& putU8(uint8_t value);
+    XbusMessageBuilder& putU16(uint16_t value);
+    XbusMessageBuilder& putU32(uint32_t value);
+    XbusMessageBuilder& putFloat(float value);
+    XbusMessageBuilder& putBytes(const uint8_t* data, size_t length);
+    
+    // Write the checksum. Returns the message size, or 0 if the message did
+    // not fit or the payload written does not match the declared length.
+    size_t finish();
+    
+    const uint8_t* data() const;
+
+private:
+    uint8_t* m_buffer;
+    size_t m_capacity;
+    size_t m_position;
+    size_t m_payloadEnd;
+    uint8_t m_checksum;
+    bool m_failed;
+};
+
+// Pre-encoded frames for commands that never change. They are computed at
+// compile time (checksum included) and can be written to a port as is.
+namespace XbusCommand {
+
+// Complete frame without payload, addressed to the master device
+constexpr std::array<uint8_t, 5> encode(uint8_t messageId) {
+    return {{Xbus::XBUS_PREAMBLE, Xbus::XBUS_MASTERDEVICE, messageId, 0x00,
+             static_cast<uint8_t>(0x100 - ((Xbus::XBUS_MASTERDEVICE + messageId) & 0xFF))}};
+}
+
+// Complete frame with a short fixed payload, addressed to the master device
+template <size_t N>
+constexpr std::array<uint8_t, N + 5> encode(uint8_t messageId, const std::array<uint8_t, N>& payload) {
+    static_assert(N < Xbus::XBUS_EXTENDED_LENGTH, "Pre-encoded frames use the standard length field");
+    
+    std::array<uint8_t, N + 5> frame{};
+    frame[0] = Xbus::XBUS_PREAMBLE;
+    frame[1] = Xbus::XBUS_MASTERDEVICE;
+    frame[2] = messageId;
+    frame[3] = static_cast<uint8_t>(N);
+    
+    uint8_t checksum = static_cast<uint8_t>(0 - Xbus::XBUS_MASTERDEVICE - messageId - N);
+    for (size_t i = 0; i < N; i++) {
+        frame[4 + i] = payload[i];
+        checksum = static_cast<uint8_t>(checksum - payload[i]);
+    }
+    frame[4 + N] = checksum;
+    return frame;
+}
+
+constexpr std::array<uint8_t, 5> GOTO_CONFIG = encode(XMID_GotoConfig);
+constexpr std::array<uint8_t, 5> GOTO_MEASUREMENT = encode(XMID_GotoMeasurement);
+constexpr std::array<uint8_t, 5> REQ_DID = encode(XMID_ReqDid);
+constexpr std::array<uint8_t, 5> REQ_FIRMWARE_REVISION = encode(XMID_ReqFirmwareRevision);
+constexpr std::array<uint8_t, 5> REQ_OUTPUT_CONFIG = encode(XMID_ReqOutputConfig);
+constexpr std::array<uint8_t, 5> RESET = encode(XMID_Reset);
+constexpr std::array<uint8_t, 5> WAKEUP_ACK = encode(XMID_WakeupAck);
+
+} // namespace XbusCommand
+
+#endif // XBUS_MESSAGE_BUILDER_H
@@ -0,0 +1,551 @@
+#include "xbus_orientation.h"
+#include "xbus_simd.h"
+#include "xbus_simd_target.h"
+#include <algorithm>
+#include <cmath>
+
+// vdivq_f32, vsqrtq_f32 and vcvtnq_s32_f32 are AArch64 only; 32-bit ARM
+// uses the scalar kernels
+#if defined(XBUS_SIMD_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define XBUS_ORIENTATION_NEON 1
+#endif
+
+namespace {
+
+constexpr float PI = 3.14159265358979f;
+constexpr float HALF_PI = 1.57079632679490f;
+constexpr float QUARTER_PI = 0.785398163397448f;
+constexpr float RAD_TO_DEG = 57.2957795130823f;
+constexpr float DEG_TO_RAD = 0.0174532925199433f;
+
+// Cephes atanf on [-tan(pi/8), tan(pi/8)] and sinf/cosf on [-pi/4, pi/4]
+constexpr float ATAN_P0 = 8.05374449538e-2f;
+constexpr float ATAN_P1 = -1.38776856032e-1f;
+constexpr float ATAN_P2 = 1.99777106478e-1f;
+constexpr float ATAN_P3 = -3.33329491539e-1f;
+constexpr float TAN_PI_8 = 0.414213562373095f;
+constexpr float SIN_P0 = -1.9515295891e-4f;
+constexpr float SIN_P1 = 8.3321608736e-3f;
+constexpr float SIN_P2 = -1.6666654611e-1f;
+constexpr float COS_P0 = 2.443315711809948e-5f;
+constexpr float COS_P1 = -1.388731625493765e-3f;
+constexpr float COS_P2 = 4.166664568298827e-2f;
+
+struct Kernels {
+    void (*quaternionToEuler)(const float* q0, const float* q1, const float* q2, const float* q3,
+                              float* roll, float* pitch, float* yaw, size_t count);
+    void (*eulerToQuaternion)(const float* roll, const float* pitch, const float* yaw,
+                              float* q0, float* q1, float* q2, float* q3, size_t count);
+    void (*quaternionToMatrix)(const float* q0, const float* q1, const float* q2, const float* q3,
+                               float* const matrix[9], size_t count);
+    // sign -1 rotates by the conjugate, i.e. to the sensor frame
+    void (*rotate)(const float* q0, const float* q1, const float* q2, const float* q3,
+                   const float* x, const float* y, const float* z,
+                   float* outX, float* outY, float* outZ, size_t count, float sign);
+};
+
+// ---------------------------------------------------------------------------
+// Scalar kernels (libm). The vector kernels use the same formulas.
+
+void scalarQuaternionToEuler(const float* q0, const float* q1, const float* q2, const float* q3,
+                             float* roll, float* pitch, float* yaw, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        float w = q0[i];
+        float x = q1[i];
+        float y = q2[i];
+        float z = q3[i];
+        // Rounding can push the sine of pitch just past +-1 near gimbal lock
+        float sinPitch = std::min(std::max(2.0f * (w * y - x * z), -1.0f), 1.0f);
+        roll[i] = std::atan2(2.0f * (y * z + w * x), 2.0f * (w * w + z * z) - 1.0f) * RAD_TO_DEG;
+        pitch[i] = std::asin(sinPitch) * RAD_TO_DEG;
+        yaw[i] = std::atan2(2.0f * (x * y + w * z), 2.0f * (w * w + x * x) - 1.0f) * RAD_TO_DEG;
+    }
+}
+
+void scalarEulerToQuaternion(const float* roll, const float* pitch, const float* yaw,
+                             float* q0, float* q1, float* q2, float* q3, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        float halfRoll = roll[i] * (0.5f * DEG_TO_RAD);
+        float halfPitch = pitch[i] * (0.5f * DEG_TO_RAD);
+        float halfYaw = yaw[i] * (0.5f * DEG_TO_RAD);
+        float cr = std::cos(halfRoll);
+        float sr = std::sin(halfRoll);
+        float cp = std::cos(halfPitch);
+        float sp = std::sin(halfPitch);
+        float cy = std::cos(halfYaw);
+        float sy = std::sin(halfYaw);
+        q0[i] = cr * cp * cy + sr * sp * sy;
+        q1[i] = sr * cp * cy - cr * sp * sy;
+        q2[i] = cr * sp * cy + sr * cp * sy;
+        q3[i] = cr * cp * sy - sr * sp * cy;
+    }
+}
+
+void scalarQuaternionToMatrix(const float* q0, const float* q1, const float* q2, const float* q3,
+                              float* const matrix[9], size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        float w = q0[i];
+        float x = q1[i];
+        float y = q2[i];
+        float z = q3[i];
+        matrix[0][i] = 2.0f * (w * w + x * x) - 1.0f;
+        matrix[1][i] = 2.0f * (x * y - w * z);
+        matrix[2][i] = 2.0f * (x * z + w * y);
+        matrix[3][i] = 2.0f * (x * y + w * z);
+        matrix[4][i] = 2.0f * (w * w + y * y) - 1.0f;
+        matrix[5][i] = 2.0f * (y * z - w * x);
+        matrix[6][i] = 2.0f * (x * z - w * y);
+        matrix[7][i] = 2.0f * (y * z + w * x);
+        matrix[8][i] = 2.0f * (w * w + z * z) - 1.0f;
+    }
+}
+
+// v' = v + w t + q x t with t = 2 (q x v), for the vector part q
+void scalarRotate(const float* q0, const float* q1, const float* q2, const float* q3,
+                  const float* x, const float* y, const float* z,
+                  float* outX, float* outY, float* outZ, size_t count, float sign) {
+    for (size_t i = 0; i < count; i++) {
+        float w = q0[i];
+        float qx = sign * q1[i];
+        float qy = sign * q2[i];
+        float qz = sign * q3[i];
+        float vx = x[i];
+        float vy = y[i];
+        float vz = z[i];
+        float tx = 2.0f * (qy * vz - qz * vy);
+        float ty = 2.0f * (qz * vx - qx * vz);
+        float tz = 2.0f * (qx * vy - qy * vx);
+        outX[i] = vx + w * tx + (qy * tz - qz * ty);
+        outY[i] = vy + w * ty + (qz * tx - qx * tz);
+        outZ[i] = vz + w * tz + (qx * ty - qy * tx);
+    }
+}
+
+const Kernels scalarKernels = {
+    scalarQuaternionToEuler, scalarEulerToQuaternion, scalarQuaternionToMatrix, scalarRotate
+};
+
+// ---------------------------------------------------------------------------
+// x86 kernels, SSE2 arithmetic on 4 rows per step
+
+#if defined(XBUS_SIMD_X86)
+
+XBUS_TARGET_SSSE3 inline __m128 sseSelect(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// atan of min(|x|, |y|) / max(|x|, |y|), which lies in [0, 1], then moved to
+// the octant of (x, y)
+XBUS_TARGET_SSSE3 inline __m128 sseAtan2(__m128 y, __m128 x) {
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 absX = _mm_andnot_ps(signBit, x);
+    __m128 absY = _mm_andnot_ps(signBit, y);
+    
+    // 0 / 0 for x = y = 0 is masked to 0
+    __m128 swap = _mm_cmpgt_ps(absY, absX);
+    __m128 t = _mm_div_ps(sseSelect(swap, absX, absY), sseSelect(swap, absY, absX));
+    t = _mm_and_ps(t, _mm_cmpgt_ps(_mm_max_ps(absX, absY), _mm_setzero_ps()));
+    
+    // Above tan(pi/8): atan(t) = pi/4 + atan((t - 1) / (t + 1))
+    __m128 reduce = _mm_cmpgt_ps(t, _mm_set1_ps(TAN_PI_8));
+    __m128 a = sseSelect(reduce, _mm_div_ps(_mm_sub_ps(t, one), _mm_add_ps(t, one)), t);
+    __m128 z = _mm_mul_ps(a, a);
+    __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ATAN_P0), z), _mm_set1_ps(ATAN_P1));
+    p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(ATAN_P2));
+    p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(ATAN_P3));
+    __m128 angle = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, z), a), a),
+                              _mm_and_ps(reduce, _mm_set1_ps(QUARTER_PI)));
+    
+    angle = sseSelect(swap, _mm_sub_ps(_mm_set1_ps(HALF_PI), angle), angle);
+    angle = sseSelect(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(PI), angle), angle);
+    return _mm_or_ps(angle, _mm_and_ps(y, signBit));
+}
+
+// asin(s) = atan2(s, sqrt(1 - s^2)), with (1 - s)(1 + s) for precision near +-1
+XBUS_TARGET_SSSE3 inline __m128 sseAsin(__m128 s) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    s = _mm_min_ps(_mm_max_ps(s, _mm_set1_ps(-1.0f)), one);
+    __m128 c = _mm_sqrt_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(one, s), _mm_add_ps(one, s)), _mm_setzero_ps()));
+    return sseAtan2(s, c);
+}
+
+// Sine and cosine of angles in degrees. Whole quadrants are taken off in
+// degrees, where that is exact, leaving [-45, 45] degrees for the
+// polynomials; the quadrant then swaps and negates the results.
+XBUS_TARGET_SSSE3 inline void sseSinCosDegrees(__m128 degrees, __m128& sine, __m128& cosine) {
+    const __m128i oneInt = _mm_set1_epi32(1);
+    const __m128i twoInt = _mm_set1_epi32(2);
+    __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(degrees, _mm_set1_ps(1.0f / 90.0f)));
+    __m128 remainder = _mm_sub_ps(degrees, _mm_mul_ps(_mm_cvtepi32_ps(quadrant), _mm_set1_ps(90.0f)));
+    __m128 x = _mm_mul_ps(remainder, _mm_set1_ps(DEG_TO_RAD));
+    __m128 z = _mm_mul_ps(x, x);
+    
+    __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_P0), z), _mm_set1_ps(SIN_P1));
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(SIN_P2));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+    __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_P0), z), _mm_set1_ps(COS_P1));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(COS_P2));
+    c = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(c, z), z), _mm_mul_ps(z, _mm_set1_ps(0.5f))),
+                   _mm_set1_ps(1.0f));
+    
+    // Odd quadrants swap sine and cosine; bit 1 of the quadrant (of the
+    // quadrant + 1 for the cosine) is the sign, moved to bit 31
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, oneInt), oneInt));
+    __m128 sineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, twoInt), 30));
+    __m128 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, oneInt),
+                                                                      twoInt), 30));
+    sine = _mm_xor_ps(sseSelect(swap, c, s), sineSign);
+    cosine = _mm_xor_ps(sseSelect(swap, s, c), cosineSign);
+}
+
+XBUS_TARGET_SSSE3 void sseQuaternionToEuler(const float* q0, const float* q1, const float* q2, const float* q3,
+                                            float* roll, float* pitch, float* yaw, size_t count) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 toDegrees = _mm_set1_ps(RAD_TO_DEG);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 w = _mm_loadu_ps(q0 + i);
+        __m128 x = _mm_loadu_ps(q1 + i);
+        __m128 y = _mm_loadu_ps(q2 + i);
+        __m128 z = _mm_loadu_ps(q3 + i);
+        __m128 ww = _mm_mul_ps(w, w);
+        
+        __m128 rollY = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(y, z), _mm_mul_ps(w, x)));
+        __m128 rollX = _mm_sub_ps(_mm_mul_ps(two, _mm_add_ps(ww, _mm_mul_ps(z, z))), one);
+        __m128 sinPitch = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(w, y), _mm_mul_ps(x, z)));
+        __m128 yawY = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, y), _mm_mul_ps(w, z)));
+        __m128 yawX = _mm_sub_ps(_mm_mul_ps(two, _mm_add_ps(ww, _mm_mul_ps(x, x))), one);
+        
+        _mm_storeu_ps(roll + i, _mm_mul_ps(sseAtan2(rollY, rollX), toDegrees));
+        _mm_storeu_ps(pitch + i, _mm_mul_ps(sseAsin(sinPitch), toDegrees));
+        _mm_storeu_ps(yaw + i, _mm_mul_ps(sseAtan2(yawY, yawX), toDegrees));
+    }
+    scalarQuaternionToEuler(q0 + i, q1 + i, q2 + i, q3 + i, roll + i, pitch + i, yaw + i, count - i);
+}
+
+XBUS_TARGET_SSSE3 void sseEulerToQuaternion(const float* roll, const float* pitch, const float* yaw,
+                                            float* q0, float* q1, float* q2, float* q3, size_t count) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 sr, cr, sp, cp, sy, cy;
+        sseSinCosDegrees(_mm_mul_ps(_mm_loadu_ps(roll + i), half), sr, cr);
+        sseSinCosDegrees(_mm_mul_ps(_mm_loadu_ps(pitch + i), half), sp, cp);
+        sseSinCosDegrees(_mm_mul_ps(_mm_loadu_ps(yaw + i), half), sy, cy);
+        
+        __m128 cpcy = _mm_mul_ps(cp, cy);
+        __m128 spsy = _mm_mul_ps(sp, sy);
+        __m128 spcy = _mm_mul_ps(sp, cy);
+        __m128 cpsy = _mm_mul_ps(cp, sy);
+        _mm_storeu_ps(q0 + i, _mm_add_ps(_mm_mul_ps(cr, cpcy), _mm_mul_ps(sr, spsy)));
+        _mm_storeu_ps(q1 + i, _mm_sub_ps(_mm_mul_ps(sr, cpcy), _mm_mul_ps(cr, spsy)));
+        _mm_storeu_ps(q2 + i, _mm_add_ps(_mm_mul_ps(cr, spcy), _mm_mul_ps(sr, cpsy)));
+        _mm_storeu_ps(q3 + i, _mm_sub_ps(_mm_mul_ps(cr, cpsy), _mm_mul_ps(sr, spcy)));
+    }
+    scalarEulerToQuaternion(roll + i, pitch + i, yaw + i, q0 + i, q1 + i, q2 + i, q3 + i, count - i);
+}
+
+XBUS_TARGET_SSSE3 void sseQuaternionToMatrix(const float* q0, const float* q1, const float* q2, const float* q3,
+                                             float* const matrix[9], size_t count) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 w = _mm_loadu_ps(q0 + i);
+        __m128 x = _mm_loadu_ps(q1 + i);
+        __m128 y = _mm_loadu_ps(q2 + i);
+        __m128 z = _mm_loadu_ps(q3 + i);
+        __m128 ww = _mm_mul_ps(w, w);
+        __m128 xy = _mm_mul_ps(x, y);
+        __m128 xz = _mm_mul_ps(x, z);
+        __m128 yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x);
+        __m128 wy = _mm_mul_ps(w, y);
+        __m128 wz = _mm_mul_ps(w, z);
+        
+        _mm_storeu_ps(matrix[0] + i, _mm_sub_ps(_mm_mul_ps(two, _mm_add_ps(ww, _mm_mul_ps(x, x))), one));
+        _mm_storeu_ps(matrix[1] + i, _mm_mul_ps(two, _mm_sub_ps(xy, wz)));
+        _mm_storeu_ps(matrix[2] + i, _mm_mul_ps(two, _mm_add_ps(xz, wy)));
+        _mm_storeu_ps(matrix[3] + i, _mm_mul_ps(two, _mm_add_ps(xy, wz)));
+        _mm_storeu_ps(matrix[4] + i, _mm_sub_ps(_mm_mul_ps(two, _mm_add_ps(ww, _mm_mul_ps(y, y))), one));
+        _mm_storeu_ps(matrix[5] + i, _mm_mul_ps(two, _mm_sub_ps(yz, wx)));
+        _mm_storeu_ps(matrix[6] + i, _mm_mul_ps(two, _mm_sub_ps(xz, wy)));
+        _mm_storeu_ps(matrix[7] + i, _mm_mul_ps(two, _mm_add_ps(yz, wx)));
+        _mm_storeu_ps(matrix[8] + i, _mm_sub_ps(_mm_mul_ps(two, _mm_add_ps(ww, _mm_mul_ps(z, z))), one));
+    }
+    float* const tail[9] = {matrix[0] + i, matrix[1] + i, matrix[2] + i, matrix[3] + i, matrix[4] + i,
+                            matrix[5] + i, matrix[6] + i, matrix[7] + i, matrix[8] + i};
+    scalarQuaternionToMatrix(q0 + i, q1 + i, q2 + i, q3 + i, tail, count - i);
+}
+
+XBUS_TARGET_SSSE3 void sseRotate(const float* q0, const float* q1, const float* q2, const float* q3,
+                                 const float* x, const float* y, const float* z,
+                                 float* outX, float* outY, float* outZ, size_t count, float sign) {
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 conjugate = _mm_set1_ps(sign);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 w = _mm_loadu_ps(q0 + i);
+        __m128 qx = _mm_mul_ps(conjugate, _mm_loadu_ps(q1 + i));
+        __m128 qy = _mm_mul_ps(conjugate, _mm_loadu_ps(q2 + i));
+        __m128 qz = _mm_mul_ps(conjugate, _mm_loadu_ps(q3 + i));
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 vy = _mm_loadu_ps(y + i);
+        __m128 vz = _mm_loadu_ps(z + i);
+        
+        __m128 tx = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qy, vz), _mm_mul_ps(qz, vy)));
+        __m128 ty = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qz, vx), _mm_mul_ps(qx, vz)));
+        __m128 tz = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qx, vy), _mm_mul_ps(qy, vx)));
+        _mm_storeu_ps(outX + i, _mm_add_ps(_mm_add_ps(vx, _mm_mul_ps(w, tx)),
+                                           _mm_sub_ps(_mm_mul_ps(qy, tz), _mm_mul_ps(qz, ty))));
+        _mm_storeu_ps(outY + i, _mm_add_ps(_mm_add_ps(vy, _mm_mul_ps(w, ty)),
+                                           _mm_sub_ps(_mm_mul_ps(qz, tx), _mm_mul_ps(qx, tz))));
+        _mm_storeu_ps(outZ + i, _mm_add_ps(_mm_add_ps(vz, _mm_mul_ps(w, tz)),
+                                           _mm_sub_ps(_mm_mul_ps(qx, ty), _mm_mul_ps(qy, tx))));
+    }
+    scalarRotate(q0 + i, q1 + i, q2 + i, q3 + i, x + i, y + i, z + i, outX + i, outY + i, outZ + i,
+                 count - i, sign);
+}
+
+// AVX2 CPUs run the same 128-bit kernels
+const Kernels sseKernels = {
+    sseQuaternionToEuler, sseEulerToQuaternion, sseQuaternionToMatrix, sseRotate
+};
+
+#endif // XBUS_SIMD_X86
+
+// ---------------------------------------------------------------------------
+// ARM NEON kernels, the SSE kernels lane for lane
+
+#if defined(XBUS_ORIENTATION_NEON)
+
+inline float32x4_t neonAtan2(float32x4_t y, float32x4_t x) {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const uint32x4_t signBit = vdupq_n_u32(0x80000000u);
+    float32x4_t absX = vabsq_f32(x);
+    float32x4_t absY = vabsq_f32(y);
+    
+    uint32x4_t swap = vcgtq_f32(absY, absX);
+    float32x4_t t = vdivq_f32(vbslq_f32(swap, absX, absY), vbslq_f32(swap, absY, absX));
+    t = vbslq_f32(vcgtq_f32(vmaxq_f32(absX, absY), zero), t, zero);
+    
+    uint32x4_t reduce = vcgtq_f32(t, vdupq_n_f32(TAN_PI_8));
+    float32x4_t a = vbslq_f32(reduce, vdivq_f32(vsubq_f32(t, one), vaddq_f32(t, one)), t);
+    float32x4_t z = vmulq_f32(a, a);
+    float32x4_t p = vaddq_f32(vmulq_f32(vdupq_n_f32(ATAN_P0), z), vdupq_n_f32(ATAN_P1));
+    p = vaddq_f32(vmulq_f32(p, z), vdupq_n_f32(ATAN_P2));
+    p = vaddq_f32(vmulq_f32(p, z), vdupq_n_f32(ATAN_P3));
+    float32x4_t angle = vaddq_f32(vaddq_f32(vmulq_f32(vmulq_f32(p, z), a), a),
+                                  vbslq_f32(reduce, vdupq_n_f32(QUARTER_PI), zero));
+    
+    angle = vbslq_f32(swap, vsubq_f32(vdupq_n_f32(HALF_PI), angle), angle);
+    angle = vbslq_f32(vcltq_f32(x, zero), vsubq_f32(vdupq_n_f32(PI), angle), angle);
+    return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(angle),
+                                           vandq_u32(vreinterpretq_u32_f32(y), signBit)));
+}
+
+inline float32x4_t neonAsin(float32x4_t s) {
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    s = vminq_f32(vmaxq_f32(s, vdupq_n_f32(-1.0f)), one);
+    float32x4_t c = vsqrtq_f32(vmaxq_f32(vmulq_f32(vsubq_f32(one, s), vaddq_f32(one, s)), vdupq_n_f32(0.0f)));
+    return neonAtan2(s, c);
+}
+
+inline void neonSinCosDegrees(float32x4_t degrees, float32x4_t& sine, float32x4_t& cosine) {
+    const int32x4_t oneInt = vdupq_n_s32(1);
+    const int32x4_t twoInt = vdupq_n_s32(2);
+    int32x4_t quadrant = vcvtnq_s32_f32(vmulq_f32(degrees, vdupq_n_f32(1.0f / 90.0f)));
+    float32x4_t remainder = vsubq_f32(degrees, vmulq_f32(vcvtq_f32_s32(quadrant), vdupq_n_f32(90.0f)));
+    float32x4_t x = vmulq_f32(remainder, vdupq_n_f32(DEG_TO_RAD));
+    float32x4_t z = vmulq_f32(x, x);
+    
+    float32x4_t s = vaddq_f32(vmulq_f32(vdupq_n_f32(SIN_P0), z), vdupq_n_f32(SIN_P1));
+    s = vaddq_f32(vmulq_f32(s, z), vdupq_n_f32(SIN_P2));
+    s = vaddq_f32(vmulq_f32(vmulq_f32(s, z), x), x);
+    float32x4_t c = vaddq_f32(vmulq_f32(vdupq_n_f32(COS_P0), z), vdupq_n_f32(COS_P1));
+    c = vaddq_f32(vmulq_f32(c, z), vdupq_n_f32(COS_P2));
+    c = vaddq_f32(vsubq_f32(vmulq_f32(vmulq_f32(c, z), z), vmulq_f32(z, vdupq_n_f32(0.5f))), vdupq_n_f32(1.0f));
+    
+    uint32x4_t swap = vceqq_s32(vandq_s32(quadrant, oneInt), oneInt);
+    uint32x4_t sineSign = vreinterpretq_u32_s32(vshlq_n_s32(vandq_s32(quadrant, twoInt), 30));
+    uint32x4_t cosineSign = vreinterpretq_u32_s32(vshlq_n_s32(vandq_s32(vaddq_s32(quadrant, oneInt), twoInt), 30));
+    sine = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vbslq_f32(swap, c, s)), sineSign));
+    cosine = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vbslq_f32(swap, s, c)), cosineSign));
+}
+
+void neonQuaternionToEuler(const float* q0, const float* q1, const float* q2, const float* q3,
+                           float* roll, float* pitch, float* yaw, size_t count) {
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t two = vdupq_n_f32(2.0f);
+    const float32x4_t toDegrees = vdupq_n_f32(RAD_TO_DEG);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t w = vld1q_f32(q0 + i);
+        float32x4_t x = vld1q_f32(q1 + i);
+        float32x4_t y = vld1q_f32(q2 + i);
+        float32x4_t z = vld1q_f32(q3 + i);
+        float32x4_t ww = vmulq_f32(w, w);
+        
+        float32x4_t rollY = vmulq_f32(two, vaddq_f32(vmulq_f32(y, z), vmulq_f32(w, x)));
+        float32x4_t rollX = vsubq_f32(vmulq_f32(two, vaddq_f32(ww, vmulq_f32(z, z))), one);
+        float32x4_t sinPitch = vmulq_f32(two, vsubq_f32(vmulq_f32(w, y), vmulq_f32(x, z)));
+        float32x4_t yawY = vmulq_f32(two, vaddq_f32(vmulq_f32(x, y), vmulq_f32(w, z)));
+        float32x4_t yawX = vsubq_f32(vmulq_f32(two, vaddq_f32(ww, vmulq_f32(x, x))), one);
+        
+        vst1q_f32(roll + i, vmulq_f32(neonAtan2(rollY, rollX), toDegrees));
+        vst1q_f32(pitch + i, vmulq_f32(neonAsin(sinPitch), toDegrees));
+        vst1q_f32(yaw + i, vmulq_f32(neonAtan2(yawY, yawX), toDegrees));
+    }
+    scalarQuaternionToEuler(q0 + i, q1 + i, q2 + i, q3 + i, roll + i, pitch + i, yaw + i, count - i);
+}
+
+void neonEulerToQuaternion(const float* roll, const float* pitch, const float* yaw,
+                           float* q0, float* q1, float* q2, float* q3, size_t count) {
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t sr, cr, sp, cp, sy, cy;
+        neonSinCosDegrees(vmulq_f32(vld1q_f32(roll + i), half), sr, cr);
+        neonSinCosDegrees(vmulq_f32(vld1q_f32(pitch + i), half), sp, cp);
+        neonSinCosDegrees(vmulq_f32(vld1q_f32(yaw + i), half), sy, cy);
+        
+        float32x4_t cpcy = vmulq_f32(cp, cy);
+        float32x4_t spsy = vmulq_f32(sp, sy);
+        float32x4_t spcy = vmulq_f32(sp, cy);
+        float32x4_t cpsy = vmulq_f32(cp, sy);
+        vst1q_f32(q0 + i, vaddq_f32(vmulq_f32(cr, cpcy), vmulq_f32(sr, spsy)));
+        vst1q_f32(q1 + i, vsubq_f32(vmulq_f32(sr, cpcy), vmulq_f32(cr, spsy)));
+        vst1q_f32(q2 + i, vaddq_f32(vmulq_f32(cr, spcy), vmulq_f32(sr, cpsy)));
+        vst1q_f32(q3 + i, vsubq_f32(vmulq_f32(cr, cpsy), vmulq_f32(sr, spcy)));
+    }
+    scalarEulerToQuaternion(roll + i, pitch + i, yaw + i, q0 + i, q1 + i, q2 + i, q3 + i, count - i);
+}
+
+// The matrix and rotation kernels are plain multiply-adds that compilers
+// vectorize well for AArch64 already
+const Kernels neonKernels = {
+    neonQuaternionToEuler, neonEulerToQuaternion, scalarQuaternionToMatrix, scalarRotate
+};
+
+#endif // XBUS_ORIENTATION_NEON
+
+// Follows the XbusSimd level, so setLevel(Level::Scalar) also selects the
+// libm kernels here
+const Kernels& active() {
+    switch (XbusSimd::activeLevel()) {
+#if defined(XBUS_SIMD_X86)
+        case XbusSimd::Level::Ssse3:
+        case XbusSimd::Level::Avx2:
+            return sseKernels;
+#endif
+#if defined(XBUS_ORIENTATION_NEON)
+        case XbusSimd::Level::Neon:
+            return neonKernels;
+#endif
+        default:
+            return scalarKernels;
+    }
+}
+
+} // namespace
+
+void XbusOrientation::quaternionToEuler(const float* q0, const float* q1, const float* q2, const float* q3,
+                                        float* roll, float* pitch, float* yaw, size_t count) {
+    active().quaternionToEuler(q0, q1, q2, q3, roll, pitch, yaw, count);
+}
+
+void XbusOrientation::eulerToQuaternion(const float* roll, const float* pitch, const float* yaw,
+                                        float* q0, float* q1, float* q2, float* q3, size_t count) {
+    active().eulerToQuaternion(roll, pitch, yaw, q0, q1, q2, q3, count);
+}
+
+void XbusOrientation::quaternionToMatrix(const float* q0, const float* q1, const float* q2, const float* q3,
+                                         float* const matrix[9], size_t count) {
+    active().quaternionToMatrix(q0, q1, q2, q3, matrix, count);
+}
+
+void XbusOrientation::rotateToGlobal(const float* q0, const float* q1, const float* q2, const float* q3,
+                                     const float* x, const float* y, const float* z,
+                                     float* outX, float* outY, float* outZ, size_t count) {
+    active().rotate(q0, q1, q2, q3, x, y, z, outX, outY, outZ, count, 1.0f);
+}
+
+void XbusOrientation::rotateToSensor(const float* q0, const float* q1, const float* q2, const float* q3,
+                                     const float* x, const float* y, const float* z,
+                                     float* outX, float* outY, float* outZ, size_t count) {
+    active().rotate(q0, q1, q2, q3, x, y, z, outX, outY, outZ, count, -1.0f);
+}
+
+EulerAngles XbusOrientation::toEuler(const Quaternion& quaternion) {
+    EulerAngles angles;
+    scalarQuaternionToEuler(&quaternion.q0, &quaternion.q1, &quaternion.q2, &quaternion.q3,
+                            &angles.roll, &angles.pitch, &angles.yaw, 1);
+    return angles;
+}
+
+Quaternion XbusOrientation::toQuaternion(const EulerAngles& angles) {
+    Quaternion quaternion;
+    scalarEulerToQuaternion(&angles.roll, &angles.pitch, &angles.yaw,
+                            &quaternion.q0, &quaternion.q1, &quaternion.q2, &quaternion.q3, 1);
+    return quaternion;
+}
+
+RotationMatrix XbusOrientation::toMatrix(const Quaternion& quaternion) {
+    RotationMatrix matrix;
+    float* const elements[9] = {&matrix.m[0][0], &matrix.m[0][1], &matrix.m[0][2],
+                                &matrix.m[1][0], &matrix.m[1][1], &matrix.m[1][2],
+                                &matrix.m[2][0], &matrix.m[2][1], &matrix.m[2][2]};
+    scalarQuaternionToMatrix(&quaternion.q0, &quaternion.q1, &quaternion.q2, &quaternion.q3, elements, 1);
+    return matrix;
+}
+
+Vector3 XbusOrientation::rotateToGlobal(const Quaternion& quaternion, const Vector3& vector) {
+    Vector3 result;
+    scalarRotate(&quaternion.q0, &quaternion.q1, &quaternion.q2, &quaternion.q3, &vector.x, &vector.y, &vector.z,
+                 &result.x, &result.y, &result.z, 1, 1.0f);
+    return result;
+}
+
+Vector3 XbusOrientation::rotateToSensor(const Quaternion& quaternion, const Vector3& vector) {
+    Vector3 result;
+    scalarRotate(&quaternion.q0, &quaternion.q1, &quaternion.q2, &quaternion.q3, &vector.x, &vector.y, &vector.z,
+                 &result.x, &result.y, &result.z, 1, -1.0f);
+    return result;
+}
+
+size_t XbusOrientation::completeOrientation(SensorDataColumns& columns) {
+    const uint32_t both = SensorField::QUATERNION | SensorField::EULER_ANGLES;
+    size_t rows = columns.size();
+    size_t filled = 0;
+    size_t row = 0;
+    while (row < rows) {
+        // Runs of rows missing the same form go to the kernels together
+        uint32_t present = columns.presence[row] & both;
+        if (present == 0 || present == both) {
+            row++;
+            continue;
+        }
+        size_t end = row + 1;
+        while (end < rows && (columns.presence[end] & both) == present) {
+            end++;
+        }
+        
+        size_t count = end - row;
+        if (present == SensorField::QUATERNION) {
+            quaternionToEuler(&columns.q0[row], &columns.q1[row], &columns.q2[row], &columns.q3[row],
+                              &columns.roll[row], &columns.pitch[row], &columns.yaw[row], count);
+        } else {
+            eulerToQuaternion(&columns.roll[row], &columns.pitch[row], &columns.yaw[row],
+                              &columns.q0[row], &columns.q1[row], &columns.q2[row], &columns.q3[row], count);
+        }
+        for (size_t i = row; i < end; i++) {
+            columns.presence[i] |= both;
+        }
+        filled += count;
+        row = end;
+    }
+    return filled;
+}
@@ -0,0 +1,71 @@
+#ifndef XBUS_ORIENTATION_H
+#define XBUS_ORIENTATION_H
+
+#include "xbus_parser.h"
+#include <cstdint>
+#include <cstddef>
+
+// Row-major rotation matrix from the sensor to the global frame (Xsens
+// R_GS): v_global = m * v_sensor. Identity by default.
+struct RotationMatrix {
+    float m[3][3];
+    
+    RotationMatrix() : m{{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}} {}
+};
+
+// Conversions between the orientation outputs, in Xsens conventions.
+//
+// Quaternions are q_GS, sensor to global frame, with q0 the real part, as
+// the device sends them (XDI::QUATERNION). Euler angles are in degrees and
+// follow the device's EulerAngles output: roll about x, pitch about y, yaw
+// about z applied as R_GS = Rz(yaw) * Ry(pitch) * Rx(roll), with pitch in
+// [-90, 90] and roll and yaw in [-180, 180]. Quaternions are assumed to be
+// of unit length.
+//
+// The batch functions work on structure-of-arrays columns, e.g. those of
+// SensorDataColumns, count entries each:
+//
+//     XbusOrientation::quaternionToEuler(columns.q0.data(), columns.q1.data(), columns.q2.data(),
+//                                        columns.q3.data(), roll, pitch, yaw, columns.size());
+//
+// They run 4 rows per step with SSE on x86 (at the SSSE3 and AVX2 levels of
+// XbusSimd) and NEON on 64-bit ARM, using polynomial atan2, asin and sine
+// that agree with the float libm results to a unit or two in the last
+// place. The Scalar level (XbusSimd::setLevel) and the single-sample
+// functions use libm.
+class XbusOrientation {
+public:
+    static void quaternionToEuler(const float* q0, const float* q1, const float* q2, const float* q3,
+                                  float* roll, float* pitch, float* yaw, size_t count);
+    
+    static void eulerToQuaternion(const float* roll, const float* pitch, const float* yaw,
+                                  float* q0, float* q1, float* q2, float* q3, size_t count);
+    
+    // matrix[3 * row + column] is the output column of that matrix element
+    static void quaternionToMatrix(const float* q0, const float* q1, const float* q2, const float* q3,
+                                   float* const matrix[9], size_t count);
+    
+    // Rotate vectors, e.g. acceleration, from the sensor to the global frame
+    // by each row's quaternion, or back. The outputs may be the inputs.
+    static void rotateToGlobal(const float* q0, const float* q1, const float* q2, const float* q3,
+                               const float* x, const float* y, const float* z,
+                               float* outX, float* outY, float* outZ, size_t count);
+    static void rotateToSensor(const float* q0, const float* q1, const float* q2, const float* q3,
+                               const float* x, const float* y, const float* z,
+                               float* outX, float* outY, float* outZ, size_t count);
+    
+    // One sample
+    static EulerAngles toEuler(const Quaternion& quaternion);
+    static Quaternion toQuaternion(const EulerAngles& angles);
+    static RotationMatrix toMatrix(const Quaternion& quaternion);
+    static Vector3 rotateToGlobal(const Quaternion& quaternion, const Vector3& vector);
+    static Vector3 rotateToSensor(const Quaternion& quaternion, const Vector3& vector);
+    
+    // Fill in the orientation form a device did not send: Euler angles for
+    // rows with only a quaternion and the quaternion for rows with only
+    // Euler angles. The filled field's presence bit is set. Returns the
+    // number of rows filled.
+    static size_t completeOrientation(SensorDataColumns& columns);
+};
+
+#endif // XBUS_ORIENTATION_H
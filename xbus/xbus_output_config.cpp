@@ -0,0 +1,119 @@
+#include "xbus_output_config.h"
+#include "xbus.h"
+#include "xbus_message_builder.h"
+#include "xbus_message_id.h"
+#include "xbus_parser.h"
+
+XbusOutputConfig& XbusOutputConfig::add(uint16_t xdi, uint16_t frequency) {
+    Output output;
+    output.xdi = xdi;
+    output.frequency = frequency;
+    m_outputs.push_back(output);
+    return *this;
+}
+
+void XbusOutputConfig::clear() {
+    m_outputs.clear();
+}
+
+bool XbusOutputConfig::parse(const uint8_t* xbusData) {
+    m_outputs.clear();
+    if (!Xbus::checkPreamble(xbusData) || Xbus::getMessageId(xbusData) != XMID_OutputConfig) {
+        return false;
+    }
+    
+    int payloadLength = Xbus::getPayloadLength(xbusData);
+    const uint8_t* payload = Xbus::getConstPointerToPayload(xbusData);
+    if (payloadLength % OUTPUT_SIZE != 0 || static_cast<size_t>(payloadLength) > MAX_OUTPUTS * OUTPUT_SIZE) {
+        return false;
+    }
+    
+    int index = 0;
+    while (index < payloadLength) {
+        uint16_t xdi = XbusParser::readUint16(payload, index);
+        uint16_t frequency = XbusParser::readUint16(payload, index);
+        add(xdi, frequency);
+    }
+    return true;
+}
+
+bool XbusOutputConfig::parse(const uint8_t* xbusData, size_t size) {
+    if (!Xbus::isComplete(xbusData, size)) {
+        m_outputs.clear();
+        return false;
+    }
+    return parse(xbusData);
+}
+
+size_t XbusOutputConfig::build(uint8_t* dest, size_t capacity) const {
+    if (m_outputs.size() > MAX_OUTPUTS) {
+        return 0;
+    }
+    
+    XbusMessageBuilder builder(dest, capacity);
+    builder.begin(XMID_SetOutputConfig, static_cast<uint16_t>(m_outputs.size() * OUTPUT_SIZE));
+    for (const Output& output : m_outputs) {
+        builder.putU16(output.xdi).putU16(output.frequency);
+    }
+    return builder.finish();
+}
+
+size_t XbusOutputConfig::messageSize() const {
+    return XbusMessageBuilder::messageSize(m_outputs.size() * OUTPUT_SIZE);
+}
+
+const std::vector<XbusOutputConfig::Output>& XbusOutputConfig::outputs() const {
+    return m_outputs;
+}
+
+size_t XbusOutputConfig::size() const {
+    return m_outputs.size();
+}
+
+bool XbusOutputConfig::empty() const {
+    return m_outputs.empty();
+}
+
+uint32_t XbusOutputConfig::fields() const {
+    uint32_t result = 0;
+    for (const Output& output : m_outputs) {
+        result |= SensorField::fromXdi(output.xdi);
+    }
+    return result;
+}
+
+uint16_t XbusOutputConfig::packetRate() const {
+    uint16_t rate = 0;
+    for (const Output& output : m_outputs) {
+        if (!isEveryPacket(output.frequency) && output.frequency > rate) {
+            rate = output.frequency;
+        }
+    }
+    return rate;
+}
+
+bool XbusOutputConfig::hasFixedLayout() const {
+    uint16_t rate = packetRate();
+    for (const Output& output : m_outputs) {
+        if (!isEveryPacket(output.frequency) && output.frequency != rate) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t XbusOutputConfig::packetPayloadLength() const {
+    size_t length = 0;
+    for (const Output& output : m_outputs) {
+        uint8_t size = XbusParser::getDataItemSize(output.xdi);
+        if (size == 0) {
+            return 0;
+        }
+        length += 3 + size;
+    }
+    return length;
+}
+
+bool XbusOutputConfig::isEveryPacket(uint16_t frequency) {
+    return frequency == EVERY_PACKET || frequency == 0;
+}
@@ -0,0 +1,73 @@
+#ifndef XBUS_OUTPUT_CONFIG_H
+#define XBUS_OUTPUT_CONFIG_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// The data items a device puts in its MTData2 packets and their rates.
+//
+// This is the payload of XMID_SetOutputConfig (sent in config mode) and of
+// the XMID_OutputConfig reply to it or to XMID_ReqOutputConfig: a list of
+// (XDI, frequency) pairs, big-endian. Items like PacketCounter and
+// SampleTimeFine are sent with every packet and have frequency 0xFFFF (or
+// 0x0000). Outputs appear in MTData2 packets in list order.
+//
+//     XbusOutputConfig config;
+//     config.add(XDI::PACKET_COUNTER).add(XDI::EULER_ANGLES, 100);
+//     uint8_t message[XbusOutputConfig::MAX_MESSAGE_SIZE];
+//     size_t size = config.build(message, sizeof(message));
+//
+// XbusLayoutDecoder::configure() locks a decoder onto the packet layout a
+// configuration produces.
+class XbusOutputConfig {
+public:
+    struct Output {
+        uint16_t xdi;         // including the format bits (see XdiFormat)
+        uint16_t frequency;   // Hz, or EVERY_PACKET
+    };
+    
+    static constexpr uint16_t EVERY_PACKET = 0xFFFF;
+    static constexpr size_t MAX_OUTPUTS = 32;
+    static constexpr size_t OUTPUT_SIZE = 4;
+    static constexpr size_t MAX_MESSAGE_SIZE = 5 + MAX_OUTPUTS * OUTPUT_SIZE;
+    
+    // Append an output. Outputs beyond MAX_OUTPUTS make build() fail.
+    XbusOutputConfig& add(uint16_t xdi, uint16_t frequency = EVERY_PACKET);
+    void clear();
+    
+    // Read the list from an XMID_OutputConfig message. False, leaving the
+    // configuration empty, for other messages or a malformed payload.
+    bool parse(const uint8_t* xbusData);
+    bool parse(const uint8_t* xbusData, size_t size);
+    
+    // Write XMID_SetOutputConfig into dest. Returns the message size, or 0
+    // when it does not fit or the configuration has too many outputs.
+    size_t build(uint8_t* dest, size_t capacity) const;
+    size_t messageSize() const;
+    
+    const std::vector<Output>& outputs() const;
+    size_t size() const;
+    bool empty() const;
+    
+    // SensorField bits XbusParser decodes from these outputs
+    uint32_t fields() const;
+    
+    // Highest output rate, 0 when every output is EVERY_PACKET
+    uint16_t packetRate() const;
+    
+    // True when every packet carries every output: all rated outputs share
+    // one frequency. Only then is the MTData2 layout the same in each packet.
+    bool hasFixedLayout() const;
+    
+    // MTData2 payload length of a packet with every output, 0 when an
+    // output has a size XbusParser does not know
+    size_t packetPayloadLength() const;
+
+private:
+    static bool isEveryPacket(uint16_t frequency);
+    
+    std::vector<Output> m_outputs;
+};
+
+#endif // XBUS_OUTPUT_CONFIG_H
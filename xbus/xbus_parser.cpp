@@ -1,7 +1,5 @@
 // Enhanced xbus_parser.cpp
 #include "xbus_parser.h"
-#include <sstream>
-#include <iomanip>
 #include <cstring>
 
 uint8_t XbusParser::readUint8(const uint8_t* data, int& index) {
@@ -54,76 +52,203 @@ double XbusParser::readFP1632(const uint8_t* data, int& index) {
     return result;
 }
 
+namespace {
+
+// Text of a message as a string. It is written into a TEXT_BUFFER_SIZE
+// stack buffer first; the rare longer text (e.g. an extended-length
+// XMID_OutputConfig) is written again into a heap buffer, doubled until
+// it fits.
+template <typename Format>
+std::string formatMessage(Format format) {
+    char buffer[XbusParser::TEXT_BUFFER_SIZE];
+    XbusTextWriter out(buffer);
+    format(out);
+    if (!out.truncated()) {
+        return std::string(out.data(), out.size());
+    }
+    
+    std::vector<char> large(sizeof(buffer));
+    for (;;) {
+        large.resize(2 * large.size());
+        XbusTextWriter retry(large.data(), large.size());
+        format(retry);
+        if (!retry.truncated()) {
+            return std::string(retry.data(), retry.size());
+        }
+    }
+}
+
+} // namespace
+
 std::string XbusParser::messageToString(const uint8_t* xbusData) {
-    if (!Xbus::checkPreamble(xbusData)) {
-        return "Invalid xbus message";
+    return formatMessage([xbusData](XbusTextWriter& out) {
+        messageToString(xbusData, out);
+    });
+}
+
+std::string XbusParser::messageToString(const uint8_t* xbusData, size_t size) {
+    return formatMessage([xbusData, size](XbusTextWriter& out) {
+        messageToString(xbusData, size, out);
+    });
+}
+
+void XbusParser::messageToString(const uint8_t* xbusData, size_t size, XbusTextWriter& out) {
+    if (!Xbus::isComplete(xbusData, size)) {
+        out.append("Invalid xbus message");
+        return;
     }
+    messageToString(xbusData, out);
+}
 
+void XbusParser::messageToString(const uint8_t* xbusData, XbusTextWriter& out) {
+    if (!Xbus::checkPreamble(xbusData)) {
+        out.append("Invalid xbus message");
+        return;
+    }
+    
+    // Fixed size replies are read from the payload only when it is long enough
     uint8_t messageId = Xbus::getMessageId(xbusData);
-    int index = 4;
-    std::ostringstream oss;
-
+    const uint8_t* payload = Xbus::getConstPointerToPayload(xbusData);
+    int payloadLength = Xbus::getPayloadLength(xbusData);
+    int index = 0;
+    
     switch (messageId) {
         case XMID_Wakeup:
-            return "XMID_Wakeup";
-
-        case XMID_DeviceId: {
-            uint32_t deviceId = readUint32(xbusData, index);
-            oss << "XMID_DeviceId: 0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(8) << deviceId;
-            return oss.str();
-        }
-
+            out.append("XMID_Wakeup");
+            break;
+        
+        case XMID_DeviceId:
+            if (payloadLength < 4) {
+                out.append("XMID_DeviceId: Invalid length");
+                break;
+            }
+            out.append("XMID_DeviceId: 0x");
+            out.appendHex(readUint32(payload, index), 8);
+            break;
+        
         case XMID_GotoConfigAck:
-            return "XMID_GotoConfigAck";
-
+            out.append("XMID_GotoConfigAck");
+            break;
+        
         case XMID_GotoMeasurementAck:
-            return "XMID_GotoMeasurementAck";
-
+            out.append("XMID_GotoMeasurementAck");
+            break;
+        
         case XMID_MtData2: {
             // Use enhanced parsing for MTData2
             SensorData sensorData;
             if (parseMTData2(xbusData, sensorData)) {
-                return "XMID_MtData2: " + formatSensorData(sensorData);
+                out.append("XMID_MtData2: ");
+                formatSensorData(sensorData, out);
             } else {
-                return "XMID_MtData2: Failed to parse";
+                out.append("XMID_MtData2: Failed to parse");
             }
+            break;
         }
-
+        
         case XMID_FirmwareRevision: {
-            uint8_t major = readUint8(xbusData, index);
-            uint8_t minor = readUint8(xbusData, index);
-            uint8_t patch = readUint8(xbusData, index);
-            oss << "Firmware revision: " << static_cast<int>(major) << "." 
-                << static_cast<int>(minor) << "." << static_cast<int>(patch);
-            return oss.str();
+            if (payloadLength < 3) {
+                out.append("Firmware revision: Invalid length");
+                break;
+            }
+            uint8_t major = readUint8(payload, index);
+            uint8_t minor = readUint8(payload, index);
+            uint8_t patch = readUint8(payload, index);
+            out.append("Firmware revision: ");
+            out.appendUnsigned(major);
+            out.append('.');
+            out.appendUnsigned(minor);
+            out.append('.');
+            out.appendUnsigned(patch);
+            break;
         }
-
+        
+        case XMID_OutputConfig: {
+            // (XDI, frequency) pairs; 0xFFFF and 0 mean every packet
+            out.append("XMID_OutputConfig:");
+            while (index + 4 <= payloadLength) {
+                uint16_t xdi = readUint16(payload, index);
+                uint16_t frequency = readUint16(payload, index);
+                out.append(' ');
+                out.append(xdiName(xdi));
+                out.append(" (0x");
+                out.appendHex(xdi, 4);
+                if (frequency != 0xFFFF && frequency != 0) {
+                    out.append(") @ ");
+                    out.appendUnsigned(frequency);
+                    out.append(" Hz");
+                } else {
+                    out.append(')');
+                }
+            }
+            break;
+        }
+        
         case XMID_GotoBootLoaderAck:
-            return "XMID_GotoBootLoaderAck";
-
+            out.append("XMID_GotoBootLoaderAck");
+            break;
+        
         case XMID_FirmwareUpdate:
-            return "XMID_FirmwareUpdate";
-
+            out.append("XMID_FirmwareUpdate");
+            break;
+        
         case XMID_ResetAck:
-            return "XMID_ResetAck";
-
+            out.append("XMID_ResetAck");
+            break;
+        
         default:
-            oss << "Unhandled xbus message: MessageId = 0x" << std::hex << std::uppercase 
-                << std::setfill('0') << std::setw(2) << static_cast<int>(messageId);
-            return oss.str();
+            out.append("Unhandled xbus message: MessageId = 0x");
+            out.appendHex(messageId, 2);
+            break;
     }
 }
 
+void SensorDataColumns::reserve(size_t rows) {
+    presence.reserve(rows);
+    SensorDataXdi::All::reserveColumns(*this, rows);
+}
+
+void SensorDataColumns::clear() {
+    presence.clear();
+    SensorDataXdi::All::clearColumns(*this);
+}
+
+size_t SensorDataColumns::appendRow() {
+    // Defaults match a freshly constructed SensorData
+    presence.push_back(0);
+    SensorDataXdi::All::appendColumns(*this);
+    return presence.size() - 1;
+}
+
+size_t SensorDataColumns::append(const SensorData& data) {
+    presence.push_back(SensorDataXdi::All::present(data));
+    SensorDataXdi::All::appendColumns(*this, data);
+    return presence.size() - 1;
+}
+
+void SensorDataColumns::append(const SensorDataColumns& other) {
+    presence.insert(presence.end(), other.presence.begin(), other.presence.end());
+    SensorDataXdi::All::appendColumns(*this, other);
+}
+
+uint8_t XbusParser::getDataItemSize(uint16_t xdi) {
+    return SensorDataXdi::All::size(xdi);
+}
+
+XbusParser::DataItemDecoder XbusParser::getDataItemDecoder(uint16_t xdi, uint8_t size) {
+    return SensorDataXdi::All::decoder(xdi, size); // nullptr for unknown XDIs or unexpected sizes
+}
+
 bool XbusParser::parseMTData2(const uint8_t* xbusData, SensorData& sensorData) {
     if (!Xbus::checkPreamble(xbusData)) {
         return false;
     }
-
+    
     uint8_t messageId = Xbus::getMessageId(xbusData);
     if (messageId != XMID_MtData2) {
         return false;
     }
-
+    
     // Reset the sensor data structure
     sensorData = SensorData();
     
@@ -145,245 +270,290 @@ bool XbusParser::parseMTData2(const uint8_t* xbusData, SensorData& sensorData) {
             break; // Not enough bytes for the data
         }
         
-        switch (xdi) {
-            case XDI::PACKET_COUNTER:
-                if (size == 2) {
-                    sensorData.packetCounter = readUint16(payload, index);
-                    sensorData.hasPacketCounter = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            case XDI::SAMPLE_TIME_FINE:
-                if (size == 4) {
-                    sensorData.sampleTimeFine = readUint32(payload, index);
-                    sensorData.hasSampleTimeFine = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            case XDI::EULER_ANGLES:
-                if (size == 12) {
-                    sensorData.eulerAngles.roll = readFloat(payload, index);
-                    sensorData.eulerAngles.pitch = readFloat(payload, index);
-                    sensorData.eulerAngles.yaw = readFloat(payload, index);
-                    sensorData.hasEulerAngles = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            case XDI::STATUS_WORD:
-                if (size == 4) {
-                    sensorData.statusWord = readUint32(payload, index);
-                    sensorData.hasStatusWord = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            case XDI::LAT_LON:
-                if (size == 12) { // 6 bytes each for lat and lon
-                    sensorData.latLon.latitude = readFP1632(payload, index);
-                    sensorData.latLon.longitude = readFP1632(payload, index);
-                    sensorData.hasLatLon = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            case XDI::ALTITUDE_ELLIPSOID:
-                if (size == 6) { // FP1632 format
-                    sensorData.altitudeEllipsoid = readFP1632(payload, index);
-                    sensorData.hasAltitudeEllipsoid = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            case XDI::VELOCITY_XYZ:
-                if (size == 18) { // 6 bytes each for X, Y, Z
-                    sensorData.velocityXYZ.velX = readFP1632(payload, index);
-                    sensorData.velocityXYZ.velY = readFP1632(payload, index);
-                    sensorData.velocityXYZ.velZ = readFP1632(payload, index);
-                    sensorData.hasVelocityXYZ = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            case XDI::UTC_TIME:
-                if (size == 12) { // 4 bytes ns + 2 bytes year + 1 byte each for month, day, hour, minute, second, flags
-                    sensorData.utcTime.nanoseconds = readUint32(payload, index);
-                    sensorData.utcTime.year = readUint16(payload, index);
-                    sensorData.utcTime.month = readUint8(payload, index);
-                    sensorData.utcTime.day = readUint8(payload, index);
-                    sensorData.utcTime.hour = readUint8(payload, index);
-                    sensorData.utcTime.minute = readUint8(payload, index);
-                    sensorData.utcTime.second = readUint8(payload, index);
-                    sensorData.utcTime.flags = readUint8(payload, index);
-                    sensorData.hasUtcTime = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            case XDI::QUATERNION:
-                if (size == 16) { // 4 bytes each for q0, q1, q2, q3
-                    sensorData.quaternion.q0 = readFloat(payload, index);
-                    sensorData.quaternion.q1 = readFloat(payload, index);
-                    sensorData.quaternion.q2 = readFloat(payload, index);
-                    sensorData.quaternion.q3 = readFloat(payload, index);
-                    sensorData.hasQuaternion = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            case XDI::BAROMETRIC_PRESSURE:
-                if (size == 4) { // 4 bytes for pressure
-                    sensorData.barometricPressure.pressure = readUint32(payload, index);
-                    sensorData.hasBarometricPressure = true;
-                } else {
-                    index += size; // Skip unknown size
-                }
-                break;
-                
-            default:
-                // Unknown XDI, skip it
-                index += size;
-                break;
+        // Unknown XDIs and unexpected sizes are skipped
+        SensorDataXdi::All::decode(xdi, size, payload + index, sensorData);
+        index += size;
+    }
+    
+    return true;
+}
+
+bool XbusParser::parseMTData2(const uint8_t* xbusData, size_t size, SensorData& sensorData) {
+    return Xbus::isComplete(xbusData, size) && parseMTData2(xbusData, sensorData);
+}
+
+uint32_t XbusParser::parseMTData2Fields(const uint8_t* xbusData, size_t size, uint32_t fields,
+                                        SensorData& sensorData) {
+    if (!Xbus::isComplete(xbusData, size)) {
+        return 0;
+    }
+    return parseMTData2Fields(xbusData, fields, sensorData);
+}
+
+uint32_t XbusParser::parseMTData2Fields(const uint8_t* xbusData, uint32_t fields, SensorData& sensorData) {
+    if (!Xbus::checkPreamble(xbusData) || Xbus::getMessageId(xbusData) != XMID_MtData2) {
+        return 0;
+    }
+    
+    SensorDataXdi::All::clear(sensorData, fields);
+    
+    int payloadLength = Xbus::getPayloadLength(xbusData);
+    const uint8_t* payload = Xbus::getConstPointerToPayload(xbusData);
+    
+    uint32_t found = 0;
+    int index = 0;
+    while (index + 3 <= payloadLength && found != fields) {
+        uint16_t xdi = readUint16(payload, index);
+        uint8_t size = readUint8(payload, index);
+        
+        if (index + size > payloadLength) {
+            break; // Not enough bytes for the data
+        }
+        
+        // Only wanted items are looked up; everything else is jumped over
+        uint32_t field = SensorField::fromXdi(xdi) & fields;
+        if (field != 0 && SensorDataXdi::All::decode(xdi, size, payload + index, sensorData)) {
+            found |= field;
         }
+        index += size;
     }
     
+    return found;
+}
+
+namespace {
+
+// One parseMTData2Batch row; false for frames that are not MTData2
+bool appendMTData2Row(const uint8_t* xbusData, SensorDataColumns& columns) {
+    if (xbusData == nullptr || !Xbus::checkPreamble(xbusData) || Xbus::getMessageId(xbusData) != XMID_MtData2) {
+        return false;
+    }
+    
+    int payloadLength = Xbus::getPayloadLength(xbusData);
+    const uint8_t* payload = Xbus::getConstPointerToPayload(xbusData);
+    size_t row = columns.appendRow();
+    
+    // Same item walk as parseMTData2
+    int index = 0;
+    while (index + 3 <= payloadLength) {
+        uint16_t xdi = XbusParser::readUint16(payload, index);
+        uint8_t size = XbusParser::readUint8(payload, index);
+        
+        if (index + size > payloadLength) {
+            break;
+        }
+        
+        columns.presence[row] |= SensorDataXdi::All::decodeColumns(xdi, size, payload + index, columns, row);
+        index += size;
+    }
     return true;
 }
 
+} // namespace
+
+size_t XbusParser::parseMTData2Batch(const uint8_t* const* frames, size_t count, SensorDataColumns& columns) {
+    columns.reserve(columns.size() + count);
+    
+    size_t rows = 0;
+    for (size_t n = 0; n < count; n++) {
+        if (appendMTData2Row(frames[n], columns)) {
+            rows++;
+        }
+    }
+    return rows;
+}
+
+size_t XbusParser::parseMTData2Batch(const uint8_t* const* frames, const size_t* sizes, size_t count,
+                                     SensorDataColumns& columns) {
+    columns.reserve(columns.size() + count);
+    
+    size_t rows = 0;
+    for (size_t n = 0; n < count; n++) {
+        if (Xbus::isComplete(frames[n], sizes[n]) && appendMTData2Row(frames[n], columns)) {
+            rows++;
+        }
+    }
+    return rows;
+}
+
 std::string XbusParser::formatSensorData(const SensorData& data) {
-    std::ostringstream oss;
+    char buffer[TEXT_BUFFER_SIZE];
+    XbusTextWriter out(buffer);
+    formatSensorData(data, out);
+    return std::string(out.data(), out.size());
+}
+
+void XbusParser::formatSensorData(const SensorData& data, XbusTextWriter& out) {
+    // Fields are separated by ", " after the first one written
+    size_t start = out.size();
+    auto separate = [&out, start]() {
+        if (out.size() != start) {
+            out.append(", ", 2);
+        }
+    };
     
     if (data.hasPacketCounter) {
-        oss << "PC=" << data.packetCounter;
+        out.append("PC=");
+        out.appendUnsigned(data.packetCounter);
     }
     
     if (data.hasSampleTimeFine) {
-        if (!oss.str().empty()) oss << ", ";
-        oss << "STF=" << data.sampleTimeFine;
+        separate();
+        out.append("STF=");
+        out.appendUnsigned(data.sampleTimeFine);
     }
     
     if (data.hasUtcTime) {
-        if (!oss.str().empty()) oss << ", ";
-        oss << "UTC=" << formatUtcTime(data.utcTime);
+        separate();
+        out.append("UTC=");
+        formatUtcTime(data.utcTime, out);
     }
     
     if (data.hasEulerAngles) {
-        if (!oss.str().empty()) oss << ", ";
-        oss << "Euler(R=" << std::fixed << std::setprecision(2) << data.eulerAngles.roll
-            << "°, P=" << data.eulerAngles.pitch 
-            << "°, Y=" << data.eulerAngles.yaw << "°)";
+        separate();
+        out.append("Euler(R=");
+        out.appendFixed(data.eulerAngles.roll, 2);
+        out.append("°, P=");
+        out.appendFixed(data.eulerAngles.pitch, 2);
+        out.append("°, Y=");
+        out.appendFixed(data.eulerAngles.yaw, 2);
+        out.append("°)");
     }
     
     if (data.hasQuaternion) {
-        if (!oss.str().empty()) oss << ", ";
-        oss << "Quat=" << formatQuaternion(data.quaternion);
+        separate();
+        out.append("Quat=");
+        formatQuaternion(data.quaternion, out);
     }
     
     if (data.hasLatLon) {
-        if (!oss.str().empty()) oss << ", ";
-        oss << "LatLon(" << std::fixed << std::setprecision(8) << data.latLon.latitude
-            << ", " << data.latLon.longitude << ")";
+        separate();
+        out.append("LatLon(");
+        out.appendFixed(data.latLon.latitude, 8);
+        out.append(", ");
+        out.appendFixed(data.latLon.longitude, 8);
+        out.append(')');
     }
     
     if (data.hasAltitudeEllipsoid) {
-        if (!oss.str().empty()) oss << ", ";
-        oss << "Alt=" << std::fixed << std::setprecision(3) << data.altitudeEllipsoid << "m";
+        separate();
+        out.append("Alt=");
+        out.appendFixed(data.altitudeEllipsoid, 3);
+        out.append('m');
     }
     
     if (data.hasVelocityXYZ) {
-        if (!oss.str().empty()) oss << ", ";
-        oss << "Vel(" << std::fixed << std::setprecision(4) << data.velocityXYZ.velX
-            << ", " << data.velocityXYZ.velY << ", " << data.velocityXYZ.velZ << ")m/s";
+        separate();
+        out.append("Vel(");
+        out.appendFixed(data.velocityXYZ.velX, 4);
+        out.append(", ");
+        out.appendFixed(data.velocityXYZ.velY, 4);
+        out.append(", ");
+        out.appendFixed(data.velocityXYZ.velZ, 4);
+        out.append(")m/s");
+    }
+    
+    if (data.hasAcceleration) {
+        separate();
+        out.append("Acc");
+        formatVector3(data.acceleration, out);
+        out.append("m/s²");
+    }
+    
+    if (data.hasRateOfTurn) {
+        separate();
+        out.append("Gyr");
+        formatVector3(data.rateOfTurn, out);
+        out.append("rad/s");
+    }
+    
+    if (data.hasMagneticField) {
+        separate();
+        out.append("Mag");
+        formatVector3(data.magneticField, out);
+        out.append("a.u.");
     }
     
     if (data.hasBarometricPressure) {
-        if (!oss.str().empty()) oss << ", ";
-        oss << "Baro=" << formatBarometricPressure(data.barometricPressure);
+        separate();
+        out.append("Baro=");
+        formatBarometricPressure(data.barometricPressure, out);
     }
     
     if (data.hasStatusWord) {
-        if (!oss.str().empty()) oss << ", ";
-        oss << "Status=" << formatStatusWord(data.statusWord);
+        separate();
+        out.append("Status=");
+        formatStatusWord(data.statusWord, out);
     }
-    
-    return oss.str();
 }
 
-std::string XbusParser::getXDIName(uint16_t xdi) {
-    switch (xdi) {
-        case XDI::PACKET_COUNTER: return "PacketCounter";
-        case XDI::SAMPLE_TIME_FINE: return "SampleTimeFine";
-        case XDI::EULER_ANGLES: return "EulerAngles";
-        case XDI::STATUS_WORD: return "StatusWord";
-        case XDI::LAT_LON: return "LatLon";
-        case XDI::ALTITUDE_ELLIPSOID: return "AltitudeEllipsoid";
-        case XDI::VELOCITY_XYZ: return "VelocityXYZ";
-        case XDI::QUATERNION: return "Quaternion";
-        case XDI::ACCELERATION: return "Acceleration";
-        case XDI::RATE_OF_TURN: return "RateOfTurn";
-        case XDI::MAGNETIC_FIELD: return "MagneticField";
-        case XDI::UTC_TIME: return "UtcTime";
-        case XDI::BAROMETRIC_PRESSURE: return "BarometricPressure";
-        default: return "Unknown";
-    }
+const char* XbusParser::xdiName(uint16_t xdi) {
+    const char* name = SensorDataXdi::All::name(xdi);
+    return name != nullptr ? name : "Unknown";
 }
 
-std::string XbusParser::formatStatusWord(uint32_t statusWord) {
-    std::ostringstream oss;
-    oss << "0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(8) << statusWord;
+void XbusParser::formatStatusWord(uint32_t statusWord, XbusTextWriter& out) {
+    out.append("0x");
+    out.appendHex(statusWord, 8);
     
     // Add some basic status interpretation
-    if (statusWord & 0x0001) oss << " [SelfTest]";
-    if (statusWord & 0x0002) oss << " [FilterValid]";
-    if (statusWord & 0x0004) oss << " [GNSSFix]";
-    
-    return oss.str();
+    if (statusWord & 0x0001) out.append(" [SelfTest]");
+    if (statusWord & 0x0002) out.append(" [FilterValid]");
+    if (statusWord & 0x0004) out.append(" [GNSSFix]");
 }
 
-std::string XbusParser::formatUtcTime(const UtcTime& utcTime) {
-    std::ostringstream oss;
-    oss << std::setfill('0') << std::setw(4) << utcTime.year << "-"
-        << std::setw(2) << static_cast<int>(utcTime.month) << "-"
-        << std::setw(2) << static_cast<int>(utcTime.day) << " "
-        << std::setw(2) << static_cast<int>(utcTime.hour) << ":"
-        << std::setw(2) << static_cast<int>(utcTime.minute) << ":"
-        << std::setw(2) << static_cast<int>(utcTime.second) << "."
-        << std::setw(9) << utcTime.nanoseconds;
+void XbusParser::formatUtcTime(const UtcTime& utcTime, XbusTextWriter& out) {
+    out.appendUnsigned(utcTime.year, 4);
+    out.append('-');
+    out.appendUnsigned(utcTime.month, 2);
+    out.append('-');
+    out.appendUnsigned(utcTime.day, 2);
+    out.append(' ');
+    out.appendUnsigned(utcTime.hour, 2);
+    out.append(':');
+    out.appendUnsigned(utcTime.minute, 2);
+    out.append(':');
+    out.appendUnsigned(utcTime.second, 2);
+    out.append('.');
+    out.appendUnsigned(utcTime.nanoseconds, 9);
     
     if (utcTime.flags != 0) {
-        oss << " [F:" << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << static_cast<int>(utcTime.flags) << "]";
+        out.append(" [F:");
+        out.appendHex(utcTime.flags, 2);
+        out.append(']');
     }
-    
-    return oss.str();
 }
 
-std::string XbusParser::formatQuaternion(const Quaternion& quaternion) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(6) << "(" << quaternion.q0 << ", " 
-        << quaternion.q1 << ", " << quaternion.q2 << ", " << quaternion.q3 << ")";
-    return oss.str();
+void XbusParser::formatQuaternion(const Quaternion& quaternion, XbusTextWriter& out) {
+    out.append('(');
+    out.appendFixed(quaternion.q0, 6);
+    out.append(", ");
+    out.appendFixed(quaternion.q1, 6);
+    out.append(", ");
+    out.appendFixed(quaternion.q2, 6);
+    out.append(", ");
+    out.appendFixed(quaternion.q3, 6);
+    out.append(')');
+}
+
+void XbusParser::formatVector3(const Vector3& vector, XbusTextWriter& out) {
+    out.append('(');
+    out.appendFixed(vector.x, 4);
+    out.append(", ");
+    out.appendFixed(vector.y, 4);
+    out.append(", ");
+    out.appendFixed(vector.z, 4);
+    out.append(')');
 }
 
-std::string XbusParser::formatBarometricPressure(const BarometricPressure& pressure) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(2) << (pressure.pressure / 100.0) << " hPa";
-    return oss.str();
+void XbusParser::formatBarometricPressure(const BarometricPressure& pressure, XbusTextWriter& out) {
+    out.appendFixed(pressure.pressure / 100.0, 2);
+    out.append(" hPa");
 }
 
 bool XbusParser::parseEulerAngles(const uint8_t* xbusData, EulerAngles& angles) {
     SensorData sensorData;
-    if (parseMTData2(xbusData, sensorData) && sensorData.hasEulerAngles) {
+    if (parseMTData2Fields(xbusData, SensorField::EULER_ANGLES, sensorData) != 0) {
         angles = sensorData.eulerAngles;
         return true;
     }
@@ -392,7 +562,7 @@ bool XbusParser::parseEulerAngles(const uint8_t* xbusData, EulerAngles& angles)
 
 bool XbusParser::parseQuaternion(const uint8_t* xbusData, Quaternion& quaternion) {
     SensorData sensorData;
-    if (parseMTData2(xbusData, sensorData) && sensorData.hasQuaternion) {
+    if (parseMTData2Fields(xbusData, SensorField::QUATERNION, sensorData) != 0) {
         quaternion = sensorData.quaternion;
         return true;
     }
@@ -401,7 +571,7 @@ bool XbusParser::parseQuaternion(const uint8_t* xbusData, Quaternion& quaternion
 
 bool XbusParser::parseUtcTime(const uint8_t* xbusData, UtcTime& utcTime) {
     SensorData sensorData;
-    if (parseMTData2(xbusData, sensorData) && sensorData.hasUtcTime) {
+    if (parseMTData2Fields(xbusData, SensorField::UTC_TIME, sensorData) != 0) {
         utcTime = sensorData.utcTime;
         return true;
     }
@@ -410,7 +580,7 @@ bool XbusParser::parseUtcTime(const uint8_t* xbusData, UtcTime& utcTime) {
 
 bool XbusParser::parseBarometricPressure(const uint8_t* xbusData, BarometricPressure& pressure) {
     SensorData sensorData;
-    if (parseMTData2(xbusData, sensorData) && sensorData.hasBarometricPressure) {
+    if (parseMTData2Fields(xbusData, SensorField::BAROMETRIC_PRESSURE, sensorData) != 0) {
         pressure = sensorData.barometricPressure;
         return true;
     }
@@ -421,32 +591,38 @@ uint32_t XbusParser::parseDeviceId(const uint8_t* xbusData) {
     if (!Xbus::checkPreamble(xbusData)) {
         return 0;
     }
-
+    
     uint8_t messageId = Xbus::getMessageId(xbusData);
-    if (messageId != XMID_DeviceId) {
+    if (messageId != XMID_DeviceId || Xbus::getPayloadLength(xbusData) < 4) {
         return 0;
     }
-
-    int index = 4;
-    return readUint32(xbusData, index);
+    
+    int index = 0;
+    return readUint32(Xbus::getConstPointerToPayload(xbusData), index);
 }
 
 std::string XbusParser::parseFirmwareRevision(const uint8_t* xbusData) {
     if (!Xbus::checkPreamble(xbusData)) {
         return "";
     }
-
+    
     uint8_t messageId = Xbus::getMessageId(xbusData);
-    if (messageId != XMID_FirmwareRevision) {
+    if (messageId != XMID_FirmwareRevision || Xbus::getPayloadLength(xbusData) < 3) {
         return "";
     }
-
-    int index = 4;
-    uint8_t major = readUint8(xbusData, index);
-    uint8_t minor = readUint8(xbusData, index);
-    uint8_t patch = readUint8(xbusData, index);
     
-    std::ostringstream oss;
-    oss << static_cast<int>(major) << "." << static_cast<int>(minor) << "." << static_cast<int>(patch);
-    return oss.str();
+    const uint8_t* payload = Xbus::getConstPointerToPayload(xbusData);
+    int index = 0;
+    uint8_t major = readUint8(payload, index);
+    uint8_t minor = readUint8(payload, index);
+    uint8_t patch = readUint8(payload, index);
+    
+    char buffer[16];
+    XbusTextWriter out(buffer);
+    out.appendUnsigned(major);
+    out.append('.');
+    out.appendUnsigned(minor);
+    out.append('.');
+    out.appendUnsigned(patch);
+    return std::string(out.data(), out.size());
 }
\ No newline at end of file
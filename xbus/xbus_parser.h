@@ -3,6 +3,8 @@
 
 #include "xbus.h"
 #include "xbus_message_id.h"
+#include "xbus_text_writer.h"
+#include "xbus_xdi_registry.h"
 #include <string>
 #include <cstdint>
 #include <vector>
@@ -55,6 +57,20 @@ struct UtcTime {
     uint8_t flags;
     
     UtcTime() : nanoseconds(0), year(0), month(0), day(0), hour(0), minute(0), second(0), flags(0) {}
+    UtcTime(uint32_t ns, uint16_t y, uint8_t mo, uint8_t d, uint8_t h, uint8_t mi, uint8_t s, uint8_t f)
+        : nanoseconds(ns), year(y), month(mo), day(d), hour(h), minute(mi), second(s), flags(f) {}
+};
+
+// Three-axis inertial output: acceleration (m/s²), rate of turn (rad/s) or
+// magnetic field (arbitrary units, 1 = field at calibration). Aligned to 16
+// bytes so a vector never straddles a cache line.
+struct alignas(16) Vector3 {
+    float x;
+    float y;
+    float z;
+    
+    Vector3() : x(0.0f), y(0.0f), z(0.0f) {}
+    Vector3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
 };
 
 struct BarometricPressure {
@@ -75,6 +91,21 @@ struct SensorData {
     bool hasUtcTime = false;
     bool hasQuaternion = false;
     bool hasBarometricPressure = false;
+    bool hasAcceleration = false;
+    bool hasRateOfTurn = false;
+    bool hasMagneticField = false;
+    
+    // XdiFormat::bits (precision and coordinate system) each real-valued
+    // output was sent with, e.g. XdiFormat::coordinateSystem(eulerAnglesFormat)
+    // is XdiFormat::NED for NED angles
+    uint8_t eulerAnglesFormat = 0;
+    uint8_t latLonFormat = 0;
+    uint8_t altitudeEllipsoidFormat = 0;
+    uint8_t velocityXYZFormat = 0;
+    uint8_t quaternionFormat = 0;
+    uint8_t accelerationFormat = 0;
+    uint8_t rateOfTurnFormat = 0;
+    uint8_t magneticFieldFormat = 0;
     
     uint16_t packetCounter = 0;
     uint32_t sampleTimeFine = 0;
@@ -86,9 +117,88 @@ struct SensorData {
     UtcTime utcTime;
     Quaternion quaternion;
     BarometricPressure barometricPressure;
+    Vector3 acceleration;
+    Vector3 rateOfTurn;
+    Vector3 magneticField;
+};
+
+// Presence bits for SensorDataColumns rows
+namespace SensorField {
+    constexpr uint32_t PACKET_COUNTER = 1u << 0;
+    constexpr uint32_t SAMPLE_TIME_FINE = 1u << 1;
+    constexpr uint32_t EULER_ANGLES = 1u << 2;
+    constexpr uint32_t STATUS_WORD = 1u << 3;
+    constexpr uint32_t LAT_LON = 1u << 4;
+    constexpr uint32_t ALTITUDE_ELLIPSOID = 1u << 5;
+    constexpr uint32_t VELOCITY_XYZ = 1u << 6;
+    constexpr uint32_t UTC_TIME = 1u << 7;
+    constexpr uint32_t QUATERNION = 1u << 8;
+    constexpr uint32_t BAROMETRIC_PRESSURE = 1u << 9;
+    constexpr uint32_t ACCELERATION = 1u << 10;
+    constexpr uint32_t RATE_OF_TURN = 1u << 11;
+    constexpr uint32_t MAGNETIC_FIELD = 1u << 12;
+}
+
+// Structure-of-arrays storage for many decoded MTData2 packets.
+// Every column has size() entries; row i of a column is only meaningful when
+// the matching SensorField bit is set in presence[i], otherwise it holds the
+// same default value SensorData would.
+struct SensorDataColumns {
+    std::vector<uint32_t> presence;
+    
+    std::vector<uint16_t> packetCounter;
+    std::vector<uint32_t> sampleTimeFine;
+    std::vector<float> roll;
+    std::vector<float> pitch;
+    std::vector<float> yaw;
+    std::vector<uint8_t> eulerAnglesFormat;
+    std::vector<uint32_t> statusWord;
+    std::vector<double> latitude;
+    std::vector<double> longitude;
+    std::vector<uint8_t> latLonFormat;
+    std::vector<double> altitudeEllipsoid;
+    std::vector<uint8_t> altitudeEllipsoidFormat;
+    std::vector<double> velX;
+    std::vector<double> velY;
+    std::vector<double> velZ;
+    std::vector<uint8_t> velocityXYZFormat;
+    std::vector<UtcTime> utcTime;
+    std::vector<float> q0;
+    std::vector<float> q1;
+    std::vector<float> q2;
+    std::vector<float> q3;
+    std::vector<uint8_t> quaternionFormat;
+    std::vector<uint32_t> barometricPressure;
+    std::vector<float> accX;
+    std::vector<float> accY;
+    std::vector<float> accZ;
+    std::vector<uint8_t> accelerationFormat;
+    std::vector<float> gyrX;
+    std::vector<float> gyrY;
+    std::vector<float> gyrZ;
+    std::vector<uint8_t> rateOfTurnFormat;
+    std::vector<float> magX;
+    std::vector<float> magY;
+    std::vector<float> magZ;
+    std::vector<uint8_t> magneticFieldFormat;
+    
+    size_t size() const { return presence.size(); }
+    bool has(size_t row, uint32_t field) const { return (presence[row] & field) != 0; }
+    
+    void reserve(size_t rows);
+    void clear();
+    
+    // Append one row with every field absent; returns its index
+    size_t appendRow();
+    
+    // Append a decoded sample, or all rows of another batch
+    size_t append(const SensorData& data);
+    void append(const SensorDataColumns& other);
 };
 
-// XDI (Xsens Data Identifier) constants
+// XDI (Xsens Data Identifier) constants. Real-valued outputs are listed with
+// their default format; the low nibble selects precision and coordinate
+// system (see XdiFormat), e.g. XdiFormat::withPrecision(XDI::LAT_LON, XdiFormat::FLOAT64).
 namespace XDI {
     constexpr uint16_t PACKET_COUNTER = 0x1020;
     constexpr uint16_t SAMPLE_TIME_FINE = 0x1060;
@@ -105,6 +215,157 @@ namespace XDI {
     constexpr uint16_t BAROMETRIC_PRESSURE = 0x3010;
 }
 
+// Data items decoded into SensorData. Each XDI is declared once with its
+// wire layout; XbusParser's decoders, item sizes, field masks and names are
+// all generated from this list (see xbus_xdi_registry.h).
+namespace SensorDataXdi {
+    struct PacketCounter : XdiField<XDI::PACKET_COUNTER, SensorField::PACKET_COUNTER,
+                                    &SensorData::packetCounter, &SensorData::hasPacketCounter,
+                                    nullptr, uint16_t> {
+        static constexpr const char* name = "PacketCounter";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::packetCounter, "PacketCounter"));
+    };
+    
+    struct SampleTimeFine : XdiField<XDI::SAMPLE_TIME_FINE, SensorField::SAMPLE_TIME_FINE,
+                                     &SensorData::sampleTimeFine, &SensorData::hasSampleTimeFine,
+                                     nullptr, uint32_t> {
+        static constexpr const char* name = "SampleTimeFine";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::sampleTimeFine, "SampleTimeFine"));
+    };
+    
+    struct EulerAngles : XdiField<XDI::EULER_ANGLES, SensorField::EULER_ANGLES,
+                                  &SensorData::eulerAngles, &SensorData::hasEulerAngles,
+                                  &SensorData::eulerAnglesFormat,
+                                  float, float, float> {
+        static constexpr const char* name = "EulerAngles";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::roll, &::EulerAngles::roll, "Roll"),
+            XdiColumn(&SensorDataColumns::pitch, &::EulerAngles::pitch, "Pitch"),
+            XdiColumn(&SensorDataColumns::yaw, &::EulerAngles::yaw, "Yaw"),
+            XdiColumn(&SensorDataColumns::eulerAnglesFormat, XdiFormatBits(), "EulerAnglesFormat"));
+    };
+    
+    struct StatusWord : XdiField<XDI::STATUS_WORD, SensorField::STATUS_WORD,
+                                 &SensorData::statusWord, &SensorData::hasStatusWord,
+                                 nullptr, uint32_t> {
+        static constexpr const char* name = "StatusWord";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::statusWord, "StatusWord"));
+    };
+    
+    struct LatLon : XdiField<XDI::LAT_LON, SensorField::LAT_LON,
+                             &SensorData::latLon, &SensorData::hasLatLon,
+                             &SensorData::latLonFormat,
+                             Fp1632, Fp1632> {
+        static constexpr const char* name = "LatLon";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::latitude, &::LatLon::latitude, "Latitude"),
+            XdiColumn(&SensorDataColumns::longitude, &::LatLon::longitude, "Longitude"),
+            XdiColumn(&SensorDataColumns::latLonFormat, XdiFormatBits(), "LatLonFormat"));
+    };
+    
+    struct AltitudeEllipsoid : XdiField<XDI::ALTITUDE_ELLIPSOID, SensorField::ALTITUDE_ELLIPSOID,
+                                        &SensorData::altitudeEllipsoid, &SensorData::hasAltitudeEllipsoid,
+                                        &SensorData::altitudeEllipsoidFormat,
+                                        Fp1632> {
+        static constexpr const char* name = "AltitudeEllipsoid";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::altitudeEllipsoid, "AltitudeEllipsoid"),
+            XdiColumn(&SensorDataColumns::altitudeEllipsoidFormat, XdiFormatBits(), "AltitudeEllipsoidFormat"));
+    };
+    
+    struct VelocityXYZ : XdiField<XDI::VELOCITY_XYZ, SensorField::VELOCITY_XYZ,
+                                  &SensorData::velocityXYZ, &SensorData::hasVelocityXYZ,
+                                  &SensorData::velocityXYZFormat,
+                                  Fp1632, Fp1632, Fp1632> {
+        static constexpr const char* name = "VelocityXYZ";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::velX, &::VelocityXYZ::velX, "VelX"),
+            XdiColumn(&SensorDataColumns::velY, &::VelocityXYZ::velY, "VelY"),
+            XdiColumn(&SensorDataColumns::velZ, &::VelocityXYZ::velZ, "VelZ"),
+            XdiColumn(&SensorDataColumns::velocityXYZFormat, XdiFormatBits(), "VelocityXYZFormat"));
+    };
+    
+    // ns, year, month, day, hour, minute, second, flags
+    struct UtcTime : XdiField<XDI::UTC_TIME, SensorField::UTC_TIME,
+                              &SensorData::utcTime, &SensorData::hasUtcTime,
+                              nullptr, uint32_t, uint16_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t> {
+        static constexpr const char* name = "UtcTime";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::utcTime, "UtcTime"));
+    };
+    
+    struct Quaternion : XdiField<XDI::QUATERNION, SensorField::QUATERNION,
+                                 &SensorData::quaternion, &SensorData::hasQuaternion,
+                                 &SensorData::quaternionFormat,
+                                 float, float, float, float> {
+        static constexpr const char* name = "Quaternion";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::q0, &::Quaternion::q0, "Q0"),
+            XdiColumn(&SensorDataColumns::q1, &::Quaternion::q1, "Q1"),
+            XdiColumn(&SensorDataColumns::q2, &::Quaternion::q2, "Q2"),
+            XdiColumn(&SensorDataColumns::q3, &::Quaternion::q3, "Q3"),
+            XdiColumn(&SensorDataColumns::quaternionFormat, XdiFormatBits(), "QuaternionFormat"));
+    };
+    
+    struct BarometricPressure : XdiField<XDI::BAROMETRIC_PRESSURE, SensorField::BAROMETRIC_PRESSURE,
+                                         &SensorData::barometricPressure, &SensorData::hasBarometricPressure,
+                                         nullptr, uint32_t> {
+        static constexpr const char* name = "BarometricPressure";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::barometricPressure, &::BarometricPressure::pressure, "BarometricPressure"));
+    };
+    
+    struct Acceleration : XdiField<XDI::ACCELERATION, SensorField::ACCELERATION,
+                                   &SensorData::acceleration, &SensorData::hasAcceleration,
+                                   &SensorData::accelerationFormat,
+                                   float, float, float> {
+        static constexpr const char* name = "Acceleration";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::accX, &Vector3::x, "AccX"),
+            XdiColumn(&SensorDataColumns::accY, &Vector3::y, "AccY"),
+            XdiColumn(&SensorDataColumns::accZ, &Vector3::z, "AccZ"),
+            XdiColumn(&SensorDataColumns::accelerationFormat, XdiFormatBits(), "AccelerationFormat"));
+    };
+    
+    struct RateOfTurn : XdiField<XDI::RATE_OF_TURN, SensorField::RATE_OF_TURN,
+                                 &SensorData::rateOfTurn, &SensorData::hasRateOfTurn,
+                                 &SensorData::rateOfTurnFormat,
+                                 float, float, float> {
+        static constexpr const char* name = "RateOfTurn";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::gyrX, &Vector3::x, "GyrX"),
+            XdiColumn(&SensorDataColumns::gyrY, &Vector3::y, "GyrY"),
+            XdiColumn(&SensorDataColumns::gyrZ, &Vector3::z, "GyrZ"),
+            XdiColumn(&SensorDataColumns::rateOfTurnFormat, XdiFormatBits(), "RateOfTurnFormat"));
+    };
+    
+    struct MagneticField : XdiField<XDI::MAGNETIC_FIELD, SensorField::MAGNETIC_FIELD,
+                                    &SensorData::magneticField, &SensorData::hasMagneticField,
+                                    &SensorData::magneticFieldFormat,
+                                    float, float, float> {
+        static constexpr const char* name = "MagneticField";
+        static constexpr auto columns = std::make_tuple(
+            XdiColumn(&SensorDataColumns::magX, &Vector3::x, "MagX"),
+            XdiColumn(&SensorDataColumns::magY, &Vector3::y, "MagY"),
+            XdiColumn(&SensorDataColumns::magZ, &Vector3::z, "MagZ"),
+            XdiColumn(&SensorDataColumns::magneticFieldFormat, XdiFormatBits(), "MagneticFieldFormat"));
+    };
+    
+    typedef XdiList<PacketCounter, SampleTimeFine, EulerAngles, StatusWord, LatLon, AltitudeEllipsoid,
+                    VelocityXYZ, UtcTime, Quaternion, BarometricPressure, Acceleration, RateOfTurn,
+                    MagneticField> All;
+}
+
+namespace SensorField {
+    // SensorField bit filled by an XDI, 0 for XDIs that are not decoded
+    constexpr uint32_t fromXdi(uint16_t xdi) {
+        return SensorDataXdi::All::field(xdi);
+    }
+}
+
 class XbusParser {
 public:
     // Helper functions for reading data from payload
@@ -125,14 +386,69 @@ public:
     
     // Enhanced MTData2 parsing
     static bool parseMTData2(const uint8_t* xbusData, SensorData& sensorData);
+    
+    // The functions taking only a pointer expect a complete message, e.g. a
+    // frame from XbusFramer. These overloads take the size of the memory
+    // behind xbusData and reject a message that does not fit in it, so they
+    // never read past size bytes.
+    static bool parseMTData2(const uint8_t* xbusData, size_t size, SensorData& sensorData);
+    static uint32_t parseMTData2Fields(const uint8_t* xbusData, size_t size, uint32_t fields,
+                                       SensorData& sensorData);
+    static std::string messageToString(const uint8_t* xbusData, size_t size);
+    static void messageToString(const uint8_t* xbusData, size_t size, XbusTextWriter& out);
     static std::string formatSensorData(const SensorData& data);
     
+    // messageToString and formatSensorData appending to a caller buffer:
+    // no streams, no locale and no allocation. A TEXT_BUFFER_SIZE buffer
+    // holds any sample and the common messages; longer text, such as an
+    // extended-length XMID_OutputConfig, is cut off and out.truncated() set
+    // (the std::string overloads grow their buffer instead), e.g.
+    //     char text[XbusParser::TEXT_BUFFER_SIZE];
+    //     XbusTextWriter out(text);
+    //     XbusParser::messageToString(frame, out);
+    static constexpr size_t TEXT_BUFFER_SIZE = 4096;
+    static void messageToString(const uint8_t* xbusData, XbusTextWriter& out);
+    static void formatSensorData(const SensorData& data, XbusTextWriter& out);
+    
+    // Decode only the SensorField bits set in fields. Other items are
+    // skipped using their size byte and the walk stops as soon as every
+    // requested field has been found. Only the has* flags of the requested
+    // fields are reset; the rest of sensorData is left untouched.
+    // Returns the SensorField bits that were decoded (0 if not MTData2).
+    static uint32_t parseMTData2Fields(const uint8_t* xbusData, uint32_t fields, SensorData& sensorData);
+    
+    // parseMTData2Fields with the wanted XDIs fixed at compile time, e.g.
+    // parseMTData2Select<XDI::EULER_ANGLES, XDI::QUATERNION>(frame, data)
+    template <uint16_t... Xdis>
+    static uint32_t parseMTData2Select(const uint8_t* xbusData, SensorData& sensorData) {
+        static_assert(sizeof...(Xdis) > 0, "Select at least one XDI");
+        static_assert(((SensorField::fromXdi(Xdis) != 0) && ...), "XDI is not decoded by XbusParser");
+        constexpr uint32_t fields = (SensorField::fromXdi(Xdis) | ...);
+        return parseMTData2Fields(xbusData, fields, sensorData);
+    }
+    
+    // Decode many MTData2 frames and append one row per valid frame to
+    // columns. Frames that are not MTData2 are skipped. Returns rows appended.
+    // Like the other functions taking only a pointer, the first form expects
+    // complete messages; the second takes the size of the memory behind each
+    // frame and skips frames that do not fit in it (Xbus::isComplete).
+    static size_t parseMTData2Batch(const uint8_t* const* frames, size_t count, SensorDataColumns& columns);
+    static size_t parseMTData2Batch(const uint8_t* const* frames, const size_t* sizes, size_t count,
+                                    SensorDataColumns& columns);
+    
+    // Per data item decoding, shared by parseMTData2 and XbusLayoutDecoder.
+    // A decoder receives a pointer just past the XDI and size bytes.
+    typedef void (*DataItemDecoder)(const uint8_t* item, SensorData& sensorData);
+    static uint8_t getDataItemSize(uint16_t xdi);  // 0 for unsupported XDIs
+    static DataItemDecoder getDataItemDecoder(uint16_t xdi, uint8_t size);
+
 private:
-    static std::string getXDIName(uint16_t xdi);
-    static std::string formatStatusWord(uint32_t statusWord);
-    static std::string formatUtcTime(const UtcTime& utcTime);
-    static std::string formatQuaternion(const Quaternion& quaternion);
-    static std::string formatBarometricPressure(const BarometricPressure& pressure);
+    static const char* xdiName(uint16_t xdi);  // registry name, "Unknown" if not decoded
+    static void formatStatusWord(uint32_t statusWord, XbusTextWriter& out);
+    static void formatUtcTime(const UtcTime& utcTime, XbusTextWriter& out);
+    static void formatQuaternion(const Quaternion& quaternion, XbusTextWriter& out);
+    static void formatBarometricPressure(const BarometricPressure& pressure, XbusTextWriter& out);
+    static void formatVector3(const Vector3& vector, XbusTextWriter& out);
 };
 
 #endif // XBUS_PARSER_H
\ No newline at end of file
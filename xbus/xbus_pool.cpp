@@ -0,0 +1,89 @@
+#include "xbus_pool.h"
+
+XbusSlotList::XbusSlotList(size_t count)
+    : m_count(count)
+    , m_next(new std::atomic<uint32_t>[count])
+    , m_references(new std::atomic<uint32_t>[count])
+    , m_head(pack(0, count > 0 ? 0 : NONE))
+    , m_acquired(0)
+    , m_exhausted(0)
+    , m_inUse(0)
+    , m_highWater(0) {
+    for (size_t i = 0; i < count; i++) {
+        m_next[i].store(i + 1 < count ? static_cast<uint32_t>(i + 1) : NONE, std::memory_order_relaxed);
+        m_references[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+uint32_t XbusSlotList::acquire() {
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t slot = static_cast<uint32_t>(head);
+        if (slot == NONE) {
+            m_exhausted.fetch_add(1, std::memory_order_relaxed);
+            return NONE;
+        }
+        
+        // next may be stale if the slot was taken meanwhile; the tag makes
+        // the exchange fail in that case
+        uint32_t next = m_next[slot].load(std::memory_order_relaxed);
+        if (m_head.compare_exchange_weak(head, pack(static_cast<uint32_t>(head >> 32) + 1, next),
+                                         std::memory_order_acquire, std::memory_order_acquire)) {
+            m_references[slot].store(1, std::memory_order_relaxed);
+            m_acquired.fetch_add(1, std::memory_order_relaxed);
+            size_t inUse = m_inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+            size_t highWater = m_highWater.load(std::memory_order_relaxed);
+            while (inUse > highWater &&
+                   !m_highWater.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed)) {
+            }
+            return slot;
+        }
+    }
+}
+
+void XbusSlotList::retain(uint32_t slot) {
+    m_references[slot].fetch_add(1, std::memory_order_relaxed);
+}
+
+bool XbusSlotList::release(uint32_t slot) {
+    // acq_rel: writes made through any handle happen before the slot is
+    // handed out again
+    if (m_references[slot].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return false;
+    }
+    m_inUse.fetch_sub(1, std::memory_order_relaxed);
+    push(slot);
+    return true;
+}
+
+uint32_t XbusSlotList::useCount(uint32_t slot) const {
+    return m_references[slot].load(std::memory_order_relaxed);
+}
+
+size_t XbusSlotList::capacity() const {
+    return m_count;
+}
+
+XbusSlotList::Stats XbusSlotList::stats() const {
+    Stats stats;
+    stats.acquired = m_acquired.load(std::memory_order_relaxed);
+    stats.exhausted = m_exhausted.load(std::memory_order_relaxed);
+    stats.inUse = m_inUse.load(std::memory_order_relaxed);
+    stats.highWater = m_highWater.load(std::memory_order_relaxed);
+    return stats;
+}
+
+uint64_t XbusSlotList::pack(uint32_t tag, uint32_t slot) {
+    return (static_cast<uint64_t>(tag) << 32) | slot;
+}
+
+void XbusSlotList::push(uint32_t slot) {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    for (;;) {
+        m_next[slot].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        if (m_head.compare_exchange_weak(head, pack(static_cast<uint32_t>(head >> 32) + 1, slot),
+                                         std::memory_order_release, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,198 @@
+#ifndef XBUS_POOL_H
+#define XBUS_POOL_H
+
+#include "xbus.h"
+#include "xbus_framer.h"
+#include "xbus_parser.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+// Free list and reference counts for a fixed number of slots.
+//
+// acquire() and release() are lock-free and may be called from any thread:
+// the free list is a stack of slot indices whose head carries a tag that
+// changes on every update, so a slot taken and returned between a load and
+// the compare-exchange is noticed. Nothing is allocated after construction.
+class XbusSlotList {
+public:
+    static constexpr uint32_t NONE = 0xFFFFFFFF;
+    
+    // Snapshot; counters are updated with relaxed atomics
+    struct Stats {
+        uint64_t acquired;
+        uint64_t exhausted;     // acquire() calls that found no free slot
+        size_t inUse;
+        size_t highWater;       // most slots in use at once
+    };
+    
+    explicit XbusSlotList(size_t count);
+    
+    XbusSlotList(const XbusSlotList&) = delete;
+    XbusSlotList& operator=(const XbusSlotList&) = delete;
+    
+    // Take a free slot with one reference, NONE when all are in use
+    uint32_t acquire();
+    
+    // Add a reference to a slot in use
+    void retain(uint32_t slot);
+    
+    // Drop a reference. The last one returns the slot to the free list and
+    // makes release() return true.
+    bool release(uint32_t slot);
+    
+    uint32_t useCount(uint32_t slot) const;
+    size_t capacity() const;
+    Stats stats() const;
+
+private:
+    static uint64_t pack(uint32_t tag, uint32_t slot);
+    void push(uint32_t slot);
+    
+    const size_t m_count;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_references;
+    std::atomic<uint64_t> m_head;           // tag << 32 | first free slot
+    
+    std::atomic<uint64_t> m_acquired;
+    std::atomic<uint64_t> m_exhausted;
+    std::atomic<size_t> m_inUse;
+    std::atomic<size_t> m_highWater;
+};
+
+// Fixed-capacity pool of T for the sample path.
+//
+// All capacity objects are constructed up front. acquire() hands out a
+// reference-counted Handle to a free one; copies of the handle share the
+// object, so one decoded sample or received frame can be passed to several
+// consumers without copying it, and the last handle to go away returns the
+// object to the pool. Once the pool exists, acquiring, sharing and releasing
+// never touch the heap. When every object is in use acquire() returns an
+// empty handle and counts it in stats().exhausted.
+//
+//     SensorDataPool pool(256);
+//     SensorDataPool::Handle sample = pool.acquire();
+//     if (sample && XbusParser::parseMTData2(frame.data, *sample)) {
+//         queue.tryPush(sample);   // the consumer's copy keeps it alive
+//     }
+//
+// Objects keep their previous contents when handed out again; the producer
+// overwrites them (parseMTData2 and XbusFrameBuffer::assign() do) before
+// sharing the handle. Consumers should treat a shared object as read-only.
+// The pool must outlive its handles.
+template <typename T>
+class XbusPool {
+public:
+    class Handle {
+    public:
+        Handle() : m_pool(nullptr), m_slot(XbusSlotList::NONE) {}
+        
+        Handle(const Handle& other) : m_pool(other.m_pool), m_slot(other.m_slot) {
+            if (m_pool != nullptr) {
+                m_pool->m_slots.retain(m_slot);
+            }
+        }
+        
+        Handle(Handle&& other) noexcept : m_pool(other.m_pool), m_slot(other.m_slot) {
+            other.m_pool = nullptr;
+            other.m_slot = XbusSlotList::NONE;
+        }
+        
+        Handle& operator=(Handle other) noexcept {
+            std::swap(m_pool, other.m_pool);
+            std::swap(m_slot, other.m_slot);
+            return *this;
+        }
+        
+        ~Handle() {
+            reset();
+        }
+        
+        // Drop this reference
+        void reset() {
+            if (m_pool != nullptr) {
+                m_pool->m_slots.release(m_slot);
+                m_pool = nullptr;
+                m_slot = XbusSlotList::NONE;
+            }
+        }
+        
+        T* get() const { return m_pool != nullptr ? &m_pool->m_objects[m_slot] : nullptr; }
+        T& operator*() const { return m_pool->m_objects[m_slot]; }
+        T* operator->() const { return get(); }
+        explicit operator bool() const { return m_pool != nullptr; }
+        
+        // Handles sharing the object, 0 for an empty handle
+        uint32_t useCount() const { return m_pool != nullptr ? m_pool->m_slots.useCount(m_slot) : 0; }
+    
+    private:
+        friend class XbusPool;
+        Handle(XbusPool* pool, uint32_t slot) : m_pool(pool), m_slot(slot) {}
+        
+        XbusPool* m_pool;
+        uint32_t m_slot;
+    };
+    
+    explicit XbusPool(size_t capacity)
+        : m_objects(new T[capacity < 1 ? 1 : capacity])
+        , m_slots(capacity < 1 ? 1 : capacity) {
+    }
+    
+    XbusPool(const XbusPool&) = delete;
+    XbusPool& operator=(const XbusPool&) = delete;
+    
+    // A free object, or an empty handle when the pool is exhausted
+    Handle acquire() {
+        uint32_t slot = m_slots.acquire();
+        return slot != XbusSlotList::NONE ? Handle(this, slot) : Handle();
+    }
+    
+    // A free object set to value
+    Handle acquire(const T& value) {
+        Handle handle = acquire();
+        if (handle) {
+            *handle = value;
+        }
+        return handle;
+    }
+    
+    size_t capacity() const { return m_slots.capacity(); }
+    XbusSlotList::Stats stats() const { return m_slots.stats(); }
+
+private:
+    std::unique_ptr<T[]> m_objects;
+    XbusSlotList m_slots;
+};
+
+// Pool object holding one received frame. The default capacity fits every
+// frame with a standard length field; pick a larger one for extended-length
+// outputs.
+template <size_t Capacity = Xbus::OFFSET_TO_PAYLOAD + Xbus::XBUS_EXTENDED_LENGTH - 1 + Xbus::XBUS_CHECKSUM_SIZE>
+struct XbusFrameBuffer {
+    static constexpr size_t CAPACITY = Capacity;
+    
+    size_t size = 0;
+    uint8_t data[Capacity];
+    
+    // Copy a frame in; false, leaving the buffer empty, if it does not fit
+    bool assign(const XbusFrame& frame) {
+        if (frame.size > Capacity) {
+            size = 0;
+            return false;
+        }
+        memcpy(data, frame.data, frame.size);
+        size = frame.size;
+        return true;
+    }
+    
+    XbusFrame frame() const { return XbusFrame(data, size); }
+};
+
+typedef XbusFrameBuffer<> XbusFrameSlot;
+typedef XbusPool<XbusFrameSlot> XbusFramePool;
+typedef XbusPool<SensorData> SensorDataPool;
+
+#endif // XBUS_POOL_H
@@ -0,0 +1,386 @@
+#include "xbus_recorder.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void writeLe32(uint8_t* dest, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        dest[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+void writeLe64(uint8_t* dest, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        dest[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t readLe32(const uint8_t* src) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | src[i];
+    }
+    return value;
+}
+
+uint64_t readLe64(const uint8_t* src) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | src[i];
+    }
+    return value;
+}
+
+std::string errnoString() {
+    return std::string(strerror(errno)) + " (errno " + std::to_string(errno) + ")";
+}
+
+} // namespace
+
+// XbusRecorder
+
+XbusRecorder::XbusRecorder(size_t bufferSize)
+    : m_file(nullptr)
+    , m_buffer(bufferSize < XbusLog::RECORD_HEADER_SIZE ? XbusLog::RECORD_HEADER_SIZE : bufferSize)
+    , m_used(0)
+    , m_framesRecorded(0)
+    , m_bytesRecorded(0) {
+}
+
+XbusRecorder::~XbusRecorder() {
+    close();
+}
+
+bool XbusRecorder::open(const std::string& path) {
+    close();
+    
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file) {
+        setLastError("Failed to create " + path + ": " + errnoString());
+        return false;
+    }
+    
+    // Records are collected in m_buffer; stdio buffering would only copy again
+    std::setvbuf(m_file, nullptr, _IONBF, 0);
+    
+    uint8_t header[XbusLog::FILE_HEADER_SIZE] = {0};
+    memcpy(header, XbusLog::MAGIC, sizeof(XbusLog::MAGIC));
+    writeLe32(header + 8, XbusLog::VERSION);
+    writeLe32(header + 12, 0); // flags, reserved
+    writeLe64(header + 16, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()));
+    writeLe64(header + 24, XbusLog::steadyTimeNs());
+    
+    if (std::fwrite(header, 1, sizeof(header), m_file) != sizeof(header)) {
+        setLastError("Failed to write log header: " + errnoString());
+        std::fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    
+    m_used = 0;
+    m_framesRecorded = 0;
+    m_bytesRecorded = sizeof(header);
+    return true;
+}
+
+void XbusRecorder::close() {
+    if (!m_file) {
+        return;
+    }
+    
+    flush();
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+bool XbusRecorder::isOpen() const {
+    return m_file != nullptr;
+}
+
+bool XbusRecorder::record(const uint8_t* frame, size_t size, uint64_t receiveTimeNs) {
+    if (!m_file) {
+        setLastError("Recorder is not open");
+        return false;
+    }
+    
+    size_t recordSize = XbusLog::RECORD_HEADER_SIZE + size;
+    if (recordSize > m_buffer.size() - m_used && !writeBuffer()) {
+        return false;
+    }
+    
+    uint8_t* dest = m_buffer.data() + m_used;
+    writeLe64(dest, receiveTimeNs);
+    writeLe32(dest + 8, static_cast<uint32_t>(size));
+    
+    if (recordSize <= m_buffer.size()) {
+        memcpy(dest + XbusLog::RECORD_HEADER_SIZE, frame, size);
+        m_used += recordSize;
+    } else {
+        // Larger than the whole buffer: write header and frame directly
+        m_used += XbusLog::RECORD_HEADER_SIZE;
+        if (!writeBuffer() || std::fwrite(frame, 1, size, m_file) != size) {
+            setLastError("Failed to write log: " + errnoString());
+            return false;
+        }
+    }
+    
+    m_framesRecorded++;
+    m_bytesRecorded += recordSize;
+    return true;
+}
+
+bool XbusRecorder::record(const XbusFrame& frame, uint64_t receiveTimeNs) {
+    return record(frame.data, frame.size, receiveTimeNs);
+}
+
+bool XbusRecorder::flush() {
+    if (!m_file) {
+        return false;
+    }
+    
+    return writeBuffer() && std::fflush(m_file) == 0;
+}
+
+uint64_t XbusRecorder::framesRecorded() const {
+    return m_framesRecorded;
+}
+
+uint64_t XbusRecorder::bytesRecorded() const {
+    return m_bytesRecorded;
+}
+
+std::string XbusRecorder::getLastError() const {
+    return m_lastError;
+}
+
+bool XbusRecorder::writeBuffer() {
+    if (m_used == 0) {
+        return true;
+    }
+    
+    size_t written = std::fwrite(m_buffer.data(), 1, m_used, m_file);
+    bool ok = written == m_used;
+    m_used = 0;
+    if (!ok) {
+        setLastError("Failed to write log: " + errnoString());
+    }
+    return ok;
+}
+
+void XbusRecorder::setLastError(const std::string& error) {
+    m_lastError = error;
+}
+
+// XbusReplay
+
+XbusReplay::XbusReplay()
+    : m_data(nullptr)
+    , m_size(0)
+#ifdef _WIN32
+    , m_fileHandle(INVALID_HANDLE_VALUE)
+    , m_mappingHandle(nullptr)
+#endif
+    , m_startSystemTimeNs(0)
+    , m_startSteadyTimeNs(0)
+    , m_truncated(false) {
+}
+
+XbusReplay::~XbusReplay() {
+    close();
+}
+
+bool XbusReplay::open(const std::string& path) {
+    close();
+    
+    if (!map(path)) {
+        return false;
+    }
+    
+    if (m_size < XbusLog::FILE_HEADER_SIZE || memcmp(m_data, XbusLog::MAGIC, sizeof(XbusLog::MAGIC)) != 0) {
+        setLastError(path + " is not an Xbus session log");
+        close();
+        return false;
+    }
+    
+    uint32_t version = readLe32(m_data + 8);
+    if (version != XbusLog::VERSION) {
+        setLastError("Unsupported log version " + std::to_string(version));
+        close();
+        return false;
+    }
+    
+    m_startSystemTimeNs = readLe64(m_data + 16);
+    m_startSteadyTimeNs = readLe64(m_data + 24);
+    
+    // Index every complete record
+    size_t offset = XbusLog::FILE_HEADER_SIZE;
+    while (offset < m_size) {
+        if (m_size - offset < XbusLog::RECORD_HEADER_SIZE) {
+            m_truncated = true;
+            break;
+        }
+        
+        IndexEntry entry;
+        entry.receiveTimeNs = readLe64(m_data + offset);
+        entry.size = readLe32(m_data + offset + 8);
+        entry.offset = offset + XbusLog::RECORD_HEADER_SIZE;
+        if (entry.size > m_size - entry.offset) {
+            m_truncated = true;
+            break;
+        }
+        
+        m_index.push_back(entry);
+        offset = entry.offset + entry.size;
+    }
+    
+    return true;
+}
+
+void XbusReplay::close() {
+    unmap();
+    m_index.clear();
+    m_startSystemTimeNs = 0;
+    m_startSteadyTimeNs = 0;
+    m_truncated = false;
+}
+
+bool XbusReplay::isOpen() const {
+    return m_data != nullptr;
+}
+
+size_t XbusReplay::recordCount() const {
+    return m_index.size();
+}
+
+XbusReplay::Record XbusReplay::record(size_t index) const {
+    Record result;
+    result.receiveTimeNs = 0;
+    if (index < m_index.size()) {
+        const IndexEntry& entry = m_index[index];
+        result.receiveTimeNs = entry.receiveTimeNs;
+        result.frame = XbusFrame(m_data + entry.offset, entry.size);
+    }
+    return result;
+}
+
+uint64_t XbusReplay::startSystemTimeNs() const {
+    return m_startSystemTimeNs;
+}
+
+uint64_t XbusReplay::startSteadyTimeNs() const {
+    return m_startSteadyTimeNs;
+}
+
+bool XbusReplay::truncated() const {
+    return m_truncated;
+}
+
+std::string XbusReplay::getLastError() const {
+    return m_lastError;
+}
+
+#ifdef _WIN32
+
+bool XbusReplay::map(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        setLastError("Failed to open " + path + ". Error: " + std::to_string(GetLastError()));
+        return false;
+    }
+    
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        setLastError(path + " is empty or unreadable");
+        CloseHandle(file);
+        return false;
+    }
+    
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        setLastError("Failed to map " + path + ". Error: " + std::to_string(GetLastError()));
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+    
+    m_fileHandle = file;
+    m_mappingHandle = mapping;
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void XbusReplay::unmap() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mappingHandle) {
+        CloseHandle(m_mappingHandle);
+        m_mappingHandle = nullptr;
+    }
+    if (m_fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_fileHandle);
+        m_fileHandle = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
+
+#else
+
+bool XbusReplay::map(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        setLastError("Failed to open " + path + ": " + errnoString());
+        return false;
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        setLastError(path + " is empty or unreadable");
+        ::close(fd);
+        return false;
+    }
+    
+    // The mapping stays valid after the descriptor is closed
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        setLastError("Failed to map " + path + ": " + errnoString());
+        return false;
+    }
+    madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+    
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void XbusReplay::unmap() {
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+        m_data = nullptr;
+    }
+    m_size = 0;
+}
+
+#endif
+
+void XbusReplay::setLastError(const std::string& error) {
+    m_lastError = error;
+}
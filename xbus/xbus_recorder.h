@@ -0,0 +1,189 @@
+#ifndef XBUS_RECORDER_H
+#define XBUS_RECORDER_H
+
+#include "xbus_framer.h"
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Binary session log of verified Xbus frames.
+//
+// File layout (all header fields little-endian):
+//
+//     file header  32 bytes  "XBUSREC1", version, flags, recording start
+//                            time (system clock) and the steady clock time
+//                            at that moment, both in ns
+//     record       12 bytes  receive time (steady clock, ns), frame size
+//                  N bytes   raw frame, preamble through checksum
+//     record ...
+//
+// Receive times are host steady clock values; the header pair maps them to
+// wall-clock time. A log cut off mid-record (e.g. by a crash) stays readable
+// up to the last complete record.
+namespace XbusLog {
+
+constexpr char MAGIC[8] = {'X', 'B', 'U', 'S', 'R', 'E', 'C', '1'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t FILE_HEADER_SIZE = 32;
+constexpr size_t RECORD_HEADER_SIZE = 12;
+
+// Host steady clock in ns, the time base of recorded receive times
+inline uint64_t steadyTimeNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace XbusLog
+
+// Appends frames to a session log through a large write buffer, so the
+// file is only written once per buffer (1 MiB by default) instead of once
+// per frame.
+class XbusRecorder {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+    
+    explicit XbusRecorder(size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    ~XbusRecorder();
+    
+    XbusRecorder(const XbusRecorder&) = delete;
+    XbusRecorder& operator=(const XbusRecorder&) = delete;
+    
+    // Create (or truncate) a log file and write its header
+    bool open(const std::string& path);
+    
+    // Flush and close the file
+    void close();
+    bool isOpen() const;
+    
+    // Append one frame with its host receive time
+    bool record(const uint8_t* frame, size_t size, uint64_t receiveTimeNs);
+    bool record(const XbusFrame& frame, uint64_t receiveTimeNs);
+    
+    // Write buffered records to the file
+    bool flush();
+    
+    uint64_t framesRecorded() const;
+    uint64_t bytesRecorded() const;
+    std::string getLastError() const;
+
+private:
+    bool writeBuffer();
+    void setLastError(const std::string& error);
+    
+    std::FILE* m_file;
+    std::vector<uint8_t> m_buffer;
+    size_t m_used;
+    uint64_t m_framesRecorded;
+    uint64_t m_bytesRecorded;
+    std::string m_lastError;
+};
+
+// Reads a session log through a read-only memory mapping. Opening builds an
+// index of all records, so records can be accessed randomly and replayed
+// without copying the frame bytes.
+class XbusReplay {
+public:
+    struct Record {
+        uint64_t receiveTimeNs;
+        XbusFrame frame;        // points into the mapping, valid until close()
+    };
+    
+    XbusReplay();
+    ~XbusReplay();
+    
+    XbusReplay(const XbusReplay&) = delete;
+    XbusReplay& operator=(const XbusReplay&) = delete;
+    
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+    
+    size_t recordCount() const;
+    Record record(size_t index) const;
+    
+    // Recording start, wall-clock (system clock) ns since the epoch;
+    // receive times convert with startSystemTimeNs() + (t - startSteadyTimeNs())
+    uint64_t startSystemTimeNs() const;
+    uint64_t startSteadyTimeNs() const;
+    
+    // True if the file ended inside a record; that record is ignored
+    bool truncated() const;
+    
+    // Call callback(const Record&) for records [first, recordCount()).
+    // speed 0 replays as fast as possible, 1.0 at the recorded pace, 2.0 at
+    // twice that. Returns the number of records played.
+    template <typename Callback>
+    size_t play(Callback callback, double speed = 0.0, size_t first = 0) const;
+    
+    // Replay the frames as a byte stream through a framer, as they would
+    // arrive from a port, calling callback(const XbusFrame&) for every
+    // frame the framer accepts. Returns the number of frames delivered.
+    template <typename Callback>
+    size_t feed(XbusFramer& framer, Callback callback, double speed = 0.0) const;
+    
+    std::string getLastError() const;
+
+private:
+    struct IndexEntry {
+        uint64_t offset;        // offset of the frame bytes in the file
+        uint64_t receiveTimeNs;
+        uint32_t size;
+    };
+    
+    bool map(const std::string& path);
+    void unmap();
+    void setLastError(const std::string& error);
+    
+    const uint8_t* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#endif
+    std::vector<IndexEntry> m_index;
+    uint64_t m_startSystemTimeNs;
+    uint64_t m_startSteadyTimeNs;
+    bool m_truncated;
+    std::string m_lastError;
+};
+
+template <typename Callback>
+size_t XbusReplay::play(Callback callback, double speed, size_t first) const {
+    if (first >= m_index.size()) {
+        return 0;
+    }
+    
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const uint64_t firstTime = m_index[first].receiveTimeNs;
+    
+    size_t played = 0;
+    for (size_t i = first; i < m_index.size(); i++) {
+        const IndexEntry& entry = m_index[i];
+        if (speed > 0.0 && entry.receiveTimeNs > firstTime) {
+            std::chrono::nanoseconds offset(static_cast<int64_t>((entry.receiveTimeNs - firstTime) / speed));
+            std::this_thread::sleep_until(start + offset);
+        }
+        
+        Record current;
+        current.receiveTimeNs = entry.receiveTimeNs;
+        current.frame = XbusFrame(m_data + entry.offset, entry.size);
+        callback(static_cast<const Record&>(current));
+        played++;
+    }
+    return played;
+}
+
+template <typename Callback>
+size_t XbusReplay::feed(XbusFramer& framer, Callback callback, double speed) const {
+    size_t delivered = 0;
+    play([&framer, &callback, &delivered](const Record& current) {
+        delivered += framer.feed(current.frame.data, current.frame.size, callback);
+    }, speed);
+    return delivered;
+}
+
+#endif // XBUS_RECORDER_H
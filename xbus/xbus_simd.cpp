@@ -0,0 +1,218 @@
+#include "xbus_simd.h"
+#include "xbus_simd_target.h"
+#include <atomic>
+#include <cstring>
+
+namespace XbusSimd {
+
+namespace {
+
+struct Kernels {
+    uint8_t (*byteSum)(const uint8_t* data, size_t length);
+    Level level;
+};
+
+// ---------------------------------------------------------------------------
+// Scalar kernel
+
+// Eight bytes per step: the words are added bytewise modulo 256 (the top
+// bit of each byte is handled separately so no carry crosses into the next
+// byte) and the eight byte lanes are folded at the end
+uint8_t scalarByteSum(const uint8_t* data, size_t length) {
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+    const uint64_t high = 0x8080808080808080ULL;
+    uint64_t lanes = 0;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        lanes = ((lanes & low7) + (word & low7)) ^ ((lanes ^ word) & high);
+    }
+    
+    uint8_t sum = 0;
+    for (int lane = 0; lane < 8; lane++) {
+        sum = static_cast<uint8_t>(sum + (lanes >> (8 * lane)));
+    }
+    for (; i < length; i++) {
+        sum = static_cast<uint8_t>(sum + data[i]);
+    }
+    return sum;
+}
+
+const Kernels scalarKernels = {scalarByteSum, Level::Scalar};
+
+// ---------------------------------------------------------------------------
+// x86 kernels
+
+#if defined(XBUS_SIMD_X86)
+
+// Bytes are added lane by lane modulo 256, which is all the checksum
+// needs; one psadbw then adds the 16 lanes
+XBUS_TARGET_SSSE3 inline uint8_t foldByteSum(__m128i lanes) {
+    __m128i sums = _mm_sad_epu8(lanes, _mm_setzero_si128());
+    return static_cast<uint8_t>(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+}
+
+XBUS_TARGET_SSSE3 uint8_t ssse3ByteSum(const uint8_t* data, size_t length) {
+    __m128i lanes = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        lanes = _mm_add_epi8(lanes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+    }
+    return static_cast<uint8_t>(foldByteSum(lanes) + scalarByteSum(data + i, length - i));
+}
+
+XBUS_TARGET_AVX2 uint8_t avx2ByteSum(const uint8_t* data, size_t length) {
+    // Two accumulators keep two loads in flight per iteration
+    __m256i lanes0 = _mm256_setzero_si256();
+    __m256i lanes1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        lanes0 = _mm256_add_epi8(lanes0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+        lanes1 = _mm256_add_epi8(lanes1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32)));
+    }
+    __m256i lanes = _mm256_add_epi8(lanes0, lanes1);
+    __m128i half = _mm_add_epi8(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+    return static_cast<uint8_t>(foldByteSum(half) + ssse3ByteSum(data + i, length - i));
+}
+
+const Kernels ssse3Kernels = {ssse3ByteSum, Level::Ssse3};
+const Kernels avx2Kernels = {avx2ByteSum, Level::Avx2};
+
+bool cpuHasSsse3() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    // The OS must save the YMM registers (OSXSAVE plus XCR0 bits 1 and 2)
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // XBUS_SIMD_X86
+
+// ---------------------------------------------------------------------------
+// ARM NEON kernels
+
+#if defined(XBUS_SIMD_NEON)
+
+uint8_t neonByteSum(const uint8_t* data, size_t length) {
+    uint8x16_t lanes = vdupq_n_u8(0);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        lanes = vaddq_u8(lanes, vld1q_u8(data + i));
+    }
+    uint8_t folded[16];
+    vst1q_u8(folded, lanes);
+    return static_cast<uint8_t>(scalarByteSum(folded, 16) + scalarByteSum(data + i, length - i));
+}
+
+const Kernels neonKernels = {neonByteSum, Level::Neon};
+
+#endif // XBUS_SIMD_NEON
+
+const Kernels* kernelsFor(Level level) {
+    switch (level) {
+#if defined(XBUS_SIMD_X86)
+        case Level::Ssse3: return &ssse3Kernels;
+        case Level::Avx2: return &avx2Kernels;
+#endif
+#if defined(XBUS_SIMD_NEON)
+        case Level::Neon: return &neonKernels;
+#endif
+        default: return &scalarKernels;
+    }
+}
+
+Level detect() {
+#if defined(XBUS_SIMD_X86)
+    if (cpuHasAvx2()) {
+        return Level::Avx2;
+    }
+    if (cpuHasSsse3()) {
+        return Level::Ssse3;
+    }
+    return Level::Scalar;
+#elif defined(XBUS_SIMD_NEON)
+    return Level::Neon;
+#else
+    return Level::Scalar;
+#endif
+}
+
+std::atomic<const Kernels*> g_active(nullptr);
+
+inline const Kernels& active() {
+    const Kernels* kernels = g_active.load(std::memory_order_relaxed);
+    if (kernels == nullptr) {
+        kernels = kernelsFor(detectedLevel());
+        g_active.store(kernels, std::memory_order_relaxed);
+    }
+    return *kernels;
+}
+
+} // namespace
+
+Level detectedLevel() {
+    static const Level level = detect();
+    return level;
+}
+
+Level activeLevel() {
+    return active().level;
+}
+
+bool setLevel(Level level) {
+    Level detected = detectedLevel();
+    bool supported = (level == Level::Scalar) || (level == detected);
+#if defined(XBUS_SIMD_X86)
+    // An AVX2 CPU also runs the SSSE3 kernels
+    supported = supported || (level == Level::Ssse3 && detected == Level::Avx2);
+#endif
+    if (!supported) {
+        return false;
+    }
+    g_active.store(kernelsFor(level), std::memory_order_relaxed);
+    return true;
+}
+
+const char* levelName(Level level) {
+    switch (level) {
+        case Level::Scalar: return "Scalar";
+        case Level::Ssse3: return "SSSE3";
+        case Level::Avx2: return "AVX2";
+        case Level::Neon: return "NEON";
+        default: return "Unknown";
+    }
+}
+
+uint8_t byteSum(const uint8_t* data, size_t length) {
+    // Short runs finish before a vector kernel would pay for its call
+    if (length < VECTOR_SUM_MIN_LENGTH) {
+        return scalarByteSum(data, length);
+    }
+    return active().byteSum(data, length);
+}
+
+} // namespace XbusSimd
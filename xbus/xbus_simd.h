@@ -0,0 +1,46 @@
+#ifndef XBUS_SIMD_H
+#define XBUS_SIMD_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Vectorized byte sum behind the Xbus checksum. The big-endian values of a
+// data item come in runs of 2-4 and are read with inline scalar code
+// (readValues in xbus_xdi_registry.h), which is as fast as a vector kernel
+// once the call through the kernel table is counted.
+//
+// byteSum matches a byte-at-a-time sum. The implementation is selected once
+// at runtime from the instruction sets the CPU supports (SSSE3/AVX2 on x86,
+// ARM NEON) with a portable scalar fallback. It never reads outside the
+// bytes it sums.
+namespace XbusSimd {
+
+enum class Level {
+    Scalar,
+    Ssse3,
+    Avx2,
+    Neon
+};
+
+// Best level supported by this CPU
+Level detectedLevel();
+
+// Level currently used by the kernels
+Level activeLevel();
+
+// Select a level, e.g. Scalar to compare against the vector paths.
+// Returns false (and keeps the current level) if the CPU lacks support.
+bool setLevel(Level level);
+
+const char* levelName(Level level);
+
+// Sum of length bytes modulo 256, the arithmetic of the Xbus checksum
+// (Xbus::verifyChecksum, XbusFramer). 16 or 32 bytes per step on SSSE3/AVX2
+// and NEON, 8 bytes per step in the scalar fallback. Runs shorter than
+// VECTOR_SUM_MIN_LENGTH always take the scalar path.
+constexpr size_t VECTOR_SUM_MIN_LENGTH = 16;
+uint8_t byteSum(const uint8_t* data, size_t length);
+
+} // namespace XbusSimd
+
+#endif // XBUS_SIMD_H
@@ -0,0 +1,29 @@
+#ifndef XBUS_SIMD_TARGET_H
+#define XBUS_SIMD_TARGET_H
+
+// Instruction set selection shared by the translation units with vector
+// kernels (xbus_simd.cpp, xbus_orientation.cpp). Not part of the public
+// API: include it from .cpp files only.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define XBUS_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || (defined(__ARM_NEON) && defined(__arm__))
+#define XBUS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang need per-function target attributes to use instructions
+// beyond the baseline; MSVC accepts the intrinsics without them.
+#if defined(XBUS_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define XBUS_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define XBUS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define XBUS_TARGET_SSSE3
+#define XBUS_TARGET_AVX2
+#endif
+
+#endif // XBUS_SIMD_TARGET_H
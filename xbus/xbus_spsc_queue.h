@@ -0,0 +1,236 @@
+#ifndef XBUS_SPSC_QUEUE_H
+#define XBUS_SPSC_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// Bounded lock-free single-producer/single-consumer queue.
+//
+// Decouples the serial read thread (producer) from parsing, logging or
+// publishing code (consumer): the producer never blocks, a full queue
+// drops the new element and counts it. Exactly one thread may push and
+// exactly one thread may pop at a time.
+//
+// The capacity is rounded up to a power of two. Elements are preallocated
+// and copied in place, so T should be cheap to copy or trivially copyable
+// for the hot path to stay allocation free.
+//
+// Consumers can poll with tryPop() or block in pop(). Blocking consumers
+// park on a condition variable; the producer only touches the mutex when a
+// consumer is actually waiting.
+template <typename T>
+class SpscQueue {
+public:
+    struct Stats {
+        uint64_t pushed;
+        uint64_t popped;
+        uint64_t dropped;    // elements rejected because the queue was full
+        size_t highWater;    // largest queue depth seen by the producer (upper bound)
+    };
+    
+    explicit SpscQueue(size_t capacity)
+        : m_capacity(roundUpPow2(capacity < 2 ? 2 : capacity)),
+          m_mask(m_capacity - 1),
+          m_slots(new T[m_capacity]),
+          m_head(0),
+          m_tail(0),
+          m_cachedTail(0),
+          m_cachedHead(0),
+          m_pushed(0),
+          m_dropped(0),
+          m_highWater(0),
+          m_popped(0),
+          m_consumerWaiting(false),
+          m_closed(false) {
+    }
+    
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    
+    // Producer: enqueue a copy of value. Returns false and counts a drop
+    // when the queue is full or closed.
+    bool tryPush(const T& value) {
+        T* slot = beginPush();
+        if (!slot) {
+            return false;
+        }
+        *slot = value;
+        commitPush();
+        return true;
+    }
+    
+    // Producer, zero-copy variant: get the next free slot to fill in place,
+    // then publish it with commitPush(). Returns nullptr (and counts a
+    // drop) when the queue is full or closed.
+    T* beginPush() {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead >= m_capacity) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead >= m_capacity) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        if (m_closed.load(std::memory_order_relaxed)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &m_slots[tail & m_mask];
+    }
+    
+    void commitPush() {
+        size_t tail = m_tail.load(std::memory_order_relaxed) + 1;
+        m_tail.store(tail, std::memory_order_release);
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+        
+        size_t depth = tail - m_cachedHead;
+        if (depth > m_highWater.load(std::memory_order_relaxed)) {
+            m_highWater.store(depth, std::memory_order_relaxed);
+        }
+        
+        // Pairs with the fence in pop(): either the consumer sees the
+        // new tail before sleeping, or we see it waiting and wake it.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_consumerWaiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cond.notify_one();
+        }
+    }
+    
+    // Consumer: dequeue without blocking. Returns false when empty. The
+    // element is moved out, so a slot holds no reference (e.g. a pool
+    // handle) once popped.
+    bool tryPop(T& out) {
+        if (!front()) {
+            return false;
+        }
+        out = std::move(m_slots[m_head.load(std::memory_order_relaxed) & m_mask]);
+        popFront();
+        return true;
+    }
+    
+    // Consumer, zero-copy variant: peek at the oldest element, then release
+    // it with popFront(). Returns nullptr when empty.
+    const T* front() {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail) {
+                return nullptr;
+            }
+        }
+        return &m_slots[head & m_mask];
+    }
+    
+    void popFront() {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        m_popped.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    // Consumer: dequeue, waiting up to timeout for an element. Returns false
+    // on timeout, or once the queue is closed and drained.
+    template <typename Rep, typename Period>
+    bool pop(T& out, const std::chrono::duration<Rep, Period>& timeout) {
+        if (tryPop(out)) {
+            return true;
+        }
+        
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_consumerWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool ready = m_cond.wait_for(lock, timeout, [this] {
+            return !empty() || m_closed.load(std::memory_order_acquire);
+        });
+        m_consumerWaiting.store(false, std::memory_order_relaxed);
+        lock.unlock();
+        
+        return ready && tryPop(out);
+    }
+    
+    // Consumer: dequeue, waiting until an element arrives or the queue is
+    // closed. Returns false only once the queue is closed and drained.
+    bool pop(T& out) {
+        while (!isClosed() || !empty()) {
+            if (pop(out, std::chrono::milliseconds(100))) {
+                return true;
+            }
+        }
+        return tryPop(out);
+    }
+    
+    // Reject further pushes and wake a blocked consumer. Elements already
+    // queued can still be popped.
+    void close() {
+        m_closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cond.notify_all();
+    }
+    
+    bool isClosed() const {
+        return m_closed.load(std::memory_order_acquire);
+    }
+    
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+    
+    // Approximate when called concurrently with push/pop
+    size_t size() const {
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t head = m_head.load(std::memory_order_acquire);
+        return tail - head;
+    }
+    
+    size_t capacity() const {
+        return m_capacity;
+    }
+    
+    Stats stats() const {
+        Stats stats;
+        stats.pushed = m_pushed.load(std::memory_order_relaxed);
+        stats.popped = m_popped.load(std::memory_order_relaxed);
+        stats.dropped = m_dropped.load(std::memory_order_relaxed);
+        stats.highWater = m_highWater.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+    
+    static size_t roundUpPow2(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+    
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<T[]> m_slots;
+    
+    // Indices grow without wrapping; slot = index & m_mask. Each side keeps
+    // a private copy of the other side's index so the shared cache line is
+    // only read when the queue looks full (producer) or empty (consumer).
+    alignas(CACHE_LINE) std::atomic<size_t> m_head;   // written by consumer
+    alignas(CACHE_LINE) std::atomic<size_t> m_tail;   // written by producer
+    alignas(CACHE_LINE) size_t m_cachedTail;          // consumer-owned
+    alignas(CACHE_LINE) size_t m_cachedHead;          // producer-owned
+    std::atomic<uint64_t> m_pushed;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<size_t> m_highWater;
+    alignas(CACHE_LINE) std::atomic<uint64_t> m_popped;
+    
+    std::atomic<bool> m_consumerWaiting;
+    std::atomic<bool> m_closed;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+};
+
+#endif // XBUS_SPSC_QUEUE_H
@@ -0,0 +1,185 @@
+#ifndef XBUS_STATS_H
+#define XBUS_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Lightweight statistics for the read/frame/parse pipeline.
+//
+// Every counter has a single writer (the thread that owns the component)
+// and may be read from any thread at any time. Updates are a relaxed load
+// and store instead of a locked read-modify-write, so on x86 and ARM they
+// cost the same as incrementing a plain integer; readers see each counter
+// individually up to date but not a consistent snapshot across counters.
+
+class RelaxedCounter {
+public:
+    RelaxedCounter(uint64_t value = 0) : m_value(value) {}
+    RelaxedCounter(const RelaxedCounter& other) : m_value(other.load()) {}
+    
+    RelaxedCounter& operator=(const RelaxedCounter& other) {
+        store(other.load());
+        return *this;
+    }
+    
+    uint64_t load() const { return m_value.load(std::memory_order_relaxed); }
+    void store(uint64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    operator uint64_t() const { return load(); }
+    
+    // Writer thread only
+    RelaxedCounter& operator+=(uint64_t amount) {
+        store(load() + amount);
+        return *this;
+    }
+    
+    RelaxedCounter& operator++() {
+        return *this += 1;
+    }
+    
+    // Keep the largest value seen (high-water marks)
+    void updateMax(uint64_t value) {
+        if (value > load()) {
+            store(value);
+        }
+    }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+// Histogram of durations in power-of-two buckets: bucket i counts samples in
+// [2^i, 2^(i+1)) ns, bucket 0 also counts 0 ns and the last bucket everything
+// from 2^39 ns (about 9 minutes) up. Recording is one bit scan and three
+// counter updates.
+class LatencyHistogram {
+public:
+    static constexpr size_t BUCKETS = 40;
+    
+    struct Snapshot {
+        uint64_t buckets[BUCKETS] = {};
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+        
+        double meanNs() const {
+            return count > 0 ? static_cast<double>(totalNs) / static_cast<double>(count) : 0.0;
+        }
+        
+        // Upper bound of the bucket holding the given fraction (0.5 for
+        // p50, 0.99 for p99) of all samples, capped at the largest sample
+        uint64_t percentileNs(double fraction) const {
+            uint64_t total = 0;
+            for (size_t i = 0; i < BUCKETS; i++) {
+                total += buckets[i];
+            }
+            if (total == 0) {
+                return 0;
+            }
+            
+            uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(total - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; i++) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    uint64_t upper = i + 1 < BUCKETS ? (1ull << (i + 1)) - 1 : maxNs;
+                    return upper < maxNs ? upper : maxNs;
+                }
+            }
+            return maxNs;
+        }
+    };
+    
+    static size_t bucketFor(uint64_t ns) {
+        size_t bucket = highestBit(ns | 1);
+        return bucket < BUCKETS ? bucket : BUCKETS - 1;
+    }
+    
+    // Writer thread only
+    void record(uint64_t ns) {
+        ++m_buckets[bucketFor(ns)];
+        ++m_count;
+        m_totalNs += ns;
+        m_maxNs.updateMax(ns);
+    }
+    
+    Snapshot snapshot() const {
+        Snapshot result;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            result.buckets[i] = m_buckets[i].load();
+        }
+        result.count = m_count.load();
+        result.totalNs = m_totalNs.load();
+        result.maxNs = m_maxNs.load();
+        return result;
+    }
+
+private:
+    static size_t highestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<size_t>(63 - __builtin_clzll(value));
+#elif defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        size_t bit = 0;
+        while (value >>= 1) {
+            bit++;
+        }
+        return bit;
+#endif
+    }
+    
+    RelaxedCounter m_buckets[BUCKETS];
+    RelaxedCounter m_count;
+    RelaxedCounter m_totalNs;
+    RelaxedCounter m_maxNs;
+};
+
+// Counts MTData2 packets lost between consecutive 16-bit packet counters.
+// A repeated counter is counted as a duplicate, not as a wrap-around gap.
+class PacketCounterGaps {
+public:
+    RelaxedCounter packets;
+    RelaxedCounter gaps;          // discontinuities
+    RelaxedCounter lostPackets;   // packets missing in those gaps
+    RelaxedCounter duplicates;
+    
+    PacketCounterGaps() : m_last(0), m_hasLast(false) {}
+    
+    // Writer thread only. Returns the number of packets missing before this one.
+    uint16_t update(uint16_t packetCounter) {
+        ++packets;
+        uint16_t missing = 0;
+        if (m_hasLast) {
+            if (packetCounter == m_last) {
+                ++duplicates;
+            } else {
+                missing = static_cast<uint16_t>(packetCounter - m_last - 1);
+                if (missing != 0) {
+                    ++gaps;
+                    lostPackets += missing;
+                }
+            }
+        }
+        m_last = packetCounter;
+        m_hasLast = true;
+        return missing;
+    }
+    
+    // Forget the last counter, e.g. after the device was reset
+    void restart() {
+        m_hasLast = false;
+    }
+
+private:
+    uint16_t m_last;
+    bool m_hasLast;
+};
+
+#endif // XBUS_STATS_H
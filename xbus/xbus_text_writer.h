@@ -0,0 +1,140 @@
+#ifndef XBUS_TEXT_WRITER_H
+#define XBUS_TEXT_WRITER_H
+
+#include <charconv>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Appends text to a caller-supplied character buffer.
+//
+// Numbers are written with std::to_chars, so nothing depends on the locale
+// and nothing is allocated. Output that does not fit is cut off and
+// truncated() reports it; the buffer is always NUL terminated, so it needs
+// room for one more character than the longest expected text.
+class XbusTextWriter {
+public:
+    XbusTextWriter(char* buffer, size_t capacity)
+        : m_buffer(buffer)
+        , m_capacity(capacity)
+        , m_size(0)
+        , m_truncated(false) {
+        terminate();
+    }
+    
+    template <size_t N>
+    explicit XbusTextWriter(char (&buffer)[N])
+        : XbusTextWriter(buffer, N) {
+    }
+    
+    const char* data() const { return m_buffer; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    bool truncated() const { return m_truncated; }
+    
+    void clear() {
+        m_size = 0;
+        m_truncated = false;
+        terminate();
+    }
+    
+    void append(char c) {
+        if (m_size + 1 < m_capacity) {
+            m_buffer[m_size++] = c;
+            terminate();
+        } else {
+            m_truncated = true;
+        }
+    }
+    
+    void append(const char* text, size_t length) {
+        size_t room = m_capacity > 0 ? m_capacity - 1 - m_size : 0;
+        if (length > room) {
+            length = room;
+            m_truncated = true;
+        }
+        if (length > 0) {
+            memcpy(m_buffer + m_size, text, length);
+            m_size += length;
+        }
+        terminate();
+    }
+    
+    void append(const char* text) {
+        append(text, strlen(text));
+    }
+    
+    // Decimal integers, optionally zero padded to width digits
+    void appendUnsigned(uint64_t value, int width = 0) {
+        char digits[24];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        appendPadded(digits, static_cast<size_t>(result.ptr - digits), width);
+    }
+    
+    void appendSigned(int64_t value) {
+        char digits[24];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        append(digits, static_cast<size_t>(result.ptr - digits));
+    }
+    
+    // Upper case hexadecimal without prefix, zero padded to width digits
+    void appendHex(uint64_t value, int width = 0) {
+        char digits[24];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value, 16);
+        for (char* c = digits; c != result.ptr; c++) {
+            if (*c >= 'a') {
+                *c = static_cast<char>(*c - 'a' + 'A');
+            }
+        }
+        appendPadded(digits, static_cast<size_t>(result.ptr - digits), width);
+    }
+    
+    // Fixed notation with the given number of decimals, the same digits
+    // std::fixed << std::setprecision(decimals) prints
+    void appendFixed(double value, int decimals) {
+        // Largest double in fixed notation: sign, 309 digits, point, decimals
+        char digits[320 + MAX_DECIMALS];
+        if (decimals > MAX_DECIMALS) {
+            decimals = MAX_DECIMALS;
+        }
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value,
+                                                    std::chars_format::fixed, decimals);
+        append(digits, static_cast<size_t>(result.ptr - digits));
+    }
+    
+    // Shortest text that reads back to the same value
+    void appendNumber(float value) {
+        char digits[32];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        append(digits, static_cast<size_t>(result.ptr - digits));
+    }
+    
+    void appendNumber(double value) {
+        char digits[32];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        append(digits, static_cast<size_t>(result.ptr - digits));
+    }
+
+private:
+    static constexpr int MAX_DECIMALS = 17;
+    
+    void appendPadded(const char* digits, size_t length, int width) {
+        for (size_t i = length; i < static_cast<size_t>(width > 0 ? width : 0); i++) {
+            append('0');
+        }
+        append(digits, length);
+    }
+    
+    void terminate() {
+        if (m_capacity > 0) {
+            m_buffer[m_size] = '\0';
+        }
+    }
+    
+    char* m_buffer;
+    size_t m_capacity;  // including the terminator
+    size_t m_size;
+    bool m_truncated;
+};
+
+#endif // XBUS_TEXT_WRITER_H
@@ -0,0 +1,580 @@
+#ifndef XBUS_XDI_REGISTRY_H
+#define XBUS_XDI_REGISTRY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Compile-time registry of MTData2 data items.
+//
+// Every data item is declared once as an XdiField that names its XDI, its
+// wire layout, the member it is decoded into, the member that flags its
+// presence and, for real-valued items, the member recording its format bits:
+//
+//     struct EulerAngles : XdiField<XDI::EULER_ANGLES, SensorField::EULER_ANGLES,
+//                                   &SensorData::eulerAngles, &SensorData::hasEulerAngles,
+//                                   &SensorData::eulerAnglesFormat,
+//                                   float, float, float> {
+//         static constexpr const char* name = "EulerAngles";
+//         static constexpr auto columns = std::make_tuple(
+//             XdiColumn(&SensorDataColumns::roll, &::EulerAngles::roll, "Roll"),
+//             XdiColumn(&SensorDataColumns::pitch, &::EulerAngles::pitch, "Pitch"),
+//             XdiColumn(&SensorDataColumns::yaw, &::EulerAngles::yaw, "Yaw"),
+//             XdiColumn(&SensorDataColumns::eulerAnglesFormat, XdiFormatBits(), "EulerAnglesFormat"));
+//     };
+//
+// Each field also lists its structure-of-arrays columns (see XdiColumn).
+// The item size, the decoder, the presence mask, the name lookup and every
+// column operation are generated from an XdiList of such fields. The decoded target is built from
+// the wire values in order, so it needs a matching constructor (or is a
+// plain scalar).
+//
+// Items made only of real values (float, Fixed1220, Fp1632, double) are
+// precision-selectable: the declared wire type is the default format, but
+// the item is accepted with any precision and coordinate system in the low
+// nibble of its XDI and decoded by a dedicated reader for that format. The
+// values are stored as sent and the format bits go to the format member, so
+// NED and NWU data stay distinguishable from ENU.
+
+// Format bits in the low nibble of an XDI
+namespace XdiFormat {
+
+constexpr uint16_t TYPE_MASK = 0xFFF0;
+
+constexpr uint16_t PRECISION_MASK = 0x0003;
+constexpr uint16_t FLOAT32 = 0x0000;
+constexpr uint16_t FIXED1220 = 0x0001;
+constexpr uint16_t FP1632 = 0x0002;
+constexpr uint16_t FLOAT64 = 0x0003;
+
+constexpr uint16_t COORDINATE_MASK = 0x000C;
+constexpr uint16_t ENU = 0x0000;
+constexpr uint16_t NED = 0x0004;
+constexpr uint16_t NWU = 0x0008;
+
+// Data type without format bits, e.g. 0x2030 for every Euler angle format
+constexpr uint16_t type(uint16_t xdi) {
+    return static_cast<uint16_t>(xdi & TYPE_MASK);
+}
+
+// Precision and coordinate system bits together, as recorded per item
+constexpr uint8_t bits(uint16_t xdi) {
+    return static_cast<uint8_t>(xdi & ~TYPE_MASK);
+}
+
+constexpr uint16_t precision(uint16_t xdi) {
+    return static_cast<uint16_t>(xdi & PRECISION_MASK);
+}
+
+constexpr uint16_t coordinateSystem(uint16_t xdi) {
+    return static_cast<uint16_t>(xdi & COORDINATE_MASK);
+}
+
+constexpr uint16_t withPrecision(uint16_t xdi, uint16_t precisionBits) {
+    return static_cast<uint16_t>((xdi & ~PRECISION_MASK) | (precisionBits & PRECISION_MASK));
+}
+
+constexpr uint16_t withCoordinateSystem(uint16_t xdi, uint16_t coordinateBits) {
+    return static_cast<uint16_t>((xdi & ~COORDINATE_MASK) | (coordinateBits & COORDINATE_MASK));
+}
+
+// Bytes per value for a precision
+constexpr uint8_t valueSize(uint16_t precisionBits) {
+    return (precisionBits & PRECISION_MASK) == FP1632 ? 6 : (precisionBits & PRECISION_MASK) == FLOAT64 ? 8 : 4;
+}
+
+} // namespace XdiFormat
+
+// Wire type tags for the fixed point formats, both decoded as double
+struct Fixed1220 {};    // signed 12.20 fixed point (4 bytes)
+struct Fp1632 {};       // FP16.32 fixed point (6 bytes)
+
+// Size and big-endian reader for each wire type
+template <typename T>
+struct WireFormat;
+
+template <>
+struct WireFormat<uint8_t> {
+    typedef uint8_t Value;
+    static constexpr bool real = false;
+    static constexpr size_t size = 1;
+    static Value read(const uint8_t* data) { return data[0]; }
+};
+
+template <>
+struct WireFormat<uint16_t> {
+    typedef uint16_t Value;
+    static constexpr bool real = false;
+    static constexpr size_t size = 2;
+    static Value read(const uint8_t* data) {
+        return static_cast<uint16_t>((data[0] << 8) | data[1]);
+    }
+};
+
+template <>
+struct WireFormat<uint32_t> {
+    typedef uint32_t Value;
+    static constexpr bool real = false;
+    static constexpr size_t size = 4;
+    static Value read(const uint8_t* data) {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+               (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+    }
+};
+
+template <>
+struct WireFormat<float> {
+    typedef float Value;
+    static constexpr bool real = true;
+    static constexpr uint16_t precision = XdiFormat::FLOAT32;
+    static constexpr size_t size = 4;
+    static Value read(const uint8_t* data) {
+        uint32_t bits = WireFormat<uint32_t>::read(data);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+template <>
+struct WireFormat<Fixed1220> {
+    typedef double Value;
+    static constexpr bool real = true;
+    static constexpr uint16_t precision = XdiFormat::FIXED1220;
+    static constexpr size_t size = 4;
+    static Value read(const uint8_t* data) {
+        int32_t fixedPoint = static_cast<int32_t>(WireFormat<uint32_t>::read(data));
+        return static_cast<double>(fixedPoint) / 1048576.0; // 2^20
+    }
+};
+
+template <>
+struct WireFormat<Fp1632> {
+    typedef double Value;
+    static constexpr bool real = true;
+    static constexpr uint16_t precision = XdiFormat::FP1632;
+    static constexpr size_t size = 6;
+    static Value read(const uint8_t* data) {
+        // 32-bit fraction followed by a signed 16-bit integer part
+        uint32_t fraction = WireFormat<uint32_t>::read(data);
+        int16_t integer = static_cast<int16_t>(WireFormat<uint16_t>::read(data + 4));
+        int64_t fixedPoint = static_cast<int64_t>(integer) * 4294967296LL + fraction;
+        return static_cast<double>(fixedPoint) / 4294967296.0;
+    }
+};
+
+template <>
+struct WireFormat<double> {
+    typedef double Value;
+    static constexpr bool real = true;
+    static constexpr uint16_t precision = XdiFormat::FLOAT64;
+    static constexpr size_t size = 8;
+    static Value read(const uint8_t* data) {
+        uint64_t bits = (static_cast<uint64_t>(WireFormat<uint32_t>::read(data)) << 32) |
+                        WireFormat<uint32_t>::read(data + 4);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+// Read N consecutive values of wire type W into dst. The runs are at most
+// four values, so this stays inline scalar code: a call through the
+// XbusSimd kernel table per item costs as much as the vector load saves.
+template <typename W, size_t N, typename T>
+inline void readValues(const uint8_t* src, T* dst) {
+    for (size_t i = 0; i < N; i++) {
+        dst[i] = static_cast<T>(WireFormat<W>::read(src + i * WireFormat<W>::size));
+    }
+}
+
+// Call visitor(W()) with the wire type W selected by the precision bits
+template <typename Visitor>
+inline decltype(auto) visitPrecision(uint16_t precisionBits, Visitor&& visitor) {
+    switch (precisionBits & XdiFormat::PRECISION_MASK) {
+        case XdiFormat::FLOAT32: return visitor(float());
+        case XdiFormat::FIXED1220: return visitor(Fixed1220());
+        case XdiFormat::FP1632: return visitor(Fp1632());
+        default: return visitor(double());
+    }
+}
+
+namespace XdiDetail {
+
+template <typename T>
+struct MemberTraits;
+
+template <typename Class, typename Member>
+struct MemberTraits<Member Class::*> {
+    typedef Class Owner;
+    typedef Member Type;
+};
+
+} // namespace XdiDetail
+
+// One data item: XDI, presence bit, target member, presence flag member,
+// format member (a uint8_t receiving XdiFormat::bits of the XDI it was sent
+// with, nullptr for items without format bits) and the wire types of its
+// values in transmission order
+template <uint16_t Xdi, uint32_t Field, auto Member, auto Present, auto Format, typename... Wire>
+struct XdiField {
+    static_assert(sizeof...(Wire) > 0, "A data item has at least one value");
+    
+    typedef typename XdiDetail::MemberTraits<decltype(Member)>::Owner Data;
+    typedef typename XdiDetail::MemberTraits<decltype(Member)>::Type Target;
+    typedef void (*Decoder)(const uint8_t* item, Data& data);
+    
+    static constexpr uint16_t xdi = Xdi;
+    static constexpr uint32_t field = Field;
+    static constexpr size_t count = sizeof...(Wire);
+    
+    // Size in the declared format
+    static constexpr uint8_t size = static_cast<uint8_t>((WireFormat<Wire>::size + ...));
+    
+    // True if the item accepts every precision in the XDI format bits
+    static constexpr bool selectable = (WireFormat<Wire>::real && ...);
+
+private:
+    typedef typename std::tuple_element<0, std::tuple<Wire...>>::type DeclaredWire;
+    typedef typename WireFormat<DeclaredWire>::Value Value;
+    
+    static_assert(!selectable || (std::is_same<Wire, DeclaredWire>::value && ...),
+                  "Real-valued items use one wire type for all values");
+    static constexpr bool declaredPrecisionMatches() {
+        if constexpr (selectable) {
+            return WireFormat<DeclaredWire>::precision == XdiFormat::precision(Xdi);
+        } else {
+            return true;
+        }
+    }
+    static_assert(declaredPrecisionMatches(), "Declared wire type matches the precision bits of the XDI");
+    static_assert(selectable != std::is_same<decltype(Format), std::nullptr_t>::value,
+                  "Real-valued items record their format bits, other items have none");
+
+public:
+    // True for every format of this item (any precision and coordinate
+    // system if selectable, the exact XDI otherwise)
+    static constexpr bool matches(uint16_t id) {
+        return selectable ? XdiFormat::type(id) == XdiFormat::type(Xdi) : id == Xdi;
+    }
+    
+    // Size of the item as sent with this XDI; id must match()
+    static constexpr uint8_t sizeFor(uint16_t id) {
+        return selectable ? static_cast<uint8_t>(count * XdiFormat::valueSize(XdiFormat::precision(id))) : size;
+    }
+    
+    static void clear(Data& data) {
+        data.*Present = false;
+    }
+    
+    static bool isPresent(const Data& data) {
+        return data.*Present;
+    }
+    
+    static const Target& value(const Data& data) {
+        return data.*Member;
+    }
+    
+    // Format bits the item was sent with, e.g. to tell NED from ENU; 0 for
+    // items without format bits
+    static uint8_t format(const Data& data) {
+        if constexpr (selectable) {
+            return data.*Format;
+        } else {
+            return 0;
+        }
+    }
+    
+    // item points just past the XDI and size bytes; size is already checked.
+    // Decodes the declared format.
+    static void decode(const uint8_t* item, Data& data) {
+        decodeFormat<XdiFormat::bits(Xdi)>(item, data);
+    }
+    
+    // Decode the format given by the XDI format bits
+    static void decode(uint16_t id, const uint8_t* item, Data& data) {
+        if constexpr (selectable) {
+            visitPrecision(XdiFormat::precision(id), [item, &data](auto wire) {
+                data.*Member = readAs<decltype(wire)>(item);
+            });
+            data.*Format = XdiFormat::bits(id);
+            data.*Present = true;
+        } else {
+            decode(item, data);
+        }
+    }
+    
+    // Decoder for the format given by the XDI format bits
+    static Decoder decoderFor(uint16_t id) {
+        if constexpr (selectable) {
+            return formatDecoders(std::make_integer_sequence<uint8_t, XdiFormat::bits(0xFFFF) + 1>())[XdiFormat::bits(id)];
+        } else {
+            return &decode;
+        }
+    }
+    
+    // Read the target with the format given by the XDI format bits and pass
+    // it and the format bits to store, e.g. to write them into columns
+    // instead of a Data
+    template <typename Store>
+    static void read(uint16_t id, const uint8_t* item, Store&& store) {
+        if constexpr (selectable) {
+            visitPrecision(XdiFormat::precision(id), [item, &store, id](auto wire) {
+                store(readAs<decltype(wire)>(item), XdiFormat::bits(id));
+            });
+        } else {
+            store(readAs<DeclaredWire>(item), uint8_t(0));
+        }
+    }
+
+private:
+    template <size_t I>
+    static constexpr size_t offsetOf() {
+        constexpr size_t sizes[] = {WireFormat<Wire>::size...};
+        size_t offset = 0;
+        for (size_t i = 0; i < I; i++) {
+            offset += sizes[i];
+        }
+        return offset;
+    }
+    
+    // One decoder per value of the format bits, so a decoder found once
+    // for a layout still records the coordinate system
+    template <uint8_t Bits>
+    static void decodeFormat(const uint8_t* item, Data& data) {
+        if constexpr (selectable) {
+            visitPrecision(Bits, [item, &data](auto wire) {
+                data.*Member = readAs<decltype(wire)>(item);
+            });
+            data.*Format = Bits;
+        } else {
+            data.*Member = readAs<DeclaredWire>(item);
+        }
+        data.*Present = true;
+    }
+    
+    template <uint8_t... Bits>
+    static const Decoder* formatDecoders(std::integer_sequence<uint8_t, Bits...>) {
+        static constexpr Decoder decoders[] = {&decodeFormat<Bits>...};
+        return decoders;
+    }
+    
+    // Real-valued items: every value is read with wire type W
+    template <typename W>
+    static Target readAs(const uint8_t* item) {
+        if constexpr (selectable) {
+            Value values[count];
+            readValues<W, count>(item, values);
+            return construct(values, std::index_sequence_for<Wire...>());
+        } else {
+            return readFields(item, std::index_sequence_for<Wire...>());
+        }
+    }
+    
+    template <size_t... I>
+    static Target construct(const Value* values, std::index_sequence<I...>) {
+        return Target(values[I]...);
+    }
+    
+    // Other items: each value is read with its own declared wire type
+    template <size_t... I>
+    static Target readFields(const uint8_t* item, std::index_sequence<I...>) {
+        return Target(WireFormat<Wire>::read(item + offsetOf<I>())...);
+    }
+};
+
+// Tags for a column that holds the whole decoded target or the format bits
+// the item was sent with
+struct XdiWhole {};
+struct XdiFormatBits {};
+
+// One column of a structure-of-arrays batch: the vector member of the
+// columns type, the member of the decoded target it holds (XdiWhole for the
+// target itself, XdiFormatBits for its format bits) and the column name used by the exporters. An XdiField
+// lists its columns in a static constexpr tuple named columns.
+template <typename Member, typename Component = XdiWhole>
+struct XdiColumn {
+    typedef typename XdiDetail::MemberTraits<Member>::Owner Columns;
+    typedef typename XdiDetail::MemberTraits<Member>::Type::value_type Element;
+    
+    Member column;
+    Component component;
+    const char* name;
+    
+    constexpr XdiColumn(Member column_, const char* name_) : column(column_), component(), name(name_) {}
+    constexpr XdiColumn(Member column_, Component component_, const char* name_)
+        : column(column_), component(component_), name(name_) {}
+    
+    template <typename Target>
+    Element get(const Target& target, uint8_t format) const {
+        if constexpr (std::is_same<Component, XdiWhole>::value) {
+            return static_cast<Element>(target);
+        } else if constexpr (std::is_same<Component, XdiFormatBits>::value) {
+            return static_cast<Element>(format);
+        } else {
+            return static_cast<Element>(target.*component);
+        }
+    }
+};
+
+// The set of data items one decoder understands. All lookups are folded
+// over the list at compile time; there is no runtime table.
+template <typename First, typename... Rest>
+struct XdiList {
+    typedef typename First::Data Data;
+    typedef typename First::Decoder Decoder;
+    
+    static constexpr size_t count = 1 + sizeof...(Rest);
+    
+    // Item size in bytes for this XDI's format, 0 for XDIs not in the list
+    static constexpr uint8_t size(uint16_t xdi) {
+        uint8_t result = 0;
+        (void)((First::matches(xdi) && (result = First::sizeFor(xdi), true)) ||
+               ((Rest::matches(xdi) && (result = Rest::sizeFor(xdi), true)) || ...));
+        return result;
+    }
+    
+    // Presence bit, 0 for XDIs not in the list
+    static constexpr uint32_t field(uint16_t xdi) {
+        uint32_t result = 0;
+        (void)((First::matches(xdi) && (result = First::field, true)) ||
+               ((Rest::matches(xdi) && (result = Rest::field, true)) || ...));
+        return result;
+    }
+    
+    // Union of all presence bits
+    static constexpr uint32_t allFields() {
+        return (First::field | ... | Rest::field);
+    }
+    
+    // Name of the item, nullptr for XDIs not in the list
+    static const char* name(uint16_t xdi) {
+        const char* result = nullptr;
+        (void)((First::matches(xdi) && (result = First::name, true)) ||
+               ((Rest::matches(xdi) && (result = Rest::name, true)) || ...));
+        return result;
+    }
+    
+    // Decoder function, nullptr for unknown XDIs or unexpected sizes
+    static Decoder decoder(uint16_t xdi, uint8_t itemSize) {
+        Decoder result = nullptr;
+        (void)((First::matches(xdi) && itemSize == First::sizeFor(xdi) && (result = First::decoderFor(xdi), true)) ||
+               ((Rest::matches(xdi) && itemSize == Rest::sizeFor(xdi) && (result = Rest::decoderFor(xdi), true)) || ...));
+        return result;
+    }
+    
+    // Decode one item in place, with every item decoder inlined. Returns
+    // false for unknown XDIs or unexpected sizes.
+    static bool decode(uint16_t xdi, uint8_t itemSize, const uint8_t* item, Data& data) {
+        return (First::matches(xdi) && itemSize == First::sizeFor(xdi) && (First::decode(xdi, item, data), true)) ||
+               ((Rest::matches(xdi) && itemSize == Rest::sizeFor(xdi) && (Rest::decode(xdi, item, data), true)) || ...);
+    }
+    
+    // Presence bits of the items set in data
+    static uint32_t present(const Data& data) {
+        return (First::isPresent(data) ? First::field : 0) | ((Rest::isPresent(data) ? Rest::field : 0) | ...);
+    }
+    
+    // Reset the presence flags selected by fields
+    static void clear(Data& data, uint32_t fields) {
+        if (fields & First::field) {
+            First::clear(data);
+        }
+        ((fields & Rest::field ? Rest::clear(data) : void()), ...);
+    }
+    
+    // Structure-of-arrays storage built from the columns of every item, for
+    // lists whose fields declare columns. The presence column is not part of
+    // the list and is left to the caller.
+    
+    template <typename Columns>
+    static void reserveColumns(Columns& columns, size_t rows) {
+        forEachColumn([&columns, rows](auto, const auto& column) { (columns.*column.column).reserve(rows); });
+    }
+    
+    template <typename Columns>
+    static void clearColumns(Columns& columns) {
+        forEachColumn([&columns](auto, const auto& column) { (columns.*column.column).clear(); });
+    }
+    
+    // Append the values of a default constructed Data, or of data, to every column
+    template <typename Columns>
+    static void appendColumns(Columns& columns) {
+        appendColumns(columns, Data());
+    }
+    
+    template <typename Columns>
+    static void appendColumns(Columns& columns, const Data& data) {
+        forEachColumn([&columns, &data](auto item, const auto& column) {
+            typedef typename decltype(item)::type Field;
+            (columns.*column.column).push_back(column.get(Field::value(data), Field::format(data)));
+        });
+    }
+    
+    // Append all rows of another batch
+    template <typename Columns>
+    static void appendColumns(Columns& columns, const Columns& other) {
+        forEachColumn([&columns, &other](auto, const auto& column) {
+            auto& dest = columns.*column.column;
+            const auto& source = other.*column.column;
+            dest.insert(dest.end(), source.begin(), source.end());
+        });
+    }
+    
+    // Call visit(field, name, column) for every column of the items selected
+    // by fields, in list order. columns may be const.
+    template <typename ColumnsRef, typename Visitor>
+    static void visitColumns(ColumnsRef& columns, uint32_t fields, Visitor&& visit) {
+        forEachColumn([&columns, fields, &visit](auto item, const auto& column) {
+            constexpr uint32_t field = decltype(item)::type::field;
+            if (fields & field) {
+                visit(field, column.name, columns.*column.column);
+            }
+        });
+    }
+    
+    // Decode one item into its columns at row. Returns its presence bit, 0
+    // for unknown XDIs or unexpected sizes.
+    template <typename Columns>
+    static uint32_t decodeColumns(uint16_t xdi, uint8_t itemSize, const uint8_t* item, Columns& columns, size_t row) {
+        uint32_t result = 0;
+        (void)((First::matches(xdi) && itemSize == First::sizeFor(xdi) &&
+                (result = decodeColumns<First>(xdi, item, columns, row), true)) ||
+               ((Rest::matches(xdi) && itemSize == Rest::sizeFor(xdi) &&
+                 (result = decodeColumns<Rest>(xdi, item, columns, row), true)) || ...));
+        return result;
+    }
+
+private:
+    template <typename Field>
+    struct Item {
+        typedef Field type;
+    };
+    
+    // Call function(Item<Field>(), column) for every column of every item
+    template <typename Function>
+    static void forEachColumn(Function&& function) {
+        forEachColumnOf<First>(function);
+        (forEachColumnOf<Rest>(function), ...);
+    }
+    
+    template <typename Field, typename Function>
+    static void forEachColumnOf(Function& function) {
+        std::apply([&function](const auto&... column) { (function(Item<Field>(), column), ...); }, Field::columns);
+    }
+    
+    template <typename Field, typename Columns>
+    static uint32_t decodeColumns(uint16_t xdi, const uint8_t* item, Columns& columns, size_t row) {
+        Field::read(xdi, item, [&columns, row](const typename Field::Target& value, uint8_t format) {
+            std::apply([&columns, row, &value, format](const auto&... column) {
+                (((columns.*column.column)[row] = column.get(value, format)), ...);
+            }, Field::columns);
+        });
+        return Field::field;
+    }
+};
+
+#endif // XBUS_XDI_REGISTRY_H
@@ -0,0 +1,972 @@
+#include "xbus_bridge.h"
+#include "xbus/xbus.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory words are lock-free atomics");
+static_assert(std::is_trivially_copyable<SensorData>::value, "Samples are copied through shared memory");
+static_assert(sizeof(sockaddr_in) <= 16, "Destination address fits its buffer");
+
+#ifdef _WIN32
+typedef int socklen_t;
+const intptr_t NO_SOCKET = static_cast<intptr_t>(INVALID_SOCKET);
+#else
+const intptr_t NO_SOCKET = -1;
+#endif
+
+// Shared memory ring: header, then capacityWords 64-bit words
+// The ring is divided into SHM_CHECKPOINTS blocks. The checkpoint of a
+// block is the position of the first record starting in it, so a lapped
+// subscriber can find a record boundary without the overwritten headers.
+constexpr size_t SHM_CHECKPOINTS = 64;
+
+struct ShmHeader {
+    std::atomic<uint32_t> magic;                // set last, once the header is valid
+    uint32_t version;
+    uint64_t capacityWords;
+    alignas(64) std::atomic<uint64_t> reserved;   // end of the record being written
+    alignas(64) std::atomic<uint64_t> committed;  // end of the last complete record
+    alignas(64) std::atomic<uint64_t> checkpoints[SHM_CHECKPOINTS];
+};
+
+constexpr uint32_t SHM_MAGIC = 0x5842534D;  // "XBSM"
+constexpr uint32_t SHM_VERSION = 2;
+constexpr size_t SHM_DATA_OFFSET = (sizeof(ShmHeader) + 63) / 64 * 64;
+constexpr uint64_t SHM_MIN_WORDS = 1024;
+
+// A record is a header word (payload bytes | kind << 32 | device << 40),
+// the receive time and the payload. Padding fills the end of the ring when
+// a record does not fit there; its size field counts the words to skip.
+constexpr uint8_t KIND_PADDING = 0xFF;
+
+uint64_t recordHeader(uint8_t kind, uint8_t device, uint64_t size) {
+    return size | static_cast<uint64_t>(kind) << 32 | static_cast<uint64_t>(device) << 40;
+}
+
+uint64_t roundUpPow2(uint64_t value) {
+    uint64_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+void writeU16(uint8_t* dest, uint16_t value) {
+    dest[0] = static_cast<uint8_t>(value >> 8);
+    dest[1] = static_cast<uint8_t>(value);
+}
+
+void writeU32(uint8_t* dest, uint32_t value) {
+    writeU16(dest, static_cast<uint16_t>(value >> 16));
+    writeU16(dest + 2, static_cast<uint16_t>(value));
+}
+
+void writeU64(uint8_t* dest, uint64_t value) {
+    writeU32(dest, static_cast<uint32_t>(value >> 32));
+    writeU32(dest + 4, static_cast<uint32_t>(value));
+}
+
+uint16_t readU16(const uint8_t* src) {
+    return static_cast<uint16_t>(src[0] << 8 | src[1]);
+}
+
+uint32_t readU32(const uint8_t* src) {
+    return static_cast<uint32_t>(readU16(src)) << 16 | readU16(src + 2);
+}
+
+uint64_t readU64(const uint8_t* src) {
+    return static_cast<uint64_t>(readU32(src)) << 32 | readU32(src + 4);
+}
+
+// A complete message of exactly size bytes
+bool isMessage(const uint8_t* data, size_t size) {
+    return Xbus::isComplete(data, size) && static_cast<size_t>(Xbus::getRawLength(data)) == size;
+}
+
+std::string systemError() {
+#ifdef _WIN32
+    return "error " + std::to_string(GetLastError());
+#else
+    return std::string(strerror(errno)) + " (errno " + std::to_string(errno) + ")";
+#endif
+}
+
+std::string socketError() {
+#ifdef _WIN32
+    return "error " + std::to_string(WSAGetLastError());
+#else
+    return systemError();
+#endif
+}
+
+// Winsock is reference counted: one startup per open socket
+bool startSockets() {
+#ifdef _WIN32
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    return true;
+#endif
+}
+
+void closeSocket(intptr_t socket) {
+#ifdef _WIN32
+    closesocket(static_cast<SOCKET>(socket));
+    WSACleanup();
+#else
+    ::close(static_cast<int>(socket));
+#endif
+}
+
+bool parseAddress(const std::string& address, uint16_t port, sockaddr_in& result) {
+    memset(&result, 0, sizeof(result));
+    result.sin_family = AF_INET;
+    result.sin_port = htons(port);
+    return inet_pton(AF_INET, address.c_str(), &result.sin_addr) == 1;
+}
+
+bool isMulticast(const in_addr& address) {
+    return (ntohl(address.s_addr) & 0xF0000000u) == 0xE0000000u;
+}
+
+bool waitReadable(intptr_t socket, uint32_t timeoutMs) {
+#ifdef _WIN32
+    WSAPOLLFD descriptor;
+    descriptor.fd = static_cast<SOCKET>(socket);
+    descriptor.events = POLLRDNORM;
+    descriptor.revents = 0;
+    return WSAPoll(&descriptor, 1, static_cast<INT>(timeoutMs)) > 0;
+#else
+    pollfd descriptor;
+    descriptor.fd = static_cast<int>(socket);
+    descriptor.events = POLLIN;
+    descriptor.revents = 0;
+    return ::poll(&descriptor, 1, static_cast<int>(timeoutMs)) > 0;
+#endif
+}
+
+} // namespace
+
+// XbusBridgeBatch
+
+XbusBridgeBatch::XbusBridgeBatch(size_t capacity)
+    : m_buffer(std::max(capacity, HEADER_SIZE))
+    , m_size(HEADER_SIZE)
+    , m_count(0) {
+}
+
+bool XbusBridgeBatch::add(uint8_t device, const XbusFrame& frame, uint64_t receiveTimeNs) {
+    if (!isMessage(frame.data, frame.size) || m_count == 0xFFFF ||
+        m_size + RECORD_HEADER_SIZE + frame.size > m_buffer.size()) {
+        return false;
+    }
+    
+    uint8_t* record = m_buffer.data() + m_size;
+    record[0] = device;
+    writeU64(record + 1, receiveTimeNs);
+    memcpy(record + RECORD_HEADER_SIZE, frame.data, frame.size);
+    m_size += RECORD_HEADER_SIZE + frame.size;
+    m_count++;
+    return true;
+}
+
+void XbusBridgeBatch::finish(uint32_t sequence) {
+    uint8_t* header = m_buffer.data();
+    writeU32(header, MAGIC);
+    header[4] = VERSION;
+    header[5] = 0;
+    writeU16(header + 6, static_cast<uint16_t>(m_count));
+    writeU32(header + 8, sequence);
+}
+
+void XbusBridgeBatch::clear() {
+    m_size = HEADER_SIZE;
+    m_count = 0;
+}
+
+const uint8_t* XbusBridgeBatch::data() const {
+    return m_buffer.data();
+}
+
+size_t XbusBridgeBatch::size() const {
+    return m_size;
+}
+
+size_t XbusBridgeBatch::capacity() const {
+    return m_buffer.size();
+}
+
+size_t XbusBridgeBatch::count() const {
+    return m_count;
+}
+
+bool XbusBridgeBatch::empty() const {
+    return m_count == 0;
+}
+
+bool XbusBridgeBatch::parse(const uint8_t* data, size_t size, const XbusBridgeCallback& callback, Info& info) {
+    info.sequence = 0;
+    info.records = 0;
+    info.invalid = 0;
+    if (data == nullptr || size < HEADER_SIZE || readU32(data) != MAGIC || data[4] != VERSION) {
+        return false;
+    }
+    
+    size_t count = readU16(data + 6);
+    info.sequence = readU32(data + 8);
+    
+    XbusBridgeRecord record;
+    record.kind = XbusBridgeRecord::Kind::Frame;
+    record.sample = nullptr;
+    size_t offset = HEADER_SIZE;
+    for (size_t i = 0; i < count; i++) {
+        // A truncated record leaves no way to find the ones after it
+        if (size - offset < RECORD_HEADER_SIZE ||
+            !Xbus::isComplete(data + offset + RECORD_HEADER_SIZE, size - offset - RECORD_HEADER_SIZE)) {
+            info.invalid += count - i;
+            break;
+        }
+        
+        const uint8_t* message = data + offset + RECORD_HEADER_SIZE;
+        size_t length = static_cast<size_t>(Xbus::getRawLength(message));
+        if (Xbus::verifyChecksum(message)) {
+            record.device = data[offset];
+            record.receiveTimeNs = readU64(data + offset + 1);
+            record.frame = XbusFrame(message, length);
+            callback(record);
+            info.records++;
+        } else {
+            info.invalid++;
+        }
+        offset += RECORD_HEADER_SIZE + length;
+    }
+    return true;
+}
+
+// XbusBridgePublisher
+
+bool XbusBridgePublisher::publishSample(uint8_t, const SensorData&, uint64_t) {
+    return true;
+}
+
+bool XbusBridgePublisher::flush() {
+    return true;
+}
+
+const XbusBridgePublisher::Stats& XbusBridgePublisher::stats() const {
+    return m_stats;
+}
+
+std::string XbusBridgePublisher::getLastError() const {
+    return m_lastError;
+}
+
+void XbusBridgePublisher::setLastError(const std::string& error) {
+    m_lastError = error;
+}
+
+// XbusBridgeSubscriber
+
+const XbusBridgeSubscriber::Stats& XbusBridgeSubscriber::stats() const {
+    return m_stats;
+}
+
+std::string XbusBridgeSubscriber::getLastError() const {
+    return m_lastError;
+}
+
+void XbusBridgeSubscriber::setLastError(const std::string& error) {
+    m_lastError = error;
+}
+
+// XbusSharedMemory
+
+XbusSharedMemory::XbusSharedMemory()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_owner(false) {
+#ifdef _WIN32
+    m_mapping = nullptr;
+#endif
+}
+
+XbusSharedMemory::~XbusSharedMemory() {
+    close();
+}
+
+std::string XbusSharedMemory::systemName(const std::string& name) {
+#ifdef _WIN32
+    return "Local\\xbus_" + name;
+#else
+    return "/xbus_" + name;
+#endif
+}
+
+bool XbusSharedMemory::create(const std::string& name, size_t size) {
+    close();
+    std::string path = systemName(name);
+
+#ifdef _WIN32
+    // A mapping lives while any process has it open, so a new creator
+    // reuses a region still mapped by subscribers
+    m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                   static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+                                   static_cast<DWORD>(size), path.c_str());
+    if (m_mapping == nullptr) {
+        m_lastError = "CreateFileMapping failed: " + systemError();
+        return false;
+    }
+    void* data = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (data == nullptr) {
+        m_lastError = "MapViewOfFile failed: " + systemError();
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+#else
+    // Subscribers of an earlier region keep their mapping of it, but new
+    // ones get this one
+    shm_unlink(path.c_str());
+    int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        m_lastError = "shm_open failed: " + systemError();
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        m_lastError = "ftruncate failed: " + systemError();
+        ::close(fd);
+        shm_unlink(path.c_str());
+        return false;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        m_lastError = "mmap failed: " + systemError();
+        shm_unlink(path.c_str());
+        return false;
+    }
+#endif
+
+    m_data = static_cast<uint8_t*>(data);
+    m_size = size;
+    m_owner = true;
+    m_name = path;
+    return true;
+}
+
+bool XbusSharedMemory::open(const std::string& name, size_t size) {
+    close();
+    std::string path = systemName(name);
+
+#ifdef _WIN32
+    m_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+    if (m_mapping == nullptr) {
+        m_lastError = "OpenFileMapping failed: " + systemError();
+        return false;
+    }
+    void* data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, size);
+    if (data == nullptr) {
+        m_lastError = "MapViewOfFile failed: " + systemError();
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+#else
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        m_lastError = "shm_open failed: " + systemError();
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < size) {
+        m_lastError = "Shared memory region is smaller than expected";
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        m_lastError = "mmap failed: " + systemError();
+        return false;
+    }
+#endif
+
+    m_data = static_cast<uint8_t*>(data);
+    m_size = size;
+    m_owner = false;
+    m_name = path;
+    return true;
+}
+
+void XbusSharedMemory::close() {
+    if (m_data == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap(m_data, m_size);
+    if (m_owner) {
+        shm_unlink(m_name.c_str());
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_owner = false;
+}
+
+bool XbusSharedMemory::isOpen() const {
+    return m_data != nullptr;
+}
+
+uint8_t* XbusSharedMemory::data() const {
+    return m_data;
+}
+
+size_t XbusSharedMemory::size() const {
+    return m_size;
+}
+
+std::string XbusSharedMemory::getLastError() const {
+    return m_lastError;
+}
+
+// XbusShmPublisher
+
+XbusShmPublisher::XbusShmPublisher()
+    : m_words(nullptr)
+    , m_capacityWords(0)
+    , m_position(0)
+    , m_checkpointBlock(UINT64_MAX) {
+}
+
+XbusShmPublisher::~XbusShmPublisher() {
+    close();
+}
+
+bool XbusShmPublisher::open(const std::string& name, size_t capacity) {
+    close();
+    uint64_t capacityWords = roundUpPow2(std::max<uint64_t>(capacity / sizeof(uint64_t), SHM_MIN_WORDS));
+    if (!m_memory.create(name, SHM_DATA_OFFSET + capacityWords * sizeof(uint64_t))) {
+        setLastError(m_memory.getLastError());
+        return false;
+    }
+    
+    ShmHeader* header = new (m_memory.data()) ShmHeader();
+    header->version = SHM_VERSION;
+    header->capacityWords = capacityWords;
+    header->reserved.store(0, std::memory_order_relaxed);
+    header->committed.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < SHM_CHECKPOINTS; i++) {
+        header->checkpoints[i].store(UINT64_MAX, std::memory_order_relaxed);
+    }
+    header->magic.store(SHM_MAGIC, std::memory_order_release);
+    
+    m_words = reinterpret_cast<std::atomic<uint64_t>*>(m_memory.data() + SHM_DATA_OFFSET);
+    m_capacityWords = capacityWords;
+    m_position = 0;
+    m_checkpointBlock = UINT64_MAX;
+    return true;
+}
+
+bool XbusShmPublisher::publishFrame(uint8_t device, const XbusFrame& frame, uint64_t receiveTimeNs) {
+    if (!isMessage(frame.data, frame.size)) {
+        ++m_stats.dropped;
+        setLastError("Not a complete Xbus message");
+        return false;
+    }
+    return publish(XbusBridgeRecord::Kind::Frame, device, receiveTimeNs, frame.data, frame.size);
+}
+
+bool XbusShmPublisher::publishSample(uint8_t device, const SensorData& sample, uint64_t receiveTimeNs) {
+    return publish(XbusBridgeRecord::Kind::Sample, device, receiveTimeNs, &sample, sizeof(sample));
+}
+
+void XbusShmPublisher::close() {
+    m_memory.close();
+    m_words = nullptr;
+    m_capacityWords = 0;
+}
+
+bool XbusShmPublisher::isOpen() const {
+    return m_memory.isOpen();
+}
+
+bool XbusShmPublisher::publish(XbusBridgeRecord::Kind kind, uint8_t device, uint64_t receiveTimeNs,
+                               const void* data, size_t size) {
+    if (!isOpen()) {
+        setLastError("Shared memory is not open");
+        return false;
+    }
+    
+    // Records up to a quarter of the ring, so a subscriber always has room
+    // to catch up
+    uint64_t words = 2 + (size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    if (words > m_capacityWords / 4) {
+        ++m_stats.dropped;
+        setLastError("Record does not fit in the ring");
+        return false;
+    }
+    
+    uint64_t index = m_position & (m_capacityWords - 1);
+    uint64_t padding = index + words > m_capacityWords ? m_capacityWords - index : 0;
+    uint64_t end = m_position + padding + words;
+    
+    // Announce the words about to be overwritten before touching them
+    ShmHeader* header = reinterpret_cast<ShmHeader*>(m_memory.data());
+    header->reserved.store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    if (padding != 0) {
+        checkpoint(m_position);
+        m_words[index].store(recordHeader(KIND_PADDING, 0, padding), std::memory_order_relaxed);
+        index = 0;
+    }
+    checkpoint(m_position + padding);
+    m_words[index].store(recordHeader(static_cast<uint8_t>(kind), device, size), std::memory_order_relaxed);
+    m_words[index + 1].store(receiveTimeNs, std::memory_order_relaxed);
+    
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    std::atomic<uint64_t>* payload = m_words + index + 2;
+    for (size_t offset = 0; offset < size; offset += sizeof(uint64_t)) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + offset, std::min(sizeof(uint64_t), size - offset));
+        payload[offset / sizeof(uint64_t)].store(word, std::memory_order_relaxed);
+    }
+    
+    header->committed.store(end, std::memory_order_release);
+    m_position = end;
+    ++m_stats.records;
+    ++m_stats.batches;
+    return true;
+}
+
+void XbusShmPublisher::checkpoint(uint64_t start) {
+    uint64_t block = start / (m_capacityWords / SHM_CHECKPOINTS);
+    if (block != m_checkpointBlock) {
+        ShmHeader* header = reinterpret_cast<ShmHeader*>(m_memory.data());
+        header->checkpoints[block % SHM_CHECKPOINTS].store(start, std::memory_order_relaxed);
+        m_checkpointBlock = block;
+    }
+}
+
+// XbusShmSubscriber
+
+XbusShmSubscriber::XbusShmSubscriber()
+    : m_words(nullptr)
+    , m_capacityWords(0)
+    , m_position(0) {
+}
+
+XbusShmSubscriber::~XbusShmSubscriber() {
+    close();
+}
+
+bool XbusShmSubscriber::open(const std::string& name) {
+    close();
+    
+    // The header tells how large the ring is
+    if (!m_memory.open(name, SHM_DATA_OFFSET)) {
+        setLastError(m_memory.getLastError());
+        return false;
+    }
+    const ShmHeader* header = reinterpret_cast<const ShmHeader*>(m_memory.data());
+    if (header->magic.load(std::memory_order_acquire) != SHM_MAGIC || header->version != SHM_VERSION) {
+        setLastError("Not an Xbus bridge ring (or its publisher is still starting)");
+        m_memory.close();
+        return false;
+    }
+    uint64_t capacityWords = header->capacityWords;
+    
+    if (!m_memory.open(name, SHM_DATA_OFFSET + capacityWords * sizeof(uint64_t))) {
+        setLastError(m_memory.getLastError());
+        return false;
+    }
+    header = reinterpret_cast<const ShmHeader*>(m_memory.data());
+    if (header->magic.load(std::memory_order_acquire) != SHM_MAGIC || header->capacityWords != capacityWords) {
+        setLastError("Publisher restarted while attaching");
+        m_memory.close();
+        return false;
+    }
+    
+    m_words = reinterpret_cast<const std::atomic<uint64_t>*>(m_memory.data() + SHM_DATA_OFFSET);
+    m_capacityWords = capacityWords;
+    m_position = header->committed.load(std::memory_order_acquire);
+    m_record.assign(capacityWords / 4, 0);
+    return true;
+}
+
+size_t XbusShmSubscriber::receive(const XbusBridgeCallback& callback, uint32_t timeoutMs) {
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+        size_t delivered = poll(callback);
+        if (delivered != 0 || !isOpen() || std::chrono::steady_clock::now() >= deadline) {
+            return delivered;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(POLL_INTERVAL_US));
+    }
+}
+
+size_t XbusShmSubscriber::poll(const XbusBridgeCallback& callback, size_t maxRecords) {
+    if (!isOpen()) {
+        return 0;
+    }
+    
+    const ShmHeader* header = reinterpret_cast<const ShmHeader*>(m_memory.data());
+    uint64_t committed = header->committed.load(std::memory_order_acquire);
+    size_t delivered = 0;
+    while (m_position != committed && delivered < maxRecords) {
+        uint64_t index = m_position & (m_capacityWords - 1);
+        uint64_t word = m_words[index].load(std::memory_order_relaxed);
+        uint8_t kind = static_cast<uint8_t>(word >> 32);
+        uint8_t device = static_cast<uint8_t>(word >> 40);
+        uint64_t size = word & 0xFFFFFFFFu;
+        uint64_t words = kind == KIND_PADDING ? size : 2 + (size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        
+        // Copy first, then check that the publisher did not lap us while we
+        // read; until then the header may be torn, so only bounds are checked
+        bool valid = words != 0 && index + words <= m_capacityWords &&
+                     (kind == KIND_PADDING || words - 1 <= m_record.size());
+        if (valid && kind != KIND_PADDING) {
+            for (uint64_t i = 1; i < words; i++) {
+                m_record[i - 1] = m_words[index + i].load(std::memory_order_relaxed);
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->reserved.load(std::memory_order_relaxed) - m_position > m_capacityWords) {
+            ++m_stats.lost;
+            m_position = oldestRecord(committed);
+            continue;
+        }
+        if (!valid) {
+            ++m_stats.invalid;
+            m_position = committed;
+            break;
+        }
+        
+        m_position += words;
+        if (kind == KIND_PADDING) {
+            continue;
+        }
+        
+        XbusBridgeRecord record;
+        record.kind = static_cast<XbusBridgeRecord::Kind>(kind);
+        record.device = device;
+        record.receiveTimeNs = m_record[0];
+        record.sample = nullptr;
+        const uint8_t* payload = reinterpret_cast<const uint8_t*>(&m_record[1]);
+        if (record.kind == XbusBridgeRecord::Kind::Frame && isMessage(payload, size)) {
+            record.frame = XbusFrame(payload, size);
+        } else if (record.kind == XbusBridgeRecord::Kind::Sample && size == sizeof(SensorData)) {
+            memcpy(&m_sample, payload, sizeof(SensorData));
+            record.sample = &m_sample;
+        } else {
+            ++m_stats.invalid;
+            continue;
+        }
+        
+        callback(record);
+        ++m_stats.records;
+        delivered++;
+    }
+    return delivered;
+}
+
+uint64_t XbusShmSubscriber::oldestRecord(uint64_t& committed) const {
+    const ShmHeader* header = reinterpret_cast<const ShmHeader*>(m_memory.data());
+    uint64_t blockWords = m_capacityWords / SHM_CHECKPOINTS;
+    for (;;) {
+        committed = header->committed.load(std::memory_order_acquire);
+        uint64_t reserved = header->reserved.load(std::memory_order_relaxed);
+        
+        // Words before reserved - capacity are being overwritten. Records are
+        // at most a quarter of the ring, so one of the following blocks has a
+        // record start unless the publisher has not got that far.
+        uint64_t position = committed;
+        for (uint64_t block = (reserved - m_capacityWords) / blockWords + 1; block * blockWords < committed; block++) {
+            uint64_t start = header->checkpoints[block % SHM_CHECKPOINTS].load(std::memory_order_relaxed);
+            if (start >= block * blockWords && start < (block + 1) * blockWords) {
+                position = std::min(start, committed);
+                break;
+            }
+        }
+        
+        // The checkpoint is only good if the publisher did not pass it meanwhile
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->reserved.load(std::memory_order_relaxed) - position <= m_capacityWords) {
+            return position;
+        }
+    }
+}
+
+void XbusShmSubscriber::close() {
+    m_memory.close();
+    m_words = nullptr;
+    m_capacityWords = 0;
+}
+
+bool XbusShmSubscriber::isOpen() const {
+    return m_memory.isOpen();
+}
+
+// XbusUdpPublisher
+
+XbusUdpPublisher::XbusUdpPublisher()
+    : m_socket(NO_SOCKET)
+    , m_datagramSize(DEFAULT_DATAGRAM_SIZE)
+    , m_sequence(0)
+    , m_batch(MAX_DATAGRAM_SIZE) {
+    memset(m_address, 0, sizeof(m_address));
+}
+
+XbusUdpPublisher::~XbusUdpPublisher() {
+    close();
+}
+
+bool XbusUdpPublisher::open(const std::string& address, uint16_t port, uint8_t ttl, size_t datagramSize) {
+    close();
+    sockaddr_in destination;
+    if (!parseAddress(address, port, destination)) {
+        setLastError("Invalid IPv4 address: " + address);
+        return false;
+    }
+    if (!startSockets()) {
+        setLastError("Winsock startup failed");
+        return false;
+    }
+    
+    intptr_t socket = static_cast<intptr_t>(::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    if (socket == NO_SOCKET) {
+        setLastError("socket failed: " + socketError());
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+    
+    if (isMulticast(destination.sin_addr)) {
+        // Looped back so subscribers on this host receive the group too
+        int hops = ttl;
+        int loop = 1;
+        if (setsockopt(socket, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast<const char*>(&hops), sizeof(hops)) != 0 ||
+            setsockopt(socket, IPPROTO_IP, IP_MULTICAST_LOOP, reinterpret_cast<const char*>(&loop), sizeof(loop)) != 0) {
+            setLastError("Multicast setup failed: " + socketError());
+            closeSocket(socket);
+            return false;
+        }
+    }
+    
+    m_socket = socket;
+    memcpy(m_address, &destination, sizeof(destination));
+    m_datagramSize = std::min(std::max(datagramSize, XbusBridgeBatch::HEADER_SIZE + XbusBridgeBatch::RECORD_HEADER_SIZE),
+                              MAX_DATAGRAM_SIZE);
+    m_batch.clear();
+    return true;
+}
+
+bool XbusUdpPublisher::publishFrame(uint8_t device, const XbusFrame& frame, uint64_t receiveTimeNs) {
+    if (!isOpen()) {
+        setLastError("Socket is not open");
+        return false;
+    }
+    
+    if (!m_batch.empty() && m_batch.size() + XbusBridgeBatch::RECORD_HEADER_SIZE + frame.size > m_datagramSize) {
+        flush();
+    }
+    if (!m_batch.add(device, frame, receiveTimeNs)) {
+        ++m_stats.dropped;
+        setLastError("Frame does not fit in a datagram");
+        return false;
+    }
+    ++m_stats.records;
+    
+    if (m_batch.size() >= m_datagramSize) {
+        return flush();
+    }
+    return true;
+}
+
+bool XbusUdpPublisher::flush() {
+    if (!isOpen() || m_batch.empty()) {
+        return true;
+    }
+    
+    m_batch.finish(m_sequence++);
+    int sent = static_cast<int>(sendto(m_socket, reinterpret_cast<const char*>(m_batch.data()),
+                                       static_cast<int>(m_batch.size()), 0,
+                                       reinterpret_cast<const sockaddr*>(m_address), sizeof(sockaddr_in)));
+    bool ok = sent == static_cast<int>(m_batch.size());
+    if (ok) {
+        ++m_stats.batches;
+    } else {
+        m_stats.dropped += m_batch.count();
+        setLastError("sendto failed: " + socketError());
+    }
+    m_batch.clear();
+    return ok;
+}
+
+void XbusUdpPublisher::close() {
+    if (m_socket != NO_SOCKET) {
+        flush();
+        closeSocket(m_socket);
+        m_socket = NO_SOCKET;
+    }
+}
+
+bool XbusUdpPublisher::isOpen() const {
+    return m_socket != NO_SOCKET;
+}
+
+// XbusUdpSubscriber
+
+XbusUdpSubscriber::XbusUdpSubscriber()
+    : m_socket(NO_SOCKET)
+    , m_haveSequence(false)
+    , m_nextSequence(0) {
+}
+
+XbusUdpSubscriber::~XbusUdpSubscriber() {
+    close();
+}
+
+bool XbusUdpSubscriber::open(const std::string& address, uint16_t port) {
+    close();
+    sockaddr_in group;
+    if (!parseAddress(address, port, group)) {
+        setLastError("Invalid IPv4 address: " + address);
+        return false;
+    }
+    if (!startSockets()) {
+        setLastError("Winsock startup failed");
+        return false;
+    }
+    
+    intptr_t socket = static_cast<intptr_t>(::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    if (socket == NO_SOCKET) {
+        setLastError("socket failed: " + socketError());
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+    
+    // Shared with other subscribers of the group, and room for bursts
+    int reuse = 1;
+    int receiveBuffer = 1 << 20;
+    setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    setsockopt(socket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receiveBuffer), sizeof(receiveBuffer));
+    
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(socket, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0) {
+        setLastError("bind failed: " + socketError());
+        closeSocket(socket);
+        return false;
+    }
+    
+    if (isMulticast(group.sin_addr)) {
+        ip_mreq membership;
+        membership.imr_multiaddr = group.sin_addr;
+        membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, reinterpret_cast<const char*>(&membership),
+                       sizeof(membership)) != 0) {
+            setLastError("Joining " + address + " failed: " + socketError());
+            closeSocket(socket);
+            return false;
+        }
+    }
+    
+    m_socket = socket;
+    m_haveSequence = false;
+    m_datagram.resize(1 << 16);
+    return true;
+}
+
+size_t XbusUdpSubscriber::receive(const XbusBridgeCallback& callback, uint32_t timeoutMs) {
+    size_t delivered = 0;
+    uint32_t wait = timeoutMs;
+    while (isOpen() && waitReadable(m_socket, wait)) {
+        int received = static_cast<int>(recv(m_socket, reinterpret_cast<char*>(m_datagram.data()),
+                                             static_cast<int>(m_datagram.size()), 0));
+        if (received < 0) {
+            setLastError("recv failed: " + socketError());
+            break;
+        }
+        delivered += deliver(static_cast<size_t>(received), callback);
+        
+        // Then whatever else already arrived, without waiting
+        wait = 0;
+    }
+    return delivered;
+}
+
+void XbusUdpSubscriber::close() {
+    if (m_socket != NO_SOCKET) {
+        closeSocket(m_socket);
+        m_socket = NO_SOCKET;
+    }
+}
+
+bool XbusUdpSubscriber::isOpen() const {
+    return m_socket != NO_SOCKET;
+}
+
+uint16_t XbusUdpSubscriber::port() const {
+    sockaddr_in local;
+    socklen_t length = sizeof(local);
+    if (!isOpen() || getsockname(m_socket, reinterpret_cast<sockaddr*>(&local), &length) != 0) {
+        return 0;
+    }
+    return ntohs(local.sin_port);
+}
+
+size_t XbusUdpSubscriber::deliver(size_t size, const XbusBridgeCallback& callback) {
+    XbusBridgeBatch::Info info;
+    if (!XbusBridgeBatch::parse(m_datagram.data(), size, callback, info)) {
+        ++m_stats.invalid;
+        return 0;
+    }
+    
+    // A sequence far behind is a restarted publisher or reordering, not loss
+    if (m_haveSequence && info.sequence != m_nextSequence) {
+        uint32_t missing = info.sequence - m_nextSequence;
+        if (missing < 0x80000000u) {
+            m_stats.lost += missing;
+        }
+    }
+    m_haveSequence = true;
+    m_nextSequence = info.sequence + 1;
+    m_stats.records += info.records;
+    m_stats.invalid += info.invalid;
+    return info.records;
+}
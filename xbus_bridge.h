@@ -0,0 +1,332 @@
+#ifndef XBUS_BRIDGE_H
+#define XBUS_BRIDGE_H
+
+#include "xbus/xbus_framer.h"
+#include "xbus/xbus_parser.h"
+#include "xbus/xbus_stats.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Distribution of one device stream to other processes.
+//
+// The process that owns the serial port publishes what it receives and any
+// number of same-host or remote processes subscribe, so the port is opened
+// (and every frame verified) once. Two transports:
+//
+//   XbusShmPublisher / XbusShmSubscriber: a broadcast ring in named shared
+//   memory. The publisher never waits for subscribers; each subscriber
+//   follows at its own pace and, when it falls a whole ring behind, skips
+//   ahead to the oldest records still intact and counts the overrun. Besides frames the ring carries decoded
+//   SensorData, so same-host consumers need not decode again.
+//
+//   XbusUdpPublisher / XbusUdpSubscriber: frames batched into datagrams
+//   (XbusBridgeBatch) and sent to a multicast group, or any unicast
+//   address. Subscribers count datagrams missing from the sequence.
+//
+// Subscribers hand out records with the frame exactly as the publisher
+// received it, so a client feeds record.frame to an XbusDispatcher, a
+// layout decoder or XbusParser as if it came from its own framer.
+//
+//     XbusShmSubscriber subscriber;
+//     subscriber.open("imu0");
+//     subscriber.receive([&](const XbusBridgeRecord& record) {
+//         if (record.kind == XbusBridgeRecord::Kind::Frame) {
+//             dispatcher.dispatch(record.device, record.frame, record.receiveTimeNs);
+//         }
+//     }, 100);
+//
+// Publishers and subscribers are not thread safe; use each from one thread.
+
+// One frame or decoded sample passed through a bridge, valid until the
+// callback returns
+struct XbusBridgeRecord {
+    enum class Kind : uint8_t {
+        Frame = 1,
+        Sample = 2      // shared memory only, the struct layout of this build
+    };
+    
+    Kind kind;
+    uint8_t device;
+    uint64_t receiveTimeNs;
+    XbusFrame frame;            // Kind::Frame, a verified Xbus message
+    const SensorData* sample;   // Kind::Sample, nullptr otherwise
+};
+
+typedef std::function<void(const XbusBridgeRecord& record)> XbusBridgeCallback;
+
+// Wire format of a UDP datagram, big-endian like Xbus itself:
+//
+//     magic (4) | version (1) | reserved (1) | record count (2) | sequence (4)
+//     per record: device (1) | receive time ns (8) | Xbus message
+//
+// Messages carry their own length, so records need no length field.
+class XbusBridgeBatch {
+public:
+    static constexpr uint32_t MAGIC = 0x58425247;  // "XBRG"
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 12;
+    static constexpr size_t RECORD_HEADER_SIZE = 9;
+    
+    struct Info {
+        uint32_t sequence;
+        size_t records;     // records delivered
+        size_t invalid;     // records dropped for a bad or truncated message
+    };
+    
+    explicit XbusBridgeBatch(size_t capacity);
+    
+    // Append a frame. False, leaving the batch unchanged, if it does not fit
+    // or is not a complete message.
+    bool add(uint8_t device, const XbusFrame& frame, uint64_t receiveTimeNs);
+    
+    // Write the header; the batch is then data()/size()
+    void finish(uint32_t sequence);
+    void clear();
+    
+    const uint8_t* data() const;
+    size_t size() const;
+    size_t capacity() const;
+    size_t count() const;
+    bool empty() const;
+    
+    // Deliver the records of a received batch. Messages are checked before
+    // they are passed on, so a damaged datagram cannot deliver a bad frame.
+    // False for data that is not a batch of this version.
+    static bool parse(const uint8_t* data, size_t size, const XbusBridgeCallback& callback, Info& info);
+
+private:
+    std::vector<uint8_t> m_buffer;
+    size_t m_size;
+    size_t m_count;
+};
+
+// Base of the publishers
+class XbusBridgePublisher {
+public:
+    // Written by the publishing thread only
+    struct Stats {
+        RelaxedCounter records;     // frames and samples published
+        RelaxedCounter batches;     // datagrams sent (UDP) or ring writes (shared memory)
+        RelaxedCounter dropped;     // records too large or lost to send errors
+    };
+    
+    virtual ~XbusBridgePublisher() = default;
+    
+    virtual bool publishFrame(uint8_t device, const XbusFrame& frame, uint64_t receiveTimeNs) = 0;
+    
+    // Decoded samples, for transports that carry them; the others ignore
+    // them and return true
+    virtual bool publishSample(uint8_t device, const SensorData& sample, uint64_t receiveTimeNs);
+    
+    // Send whatever is batched, e.g. after each serial read
+    virtual bool flush();
+    
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+    
+    const Stats& stats() const;
+    std::string getLastError() const;
+
+protected:
+    void setLastError(const std::string& error);
+    
+    Stats m_stats;
+
+private:
+    std::string m_lastError;
+};
+
+// Base of the subscribers
+class XbusBridgeSubscriber {
+public:
+    // Written by the receiving thread only
+    struct Stats {
+        RelaxedCounter records;     // records delivered
+        RelaxedCounter invalid;     // records or datagrams dropped as malformed
+        RelaxedCounter lost;        // ring overruns (shared memory) or missing datagrams (UDP)
+    };
+    
+    virtual ~XbusBridgeSubscriber() = default;
+    
+    // Deliver what arrived, waiting up to timeoutMs for the first record.
+    // Returns the number of records delivered.
+    virtual size_t receive(const XbusBridgeCallback& callback, uint32_t timeoutMs) = 0;
+    
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+    
+    const Stats& stats() const;
+    std::string getLastError() const;
+
+protected:
+    void setLastError(const std::string& error);
+    
+    Stats m_stats;
+
+private:
+    std::string m_lastError;
+};
+
+// A named shared memory region, created by one process and mapped by others
+class XbusSharedMemory {
+public:
+    XbusSharedMemory();
+    ~XbusSharedMemory();
+    
+    XbusSharedMemory(const XbusSharedMemory&) = delete;
+    XbusSharedMemory& operator=(const XbusSharedMemory&) = delete;
+    
+    // Create a fresh region of size bytes, replacing one left by an earlier
+    // creator. Mapped read/write.
+    bool create(const std::string& name, size_t size);
+    
+    // Map size bytes of an existing region read-only
+    bool open(const std::string& name, size_t size);
+    
+    // Unmap; the creator also removes the name
+    void close();
+    
+    bool isOpen() const;
+    uint8_t* data() const;
+    size_t size() const;
+    std::string getLastError() const;
+
+private:
+    static std::string systemName(const std::string& name);
+    
+    uint8_t* m_data;
+    size_t m_size;
+    bool m_owner;
+    std::string m_name;
+    std::string m_lastError;
+#ifdef _WIN32
+    void* m_mapping;
+#endif
+};
+
+// Shared memory layout: a header with the write positions, then a ring of
+// 64-bit words. Every word is written and read as a relaxed atomic and the
+// positions work like a seqlock: the publisher announces the end of a
+// record before writing it, and a subscriber that finds afterwards that a
+// record it copied may have been overwritten drops it as an overrun. The
+// header also keeps a record start for every 1/64th of the ring, where an
+// overrun subscriber resumes with the oldest records still intact.
+class XbusShmPublisher : public XbusBridgePublisher {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4 << 20;
+    
+    XbusShmPublisher();
+    ~XbusShmPublisher() override;
+    
+    // capacity is the ring size in bytes, rounded up to a power of two
+    bool open(const std::string& name, size_t capacity = DEFAULT_CAPACITY);
+    
+    bool publishFrame(uint8_t device, const XbusFrame& frame, uint64_t receiveTimeNs) override;
+    bool publishSample(uint8_t device, const SensorData& sample, uint64_t receiveTimeNs) override;
+    void close() override;
+    bool isOpen() const override;
+
+private:
+    bool publish(XbusBridgeRecord::Kind kind, uint8_t device, uint64_t receiveTimeNs, const void* data,
+                 size_t size);
+    void checkpoint(uint64_t start);
+    
+    XbusSharedMemory m_memory;
+    std::atomic<uint64_t>* m_words;
+    uint64_t m_capacityWords;
+    uint64_t m_position;
+    uint64_t m_checkpointBlock;     // block of the last checkpoint written
+};
+
+class XbusShmSubscriber : public XbusBridgeSubscriber {
+public:
+    XbusShmSubscriber();
+    ~XbusShmSubscriber() override;
+    
+    // Attach to a publisher's ring; records published from now on are
+    // received
+    bool open(const std::string& name);
+    
+    // Shared memory has no wakeup: waiting polls every POLL_INTERVAL_US
+    static constexpr uint32_t POLL_INTERVAL_US = 200;
+    size_t receive(const XbusBridgeCallback& callback, uint32_t timeoutMs) override;
+    
+    // Deliver what is in the ring without waiting, at most maxRecords
+    size_t poll(const XbusBridgeCallback& callback, size_t maxRecords = SIZE_MAX);
+    
+    void close() override;
+    bool isOpen() const override;
+
+private:
+    // First record that is still intact after an overrun, and the committed
+    // position it was found against
+    uint64_t oldestRecord(uint64_t& committed) const;
+    
+    XbusSharedMemory m_memory;
+    const std::atomic<uint64_t>* m_words;
+    uint64_t m_capacityWords;
+    uint64_t m_position;
+    std::vector<uint64_t> m_record;
+    SensorData m_sample;
+};
+
+// Datagrams of verified frames. Frames are collected until the next one
+// would not fit in datagramSize bytes (a frame larger than that is sent
+// alone), or until flush().
+class XbusUdpPublisher : public XbusBridgePublisher {
+public:
+    static constexpr size_t DEFAULT_DATAGRAM_SIZE = 1472;     // Ethernet MTU without IP and UDP headers
+    static constexpr size_t MAX_DATAGRAM_SIZE = 65507;
+    
+    XbusUdpPublisher();
+    ~XbusUdpPublisher() override;
+    
+    // address is an IPv4 multicast group or unicast address. ttl limits how
+    // many routers multicast datagrams cross; 1 keeps them on the local network.
+    bool open(const std::string& address, uint16_t port, uint8_t ttl = 1,
+              size_t datagramSize = DEFAULT_DATAGRAM_SIZE);
+    
+    bool publishFrame(uint8_t device, const XbusFrame& frame, uint64_t receiveTimeNs) override;
+    bool flush() override;
+    void close() override;
+    bool isOpen() const override;
+
+private:
+    intptr_t m_socket;
+    uint8_t m_address[16];      // sockaddr_in of the destination
+    size_t m_datagramSize;
+    uint32_t m_sequence;
+    XbusBridgeBatch m_batch;
+};
+
+class XbusUdpSubscriber : public XbusBridgeSubscriber {
+public:
+    XbusUdpSubscriber();
+    ~XbusUdpSubscriber() override;
+    
+    // Receive datagrams sent to port, joining address when it is a multicast
+    // group. Several processes on one host can subscribe to the same group.
+    // Port 0 picks a free port, see port().
+    bool open(const std::string& address, uint16_t port);
+    
+    size_t receive(const XbusBridgeCallback& callback, uint32_t timeoutMs) override;
+    void close() override;
+    bool isOpen() const override;
+    
+    // Local port, e.g. after open() with port 0
+    uint16_t port() const;
+
+private:
+    size_t deliver(size_t size, const XbusBridgeCallback& callback);
+    
+    intptr_t m_socket;
+    bool m_haveSequence;
+    uint32_t m_nextSequence;
+    std::vector<uint8_t> m_datagram;
+};
+
+#endif // XBUS_BRIDGE_H
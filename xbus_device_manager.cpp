@@ -0,0 +1,510 @@
+#include "xbus_device_manager.h"
+#include "xbus/xbus.h"
+#include "xbus/xbus_message_id.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+#endif
+
+namespace {
+
+#ifndef _WIN32
+std::string errnoString() {
+    return std::string(strerror(errno)) + " (errno " + std::to_string(errno) + ")";
+}
+#endif
+
+} // namespace
+
+struct XbusDeviceManager::Device {
+    size_t index;
+    std::string portName;
+    SerialReader serial;
+    XbusFramer framer;
+    XbusLayoutDecoder decoder;
+    
+    // Written by the device's I/O thread only
+    RelaxedCounter bytesReceived;
+    RelaxedCounter framesReceived;
+    RelaxedCounter samplesDecoded;
+    XbusClockTracker clock;
+    LatencyHistogram processingLatency;
+    std::atomic<bool> connected;
+    
+    uint8_t readBuffer[READ_BUFFER_SIZE];
+#ifdef _WIN32
+    OVERLAPPED overlapped;
+    bool readPending;
+#endif
+
+    Device(size_t deviceIndex, const std::string& name, size_t frameCapacity)
+        : index(deviceIndex)
+        , portName(name)
+        , framer(frameCapacity)
+        , connected(false) {
+#ifdef _WIN32
+        readPending = false;
+#endif
+    }
+};
+
+struct XbusDeviceManager::IoThread {
+    std::vector<Device*> devices;
+    std::thread thread;
+#ifdef _WIN32
+    HANDLE completionPort;  // ports are associated with it once, in addDevice()
+#else
+    int wakePipe[2];        // written on stop to wake the loop
+    std::vector<std::pair<Device*, bool>> ready;  // device, hangup; refilled on every wakeup
+#endif
+
+    IoThread() {
+#ifdef _WIN32
+        completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+#else
+        wakePipe[0] = -1;
+        wakePipe[1] = -1;
+#endif
+    }
+    
+    ~IoThread() {
+#ifdef _WIN32
+        if (completionPort != nullptr) {
+            CloseHandle(completionPort);
+        }
+#endif
+    }
+};
+
+XbusDeviceManager::XbusDeviceManager(size_t ioThreads, size_t frameCapacity)
+    : m_ioThreadCount(std::max<size_t>(ioThreads, 1))
+    , m_frameCapacity(frameCapacity)
+    , m_running(false) {
+    for (size_t i = 0; i < m_ioThreadCount; i++) {
+        m_ioThreads.emplace_back(new IoThread());
+    }
+}
+
+XbusDeviceManager::~XbusDeviceManager() {
+    stop();
+}
+
+int XbusDeviceManager::addDevice(const std::string& portName, DWORD baudRate) {
+    if (m_running) {
+        setLastError("Cannot add devices while running");
+        return -1;
+    }
+    
+    std::unique_ptr<Device> device(new Device(m_devices.size(), portName, m_frameCapacity));
+    
+    // The manager waits on the port itself; the reader is only used to open,
+    // configure and write to it
+    device->serial.setReadMode(SerialReader::ReadMode::EventDriven);
+    if (!device->serial.open(portName, baudRate)) {
+        setLastError(device->serial.getLastError());
+        return -1;
+    }
+    
+    // Devices are spread round robin over the I/O threads
+    IoThread& ioThread = *m_ioThreads[device->index % m_ioThreadCount];
+
+#ifdef _WIN32
+    // Complete reads as soon as any data is buffered (see
+    // SerialReader::eventReadLoop); idle reads complete empty after 1 s
+    COMMTIMEOUTS timeouts = {0};
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = 1000;
+    timeouts.WriteTotalTimeoutConstant = 50;
+    timeouts.WriteTotalTimeoutMultiplier = 10;
+    
+    HANDLE handle = device->serial.nativeHandle();
+    if (ioThread.completionPort == nullptr || !SetCommTimeouts(handle, &timeouts) ||
+        CreateIoCompletionPort(handle, ioThread.completionPort,
+                               reinterpret_cast<ULONG_PTR>(device.get()), 0) == nullptr) {
+        setLastError("Failed to attach " + portName + " to the I/O completion port. Error: " +
+                     std::to_string(GetLastError()));
+        return -1;
+    }
+#endif
+
+    device->connected = true;
+    ioThread.devices.push_back(device.get());
+    m_devices.push_back(std::move(device));
+    return static_cast<int>(m_devices.size() - 1);
+}
+
+void XbusDeviceManager::setFrameCallback(FrameCallback callback) {
+    m_frameCallback = callback;
+}
+
+void XbusDeviceManager::setSampleCallback(SampleCallback callback) {
+    m_sampleCallback = callback;
+}
+
+void XbusDeviceManager::setErrorCallback(ErrorCallback callback) {
+    m_errorCallback = callback;
+}
+
+bool XbusDeviceManager::start() {
+    if (m_running) {
+        setLastError("Already running");
+        return false;
+    }
+    
+    if (m_devices.empty()) {
+        setLastError("No devices added");
+        return false;
+    }
+    
+    m_running = true;
+    for (auto& ioThread : m_ioThreads) {
+        if (ioThread->devices.empty()) {
+            continue;
+        }
+
+#ifndef _WIN32
+        if (pipe(ioThread->wakePipe) != 0) {
+            setLastError("Failed to create wake pipe: " + errnoString());
+            stop();
+            return false;
+        }
+        fcntl(ioThread->wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(ioThread->wakePipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(ioThread->wakePipe[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+        try {
+            ioThread->thread = std::thread(&XbusDeviceManager::ioLoop, this, std::ref(*ioThread));
+        } catch (const std::system_error&) {
+            setLastError("Failed to create I/O thread");
+            stop();
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+void XbusDeviceManager::stop() {
+    if (!m_running) {
+        return;
+    }
+    
+    m_running = false;
+    for (auto& ioThread : m_ioThreads) {
+#ifdef _WIN32
+        if (ioThread->thread.joinable()) {
+            PostQueuedCompletionStatus(ioThread->completionPort, 0, 0, nullptr);
+            ioThread->thread.join();
+        }
+#else
+        if (ioThread->wakePipe[1] >= 0) {
+            uint8_t wake = 1;
+            ssize_t written = ::write(ioThread->wakePipe[1], &wake, 1);
+            (void)written;
+        }
+        if (ioThread->thread.joinable()) {
+            ioThread->thread.join();
+        }
+        for (int& fd : ioThread->wakePipe) {
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+#endif
+    }
+}
+
+bool XbusDeviceManager::isRunning() const {
+    return m_running;
+}
+
+bool XbusDeviceManager::send(size_t device, const uint8_t* data, size_t length) {
+    if (device >= m_devices.size()) {
+        return false;
+    }
+    
+    return m_devices[device]->serial.write(data, length);
+}
+
+size_t XbusDeviceManager::deviceCount() const {
+    return m_devices.size();
+}
+
+size_t XbusDeviceManager::ioThreadCount() const {
+    return m_ioThreadCount;
+}
+
+const std::string& XbusDeviceManager::portName(size_t device) const {
+    return m_devices.at(device)->portName;
+}
+
+XbusDeviceManager::DeviceStats XbusDeviceManager::stats(size_t device) const {
+    const Device& source = *m_devices.at(device);
+    
+    DeviceStats stats;
+    stats.bytesReceived = source.bytesReceived;
+    stats.framesReceived = source.framesReceived;
+    stats.samplesDecoded = source.samplesDecoded;
+    stats.packetGaps = source.clock.packetGaps().gaps;
+    stats.lostPackets = source.clock.packetGaps().lostPackets;
+    stats.clockResyncs = source.clock.resyncs();
+    stats.connected = source.connected.load(std::memory_order_relaxed);
+    stats.framer = source.framer.stats();
+    stats.processingLatency = source.processingLatency.snapshot();
+    return stats;
+}
+
+std::string XbusDeviceManager::getLastError() const {
+    return m_lastError;
+}
+
+void XbusDeviceManager::processData(Device& device, const uint8_t* data, size_t length) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    device.bytesReceived += length;
+    
+    uint64_t receiveTimeNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        start.time_since_epoch()).count());
+    
+    device.framer.feed(data, length, [this, &device, receiveTimeNs](const XbusFrame& frame) {
+        ++device.framesReceived;
+        
+        if (m_frameCallback) {
+            m_frameCallback(device.index, frame);
+        }
+        
+        // The device reports its output configuration in reply to Req- and
+        // SetOutputConfig; lock the decoder onto it before the first packet
+        uint8_t messageId = Xbus::getMessageId(frame.data);
+        if (messageId == XMID_OutputConfig) {
+            device.decoder.learnFromOutputConfig(frame.data);
+        }
+        
+        if (m_sampleCallback && messageId == XMID_MtData2) {
+            TaggedSample sample;
+            if (device.decoder.decode(frame.data, sample.data)) {
+                sample.device = device.index;
+                sample.sequence = device.samplesDecoded;
+                ++device.samplesDecoded;
+                XbusClockTracker::Sample timing = device.clock.update(sample.data, receiveTimeNs);
+                sample.timestampNs = timing.hostTimeNs;
+                sample.lostPackets = timing.lostPackets;
+                m_sampleCallback(sample);
+            }
+        }
+    });
+    
+    device.processingLatency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count()));
+}
+
+void XbusDeviceManager::failDevice(Device& device, const std::string& error) {
+    if (!device.connected.exchange(false)) {
+        return;
+    }
+    
+    if (m_errorCallback) {
+        m_errorCallback(device.index, error);
+    }
+}
+
+void XbusDeviceManager::setLastError(const std::string& error) {
+    m_lastError = error;
+}
+
+#ifdef _WIN32
+
+void XbusDeviceManager::ioLoop(IoThread& ioThread) {
+    // One overlapped read stays outstanding per device; its completion
+    // packet carries the device as the completion key
+    size_t pendingReads = 0;
+    auto issueRead = [this, &pendingReads](Device& device) {
+        memset(&device.overlapped, 0, sizeof(device.overlapped));
+        if (!ReadFile(device.serial.nativeHandle(), device.readBuffer, READ_BUFFER_SIZE,
+                      nullptr, &device.overlapped) && GetLastError() != ERROR_IO_PENDING) {
+            failDevice(device, "Failed to read from " + device.portName + ". Error: " +
+                       std::to_string(GetLastError()));
+            return;
+        }
+        device.readPending = true;
+        pendingReads++;
+    };
+    
+    for (Device* device : ioThread.devices) {
+        if (device->connected) {
+            issueRead(*device);
+        }
+    }
+    
+    // After the stop packet, cancel the outstanding reads and keep going
+    // until their completions are in, so no read targets a freed buffer
+    bool stopping = false;
+    while (!stopping || pendingReads > 0) {
+        DWORD bytesRead = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(ioThread.completionPort, &bytesRead, &key,
+                                            &overlapped, INFINITE);
+        
+        if (overlapped == nullptr) {
+            if (!ok) {
+                break; // The completion port itself failed
+            }
+            stopping = true;
+            for (Device* device : ioThread.devices) {
+                if (device->readPending) {
+                    CancelIoEx(device->serial.nativeHandle(), &device->overlapped);
+                }
+            }
+            continue;
+        }
+        
+        Device& device = *reinterpret_cast<Device*>(key);
+        device.readPending = false;
+        pendingReads--;
+        
+        if (!ok) {
+            DWORD error = GetLastError();
+            if (!stopping && error != ERROR_OPERATION_ABORTED) {
+                failDevice(device, "Read from " + device.portName + " failed. Error: " +
+                           std::to_string(error));
+            }
+            continue;
+        }
+        
+        if (bytesRead > 0) {
+            processData(device, device.readBuffer, bytesRead);
+        }
+        
+        if (!stopping && device.connected) {
+            issueRead(device);
+        }
+    }
+}
+
+#else
+
+void XbusDeviceManager::ioLoop(IoThread& ioThread) {
+    const int wakeFd = ioThread.wakePipe[0];
+    size_t activeDevices = 0;
+
+#if defined(__linux__)
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        for (Device* device : ioThread.devices) {
+            failDevice(*device, "Failed to create epoll instance: " + errnoString());
+        }
+        return;
+    }
+    
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    for (Device* device : ioThread.devices) {
+        if (device->connected) {
+            event.data.ptr = device;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, device->serial.nativeHandle(), &event);
+            activeDevices++;
+        }
+    }
+    
+    std::vector<epoll_event> events(ioThread.devices.size() + 1);
+#else
+    // pollfds[0] is the wake pipe, pollfds[i + 1] belongs to devices[i]
+    std::vector<pollfd> pollfds(ioThread.devices.size() + 1);
+    pollfds[0] = { wakeFd, POLLIN, 0 };
+    for (size_t i = 0; i < ioThread.devices.size(); i++) {
+        Device* device = ioThread.devices[i];
+        pollfds[i + 1] = { device->connected ? device->serial.nativeHandle() : -1, POLLIN, 0 };
+        activeDevices += device->connected ? 1 : 0;
+    }
+#endif
+
+    // Reserved once so a wakeup never allocates
+    std::vector<std::pair<Device*, bool>>& ready = ioThread.ready;
+    ready.reserve(ioThread.devices.size());
+    
+    bool stopRequested = false;
+    while (!stopRequested && activeDevices > 0) {
+        // Collect the devices that have data or hung up
+        ready.clear();
+#if defined(__linux__)
+        int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == nullptr) {
+                stopRequested = true;
+            } else {
+                ready.emplace_back(static_cast<Device*>(events[i].data.ptr),
+                                   (events[i].events & (EPOLLHUP | EPOLLERR)) != 0);
+            }
+        }
+#else
+        int count = poll(pollfds.data(), pollfds.size(), -1);
+        if (count > 0) {
+            stopRequested = (pollfds[0].revents & POLLIN) != 0;
+            for (size_t i = 0; i < ioThread.devices.size(); i++) {
+                short revents = pollfds[i + 1].revents;
+                if (revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) {
+                    ready.emplace_back(ioThread.devices[i], (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0);
+                }
+            }
+        }
+#endif
+        if (count < 0 && errno != EINTR) {
+            for (Device* device : ioThread.devices) {
+                failDevice(*device, "Failed to wait for data: " + errnoString());
+            }
+            break;
+        }
+        
+        if (stopRequested) {
+            break;
+        }
+        
+        for (auto& entry : ready) {
+            Device& device = *entry.first;
+            
+            // Drain everything the driver has buffered
+            int bytesRead;
+            while ((bytesRead = device.serial.readAvailable(device.readBuffer, READ_BUFFER_SIZE)) > 0) {
+                processData(device, device.readBuffer, bytesRead);
+            }
+            
+            if (bytesRead == 0 && !entry.second) {
+                continue;
+            }
+            
+            failDevice(device, bytesRead < 0 ? device.serial.getLastError()
+                                             : "Serial device " + device.portName + " disconnected");
+            activeDevices--;
+#if defined(__linux__)
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, device.serial.nativeHandle(), nullptr);
+#else
+            for (size_t i = 0; i < ioThread.devices.size(); i++) {
+                if (ioThread.devices[i] == &device) {
+                    pollfds[i + 1].fd = -1;
+                }
+            }
+#endif
+        }
+    }
+
+#if defined(__linux__)
+    ::close(epollFd);
+#endif
+}
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef XBUS_DEVICE_MANAGER_H
+#define XBUS_DEVICE_MANAGER_H
+
+#include "serial_reader.h"
+#include "xbus/xbus_clock_tracker.h"
+#include "xbus/xbus_framer.h"
+#include "xbus/xbus_layout_decoder.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Drives many Xbus devices from a small pool of I/O threads.
+//
+// Every device is opened through its own SerialReader but no per-device
+// read thread is started. Instead each device is assigned to one of the
+// pool's I/O threads (round robin), which waits on all of its ports at
+// once with epoll (poll on other POSIX systems) or an I/O completion port
+// on Windows. Each device keeps its own framer and layout decoder, so the
+// streams are framed independently, and everything a device produces is
+// tagged with its index.
+//
+// Callbacks run on the I/O thread that owns the device: callbacks for one
+// device are never concurrent, callbacks for devices on different threads
+// can be. Keep them short or hand the data to a queue (SpscQueue per I/O
+// thread) so one slow consumer does not delay the other ports.
+//
+// An XMID_OutputConfig reply (to XbusCommand::REQ_OUTPUT_CONFIG or an
+// XbusOutputConfig sent in config mode) sets up the device's decoder for
+// the packet layout that follows.
+class XbusDeviceManager {
+public:
+    // Decoded MTData2 packet of one device
+    struct TaggedSample {
+        size_t device;          // index returned by addDevice()
+        uint64_t sequence;      // per-device count of decoded samples
+        uint64_t timestampNs;   // host steady clock time of the sample, see XbusClockTracker
+        uint16_t lostPackets;   // samples missing right before this one
+        SensorData data;
+    };
+    
+    struct DeviceStats {
+        uint64_t bytesReceived;
+        uint64_t framesReceived;
+        uint64_t samplesDecoded;
+        uint64_t packetGaps;    // packet counter discontinuities in decoded samples
+        uint64_t lostPackets;   // samples missing in those gaps
+        uint64_t clockResyncs;  // device clock restarts seen by the clock tracker
+        bool connected;         // false after a read error or hangup
+        XbusFramer::Stats framer;
+        LatencyHistogram::Snapshot processingLatency;  // per read, until all callbacks returned
+    };
+    
+    typedef std::function<void(size_t device, const XbusFrame& frame)> FrameCallback;
+    typedef std::function<void(const TaggedSample& sample)> SampleCallback;
+    typedef std::function<void(size_t device, const std::string& error)> ErrorCallback;
+    
+    static constexpr size_t DEFAULT_IO_THREADS = 2;
+    
+    // frameCapacity is the framer buffer of every device and so the largest
+    // frame accepted (see XbusFramer)
+    explicit XbusDeviceManager(size_t ioThreads = DEFAULT_IO_THREADS,
+                               size_t frameCapacity = XbusFramer::DEFAULT_CAPACITY);
+    ~XbusDeviceManager();
+    
+    XbusDeviceManager(const XbusDeviceManager&) = delete;
+    XbusDeviceManager& operator=(const XbusDeviceManager&) = delete;
+    
+    // Open a port and add it to the pool. Returns the device index, or -1
+    // with getLastError() set. Devices can only be added while stopped.
+    int addDevice(const std::string& portName, DWORD baudRate = 115200);
+    
+    // Called for every valid frame of every device
+    void setFrameCallback(FrameCallback callback);
+    
+    // Called for every MTData2 frame that decodes successfully
+    void setSampleCallback(SampleCallback callback);
+    
+    // Called once when a device fails; the device is then left idle
+    void setErrorCallback(ErrorCallback callback);
+    
+    // Start/stop the I/O threads
+    bool start();
+    void stop();
+    bool isRunning() const;
+    
+    // Send a raw (preamble to checksum) message to one device. Safe to call
+    // from any thread while the pool is running.
+    bool send(size_t device, const uint8_t* data, size_t length);
+    
+    size_t deviceCount() const;
+    size_t ioThreadCount() const;
+    const std::string& portName(size_t device) const;
+    
+    // Snapshot of a device's counters; safe to call while running. Packet
+    // gaps and the clock are only tracked while a sample callback is set.
+    DeviceStats stats(size_t device) const;
+    
+    std::string getLastError() const;
+
+private:
+    static constexpr size_t READ_BUFFER_SIZE = 1024;
+    
+    struct Device;
+    struct IoThread;
+    
+    void ioLoop(IoThread& ioThread);
+    void processData(Device& device, const uint8_t* data, size_t length);
+    void failDevice(Device& device, const std::string& error);
+    void setLastError(const std::string& error);
+    
+    std::vector<std::unique_ptr<Device>> m_devices;
+    std::vector<std::unique_ptr<IoThread>> m_ioThreads;
+    size_t m_ioThreadCount;
+    size_t m_frameCapacity;
+    std::atomic<bool> m_running;
+    std::string m_lastError;
+    
+    FrameCallback m_frameCallback;
+    SampleCallback m_sampleCallback;
+    ErrorCallback m_errorCallback;
+};
+
+#endif // XBUS_DEVICE_MANAGER_H